@@ -0,0 +1,610 @@
+/**
+ * @file bench.c
+ *
+ * Microbenchmarks of the hot kernels.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _DEFAULT_SOURCE
+/// @endcond
+
+#include "bench.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "flags.h"
+#include "parse.h"
+#include "pool.h"
+#include "types.h"
+#include "util.h"
+
+/**
+ * Number of hardware counters read by a meter.
+ */
+#define BENCH_COUNTERS 4
+
+/**
+ * Minimum time to measure each kernel for, in seconds.
+ */
+#define BENCH_SECONDS 0.5
+
+/**
+ * Maximum length of a search term derived from the records.
+ */
+#define TERM_MAX 32
+
+/**
+ * Times and counts the hardware events of the calls of a kernel.
+ *
+ * The counters are opened as a group, so they are enabled and disabled
+ * together. Counters the processor or the system does not provide are not
+ * reported, and if none can be opened only the time is measured.
+ */
+struct meter {
+    int group;                      ///< Group leader, -1 for timing only
+    int counters[BENCH_COUNTERS];   ///< Counter descriptors, -1 if missing
+    struct timespec start;          ///< Time the meter was resumed
+    double elapsed;                 ///< Time measured in seconds
+};
+
+/**
+ * Record types, with the print function that describes each.
+ */
+static const struct {
+    enum NavaidType type;   ///< The type of record
+    const char *name;       ///< The name of the type
+    const char *print;      ///< The print function, NULL if not printed
+} record_types[] = {
+    { NDB, "NDB", "print_common" },
+    { VOR, "VOR", "print_common" },
+    { ILS, "ILS", "print_loc" },
+    { LOC, "LOC", "print_loc" },
+    { GS, "GS", NULL },
+    { OM, "OM", NULL },
+    { MM, "MM", NULL },
+    { IM, "IM", NULL },
+    { DME, "DME", "print_dme" },
+    { SDM, "SDM", "print_dme" }
+};
+
+/**
+ * Number of record types.
+ */
+#define RECORD_TYPES (sizeof(record_types) / sizeof(record_types[0]))
+
+/**
+ * Opens a meter that only measures time.
+ *
+ * @param meter the meter to open
+ */
+static void open_timer(struct meter *meter)
+{
+    meter->group = -1;
+    meter->elapsed = 0;
+    for (int i = 0; i < BENCH_COUNTERS; ++i)
+        meter->counters[i] = -1;
+}
+
+/**
+ * Opens the hardware counters of a meter.
+ *
+ * Counts instructions, cycles, branch misses and cache misses in user
+ * space with perf_event_open. If no counter can be opened, for example
+ * because the system does not allow it, a message is printed to standard
+ * error and the meter only measures time.
+ *
+ * @param meter the meter to open
+ */
+static void open_meter(struct meter *meter)
+{
+    open_timer(meter);
+#ifdef __linux__
+    static const uint64_t events[BENCH_COUNTERS] = {
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    int error = 0;
+    for (int i = 0; i < BENCH_COUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = events[i];
+        attr.disabled = meter->group == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP
+            | PERF_FORMAT_TOTAL_TIME_ENABLED
+            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1,
+            meter->group, 0);
+        if (fd == -1 && error == 0)
+            error = errno;
+        if (fd != -1 && meter->group == -1)
+            meter->group = fd;
+        meter->counters[i] = fd;
+    }
+    if (meter->group == -1)
+        fprintf(stderr, "Hardware counters unavailable (%s), timing only\n",
+            strerror(error));
+#else
+    fputs("Hardware counters unavailable, timing only\n", stderr);
+#endif
+}
+
+/**
+ * Closes the hardware counters of a meter.
+ *
+ * @param meter the meter to close
+ */
+static void close_meter(struct meter *meter)
+{
+    for (int i = 0; i < BENCH_COUNTERS; ++i)
+        if (meter->counters[i] != -1)
+            close(meter->counters[i]);
+}
+
+/**
+ * Returns the time between two points in seconds.
+ *
+ * @param start the start time
+ * @param end the end time
+ * @return the elapsed time in seconds
+ */
+static double seconds(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec)
+        + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Starts measuring with a meter.
+ *
+ * @param meter the meter
+ */
+void resume_meter(struct meter *meter)
+{
+#ifdef __linux__
+    if (meter->group != -1)
+        ioctl(meter->group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &meter->start);
+}
+
+/**
+ * Stops measuring with a meter, adding to what it has measured.
+ *
+ * @param meter the meter
+ */
+void pause_meter(struct meter *meter)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef __linux__
+    if (meter->group != -1)
+        ioctl(meter->group, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    meter->elapsed += seconds(&meter->start, &end);
+}
+
+/**
+ * Discards what a meter has measured.
+ *
+ * @param meter the meter
+ */
+static void reset_meter(struct meter *meter)
+{
+#ifdef __linux__
+    if (meter->group != -1)
+        ioctl(meter->group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+#endif
+    meter->elapsed = 0;
+}
+
+/**
+ * Reads the hardware counters of a meter.
+ *
+ * Counts are scaled up if the counters were multiplexed with others, so
+ * were not running for all of the time they were enabled.
+ *
+ * @param meter the meter
+ * @param counts receives the count of each counter, NAN if missing
+ */
+static void read_meter(const struct meter *meter, double *counts)
+{
+    for (int i = 0; i < BENCH_COUNTERS; ++i)
+        counts[i] = NAN;
+    if (meter->group == -1)
+        return;
+
+    uint64_t values[3 + BENCH_COUNTERS];
+    if (read(meter->group, values, sizeof(values)) < 0) {
+        perror("read");
+        exit(EXIT_FAILURE);
+    }
+    double scale = 1;
+    if (values[2] > 0 && values[2] < values[1])
+        scale = (double)values[1] / values[2];
+    uint64_t n = 0;
+    for (int i = 0; i < BENCH_COUNTERS && n < values[0]; ++i)
+        if (meter->counters[i] != -1)
+            counts[i] = values[3 + n++] * scale;
+}
+
+/**
+ * Redirects standard output to the null device.
+ *
+ * @return a descriptor of the original standard output
+ */
+static int silence(void)
+{
+    fflush(stdout);
+    int saved, null;
+    if ((saved = dup(STDOUT_FILENO)) == -1
+        || (null = open("/dev/null", O_WRONLY)) == -1
+        || dup2(null, STDOUT_FILENO) == -1) {
+        perror("/dev/null");
+        exit(EXIT_FAILURE);
+    }
+    close(null);
+    return saved;
+}
+
+/**
+ * Restores standard output after it was silenced.
+ *
+ * @param saved the descriptor of the original standard output
+ */
+static void restore(int saved)
+{
+    fflush(stdout);
+    if (dup2(saved, STDOUT_FILENO) == -1) {
+        perror("dup2");
+        exit(EXIT_FAILURE);
+    }
+    close(saved);
+}
+
+/**
+ * Measures a kernel and prints its costs per call to standard output.
+ *
+ * The kernel is run once to warm up, then repeatedly over the records
+ * until it has been measured for at least BENCH_SECONDS.
+ *
+ * @param meter the meter
+ * @param name the name of the kernel
+ * @param run the kernel
+ * @param records the inputs to the kernel
+ * @param term a search term, for kernels that match (otherwise NULL)
+ */
+static void measure(struct meter *meter, const char *name, kernel run,
+    const struct records *records, const char *term)
+{
+    if (records->count == 0)
+        return;
+
+    bool quiet = run == bench_describe;
+    int saved = quiet ? silence() : -1;
+    run(meter, records, term);
+    reset_meter(meter);
+    long calls = 0;
+    do
+        calls += run(meter, records, term);
+    while (meter->elapsed < BENCH_SECONDS);
+    if (quiet)
+        restore(saved);
+
+    double counts[BENCH_COUNTERS];
+    read_meter(meter, counts);
+    printf("%-20s %10ld %9.1f", name, calls, meter->elapsed * 1e9 / calls);
+    for (int i = 0; i < BENCH_COUNTERS; ++i) {
+        if (isnan(counts[i]))
+            printf(" %13s", "-");
+        else
+            printf(" %13.1f", counts[i] / calls);
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+/**
+ * Adds a record to a set of records.
+ *
+ * @param records the records
+ * @param line the record
+ */
+static void add_record(struct records *records, const char *line)
+{
+    size_t n = strlen(line) + 1;
+    records->text = reserve(records->text, &records->capacity,
+        records->size + n, 1);
+    records->offsets = reserve(records->offsets, &records->limit,
+        records->count + 1, sizeof(size_t));
+    records->offsets[records->count++] = records->size;
+    memcpy(records->text + records->size, line, n);
+    records->size += n;
+}
+
+/**
+ * Parses the navaids of a set of records, once all have been added.
+ *
+ * The navaids are parsed from a copy of the text, which the text fields
+ * of the navaids refer to, and their details are decoded.
+ *
+ * @param records the records
+ */
+static void finish_records(struct records *records)
+{
+    size_t size = records->count * sizeof(struct navaid);
+    if ((records->storage = malloc(records->size + 1)) == NULL
+        || (records->navaids = malloc(size + 1)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(records->storage, records->text, records->size);
+    for (int i = 0; i < records->count; ++i) {
+        parse(records->storage + records->offsets[i], &records->navaids[i]);
+        parse_details(&records->navaids[i]);
+    }
+}
+
+/**
+ * Frees the memory used by a set of records.
+ *
+ * @param records the records
+ */
+static void free_records(struct records *records)
+{
+    free(records->text);
+    free(records->offsets);
+    free(records->storage);
+    free(records->navaids);
+}
+
+/**
+ * Records a row of the navigation data file.
+ *
+ * The header, blank lines and the end of data marker are skipped.
+ *
+ * @param row the row, without its newline
+ * @param data a pointer to the records
+ */
+static void record_row(char *row, void *data)
+{
+    static long line;
+    size_t n = strlen(row);
+    if (n > 0 && row[n - 1] == '\r')
+        row[--n] = '\0';
+    if (++line <= 2 || n == 0)
+        return;
+
+    long type = strtol(row, NULL, 10);
+    for (size_t i = 0; i < RECORD_TYPES; ++i)
+        if (record_types[i].type == type)
+            add_record(data, row);
+}
+
+/**
+ * Selects the records of some types from a set of records.
+ *
+ * @param all the records to select from
+ * @param types a bit mask of the record types to select
+ * @param selected receives the selected records
+ */
+static void select_records(const struct records *all, uint64_t types,
+    struct records *selected)
+{
+    memset(selected, 0, sizeof(struct records));
+    for (int i = 0; i < all->count; ++i)
+        if (types & (UINT64_C(1) << all->navaids[i].type))
+            add_record(selected, all->text + all->offsets[i]);
+    finish_records(selected);
+}
+
+/**
+ * Derives search terms from a navaid in the records.
+ *
+ * The terms are its code, a glob pattern that matches codes beginning
+ * with the same letter, and the first word of its name in uppercase.
+ *
+ * @param records the records
+ * @param code receives the code
+ * @param pattern receives the glob pattern
+ * @param word receives the first word of the name
+ */
+static void derive_terms(const struct records *records, char *code,
+    char *pattern, char *word)
+{
+    const struct navaid *navaid = &records->navaids[records->count / 2];
+    snprintf(code, TERM_MAX, "%s", navaid->code);
+    snprintf(pattern, TERM_MAX, "%c*", navaid->code[0]);
+    size_t n = 0;
+    for (const char *p = navaid->name; *p != '\0' && *p != ' '; ++p)
+        if (n + 1 < TERM_MAX)
+            word[n++] = toupper((unsigned char)*p);
+    word[n] = '\0';
+}
+
+/**
+ * Finds the navigation data file in FG_ROOT.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * FG_ROOT is not set or holds no navigation data.
+ *
+ * @return the path of the file, to be freed after use
+ */
+static char *find_navdata(void)
+{
+    const char *fg_root = getenv("FG_ROOT");
+    if (fg_root == NULL) {
+        fputs("Set FG_ROOT or give the path of a navigation data file\n",
+            stderr);
+        exit(EXIT_FAILURE);
+    }
+    const char *names[] = { "Navaids/nav.dat", "Navaids/nav.dat.gz" };
+    for (int i = 0; i < 2; ++i) {
+        char *path = data_path(fg_root, names[i]);
+        if (access(path, R_OK) == 0)
+            return path;
+        free(path);
+    }
+    fputs("No navigation data found in FG_ROOT\n", stderr);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Measures a name search scan on one thread and on a thread pool.
+ *
+ * The counters of a meter only count the calling thread, so the scan on
+ * the pool is timed with a timer instead. The pool has a thread for each
+ * online processor, and at least two.
+ *
+ * @param meter the meter for the scan on one thread
+ * @param records the navaids to scan
+ * @param term the search term, in uppercase
+ */
+static void measure_scan(struct meter *meter, const struct records *records,
+    const char *term)
+{
+    extern struct flags flags;
+    flags.fuzzy |= 1;
+    struct pool *pool = create_pool(1);
+    use_scan_pool(pool);
+    measure(meter, "scan 1 thread", bench_scan, records, term);
+    destroy_pool(pool);
+
+    pool = create_pool(0);
+    if (pool_size(pool) < 2) {
+        destroy_pool(pool);
+        pool = create_pool(2);
+    }
+    char name[TERM_MAX];
+    snprintf(name, sizeof(name), "scan %d threads", pool_size(pool));
+    struct meter timer;
+    open_timer(&timer);
+    use_scan_pool(pool);
+    measure(&timer, name, bench_scan, records, term);
+    use_scan_pool(NULL);
+    destroy_pool(pool);
+    flags.fuzzy = 0;
+}
+
+/**
+ * Prints usage information to standard output.
+ */
+static void print_usage(void)
+{
+    puts("Usage: nvs-bench [<nav.dat>]");
+    puts("Measures the hot kernels of nvs over the records of a navigation"
+         " data file");
+    puts("(default: the nav.dat or nav.dat.gz in FG_ROOT)");
+}
+
+/**
+ * Main entry point of the microbenchmarks.
+ *
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ * @return the exit status
+ */
+int main(int argc, char *argv[])
+{
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        print_usage();
+        return argc == 2 && strcmp(argv[1], "--help") == 0
+            ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    char *path = argc == 2 ? strdup_f(argv[1]) : find_navdata();
+
+    struct records all;
+    memset(&all, 0, sizeof(all));
+    read_rows(path, record_row, &all);
+    if (all.count == 0) {
+        fprintf(stderr, "No navaids in %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    finish_records(&all);
+    fprintf(stderr, "%d records from %s\n", all.count, path);
+    free(path);
+
+    static char buffer[BUFSIZ];
+    setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+
+    struct meter meter;
+    open_meter(&meter);
+    printf("%-20s %10s %9s %13s %13s %13s %13s\n", "kernel", "calls",
+        "ns/call", "instructions", "cycles", "branch-misses", "cache-misses");
+
+    measure(&meter, "preprocess", bench_preprocess, &all, NULL);
+
+    uint64_t printed = 0;
+    char name[TERM_MAX * 2];
+    for (size_t i = 0; i < RECORD_TYPES; ++i) {
+        struct records selected;
+        uint64_t type = UINT64_C(1) << record_types[i].type;
+        select_records(&all, type, &selected);
+        snprintf(name, sizeof(name), "parse %s", record_types[i].name);
+        measure(&meter, name, bench_parse, &selected, NULL);
+        if (record_types[i].print != NULL) {
+            snprintf(name, sizeof(name), "%s %s", record_types[i].print,
+                record_types[i].name);
+            measure(&meter, name, bench_describe, &selected, NULL);
+            printed |= type;
+        }
+        free_records(&selected);
+    }
+
+    char code[TERM_MAX], pattern[TERM_MAX], word[TERM_MAX];
+    derive_terms(&all, code, pattern, word);
+    measure(&meter, "match code", bench_match, &all, code);
+    measure(&meter, "match glob", bench_match, &all, pattern);
+    extern struct flags flags;
+    flags.fuzzy |= 1;
+    measure(&meter, "match fuzzy", bench_match, &all, word);
+    flags.fuzzy = 0;
+    measure_scan(&meter, &all, word);
+
+    struct records stations;
+    select_records(&all, printed, &stations);
+    measure(&meter, "morse", bench_morse, &stations, NULL);
+    measure(&meter, "format_coordinate", bench_format_coordinate, &all,
+        NULL);
+    free_records(&stations);
+
+    close_meter(&meter);
+    free_records(&all);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file bench.h
+ *
+ * Microbenchmarks of the hot kernels.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef bench_h
+#define bench_h
+
+#include <stddef.h>
+
+struct meter;
+struct navaid;
+struct pool;
+
+/**
+ * Records from a navigation data file, recorded as inputs to the kernels.
+ *
+ * The text is kept pristine, so kernels that modify a record in place can
+ * work on a fresh copy of it for every pass.
+ */
+struct records {
+    char *text;             ///< Records, each terminated, in file order
+    size_t size;            ///< Size of the text in bytes
+    size_t capacity;        ///< Capacity of the text in bytes
+    size_t *offsets;        ///< Offset of each record in the text
+    size_t limit;           ///< Capacity of the offsets array
+    char *storage;          ///< Copy of the text that the navaids refer to
+    struct navaid *navaids; ///< Navaid parsed from each record
+    int count;              ///< Number of records
+};
+
+/**
+ * Runs one pass of a kernel over the records.
+ *
+ * The meter is paused when the function is called and must be paused when
+ * it returns, so that preparing the inputs is not measured.
+ *
+ * @param meter the meter to resume around the calls of the kernel
+ * @param records the inputs to the kernel
+ * @param term a search term, for kernels that match (otherwise NULL)
+ * @return the number of calls of the kernel
+ */
+typedef long (*kernel)(struct meter *meter, const struct records *records,
+    const char *term);
+
+long bench_describe(struct meter *meter, const struct records *records,
+    const char *term);
+long bench_format_coordinate(struct meter *meter,
+    const struct records *records, const char *term);
+long bench_match(struct meter *meter, const struct records *records,
+    const char *term);
+long bench_morse(struct meter *meter, const struct records *records,
+    const char *term);
+long bench_parse(struct meter *meter, const struct records *records,
+    const char *term);
+long bench_preprocess(struct meter *meter, const struct records *records,
+    const char *term);
+long bench_scan(struct meter *meter, const struct records *records,
+    const char *term);
+void use_scan_pool(struct pool *pool);
+void pause_meter(struct meter *meter);
+void resume_meter(struct meter *meter);
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file bench_cache.c
+ *
+ * Kernels of the navigation data cache, for benchmarking.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include <string.h>
+
+#include "internal.h"
+#include "parse.h"
+#include "types.h"
+#include "util.h"
+
+/**
+ * Results of the kernels, kept so that the calls are not optimized away.
+ */
+static volatile long sink;
+
+/**
+ * Preprocesses every record.
+ *
+ * Records are recorded without carriage returns, so the records are left
+ * as they are, as they are for data files with Unix line endings.
+ *
+ * @param meter the meter to resume around the calls of the kernel
+ * @param records the inputs to the kernel
+ * @param term unused
+ * @return the number of calls of the kernel
+ */
+long bench_preprocess(struct meter *meter, const struct records *records,
+    const char *term)
+{
+    (void)term;
+    long length = 0;
+    resume_meter(meter);
+    for (int i = 0; i < records->count; ++i) {
+        size_t end = i + 1 < records->count ? records->offsets[i + 1]
+            : records->size;
+        char *s = records->text + records->offsets[i];
+        length += preprocess(s, records->text + end - 1);
+    }
+    pause_meter(meter);
+    sink += length;
+    return records->count;
+}
+
+/**
+ * Parses every record from a fresh copy of the text.
+ *
+ * @param meter the meter to resume around the calls of the kernel
+ * @param records the inputs to the kernel
+ * @param term unused
+ * @return the number of calls of the kernel
+ */
+long bench_parse(struct meter *meter, const struct records *records,
+    const char *term)
+{
+    (void)term;
+    static char *text;
+    static size_t capacity;
+    text = reserve(text, &capacity, records->size, 1);
+    memcpy(text, records->text, records->size);
+
+    struct navaid navaid;
+    resume_meter(meter);
+    for (int i = 0; i < records->count; ++i)
+        parse(text + records->offsets[i], &navaid);
+    pause_meter(meter);
+    return records->count;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file bench_search.c
+ *
+ * Kernels of searching and printing, for benchmarking.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "flags.h"
+#include "internal.h"
+#include "morse.h"
+#include "types.h"
+#include "util.h"
+
+/**
+ * Results of the kernels, kept so that the calls are not optimized away.
+ */
+static volatile long sink;
+
+/**
+ * Thread pool that the scan kernel runs on.
+ */
+static struct pool *scan_pool;
+
+/**
+ * Sets the thread pool that the scan kernel runs on.
+ *
+ * @param pool a thread pool (may be NULL)
+ */
+void use_scan_pool(struct pool *pool)
+{
+    scan_pool = pool;
+}
+
+/**
+ * Prints every navaid, through the print function for its type.
+ *
+ * Standard output is flushed within the measurement, so writing the
+ * output is included in the cost.
+ *
+ * @param meter the meter to resume around the calls of the kernel
+ * @param records the inputs to the kernel
+ * @param term unused
+ * @return the number of calls of the kernel
+ */
+long bench_describe(struct meter *meter, const struct records *records,
+    const char *term)
+{
+    (void)term;
+    long printed = 0;
+    resume_meter(meter);
+    for (int i = 0; i < records->count; ++i)
+        printed += describe(&records->navaids[i]);
+    fflush(stdout);
+    pause_meter(meter);
+    sink += printed;
+    return records->count;
+}
+
+/**
+ * Formats the coordinate of every navaid.
+ *
+ * @param meter the meter to resume around the calls of the kernel
+ * @param records the inputs to the kernel
+ * @param term unused
+ * @return the number of calls of the kernel
+ */
+long bench_format_coordinate(struct meter *meter,
+    const struct records *records, const char *term)
+{
+    (void)term;
+    extern struct flags flags;
+    int coordinates = flags.coordinates;
+    flags.coordinates |= 1;
+
+    long length = 0;
+    resume_meter(meter);
+    for (int i = 0; i < records->count; ++i)
+        length += *format_coordinate(records->navaids[i].coordinate);
+    pause_meter(meter);
+    sink += length;
+
+    flags.coordinates = coordinates;
+    return records->count;
+}
+
+/**
+ * Matches every navaid against a search term.
+ *
+ * @param meter the meter to resume around the calls of the kernel
+ * @param records the inputs to the kernel
+ * @param term the search term, in uppercase
+ * @return the number of calls of the kernel
+ */
+long bench_match(struct meter *meter, const struct records *records,
+    const char *term)
+{
+    long matches = 0;
+    resume_meter(meter);
+    for (int i = 0; i < records->count; ++i)
+        matches += match(term, &records->navaids[i]);
+    pause_meter(meter);
+    sink += matches;
+    return records->count;
+}
+
+/**
+ * Scans all of the navaids for a search term, as a name search does.
+ *
+ * The scan runs on the thread pool set with use_scan_pool, so the cost per
+ * navaid can be compared across numbers of threads.
+ *
+ * @param meter the meter to resume around the calls of the kernel
+ * @param records the inputs to the kernel
+ * @param term the search term, in uppercase
+ * @return the number of navaids scanned
+ */
+long bench_scan(struct meter *meter, const struct records *records,
+    const char *term)
+{
+    static struct navaid **cache;
+    static size_t capacity;
+    cache = reserve(cache, &capacity, records->count + 1,
+        sizeof(struct navaid *));
+    for (int i = 0; i < records->count; ++i)
+        cache[i] = &records->navaids[i];
+    cache[records->count] = NULL;
+
+    int *positions;
+    resume_meter(meter);
+    int n = scan(cache, scan_pool, NULL, term, 0, &positions);
+    free(positions);
+    pause_meter(meter);
+    sink += n;
+    return records->count;
+}
+
+/**
+ * Translates the code of every navaid into Morse code.
+ *
+ * @param meter the meter to resume around the calls of the kernel
+ * @param records the inputs to the kernel
+ * @param term unused
+ * @return the number of calls of the kernel
+ */
+long bench_morse(struct meter *meter, const struct records *records,
+    const char *term)
+{
+    (void)term;
+    long translated = 0;
+    resume_meter(meter);
+    for (int i = 0; i < records->count; ++i)
+        translated += morse(records->navaids[i].code, " ") != NULL;
+    pause_meter(meter);
+    sink += translated;
+    return records->count;
+}
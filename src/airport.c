@@ -0,0 +1,691 @@
+/**
+ * @file airport.c
+ *
+ * Airport and runway index built from apt.dat.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "airport.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+
+/**
+ * Magic number identifying an airport index file ("NVSA").
+ */
+#define INDEX_MAGIC 0x4153564eU
+
+/**
+ * Version of the airport index file layout.
+ */
+#define INDEX_LAYOUT 1
+
+/**
+ * Size of the buffer used for the name of an index file.
+ */
+#define INDEX_NAME_SIZE 64
+
+/**
+ * Airport data row codes that are read. All other rows are skipped.
+ */
+enum RowCode {
+    ROW_AIRPORT = 1,        ///< Land airport header
+    ROW_SEAPLANE = 16,      ///< Seaplane base header
+    ROW_HELIPORT = 17,      ///< Heliport header
+    ROW_RUNWAY = 100,       ///< Land runway
+    ROW_WATER = 101,        ///< Water runway
+    ROW_HELIPAD = 102,      ///< Helipad
+    ROW_METADATA = 1302     ///< Airport metadata, including the datum
+};
+
+/**
+ * Airport index file header.
+ *
+ * The header is followed by the airports, sorted by ICAO code, then the
+ * runways and then the names. All references between them are indexes or
+ * offsets, so the file can be mapped at any address.
+ */
+struct header {
+    uint32_t magic;         ///< INDEX_MAGIC
+    uint32_t layout;        ///< INDEX_LAYOUT
+    uint64_t source_size;   ///< Size of the airport data file
+    int64_t source_mtime;   ///< Modification time of the airport data file
+    uint64_t count;         ///< Number of airports
+    uint64_t runways;       ///< Number of runways
+    uint64_t names;         ///< Size of the names in bytes
+};
+
+/**
+ * Airport index.
+ *
+ * The index is either mapped from an index file or built in memory.
+ */
+struct airports {
+    void *base;                     ///< Mapped index file (NULL if built)
+    size_t size;                    ///< Size of the mapping
+    struct airport *airports;       ///< Airports, sorted by ICAO code
+    size_t count;                   ///< Number of airports
+    struct runway *runways;         ///< Runways, grouped by airport
+    size_t nrunways;                ///< Number of runways
+    char *names;                    ///< Airport names
+    size_t nnames;                  ///< Size of the names in bytes
+};
+
+/**
+ * State used while building an index from the airport data file.
+ */
+struct builder {
+    struct airports *index;         ///< The index being built
+    size_t capacity;                ///< Capacity of the airports array
+    size_t rcapacity;               ///< Capacity of the runways array
+    size_t ncapacity;               ///< Capacity of the names
+    double lat;                     ///< Sum of runway end latitudes
+    double lon;                     ///< Sum of runway end longitudes
+    int ends;                       ///< Number of runway ends summed
+    struct coordinate datum;        ///< Datum from metadata (NAN if none)
+};
+
+/**
+ * Tests whether a character separates fields in a row.
+ *
+ * @param c the character
+ * @return true if the character is a separator
+ */
+static bool separator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * Extracts the next field from a row, terminating it in place.
+ *
+ * @param s a pointer to the current position in the row, updated
+ * @return the field, which is empty at the end of the row
+ */
+static char *field(char **s)
+{
+    char *p = *s;
+    while (separator(*p))
+        ++p;
+    char *start = p;
+    while (*p != '\0' && !separator(*p))
+        ++p;
+    if (*p != '\0')
+        *p++ = '\0';
+    *s = p;
+    return start;
+}
+
+/**
+ * Skips a number of fields in a row.
+ *
+ * @param s a pointer to the current position in the row, updated
+ * @param n the number of fields to skip
+ */
+static void skip(char **s, int n)
+{
+    while (n-- > 0)
+        field(s);
+}
+
+/**
+ * Copies a code into a fixed size array, in uppercase and truncated if
+ * necessary.
+ *
+ * @param dest the array
+ * @param src the code
+ * @param size the size of the array
+ */
+static void copy_code(char *dest, const char *src, size_t size)
+{
+    size_t i = 0;
+    for (; i < size - 1 && src[i] != '\0'; ++i)
+        dest[i] = toupper((unsigned char)src[i]);
+    dest[i] = '\0';
+}
+
+/**
+ * Parses an angle field.
+ *
+ * @param s a pointer to the current position in the row, updated
+ * @param angle receives the angle
+ * @return true if the field is a number
+ */
+static bool parse_angle(char **s, double *angle)
+{
+    char *f = field(s), *end;
+    *angle = strtod(f, &end);
+    return end != f && *end == '\0';
+}
+
+/**
+ * Completes the current airport, setting its reference point.
+ *
+ * The datum from the airport metadata is used if there is one, otherwise
+ * the centre of the runway ends. If there are neither, the reference
+ * point is unknown.
+ *
+ * @param b a pointer to the builder
+ */
+static void finish_airport(struct builder *b)
+{
+    struct airports *index = b->index;
+    if (index->count == 0)
+        return;
+    struct airport *airport = &index->airports[index->count - 1];
+    airport->count = (uint32_t)index->nrunways - airport->runways;
+    if (!isnan(b->datum.lat) && !isnan(b->datum.lon))
+        airport->coordinate = b->datum;
+    else if (b->ends > 0) {
+        airport->coordinate.lat = b->lat / b->ends;
+        airport->coordinate.lon = b->lon / b->ends;
+    }
+}
+
+/**
+ * Starts a new airport from a header row.
+ *
+ * Header rows have the elevation, two obsolete fields, the ICAO code and
+ * the name, which may contain spaces.
+ *
+ * @param b a pointer to the builder
+ * @param s the row after the row code
+ */
+static void start_airport(struct builder *b, char *s)
+{
+    finish_airport(b);
+
+    struct airports *index = b->index;
+    index->airports = reserve(index->airports, &b->capacity,
+        index->count + 1, sizeof(struct airport));
+    struct airport *airport = &index->airports[index->count++];
+    airport->elevation = (int32_t)strtol(field(&s), NULL, 10);
+    skip(&s, 2);
+    copy_code(airport->icao, field(&s), ICAO_MAX);
+    airport->coordinate.lat = airport->coordinate.lon = NAN;
+    airport->runways = (uint32_t)index->nrunways;
+    airport->count = 0;
+
+    while (separator(*s))
+        ++s;
+    size_t n = strlen(s);
+    while (n > 0 && separator(s[n - 1]))
+        --n;
+    index->names = reserve(index->names, &b->ncapacity,
+        index->nnames + n + 1, 1);
+    airport->name = (uint32_t)index->nnames;
+    for (size_t i = 0; i < n; ++i)
+        index->names[index->nnames++] = toupper((unsigned char)s[i]);
+    index->names[index->nnames++] = '\0';
+
+    b->lat = b->lon = 0;
+    b->ends = 0;
+    b->datum.lat = b->datum.lon = NAN;
+}
+
+/**
+ * Parses a runway end, i.e. the designator, latitude and longitude.
+ *
+ * @param s a pointer to the current position in the row, updated
+ * @param end receives the runway end
+ * @return true if the runway end is valid
+ */
+static bool parse_end(char **s, struct runway_end *end)
+{
+    const char *ident = field(s);
+    if (*ident == '\0')
+        return false;
+    copy_code(end->ident, ident, RWAY_MAX);
+    return parse_angle(s, &end->coordinate.lat) &&
+        parse_angle(s, &end->coordinate.lon);
+}
+
+/**
+ * Adds a runway to the current airport from a runway row.
+ *
+ * Land runways have seven fields before the first end and six between the
+ * ends, water runways have two fields before the first end and none
+ * between them. Helipads have a single end.
+ *
+ * @param b a pointer to the builder
+ * @param s the row after the row code
+ * @param code the row code
+ */
+static void add_runway(struct builder *b, char *s, int code)
+{
+    struct airports *index = b->index;
+    if (index->count == 0)
+        return;
+
+    struct runway runway;
+    switch (code) {
+    case ROW_RUNWAY:
+        skip(&s, 7);
+        if (!parse_end(&s, &runway.end[0]))
+            return;
+        skip(&s, 6);
+        if (!parse_end(&s, &runway.end[1]))
+            return;
+        break;
+    case ROW_WATER:
+        skip(&s, 2);
+        if (!parse_end(&s, &runway.end[0]) || !parse_end(&s, &runway.end[1]))
+            return;
+        break;
+    default:
+        if (!parse_end(&s, &runway.end[0]))
+            return;
+        runway.end[1] = runway.end[0];
+        break;
+    }
+
+    index->runways = reserve(index->runways, &b->rcapacity,
+        index->nrunways + 1, sizeof(struct runway));
+    index->runways[index->nrunways++] = runway;
+    for (int i = 0; i < 2; ++i) {
+        b->lat += runway.end[i].coordinate.lat;
+        b->lon += runway.end[i].coordinate.lon;
+    }
+    b->ends += 2;
+}
+
+/**
+ * Reads the datum of the current airport from a metadata row.
+ *
+ * @param b a pointer to the builder
+ * @param s the row after the row code
+ */
+static void add_metadata(struct builder *b, char *s)
+{
+    const char *key = field(&s);
+    double value;
+    if (strcmp(key, "datum_lat") == 0 && parse_angle(&s, &value))
+        b->datum.lat = value;
+    else if (strcmp(key, "datum_lon") == 0 && parse_angle(&s, &value))
+        b->datum.lon = value;
+}
+
+/**
+ * Parses a row of the airport data file.
+ *
+ * Every row that is read has a code starting with '1', so most rows, e.g.
+ * taxiway nodes, are rejected on their first character without further
+ * parsing.
+ *
+ * @param s the row, which is modified
+ * @param data a pointer to the builder
+ */
+static void parse_row(char *s, void *data)
+{
+    struct builder *b = data;
+    if (*s != '1')
+        return;
+    char *end;
+    long code = strtol(s, &end, 10);
+    if (*end != '\0' && !separator(*end))
+        return;
+
+    switch (code) {
+    case ROW_AIRPORT:
+    case ROW_SEAPLANE:
+    case ROW_HELIPORT:
+        start_airport(b, end);
+        break;
+    case ROW_RUNWAY:
+    case ROW_WATER:
+    case ROW_HELIPAD:
+        add_runway(b, end, (int)code);
+        break;
+    case ROW_METADATA:
+        if (b->index->count > 0)
+            add_metadata(b, end);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Compares two airports by ICAO code, then by position in the data file.
+ *
+ * @param a a pointer to the first airport
+ * @param b a pointer to the second airport
+ * @return negative, zero or positive for less than, equal or greater than
+ */
+static int compare_airports(const void *a, const void *b)
+{
+    const struct airport *x = a, *y = b;
+    int cmp = strcmp(x->icao, y->icao);
+    if (cmp != 0)
+        return cmp;
+    return (x->runways > y->runways) - (x->runways < y->runways);
+}
+
+/**
+ * Builds an airport index from the airport data file.
+ *
+ * @param path the path to the airport data file
+ * @return a pointer to the index, never NULL
+ */
+static struct airports *build_index(const char *path)
+{
+    struct airports *index;
+    if ((index = calloc(1, sizeof(struct airports))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    struct builder b = { .index = index };
+    read_rows(path, parse_row, &b);
+    finish_airport(&b);
+    qsort(index->airports, index->count, sizeof(struct airport),
+        compare_airports);
+    return index;
+}
+
+/**
+ * Writes an airport index to an index file.
+ *
+ * The index is written to a temporary file that is renamed into place, so
+ * other processes never see a partial index. Index files are a cache, so
+ * failure is silently ignored.
+ *
+ * @param index a pointer to the index
+ * @param path the path to the index file
+ * @param source the status of the airport data file
+ */
+static void write_index(const struct airports *index, const char *path,
+    const struct stat *source)
+{
+    struct header header = {
+        .magic = INDEX_MAGIC,
+        .layout = INDEX_LAYOUT,
+        .source_size = (uint64_t)source->st_size,
+        .source_mtime = (int64_t)source->st_mtime,
+        .count = index->count,
+        .runways = index->nrunways,
+        .names = index->nnames
+    };
+
+    char *tmp;
+    size_t size = strlen(path) + 32;
+    if ((tmp = malloc(size)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(tmp, size, "%s.%ld", path, (long)getpid());
+
+    FILE *f;
+    if ((f = fopen(tmp, "wb")) != NULL) {
+        bool ok =
+            fwrite(&header, sizeof header, 1, f) == 1 &&
+            fwrite(index->airports, sizeof(struct airport), index->count, f)
+                == index->count &&
+            fwrite(index->runways, sizeof(struct runway), index->nrunways, f)
+                == index->nrunways &&
+            fwrite(index->names, 1, index->nnames, f) == index->nnames;
+        if (fclose(f) != 0 || !ok || rename(tmp, path) != 0)
+            unlink(tmp);
+    }
+    free(tmp);
+}
+
+/**
+ * Maps an airport index file, if it is valid for the airport data file.
+ *
+ * @param path the path to the index file
+ * @param source the status of the airport data file
+ * @return a pointer to the index, or NULL if there is no valid index file
+ */
+static struct airports *map_index(const char *path, const struct stat *source)
+{
+    int fd;
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return NULL;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct header))
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    const struct header *header = base;
+    size_t size = (size_t)st.st_size;
+    if (header->magic != INDEX_MAGIC || header->layout != INDEX_LAYOUT ||
+        header->source_size != (uint64_t)source->st_size ||
+        header->source_mtime != (int64_t)source->st_mtime ||
+        size != sizeof(struct header) +
+            header->count * sizeof(struct airport) +
+            header->runways * sizeof(struct runway) + header->names) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    struct airports *index;
+    if ((index = malloc(sizeof(struct airports))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    char *p = (char *)base + sizeof(struct header);
+    index->base = base;
+    index->size = size;
+    index->airports = (struct airport *)p;
+    index->count = header->count;
+    p += index->count * sizeof(struct airport);
+    index->runways = (struct runway *)p;
+    index->nrunways = header->runways;
+    p += index->nrunways * sizeof(struct runway);
+    index->names = p;
+    index->nnames = header->names;
+    return index;
+}
+
+/**
+ * Loads the airport index for the airport data file in FG_ROOT.
+ *
+ * The airport data file is large, so the index built from it is kept in
+ * the user's cache directory and mapped by later searches until the data
+ * file changes. Only airport headers, runways and the datum are read from
+ * the data file.
+ *
+ * The index must be released with destroy_airports after use.
+ *
+ * @param fg_root the FG_ROOT directory
+ * @return a pointer to the index, or NULL if there is no airport data file
+ */
+struct airports *load_airports(const char *fg_root)
+{
+    assert(fg_root != NULL);
+
+    char *path = data_path(fg_root, "Airports/apt.dat.gz");
+    struct stat source;
+    if (stat(path, &source) != 0) {
+        free(path);
+        return NULL;
+    }
+
+    char name[INDEX_NAME_SIZE];
+    snprintf(name, sizeof name, "airports-%016llx.idx",
+        (unsigned long long)fnv1a(path, strlen(path), FNV_OFFSET));
+    char *index_path = cache_path(name);
+
+    struct airports *index = NULL;
+    if (index_path != NULL)
+        index = map_index(index_path, &source);
+    if (index == NULL) {
+        index = build_index(path);
+        if (index_path != NULL)
+            write_index(index, index_path, &source);
+    }
+
+    free(index_path);
+    free(path);
+    return index;
+}
+
+/**
+ * Releases an airport index.
+ *
+ * @param airports a pointer to the index, or NULL
+ */
+void destroy_airports(struct airports *airports)
+{
+    if (airports == NULL)
+        return;
+    if (airports->base != NULL) {
+        munmap(airports->base, airports->size);
+    } else {
+        free(airports->airports);
+        free(airports->runways);
+        free(airports->names);
+    }
+    free(airports);
+}
+
+/**
+ * Finds the airports whose ICAO code matches a pattern.
+ *
+ * The literal prefix of the pattern is resolved with a range lookup on
+ * the sorted ICAO codes and only airports in that range are tested against
+ * the full pattern. Indexes are returned in ICAO code order. The array
+ * returned through indices must be freed after use.
+ *
+ * @param airports a pointer to the index
+ * @param pattern the search pattern, in uppercase
+ * @param indices receives an array of airport indexes
+ * @return the number of airports found
+ */
+int match_airports(const struct airports *airports, const char *pattern,
+    int **indices)
+{
+    assert(airports != NULL && pattern != NULL && indices != NULL);
+
+    size_t prefix = glob_prefix(pattern);
+    size_t lo = 0, hi = airports->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(airports->airports[mid].icao, pattern, prefix) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    size_t first = lo;
+    hi = airports->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(airports->airports[mid].icao, pattern, prefix) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    size_t n = lo - first;
+    if ((*indices = malloc((n > 0 ? n : 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    int count = 0;
+    for (size_t i = first; i < lo; ++i)
+        if (glob(pattern, airports->airports[i].icao))
+            (*indices)[count++] = (int)i;
+    return count;
+}
+
+/**
+ * Gets an airport by its index.
+ *
+ * @param airports a pointer to the index
+ * @param i the index of the airport
+ * @return a pointer to the airport
+ */
+const struct airport *get_airport(const struct airports *airports, int i)
+{
+    assert(airports != NULL && i >= 0 && (size_t)i < airports->count);
+    return &airports->airports[i];
+}
+
+/**
+ * Finds an airport by ICAO code.
+ *
+ * If there is more than one airport with the code, the first in the data
+ * file is returned.
+ *
+ * @param airports a pointer to the index
+ * @param icao the ICAO code, in uppercase
+ * @return a pointer to the airport, or NULL if not found
+ */
+const struct airport *find_airport(const struct airports *airports,
+    const char *icao)
+{
+    assert(airports != NULL && icao != NULL);
+
+    size_t lo = 0, hi = airports->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(airports->airports[mid].icao, icao, ICAO_MAX) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < airports->count &&
+        strncmp(airports->airports[lo].icao, icao, ICAO_MAX) == 0)
+        return &airports->airports[lo];
+    return NULL;
+}
+
+/**
+ * Gets the runways of an airport.
+ *
+ * @param airports a pointer to the index
+ * @param airport a pointer to the airport
+ * @return a pointer to the first of the airport's runways
+ */
+const struct runway *airport_runways(const struct airports *airports,
+    const struct airport *airport)
+{
+    assert(airports != NULL && airport != NULL);
+    return &airports->runways[airport->runways];
+}
+
+/**
+ * Gets the name of an airport.
+ *
+ * @param airports a pointer to the index
+ * @param airport a pointer to the airport
+ * @return the name of the airport
+ */
+const char *airport_name(const struct airports *airports,
+    const struct airport *airport)
+{
+    assert(airports != NULL && airport != NULL);
+    return &airports->names[airport->name];
+}
@@ -0,0 +1,71 @@
+/**
+ * @file airport.h
+ *
+ * Airport and runway index built from apt.dat.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef airport_h
+#define airport_h
+
+#include <stdint.h>
+
+#include "types.h"
+
+struct airports;
+
+/**
+ * Runway end, or helipad.
+ */
+struct runway_end {
+    char ident[RWAY_MAX];           ///< Runway designator, e.g. 14 or 27R
+    struct coordinate coordinate;   ///< Threshold or helipad position
+};
+
+/**
+ * Runway, with an end at each threshold. Both ends of a helipad are the
+ * same.
+ */
+struct runway {
+    struct runway_end end[2];       ///< Runway ends
+};
+
+/**
+ * Airport, seaplane base or heliport.
+ */
+struct airport {
+    char icao[ICAO_MAX];            ///< ICAO code
+    struct coordinate coordinate;   ///< Reference point (NAN if unknown)
+    int32_t elevation;              ///< Elevation above sea level in feet
+    uint32_t name;                  ///< Offset of the name in the names
+    uint32_t runways;               ///< Index of the first runway
+    uint32_t count;                 ///< Number of runways
+};
+
+struct airports *load_airports(const char *fg_root);
+void destroy_airports(struct airports *airports);
+int match_airports(const struct airports *airports, const char *pattern,
+    int **indices);
+const struct airport *get_airport(const struct airports *airports, int i);
+const struct airport *find_airport(const struct airports *airports,
+    const char *icao);
+const struct runway *airport_runways(const struct airports *airports,
+    const struct airport *airport);
+const char *airport_name(const struct airports *airports,
+    const struct airport *airport);
+
+#endif
@@ -0,0 +1,952 @@
+/**
+ * @file airway.c
+ *
+ * Airway network and route planning.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "airway.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "geo.h"
+#include "util.h"
+
+/**
+ * Magic number identifying an airway network file ("NVSW").
+ */
+#define NETWORK_MAGIC 0x5753564eU
+
+/**
+ * Version of the airway network file layout.
+ */
+#define NETWORK_LAYOUT 1
+
+/**
+ * Size of the buffer used for the name of a network file.
+ */
+#define NETWORK_NAME_SIZE 64
+
+/**
+ * Marker for an empty hash table slot or a missing node.
+ */
+#define NONE UINT32_MAX
+
+/**
+ * Number of steps per degree at which airway endpoints are matched, so
+ * that the same fix is one node wherever it appears.
+ */
+#define STEPS_PER_DEGREE 10000
+
+/**
+ * Node of the airway network, i.e. a fix or navaid on an airway.
+ */
+struct node {
+    char ident[CODE_MAX];           ///< Ident
+    struct coordinate coordinate;   ///< Coordinate
+};
+
+/**
+ * Directed edge of the airway network.
+ */
+struct edge {
+    uint32_t target;                ///< Node at the end of the edge
+    float distance;                 ///< Great circle distance in nm
+    uint32_t airway;                ///< Offset of the airway names
+};
+
+/**
+ * Airway segment, as read from the airway data file.
+ */
+struct segment {
+    uint32_t from;                  ///< Node at one end
+    uint32_t to;                    ///< Node at the other end
+    uint32_t airway;                ///< Offset of the airway names
+};
+
+/**
+ * Airway network file header.
+ *
+ * The header is followed by the nodes, the edge offsets, the edges, the
+ * nodes in ident order and the airway names. All references are indexes
+ * or offsets, so the file can be mapped at any address.
+ */
+struct header {
+    uint32_t magic;         ///< NETWORK_MAGIC
+    uint32_t layout;        ///< NETWORK_LAYOUT
+    uint64_t source_size;   ///< Size of the airway data file
+    int64_t source_mtime;   ///< Modification time of the airway data file
+    uint64_t count;         ///< Number of nodes
+    uint64_t edges;         ///< Number of edges
+    uint64_t names;         ///< Size of the airway names in bytes
+};
+
+/**
+ * Airway network.
+ *
+ * The network is held as a compressed sparse row graph. The edges leaving
+ * each node are contiguous, starting at the node's offset, so expanding a
+ * node during a search reads one run of memory. The network is either
+ * mapped from a network file or built in memory.
+ */
+struct airways {
+    void *base;                     ///< Mapped network file (NULL if built)
+    size_t size;                    ///< Size of the mapping
+    struct node *nodes;             ///< Nodes
+    uint32_t count;                 ///< Number of nodes
+    uint32_t *offsets;              ///< First edge of each node, plus end
+    struct edge *edges;             ///< Edges, grouped by node
+    size_t nedges;                  ///< Number of edges
+    uint32_t *idents;               ///< Nodes sorted by ident
+    char *names;                    ///< Airway names
+    size_t nnames;                  ///< Size of the airway names in bytes
+};
+
+/**
+ * State used while building the airway network.
+ */
+struct builder {
+    struct airways *airways;        ///< The network being built
+    size_t capacity;                ///< Capacity of the nodes array
+    size_t ncapacity;               ///< Capacity of the airway names
+    struct segment *segments;       ///< Segments
+    size_t nsegments;               ///< Number of segments
+    size_t scapacity;               ///< Capacity of the segments array
+    uint32_t *slots;                ///< Node hash table, NONE if empty
+    size_t mask;                    ///< Number of slots - 1
+};
+
+/**
+ * Open node in a route search, ordered by estimated route length.
+ */
+struct open {
+    double estimate;                ///< Distance so far plus heuristic
+    uint32_t node;                  ///< Node
+};
+
+/**
+ * Binary min-heap of open nodes.
+ */
+struct frontier {
+    struct open *items;             ///< Open nodes
+    size_t count;                   ///< Number of open nodes
+    size_t capacity;                ///< Capacity of the items array
+};
+
+/**
+ * Hashes the ident and position of an airway endpoint.
+ *
+ * @param ident the ident
+ * @param lat the latitude in steps
+ * @param lon the longitude in steps
+ * @return the hash
+ */
+static uint64_t hash_node(const char *ident, long lat, long lon)
+{
+    uint64_t h = fnv1a(ident, strlen(ident) + 1, FNV_OFFSET);
+    h = fnv1a(&lat, sizeof(lat), h);
+    return fnv1a(&lon, sizeof(lon), h);
+}
+
+/**
+ * Converts a latitude or longitude to steps.
+ *
+ * @param degrees the latitude or longitude
+ * @return the number of steps
+ */
+static long steps(double degrees)
+{
+    return lround(degrees * STEPS_PER_DEGREE);
+}
+
+/**
+ * Inserts a node into the node hash table.
+ *
+ * @param b a pointer to the builder
+ * @param node the node to insert
+ */
+static void insert_node(struct builder *b, uint32_t node)
+{
+    const struct node *n = &b->airways->nodes[node];
+    size_t i = hash_node(n->ident, steps(n->coordinate.lat),
+        steps(n->coordinate.lon)) & b->mask;
+    while (b->slots[i] != NONE)
+        i = (i + 1) & b->mask;
+    b->slots[i] = node;
+}
+
+/**
+ * Resizes the node hash table to keep it no more than half full.
+ *
+ * @param b a pointer to the builder
+ */
+static void grow_slots(struct builder *b)
+{
+    size_t count = b->airways->count;
+    if (b->slots != NULL && 2 * (count + 1) <= b->mask + 1)
+        return;
+    size_t size = b->slots != NULL ? 2 * (b->mask + 1) : 4096;
+    free(b->slots);
+    if ((b->slots = malloc(size * sizeof(uint32_t))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < size; ++i)
+        b->slots[i] = NONE;
+    b->mask = size - 1;
+    for (uint32_t node = 0; node < count; ++node)
+        insert_node(b, node);
+}
+
+/**
+ * Finds the node for an airway endpoint, adding it if it is new.
+ *
+ * @param b a pointer to the builder
+ * @param ident the ident of the endpoint
+ * @param c the coordinate of the endpoint
+ * @return the node
+ */
+static uint32_t intern_node(struct builder *b, const char *ident,
+    struct coordinate c)
+{
+    grow_slots(b);
+
+    struct airways *airways = b->airways;
+    long lat = steps(c.lat), lon = steps(c.lon);
+    size_t i = hash_node(ident, lat, lon) & b->mask;
+    for (; b->slots[i] != NONE; i = (i + 1) & b->mask) {
+        const struct node *n = &airways->nodes[b->slots[i]];
+        if (strcmp(n->ident, ident) == 0 && steps(n->coordinate.lat) == lat &&
+            steps(n->coordinate.lon) == lon)
+            return b->slots[i];
+    }
+
+    airways->nodes = reserve(airways->nodes, &b->capacity,
+        (size_t)airways->count + 1, sizeof(struct node));
+    struct node *n = &airways->nodes[airways->count];
+    snprintf(n->ident, CODE_MAX, "%s", ident);
+    n->coordinate = c;
+    b->slots[i] = airways->count;
+    return airways->count++;
+}
+
+/**
+ * Extracts the next field from a row, terminating it in place.
+ *
+ * @param s a pointer to the current position in the row, updated
+ * @return the field, which is empty at the end of the row
+ */
+static char *field(char **s)
+{
+    char *p = *s;
+    while (*p == ' ' || *p == '\t')
+        ++p;
+    char *start = p;
+    while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r')
+        ++p;
+    if (*p != '\0')
+        *p++ = '\0';
+    *s = p;
+    return start;
+}
+
+/**
+ * Parses an airway endpoint, i.e. an ident, latitude and longitude.
+ *
+ * @param s a pointer to the current position in the row, updated
+ * @param ident receives the ident
+ * @param c receives the coordinate
+ * @return true if the endpoint is valid
+ */
+static bool parse_endpoint(char **s, char **ident, struct coordinate *c)
+{
+    *ident = field(s);
+    if (**ident == '\0')
+        return false;
+    for (char *p = *ident; *p != '\0'; ++p)
+        *p = toupper((unsigned char)*p);
+
+    char *end;
+    c->lat = strtod(*s, &end);
+    if (end == *s)
+        return false;
+    *s = end;
+    c->lon = strtod(*s, &end);
+    if (end == *s)
+        return false;
+    *s = end;
+    return c->lat >= -90 && c->lat <= 90 && c->lon >= -180 && c->lon <= 180;
+}
+
+/**
+ * Parses a row of the airway data file and adds the segment.
+ *
+ * Rows have two endpoints, each an ident, latitude and longitude, then the
+ * airway level, base and top, and the names of the airways that use the
+ * segment, separated by hyphens. Segments are treated as two-way. Header
+ * rows and the end of data marker do not parse and are skipped.
+ *
+ * @param s the row
+ * @param data a pointer to the builder
+ */
+static void parse_segment(char *s, void *data)
+{
+    struct builder *b = data;
+    char *from, *to;
+    struct coordinate a, z;
+    if (!parse_endpoint(&s, &from, &a) || !parse_endpoint(&s, &to, &z))
+        return;
+    for (int i = 0; i < 3; ++i)
+        field(&s);
+    const char *names = field(&s);
+    if (*names == '\0')
+        return;
+
+    uint32_t first = intern_node(b, from, a);
+    uint32_t second = intern_node(b, to, z);
+    if (first == second)
+        return;
+    b->segments = reserve(b->segments, &b->scapacity, b->nsegments + 1,
+        sizeof(struct segment));
+    struct segment *segment = &b->segments[b->nsegments++];
+    segment->from = first;
+    segment->to = second;
+    struct airways *airways = b->airways;
+    size_t n = strlen(names) + 1;
+    airways->names = reserve(airways->names, &b->ncapacity,
+        airways->nnames + n, 1);
+    segment->airway = (uint32_t)airways->nnames;
+    memcpy(&airways->names[airways->nnames], names, n);
+    airways->nnames += n;
+}
+
+/**
+ * Adds an edge to the graph at the next free position of its node.
+ *
+ * @param airways a pointer to the network
+ * @param next the next free edge of each node, updated
+ * @param from the node at the start of the edge
+ * @param to the node at the end of the edge
+ * @param airway the offset of the airway names
+ */
+static void add_edge(struct airways *airways, uint32_t *next, uint32_t from,
+    uint32_t to, uint32_t airway)
+{
+    struct edge *edge = &airways->edges[next[from]++];
+    edge->target = to;
+    edge->distance = (float)distance(&airways->nodes[from].coordinate,
+        &airways->nodes[to].coordinate);
+    edge->airway = airway;
+}
+
+/**
+ * Node array used while sorting nodes by ident.
+ */
+static const struct node *sorting;
+
+/**
+ * Compares nodes by ident, then by number, for sorting.
+ *
+ * @param a pointer to the first node number
+ * @param b pointer to the second node number
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_idents(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    int c = strcmp(sorting[x].ident, sorting[y].ident);
+    return c != 0 ? c : (x > y) - (x < y);
+}
+
+/**
+ * Builds the compressed sparse row graph from the segments.
+ *
+ * The edges of each node are counted, the counts are turned into offsets
+ * and each segment is then written as an edge in both directions.
+ *
+ * @param b a pointer to the builder
+ */
+static void build_graph(struct builder *b)
+{
+    struct airways *airways = b->airways;
+    uint32_t n = airways->count;
+    size_t edges = airways->nedges = 2 * b->nsegments;
+    if ((airways->offsets = calloc((size_t)n + 1, sizeof(uint32_t))) == NULL ||
+        (airways->edges = malloc((edges > 0 ? edges : 1) *
+            sizeof(struct edge))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < b->nsegments; ++i) {
+        ++airways->offsets[b->segments[i].from + 1];
+        ++airways->offsets[b->segments[i].to + 1];
+    }
+    for (uint32_t i = 0; i < n; ++i)
+        airways->offsets[i + 1] += airways->offsets[i];
+
+    uint32_t *next;
+    if ((next = malloc(((size_t)n > 0 ? n : 1) * sizeof(uint32_t))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(next, airways->offsets, (size_t)n * sizeof(uint32_t));
+    for (size_t i = 0; i < b->nsegments; ++i) {
+        const struct segment *s = &b->segments[i];
+        add_edge(airways, next, s->from, s->to, s->airway);
+        add_edge(airways, next, s->to, s->from, s->airway);
+    }
+    free(next);
+
+    if ((airways->idents = malloc(((size_t)n > 0 ? n : 1) *
+        sizeof(uint32_t))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < n; ++i)
+        airways->idents[i] = i;
+    sorting = airways->nodes;
+    qsort(airways->idents, n, sizeof(uint32_t), compare_idents);
+    sorting = NULL;
+}
+
+/**
+ * Builds the airway network from the airway data file.
+ *
+ * @param path the path to the airway data file
+ * @return a pointer to the network, never NULL
+ */
+static struct airways *build_network(const char *path)
+{
+    struct airways *airways;
+    if ((airways = calloc(1, sizeof(struct airways))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    struct builder b = { .airways = airways };
+    read_rows(path, parse_segment, &b);
+    build_graph(&b);
+    free(b.segments);
+    free(b.slots);
+    return airways;
+}
+
+/**
+ * Writes the airway network to a network file.
+ *
+ * The network is written to a temporary file that is renamed into place,
+ * so other processes never see a partial network. Network files are a
+ * cache, so failure is silently ignored.
+ *
+ * @param airways a pointer to the network
+ * @param path the path to the network file
+ * @param source the status of the airway data file
+ */
+static void write_network(const struct airways *airways, const char *path,
+    const struct stat *source)
+{
+    struct header header = {
+        .magic = NETWORK_MAGIC,
+        .layout = NETWORK_LAYOUT,
+        .source_size = (uint64_t)source->st_size,
+        .source_mtime = (int64_t)source->st_mtime,
+        .count = airways->count,
+        .edges = airways->nedges,
+        .names = airways->nnames
+    };
+
+    char *tmp;
+    size_t size = strlen(path) + 32;
+    if ((tmp = malloc(size)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(tmp, size, "%s.%ld", path, (long)getpid());
+
+    size_t n = airways->count;
+    FILE *f;
+    if ((f = fopen(tmp, "wb")) != NULL) {
+        bool ok =
+            fwrite(&header, sizeof header, 1, f) == 1 &&
+            fwrite(airways->nodes, sizeof(struct node), n, f) == n &&
+            fwrite(airways->offsets, sizeof(uint32_t), n + 1, f) == n + 1 &&
+            fwrite(airways->edges, sizeof(struct edge), airways->nedges, f)
+                == airways->nedges &&
+            fwrite(airways->idents, sizeof(uint32_t), n, f) == n &&
+            fwrite(airways->names, 1, airways->nnames, f) == airways->nnames;
+        if (fclose(f) != 0 || !ok || rename(tmp, path) != 0)
+            unlink(tmp);
+    }
+    free(tmp);
+}
+
+/**
+ * Maps a network file, if it is valid for the airway data file.
+ *
+ * @param path the path to the network file
+ * @param source the status of the airway data file
+ * @return a pointer to the network, or NULL if there is no valid file
+ */
+static struct airways *map_network(const char *path,
+    const struct stat *source)
+{
+    int fd;
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return NULL;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct header))
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    const struct header *header = base;
+    size_t size = (size_t)st.st_size;
+    if (header->magic != NETWORK_MAGIC || header->layout != NETWORK_LAYOUT ||
+        header->source_size != (uint64_t)source->st_size ||
+        header->source_mtime != (int64_t)source->st_mtime ||
+        header->count >= NONE ||
+        size != sizeof(struct header) +
+            header->count * sizeof(struct node) +
+            (2 * header->count + 1) * sizeof(uint32_t) +
+            header->edges * sizeof(struct edge) + header->names) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    struct airways *airways;
+    if ((airways = calloc(1, sizeof(struct airways))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    char *p = (char *)base + sizeof(struct header);
+    airways->base = base;
+    airways->size = size;
+    airways->count = (uint32_t)header->count;
+    airways->nodes = (struct node *)p;
+    p += header->count * sizeof(struct node);
+    airways->offsets = (uint32_t *)p;
+    p += (header->count + 1) * sizeof(uint32_t);
+    airways->edges = (struct edge *)p;
+    airways->nedges = header->edges;
+    p += header->edges * sizeof(struct edge);
+    airways->idents = (uint32_t *)p;
+    p += header->count * sizeof(uint32_t);
+    airways->names = p;
+    airways->nnames = header->names;
+    return airways;
+}
+
+/**
+ * Creates the airway network from the airway data file in FG_ROOT.
+ *
+ * Airway endpoints with the same ident and position are joined into one
+ * node, so the network connects wherever airways cross at a fix or navaid.
+ *
+ * Building the network takes much longer than searching it, so the built
+ * network is kept in the user's cache directory and mapped by later
+ * searches until the airway data file changes.
+ *
+ * This function never returns NULL. If the airway data file cannot be
+ * read, the program is terminated with an exit status.
+ *
+ * The network must be destroyed after use with destroy_airways.
+ *
+ * @return a pointer to the airway network
+ */
+struct airways *create_airways(void)
+{
+    char *fg_root;
+    if ((fg_root = getenv("FG_ROOT")) == NULL) {
+        fprintf(stderr, "Missing environment variable FG_ROOT\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char *path = data_path(fg_root, "Navaids/awy.dat.gz");
+    struct stat source;
+    if (stat(path, &source) != 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    char name[NETWORK_NAME_SIZE];
+    snprintf(name, sizeof name, "airways-%016llx.idx",
+        (unsigned long long)fnv1a(path, strlen(path), FNV_OFFSET));
+    char *network_path = cache_path(name);
+
+    struct airways *airways = NULL;
+    if (network_path != NULL)
+        airways = map_network(network_path, &source);
+    if (airways == NULL) {
+        airways = build_network(path);
+        if (network_path != NULL)
+            write_network(airways, network_path, &source);
+    }
+
+    free(network_path);
+    free(path);
+    return airways;
+}
+
+/**
+ * Destroys an airway network.
+ *
+ * @param airways a pointer to the network (may be NULL)
+ */
+void destroy_airways(struct airways *airways)
+{
+    if (airways == NULL)
+        return;
+    if (airways->base != NULL) {
+        munmap(airways->base, airways->size);
+    } else {
+        free(airways->nodes);
+        free(airways->offsets);
+        free(airways->edges);
+        free(airways->idents);
+        free(airways->names);
+    }
+    free(airways);
+}
+
+/**
+ * Finds the range of nodes with an ident.
+ *
+ * @param airways a pointer to the network
+ * @param ident the ident, in uppercase
+ * @param first receives the position of the first node in the ident order
+ * @return the number of nodes with the ident
+ */
+static size_t find_nodes(const struct airways *airways, const char *ident,
+    size_t *first)
+{
+    size_t lo = 0, hi = airways->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(airways->nodes[airways->idents[mid]].ident, ident) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *first = lo;
+    while (hi < airways->count &&
+        strcmp(airways->nodes[airways->idents[hi]].ident, ident) == 0)
+        ++hi;
+    return hi - lo;
+}
+
+/**
+ * Copies an ident in uppercase, truncated if necessary.
+ *
+ * @param dest the destination, of size CODE_MAX
+ * @param ident the ident
+ */
+static void copy_ident(char *dest, const char *ident)
+{
+    size_t i = 0;
+    for (; i < CODE_MAX - 1 && ident[i] != '\0'; ++i)
+        dest[i] = toupper((unsigned char)ident[i]);
+    dest[i] = '\0';
+}
+
+/**
+ * Checks if a fix or navaid is on an airway.
+ *
+ * @param airways a pointer to the network
+ * @param ident the ident of the fix or navaid
+ * @return true if there is at least one node with the ident
+ */
+bool on_airway(const struct airways *airways, const char *ident)
+{
+    assert(airways != NULL && ident != NULL);
+    char key[CODE_MAX];
+    size_t first;
+    copy_ident(key, ident);
+    return find_nodes(airways, key, &first) > 0;
+}
+
+/**
+ * Adds an open node to a frontier.
+ *
+ * @param frontier a pointer to the frontier
+ * @param estimate the estimated route length through the node
+ * @param node the node
+ */
+static void push(struct frontier *frontier, double estimate, uint32_t node)
+{
+    frontier->items = reserve(frontier->items, &frontier->capacity,
+        frontier->count + 1, sizeof(struct open));
+    struct open *items = frontier->items;
+    size_t i = frontier->count++;
+    while (i > 0 && items[(i - 1) / 2].estimate > estimate) {
+        items[i] = items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    items[i].estimate = estimate;
+    items[i].node = node;
+}
+
+/**
+ * Removes the open node with the lowest estimate from a frontier.
+ *
+ * @param frontier a pointer to a non-empty frontier
+ * @return the node
+ */
+static uint32_t pop(struct frontier *frontier)
+{
+    struct open *items = frontier->items;
+    uint32_t node = items[0].node;
+    struct open last = items[--frontier->count];
+    size_t i = 0, n = frontier->count;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && items[child + 1].estimate < items[child].estimate)
+            ++child;
+        if (items[child].estimate >= last.estimate)
+            break;
+        items[i] = items[child];
+        i = child;
+    }
+    if (n > 0)
+        items[i] = last;
+    return node;
+}
+
+/**
+ * Estimates the remaining distance from a node to the nearest destination.
+ *
+ * @param airways a pointer to the network
+ * @param node the node
+ * @param targets the destination nodes
+ * @param goals the number of destination nodes
+ * @return the great circle distance in nm
+ */
+static double heuristic(const struct airways *airways, uint32_t node,
+    const uint32_t *targets, size_t goals)
+{
+    double remaining = INFINITY;
+    const struct coordinate *c = &airways->nodes[node].coordinate;
+    for (size_t g = 0; g < goals; ++g) {
+        double d = distance(c, &airways->nodes[targets[g]].coordinate);
+        if (d < remaining)
+            remaining = d;
+    }
+    return remaining;
+}
+
+/**
+ * Checks if a list of airway names contains a name.
+ *
+ * @param names the airway names, separated by hyphens
+ * @param name the name
+ * @return true if the name is in the list
+ */
+static bool has_airway(const char *names, const char *name)
+{
+    size_t n = strlen(name);
+    if (n == 0)
+        return false;
+    for (const char *p = names; *p != '\0'; p += strcspn(p, "-")) {
+        if (*p == '-')
+            ++p;
+        if (strncmp(p, name, n) == 0 && (p[n] == '-' || p[n] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Chooses one airway name for a leg from the names of its segment.
+ *
+ * Segments are often shared by several airways. The airway of the previous
+ * leg is preferred if the segment is on it, so that the route stays on one
+ * airway for as long as possible, then an airway shared with the next leg,
+ * then the first airway of the segment.
+ *
+ * @param names the airway names of the segment, separated by hyphens
+ * @param previous the airway of the previous leg (may be empty)
+ * @param next the airway names of the next segment (may be NULL)
+ * @param airway receives the airway name, of size AIRWAY_MAX
+ */
+static void choose_airway(const char *names, const char *previous,
+    const char *next, char *airway)
+{
+    if (has_airway(names, previous)) {
+        memcpy(airway, previous, strlen(previous) + 1);
+        return;
+    }
+    const char *choice = names;
+    for (const char *p = names; next != NULL && *p != '\0';
+        p += strcspn(p, "-")) {
+        if (*p == '-')
+            ++p;
+        char name[AIRWAY_MAX];
+        snprintf(name, sizeof name, "%.*s", (int)strcspn(p, "-"), p);
+        if (has_airway(next, name)) {
+            choice = p;
+            break;
+        }
+    }
+    snprintf(airway, AIRWAY_MAX, "%.*s", (int)strcspn(choice, "-"), choice);
+}
+
+/**
+ * Plans the shortest route between two fixes or navaids along airways.
+ *
+ * The route is found with an A* search over the airway network, using the
+ * great circle distance to the nearest destination node as the heuristic.
+ * Edge lengths are great circle distances too, so the heuristic never
+ * overestimates and the first route to reach a destination is shortest.
+ * Where an ident names more than one node, the route is the shortest
+ * between any of the start nodes and any of the destination nodes.
+ *
+ * The waypoints of the route, from start to destination, are returned
+ * through legs, which must be freed after use.
+ *
+ * @param airways a pointer to the network
+ * @param from the ident of the start
+ * @param to the ident of the destination
+ * @param legs receives an array of waypoints
+ * @return the number of waypoints, or 0 if there is no route
+ */
+int plan_route(const struct airways *airways, const char *from,
+    const char *to, struct leg **legs)
+{
+    assert(airways != NULL && from != NULL && to != NULL && legs != NULL);
+
+    char start[CODE_MAX], goal[CODE_MAX];
+    copy_ident(start, from);
+    copy_ident(goal, to);
+    size_t first_start, first_goal;
+    size_t starts = find_nodes(airways, start, &first_start);
+    size_t goals = find_nodes(airways, goal, &first_goal);
+    const uint32_t *targets = &airways->idents[first_goal];
+    *legs = NULL;
+    if (starts == 0 || goals == 0)
+        return 0;
+
+    uint32_t n = airways->count;
+    double *reached, *remaining;
+    uint32_t *parent, *via;
+    bool *closed;
+    if ((reached = malloc(((size_t)n + 1) * sizeof(double))) == NULL ||
+        (remaining = malloc(((size_t)n + 1) * sizeof(double))) == NULL ||
+        (parent = malloc(((size_t)n + 1) * sizeof(uint32_t))) == NULL ||
+        (via = malloc(((size_t)n + 1) * sizeof(uint32_t))) == NULL ||
+        (closed = calloc((size_t)n + 1, sizeof(bool))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        reached[i] = remaining[i] = INFINITY;
+        parent[i] = NONE;
+    }
+
+    struct frontier frontier = { NULL, 0, 0 };
+    for (size_t i = 0; i < starts; ++i) {
+        uint32_t node = airways->idents[first_start + i];
+        reached[node] = 0;
+        push(&frontier, 0, node);
+    }
+
+    uint32_t found = NONE;
+    while (frontier.count > 0) {
+        uint32_t node = pop(&frontier);
+        if (closed[node])
+            continue;
+        closed[node] = true;
+        if (strcmp(airways->nodes[node].ident, goal) == 0) {
+            found = node;
+            break;
+        }
+        for (uint32_t e = airways->offsets[node];
+            e < airways->offsets[node + 1]; ++e) {
+            const struct edge *edge = &airways->edges[e];
+            double length = reached[node] + edge->distance;
+            uint32_t target = edge->target;
+            if (closed[target] || length >= reached[target])
+                continue;
+            reached[target] = length;
+            parent[target] = node;
+            via[target] = e;
+            if (isinf(remaining[target]))
+                remaining[target] = heuristic(airways, target, targets, goals);
+            push(&frontier, length + remaining[target], target);
+        }
+    }
+    free(frontier.items);
+
+    int count = 0;
+    uint32_t *path = NULL;
+    if (found != NONE) {
+        for (uint32_t node = found; node != NONE; node = parent[node])
+            ++count;
+        if ((*legs = malloc(count * sizeof(struct leg))) == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        if ((path = malloc(count * sizeof(uint32_t))) == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        int i = count;
+        for (uint32_t node = found; node != NONE; node = parent[node]) {
+            path[--i] = node;
+            struct leg *leg = &(*legs)[i];
+            leg->ident = airways->nodes[node].ident;
+            leg->coordinate = airways->nodes[node].coordinate;
+            leg->airway[0] = '\0';
+            leg->distance = parent[node] != NONE ?
+                airways->edges[via[node]].distance : 0;
+        }
+        for (int i = 1; i < count; ++i) {
+            struct leg *leg = &(*legs)[i];
+            const char *names =
+                &airways->names[airways->edges[via[path[i]]].airway];
+            const char *next = i + 1 < count ?
+                &airways->names[airways->edges[via[path[i + 1]]].airway] :
+                NULL;
+            choose_airway(names, (*legs)[i - 1].airway, next, leg->airway);
+        }
+    }
+
+    free(path);
+    free(reached);
+    free(remaining);
+    free(closed);
+    free(parent);
+    free(via);
+    return count;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file airway.h
+ *
+ * Airway network and route planning.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef airway_h
+#define airway_h
+
+#include <stdbool.h>
+
+#include "types.h"
+
+/**
+ * Maximum length of an airway name.
+ */
+#define AIRWAY_MAX 16
+
+struct airways;
+
+/**
+ * Waypoint of a planned route, with the leg that reaches it.
+ */
+struct leg {
+    const char *ident;              ///< Waypoint ident
+    struct coordinate coordinate;   ///< Waypoint coordinate
+    char airway[AIRWAY_MAX];        ///< Airway to the waypoint (empty first)
+    double distance;                ///< Length of the leg in nm
+};
+
+struct airways *create_airways(void);
+void destroy_airways(struct airways *airways);
+bool on_airway(const struct airways *airways, const char *ident);
+int plan_route(const struct airways *airways, const char *from,
+    const char *to, struct leg **legs);
+
+#endif
@@ -0,0 +1,199 @@
+/**
+ * @file arena.c
+ *
+ * Arena allocator for data with a common lifetime.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "arena.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Alignment of arena allocations, sufficient for any navaid field.
+ */
+#define ARENA_ALIGN 16
+
+/**
+ * Rounds a size up to the arena alignment.
+ */
+#define ALIGN(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/**
+ * Arena page.
+ *
+ * Allocations are carved from the data area that follows the page header.
+ */
+struct page {
+    struct page *next;  ///< Previously filled page
+    size_t size;        ///< Size of the data area
+    size_t used;        ///< Bytes of the data area in use
+};
+
+/**
+ * Cleanup action run when an arena is destroyed.
+ */
+struct cleanup {
+    struct cleanup *next;       ///< Previously registered cleanup
+    void (*release)(void *);    ///< Function that releases the resource
+    void *data;                 ///< Resource to release
+};
+
+/**
+ * Arena structure.
+ *
+ * An arena hands out memory by bumping a pointer through large pages, and
+ * releases all of it at once when destroyed. Individual allocations are
+ * never freed. Resources not allocated from the arena, such as memory
+ * mappings, can be tied to its lifetime with cleanup actions.
+ */
+struct arena {
+    struct page *pages;         ///< Current page, linked to earlier pages
+    struct cleanup *cleanups;   ///< Cleanup actions, most recent first
+    size_t page;                ///< Size of new pages
+};
+
+/**
+ * Creates an empty arena.
+ *
+ * The pointer returned must be destroyed after use with destroy_arena.
+ *
+ * @param page the size of arena pages, e.g. ARENA_PAGE
+ * @return a pointer to an arena (never returns NULL)
+ */
+struct arena *create_arena(size_t page)
+{
+    struct arena *arena;
+    if ((arena = malloc(sizeof(struct arena))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    arena->pages = NULL;
+    arena->cleanups = NULL;
+    arena->page = page > 0 ? page : ARENA_PAGE;
+    return arena;
+}
+
+/**
+ * Adds a page to an arena.
+ *
+ * Allocations larger than the page size get a page of their own, which is
+ * linked behind the current page so that the current page remains in use.
+ *
+ * @param arena a pointer to an arena
+ * @param size the size of the allocation that needs the page
+ * @return a pointer to the new page
+ */
+static struct page *add_page(struct arena *arena, size_t size)
+{
+    size_t data = size > arena->page ? size : arena->page;
+    struct page *page;
+    if ((page = malloc(ALIGN(sizeof(struct page)) + data)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    page->size = data;
+    page->used = 0;
+    if (size > arena->page && arena->pages != NULL) {
+        page->next = arena->pages->next;
+        arena->pages->next = page;
+    } else {
+        page->next = arena->pages;
+        arena->pages = page;
+    }
+    return page;
+}
+
+/**
+ * Allocates memory from an arena.
+ *
+ * The memory is aligned for any navaid field and is not initialized. It
+ * remains valid until the arena is destroyed.
+ *
+ * @param arena a pointer to an arena
+ * @param size the size of the allocation in bytes
+ * @return a pointer to the memory (never returns NULL)
+ */
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    assert(arena != NULL);
+    size = ALIGN(size > 0 ? size : 1);
+
+    struct page *page = arena->pages;
+    if (page == NULL || page->size - page->used < size)
+        page = add_page(arena, size);
+
+    void *p = (char *)page + ALIGN(sizeof(struct page)) + page->used;
+    page->used += size;
+    return p;
+}
+
+/**
+ * Duplicates a string in an arena.
+ *
+ * @param arena a pointer to an arena
+ * @param s the string to duplicate (may be NULL)
+ * @return a duplicate of the string, or NULL
+ */
+char *arena_strdup(struct arena *arena, const char *s)
+{
+    if (s == NULL)
+        return NULL;
+    size_t n = strlen(s) + 1;
+    return memcpy(arena_alloc(arena, n), s, n);
+}
+
+/**
+ * Registers a cleanup action to run when an arena is destroyed.
+ *
+ * Cleanup actions run in reverse order of registration.
+ *
+ * @param arena a pointer to an arena
+ * @param release the function that releases the resource
+ * @param data the resource, passed to the release function
+ */
+void arena_cleanup(struct arena *arena, void (*release)(void *), void *data)
+{
+    struct cleanup *c = arena_alloc(arena, sizeof(struct cleanup));
+    c->release = release;
+    c->data = data;
+    c->next = arena->cleanups;
+    arena->cleanups = c;
+}
+
+/**
+ * Destroys an arena, releasing all memory allocated from it.
+ *
+ * @param arena a pointer to an arena (may be NULL)
+ */
+void destroy_arena(struct arena *arena)
+{
+    if (arena == NULL)
+        return;
+    for (struct cleanup *c = arena->cleanups; c != NULL; c = c->next)
+        c->release(c->data);
+    struct page *page = arena->pages;
+    while (page != NULL) {
+        struct page *next = page->next;
+        free(page);
+        page = next;
+    }
+    free(arena);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file arena.h
+ *
+ * Arena allocator for data with a common lifetime.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef arena_h
+#define arena_h
+
+#include <stddef.h>
+
+/**
+ * Default size of arena pages.
+ */
+#define ARENA_PAGE (1024 * 1024)
+
+struct arena;
+
+struct arena *create_arena(size_t page);
+void *arena_alloc(struct arena *arena, size_t size);
+char *arena_strdup(struct arena *arena, const char *s);
+void arena_cleanup(struct arena *arena, void (*release)(void *), void *data);
+void destroy_arena(struct arena *arena);
+
+#endif
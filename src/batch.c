@@ -0,0 +1,898 @@
+/**
+ * @file batch.c
+ *
+ * Nearest and receivable navaids for streams of positions.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "batch.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "filter.h"
+#include "flags.h"
+#include "geo.h"
+#include "heap.h"
+#include "parse.h"
+#include "pool.h"
+#include "search.h"
+#include "types.h"
+#include "util.h"
+
+#ifndef M_PI
+/**
+ * Value of pi, if not defined by math.h.
+ */
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * Converts degrees to radians.
+ */
+#define RADIANS(d) ((d) * M_PI / 180.0)
+
+/**
+ * Converts radians to degrees.
+ */
+#define DEGREES(r) ((r) * 180.0 / M_PI)
+
+/**
+ * Number of children of each node of the spatial index.
+ */
+#define BATCH_FANOUT 16
+
+/**
+ * Number of positions read, searched and written together.
+ */
+#define BATCH_CHUNK 65536
+
+/**
+ * Number of positions searched by each task.
+ */
+#define BATCH_TASK 256
+
+/**
+ * Maximum length of a result row.
+ */
+#define BATCH_ROW_MAX 128
+
+/**
+ * Amount by which rounding may make a lower bound on a squared chord
+ * exceed the true value.
+ */
+#define BATCH_SLACK 1e-12
+
+/**
+ * Point on the unit sphere.
+ *
+ * Distances are compared as squared chords between points, which grow
+ * with the great circle distance but need no trigonometry.
+ */
+struct vector {
+    double x;   ///< Towards latitude 0, longitude 0
+    double y;   ///< Towards latitude 0, longitude 90 east
+    double z;   ///< Towards the north pole
+};
+
+/**
+ * Navaid in the spatial index.
+ */
+struct entry {
+    struct vector vector;           ///< Position of the navaid
+    double reach;                   ///< Squared chord of the range
+    int position;                   ///< Position of the navaid in the cache
+    uint32_t key;                   ///< Hilbert key of the coordinate
+    const struct navaid *navaid;    ///< The navaid
+};
+
+/**
+ * Node of the spatial index, with the sines and cosines of the edges of
+ * its bounding box.
+ */
+struct node {
+    double min_lat;     ///< Minimum latitude below the node
+    double max_lat;     ///< Maximum latitude below the node
+    double min_lon;     ///< Minimum longitude below the node
+    double max_lon;     ///< Maximum longitude below the node
+    double lat_sin[2];  ///< Sines of the minimum and maximum latitude
+    double lat_cos[2];  ///< Cosines of the minimum and maximum latitude
+    double lon_sin[2];  ///< Sines of the minimum and maximum longitude
+    double lon_cos[2];  ///< Cosines of the minimum and maximum longitude
+    double reach;       ///< Greatest squared chord of a range below it
+    int first;          ///< First child node, or first entry of a leaf
+    int count;          ///< Number of children or entries
+};
+
+/**
+ * Position being searched, with its trigonometry.
+ */
+struct position {
+    struct coordinate coordinate;   ///< Latitude and longitude
+    struct vector vector;           ///< Point on the unit sphere
+    double lat_sin;                 ///< Sine of the latitude
+    double lat_cos;                 ///< Cosine of the latitude
+    double lon_sin;                 ///< Sine of the longitude
+    double lon_cos;                 ///< Cosine of the longitude
+};
+
+/**
+ * Read-only spatial index, shared by all the tasks.
+ *
+ * The entries are in the order of the Hilbert keys of their coordinates
+ * and each leaf holds a run of up to BATCH_FANOUT of them. Each level
+ * above groups runs of up to BATCH_FANOUT nodes of the level below, so
+ * navaids that are close together share subtrees and a search only
+ * descends into the few whose bounding boxes could hold a result.
+ */
+struct tree {
+    struct entry *entries;  ///< Entries
+    int count;              ///< Number of entries
+    struct node *nodes;     ///< Nodes, leaves first and the root last
+    int leaves;             ///< Number of leaves
+    int root;               ///< Index of the root, or -1 if there are none
+};
+
+/**
+ * Text written by a task.
+ */
+struct output {
+    char *text;             ///< Result rows
+    size_t length;          ///< Length of the rows
+    size_t capacity;        ///< Allocated size of the text
+};
+
+/**
+ * Chunk of positions searched in parallel.
+ */
+struct chunk {
+    const struct tree *tree;            ///< Spatial index
+    const struct coordinate *points;    ///< Positions
+    int count;                          ///< Number of positions
+    long first;                         ///< Number of the first position
+    bool receivable;                    ///< Find receivable, not nearest
+    struct heap *heaps;                 ///< Result heap of each worker
+    struct output *outputs;             ///< Output of each task
+};
+
+/**
+ * Source of positions.
+ */
+struct reader {
+    FILE *file;             ///< File to read
+    const char *path;       ///< Path of the file, for messages
+    bool binary;            ///< Pairs of doubles rather than CSV text
+    char *line;             ///< Line buffer for CSV
+    size_t size;            ///< Size of the line buffer
+    long lines;             ///< Number of lines read
+    long count;             ///< Number of positions read
+};
+
+/**
+ * Checks if a navaid can be a result.
+ *
+ * Glideslopes and markers are only loaded to describe stations, and DMEs
+ * only count when they were asked for.
+ *
+ * @param navaid a pointer to the navaid
+ * @return true if the navaid can be a result
+ */
+static bool is_result(const struct navaid *navaid)
+{
+    extern struct flags flags;
+    switch (navaid->type) {
+    case NDB:
+    case VOR:
+    case ILS:
+    case LOC:
+        return true;
+    case DME:
+    case SDM:
+        return flags.dme;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Compares entries by Hilbert key, then data file order.
+ *
+ * @param a pointer to the first entry
+ * @param b pointer to the second entry
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_entries(const void *a, const void *b)
+{
+    const struct entry *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return x->position - y->position;
+}
+
+/**
+ * Compares candidates by distance, then data file order.
+ *
+ * @param a pointer to the first candidate
+ * @param b pointer to the second candidate
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_distances(const struct candidate *a,
+    const struct candidate *b)
+{
+    if (a->value != b->value)
+        return a->value < b->value ? -1 : 1;
+    return a->position - b->position;
+}
+
+/**
+ * Initializes a node to cover nothing.
+ *
+ * @param node a pointer to the node
+ * @param first the first child or entry
+ * @param count the number of children or entries
+ */
+static void init_node(struct node *node, int first, int count)
+{
+    node->min_lat = node->min_lon = INFINITY;
+    node->max_lat = node->max_lon = -INFINITY;
+    node->reach = 0;
+    node->first = first;
+    node->count = count;
+}
+
+/**
+ * Calculates the sines and cosines of the edges of a node.
+ *
+ * @param node a pointer to the node, with its bounding box set
+ */
+static void finish_node(struct node *node)
+{
+    double lats[] = { node->min_lat, node->max_lat };
+    double lons[] = { node->min_lon, node->max_lon };
+    for (int i = 0; i < 2; ++i) {
+        node->lat_sin[i] = sin(RADIANS(lats[i]));
+        node->lat_cos[i] = cos(RADIANS(lats[i]));
+        node->lon_sin[i] = sin(RADIANS(lons[i]));
+        node->lon_cos[i] = cos(RADIANS(lons[i]));
+    }
+}
+
+/**
+ * Converts a coordinate to a point on the unit sphere.
+ *
+ * @param c a pointer to the coordinate
+ * @param v a pointer to the point to set
+ */
+static void to_vector(const struct coordinate *c, struct vector *v)
+{
+    v->x = cos(RADIANS(c->lat)) * cos(RADIANS(c->lon));
+    v->y = cos(RADIANS(c->lat)) * sin(RADIANS(c->lon));
+    v->z = sin(RADIANS(c->lat));
+}
+
+/**
+ * Initializes a position to search from a coordinate.
+ *
+ * @param p a pointer to the position
+ * @param c a pointer to the coordinate
+ */
+static void init_position(struct position *p, const struct coordinate *c)
+{
+    p->coordinate = *c;
+    p->lat_sin = sin(RADIANS(c->lat));
+    p->lat_cos = cos(RADIANS(c->lat));
+    p->lon_sin = sin(RADIANS(c->lon));
+    p->lon_cos = cos(RADIANS(c->lon));
+    p->vector.x = p->lat_cos * p->lon_cos;
+    p->vector.y = p->lat_cos * p->lon_sin;
+    p->vector.z = p->lat_sin;
+}
+
+/**
+ * Calculates the squared chord between two points on the unit sphere.
+ *
+ * @param a a pointer to the first point
+ * @param b a pointer to the second point
+ * @return the squared chord
+ */
+static inline double chord(const struct vector *a, const struct vector *b)
+{
+    double dx = a->x - b->x, dy = a->y - b->y, dz = a->z - b->z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/**
+ * Builds the spatial index over its entries.
+ *
+ * @param tree a pointer to the index, with its entries set
+ */
+static void build_tree(struct tree *tree)
+{
+    for (int i = 0; i < tree->count; ++i) {
+        struct entry *e = &tree->entries[i];
+        e->key = hilbert_key(&e->navaid->coordinate);
+    }
+    qsort(tree->entries, tree->count, sizeof(struct entry), compare_entries);
+
+    tree->leaves = (tree->count + BATCH_FANOUT - 1) / BATCH_FANOUT;
+    size_t total = 0;
+    for (int n = tree->leaves; n > 1; n = (n + BATCH_FANOUT - 1) / BATCH_FANOUT)
+        total += n;
+    ++total;
+    if ((tree->nodes = malloc((total + 1) * sizeof(struct node))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int l = 0; l < tree->leaves; ++l) {
+        struct node *node = &tree->nodes[l];
+        int first = l * BATCH_FANOUT;
+        int count = tree->count - first;
+        init_node(node, first, count < BATCH_FANOUT ? count : BATCH_FANOUT);
+        for (int i = first; i < first + node->count; ++i) {
+            const struct entry *e = &tree->entries[i];
+            const struct coordinate *c = &e->navaid->coordinate;
+            node->min_lat = fmin(node->min_lat, c->lat);
+            node->max_lat = fmax(node->max_lat, c->lat);
+            node->min_lon = fmin(node->min_lon, c->lon);
+            node->max_lon = fmax(node->max_lon, c->lon);
+            node->reach = fmax(node->reach, e->reach);
+        }
+        finish_node(node);
+    }
+
+    int begin = 0, end = tree->leaves;
+    while (end - begin > 1) {
+        int next = end;
+        for (int c = begin; c < end; c += BATCH_FANOUT) {
+            struct node *node = &tree->nodes[next++];
+            int count = end - c;
+            init_node(node, c, count < BATCH_FANOUT ? count : BATCH_FANOUT);
+            for (int i = c; i < c + node->count; ++i) {
+                const struct node *child = &tree->nodes[i];
+                node->min_lat = fmin(node->min_lat, child->min_lat);
+                node->max_lat = fmax(node->max_lat, child->max_lat);
+                node->min_lon = fmin(node->min_lon, child->min_lon);
+                node->max_lon = fmax(node->max_lon, child->max_lon);
+                node->reach = fmax(node->reach, child->reach);
+            }
+            finish_node(node);
+        }
+        begin = end;
+        end = next;
+    }
+    tree->root = tree->leaves > 0 ? begin : -1;
+}
+
+/**
+ * Calculates the cosine of the angle from a position to the nearest point
+ * of an edge of a node along a meridian.
+ *
+ * The nearest point of the whole meridian is where the great circle
+ * through the position and the poles meets it, or the nearer pole if the
+ * meridian is on the far side of the Earth. The angle grows away from
+ * that point, so it is clamped to the latitudes of the node.
+ *
+ * @param p a pointer to the position
+ * @param node a pointer to the node
+ * @param edge 0 for the western edge, 1 for the eastern edge
+ * @return the cosine of the angle
+ */
+static double edge_cosine(const struct position *p, const struct node *node,
+    int edge)
+{
+    double dlon_cos = node->lon_cos[edge] * p->lon_cos +
+        node->lon_sin[edge] * p->lon_sin;
+    int end;
+    if (dlon_cos <= 0)
+        end = p->lat_sin < 0 ? 0 : 1;
+    else if (p->lat_sin * node->lat_cos[0] <
+        p->lat_cos * dlon_cos * node->lat_sin[0])
+        end = 0;
+    else if (p->lat_sin * node->lat_cos[1] >
+        p->lat_cos * dlon_cos * node->lat_sin[1])
+        end = 1;
+    else {
+        double dlon_sin = node->lon_sin[edge] * p->lon_cos -
+            node->lon_cos[edge] * p->lon_sin;
+        double s = p->lat_cos * dlon_sin;
+        return sqrt(1 - s * s);
+    }
+    return p->lat_sin * node->lat_sin[end] +
+        p->lat_cos * node->lat_cos[end] * dlon_cos;
+}
+
+/**
+ * Calculates a lower bound on the squared chord from a position to the
+ * navaids below a node.
+ *
+ * Along any parallel, the distance from the position grows with the
+ * difference in longitude, so the nearest point of the bounding box is on
+ * the meridian of the position if the box spans it, otherwise on one of
+ * the edges of the box.
+ *
+ * @param p a pointer to the position
+ * @param node a pointer to the node
+ * @return the squared chord
+ */
+static double node_chord(const struct position *p, const struct node *node)
+{
+    double cosine;
+    const struct coordinate *c = &p->coordinate;
+    if (c->lon >= node->min_lon && c->lon <= node->max_lon) {
+        if (c->lat >= node->min_lat && c->lat <= node->max_lat)
+            return 0;
+        int end = c->lat < node->min_lat ? 0 : 1;
+        cosine = p->lat_sin * node->lat_sin[end] +
+            p->lat_cos * node->lat_cos[end];
+    } else
+        cosine = fmax(edge_cosine(p, node, 0), edge_cosine(p, node, 1));
+    return 2 - 2 * cosine;
+}
+
+/**
+ * Returns the squared chord that a candidate must beat to enter a heap.
+ *
+ * @param heap a pointer to the heap
+ * @return the squared chord of the worst candidate, or infinity if the
+ * heap is not full
+ */
+static double worst(const struct heap *heap)
+{
+    return heap->count == heap->limit ? heap->items[0].value : INFINITY;
+}
+
+/**
+ * Finds the navaids nearest to a position below a node.
+ *
+ * The children are visited nearest first, and the search stops at the
+ * first child that cannot beat the results found so far.
+ *
+ * @param tree a pointer to the spatial index
+ * @param n the index of the node
+ * @param p a pointer to the position
+ * @param heap a pointer to the heap of results
+ */
+static void nearest(const struct tree *tree, int n, const struct position *p,
+    struct heap *heap)
+{
+    const struct node *node = &tree->nodes[n];
+    if (n < tree->leaves) {
+        for (int i = node->first; i < node->first + node->count; ++i) {
+            const struct entry *e = &tree->entries[i];
+            struct candidate c = {
+                e->navaid, e->position, chord(&p->vector, &e->vector)
+            };
+            offer(heap, &c);
+        }
+        return;
+    }
+
+    double bounds[BATCH_FANOUT];
+    int children[BATCH_FANOUT];
+    for (int i = 0; i < node->count; ++i) {
+        double d = node_chord(p, &tree->nodes[node->first + i]);
+        int j = i;
+        for (; j > 0 && bounds[j - 1] > d; --j) {
+            bounds[j] = bounds[j - 1];
+            children[j] = children[j - 1];
+        }
+        bounds[j] = d;
+        children[j] = node->first + i;
+    }
+    for (int i = 0; i < node->count; ++i) {
+        if (bounds[i] > worst(heap) + BATCH_SLACK)
+            break;
+        nearest(tree, children[i], p, heap);
+    }
+}
+
+/**
+ * Finds the navaids below a node whose reception range reaches a
+ * position.
+ *
+ * Nodes are skipped if the position is further from them than the
+ * greatest range below them, or further than the results found so far.
+ *
+ * @param tree a pointer to the spatial index
+ * @param n the index of the node
+ * @param p a pointer to the position
+ * @param heap a pointer to the heap of results
+ */
+static void receivable(const struct tree *tree, int n,
+    const struct position *p, struct heap *heap)
+{
+    const struct node *node = &tree->nodes[n];
+    double bound = node_chord(p, node);
+    if (bound > node->reach + BATCH_SLACK ||
+        bound > worst(heap) + BATCH_SLACK)
+        return;
+    if (n >= tree->leaves) {
+        for (int i = node->first; i < node->first + node->count; ++i)
+            receivable(tree, i, p, heap);
+        return;
+    }
+    for (int i = node->first; i < node->first + node->count; ++i) {
+        const struct entry *e = &tree->entries[i];
+        double d = chord(&p->vector, &e->vector);
+        if (d <= e->reach) {
+            struct candidate c = { e->navaid, e->position, d };
+            offer(heap, &c);
+        }
+    }
+}
+
+/**
+ * Appends a result row to the output of a task.
+ *
+ * @param output a pointer to the output
+ * @param point the number of the position, from 1
+ * @param p a pointer to the position
+ * @param c a pointer to the result, valued by squared chord
+ */
+static void write_row(struct output *output, long point,
+    const struct position *p, const struct candidate *c)
+{
+    const struct navaid *navaid = c->navaid;
+    output->text = reserve(output->text, &output->capacity,
+        output->length + BATCH_ROW_MAX, 1);
+    int n = snprintf(output->text + output->length, BATCH_ROW_MAX,
+        "%ld,%s,%s,%.2f,%.1f,%.1f\n", point, type_description(navaid->type),
+        navaid->code, navaid->frequency,
+        2 * EARTH_RADIUS_NM * asin(fmin(sqrt(c->value) / 2, 1)),
+        bearing(&p->coordinate, &navaid->coordinate));
+    output->length += n < BATCH_ROW_MAX ? n : BATCH_ROW_MAX - 1;
+}
+
+/**
+ * Searches a run of the positions in a chunk.
+ *
+ * Each task writes its own output and each worker has its own heap, so
+ * the tasks share only the read-only spatial index.
+ *
+ * @param task the index of the task
+ * @param worker the index of the worker
+ * @param data a pointer to the chunk
+ */
+static void search_task(int task, int worker, void *data)
+{
+    struct chunk *chunk = data;
+    struct heap *heap = &chunk->heaps[worker];
+    struct output *output = &chunk->outputs[task];
+    output->length = 0;
+
+    int end = (task + 1) * BATCH_TASK;
+    if (end > chunk->count)
+        end = chunk->count;
+    for (int i = task * BATCH_TASK; i < end; ++i) {
+        struct position p;
+        init_position(&p, &chunk->points[i]);
+        heap->count = 0;
+        if (chunk->tree->root >= 0) {
+            if (chunk->receivable)
+                receivable(chunk->tree, chunk->tree->root, &p, heap);
+            else
+                nearest(chunk->tree, chunk->tree->root, &p, heap);
+        }
+        int n = drain(heap);
+        for (int j = 0; j < n; ++j)
+            write_row(output, chunk->first + i, &p, &heap->items[j]);
+    }
+}
+
+/**
+ * Checks if a position is a valid latitude and longitude.
+ *
+ * @param c a pointer to the position
+ * @return true if the position is valid
+ */
+static bool valid_position(const struct coordinate *c)
+{
+    return c->lat >= -90 && c->lat <= 90 && c->lon >= -180 && c->lon <= 180;
+}
+
+/**
+ * Parses a position from a CSV line.
+ *
+ * The line starts with the latitude and longitude in decimal degrees.
+ * Any further fields are ignored.
+ *
+ * @param s the line
+ * @param c a pointer to the position to set
+ * @return true if the line holds a valid position
+ */
+bool parse_position(const char *s, struct coordinate *c)
+{
+    char *end;
+    c->lat = strtod(s, &end);
+    if (end == s)
+        return false;
+    for (s = end; *s == ' ' || *s == '\t'; ++s)
+        ;
+    if (*s++ != ',')
+        return false;
+    c->lon = strtod(s, &end);
+    if (end == s)
+        return false;
+    for (s = end; *s == ' ' || *s == '\t'; ++s)
+        ;
+    return (*s == ',' || *s == '\r' || *s == '\n' || *s == '\0') &&
+        valid_position(c);
+}
+
+/**
+ * Reads positions from CSV text.
+ *
+ * Blank lines are skipped, and so is the first line if it is not a
+ * position, which allows a header row.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * any other line is not a valid position.
+ *
+ * @param reader a pointer to the reader
+ * @param points the positions to fill
+ * @param max the maximum number of positions to read
+ * @return the number of positions read, 0 at the end of the file
+ */
+static int read_text(struct reader *reader, struct coordinate *points,
+    int max)
+{
+    int n = 0;
+    while (n < max && getline(&reader->line, &reader->size, reader->file)
+        != -1) {
+        ++reader->lines;
+        if (reader->line[strspn(reader->line, " \t\r\n")] == '\0')
+            continue;
+        if (parse_position(reader->line, &points[n])) {
+            ++n;
+            continue;
+        }
+        if (reader->lines == 1)
+            continue;
+        fprintf(stderr, "Invalid position at line %ld of %s\n",
+            reader->lines, reader->path);
+        exit(EXIT_FAILURE);
+    }
+    return n;
+}
+
+/**
+ * Reads positions as pairs of native doubles, latitude first.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * a position is not valid or the file ends part way through one.
+ *
+ * @param reader a pointer to the reader
+ * @param points the positions to fill
+ * @param max the maximum number of positions to read
+ * @return the number of positions read, 0 at the end of the file
+ */
+static int read_binary(struct reader *reader, struct coordinate *points,
+    int max)
+{
+    size_t bytes = fread(points, 1, max * sizeof(struct coordinate),
+        reader->file);
+    if (bytes % sizeof(struct coordinate) != 0) {
+        fprintf(stderr, "Incomplete position at end of %s\n", reader->path);
+        exit(EXIT_FAILURE);
+    }
+    int n = (int)(bytes / sizeof(struct coordinate));
+    for (int i = 0; i < n; ++i)
+        if (!valid_position(&points[i])) {
+            fprintf(stderr, "Invalid position %ld in %s\n",
+                reader->count + i + 1, reader->path);
+            exit(EXIT_FAILURE);
+        }
+    return n;
+}
+
+/**
+ * Reads the next chunk of positions.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * the file cannot be read.
+ *
+ * @param reader a pointer to the reader
+ * @param points the positions to fill
+ * @param max the maximum number of positions to read
+ * @return the number of positions read, 0 at the end of the file
+ */
+static int read_points(struct reader *reader, struct coordinate *points,
+    int max)
+{
+    int n = reader->binary ? read_binary(reader, points, max) :
+        read_text(reader, points, max);
+    if (ferror(reader->file)) {
+        perror(reader->path);
+        exit(EXIT_FAILURE);
+    }
+    reader->count += n;
+    return n;
+}
+
+/**
+ * Collects the navaids that can be results into a spatial index.
+ *
+ * @param tree a pointer to the index to fill
+ * @param cache the navaid cache
+ * @param selection a filter selection (may be NULL)
+ * @param receivable true if only navaids with a range are needed
+ */
+static void create_tree(struct tree *tree, struct navaid **cache,
+    const uint64_t *selection, bool receivable)
+{
+    size_t count = 0;
+    while (cache[count] != NULL)
+        ++count;
+    if ((tree->entries = malloc((count + 1) * sizeof(struct entry))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    tree->count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        struct navaid *navaid = cache[i];
+        if (!is_result(navaid) || !is_selected(selection, (int)i) ||
+            isnan(navaid->coordinate.lat) || isnan(navaid->coordinate.lon))
+            continue;
+        if (receivable) {
+            parse_details(navaid);
+            if (navaid->range <= 0)
+                continue;
+        }
+        struct entry *e = &tree->entries[tree->count++];
+        to_vector(&navaid->coordinate, &e->vector);
+        double half = receivable ? navaid->range / EARTH_RADIUS_NM / 2 : 0;
+        e->reach = 4 * sin(half) * sin(half);
+        e->position = (int)i;
+        e->navaid = navaid;
+    }
+    build_tree(tree);
+}
+
+/**
+ * Returns the time elapsed since an earlier time.
+ *
+ * @param start a pointer to the earlier time
+ * @return the elapsed time in seconds
+ */
+static double elapsed(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) +
+        (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Finds the nearest or receivable navaids for each position in a file.
+ *
+ * Positions are read from a file, or standard input if the path is "-".
+ * A file whose name ends with ".bin" holds pairs of native doubles,
+ * latitude first. Anything else is CSV text with the latitude and
+ * longitude as the first two fields.
+ *
+ * The positions are read in chunks, and the positions in each chunk are
+ * searched in parallel against a read-only spatial index of the navaids.
+ * Results are written to standard output as CSV, in the order of the
+ * positions and nearest first for each position, and throughput is
+ * reported to standard error unless quiet.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * the file cannot be read or holds an invalid position.
+ *
+ * @param cache the navaid cache
+ * @param selection a filter selection (may be NULL)
+ * @param path the path of the file of positions
+ * @param receivable true to find the navaids whose reception range reaches
+ * each position, false to find the nearest navaids
+ * @param limit the maximum number of navaids for each position, 0 for the
+ * default of 1 nearest or all receivable
+ * @param pool the thread pool (may be NULL)
+ * @return the number of positions
+ */
+long batch(struct navaid **cache, const uint64_t *selection, const char *path,
+    bool receivable, int limit, struct pool *pool)
+{
+    extern struct flags flags;
+    assert(cache != NULL && path != NULL && limit >= 0);
+
+    struct reader reader = { .path = path };
+    if (strcmp(path, "-") == 0) {
+        reader.file = stdin;
+        reader.path = "standard input";
+    } else {
+        size_t length = strlen(path);
+        reader.binary = length >= 4 && strcmp(path + length - 4, ".bin") == 0;
+        if ((reader.file = fopen(path, reader.binary ? "rb" : "r")) == NULL) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct tree tree;
+    create_tree(&tree, cache, selection, receivable);
+
+    int workers = pool != NULL ? pool_size(pool) : 1;
+    int tasks = BATCH_CHUNK / BATCH_TASK;
+    struct coordinate *points;
+    struct heap *heaps;
+    struct output *outputs;
+    if ((points = malloc(BATCH_CHUNK * sizeof(struct coordinate))) == NULL ||
+        (heaps = malloc(workers * sizeof(struct heap))) == NULL ||
+        (outputs = calloc(tasks, sizeof(struct output))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // Heaps with a limit do not sort through shared state, so the limit
+    // for all receivable navaids is the number of them
+    int keep = limit > 0 ? limit : receivable && tree.count > 0 ?
+        tree.count : 1;
+    for (int w = 0; w < workers; ++w)
+        init_heap(&heaps[w], keep, compare_distances);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    puts("point,type,code,frequency,distance,bearing");
+    struct chunk chunk = {
+        &tree, points, 0, 1, receivable, heaps, outputs
+    };
+    while ((chunk.count = read_points(&reader, points, BATCH_CHUNK)) > 0) {
+        int n = (chunk.count + BATCH_TASK - 1) / BATCH_TASK;
+        if (pool != NULL)
+            run_pool(pool, n, search_task, &chunk);
+        else
+            for (int t = 0; t < n; ++t)
+                search_task(t, 0, &chunk);
+        for (int t = 0; t < n; ++t)
+            fwrite(outputs[t].text, 1, outputs[t].length, stdout);
+        chunk.first += chunk.count;
+    }
+    fflush(stdout);
+
+    if (!flags.quiet) {
+        double seconds = elapsed(&start);
+        fprintf(stderr, "%ld position%s in %.2fs, %.0f per second per core "
+            "on %d core%s\n", reader.count, reader.count == 1 ? "" : "s",
+            seconds, seconds > 0 ? reader.count / seconds / workers : 0.0,
+            workers, workers == 1 ? "" : "s");
+    }
+
+    if (reader.file != stdin)
+        fclose(reader.file);
+    free(reader.line);
+    for (int t = 0; t < tasks; ++t)
+        free(outputs[t].text);
+    for (int w = 0; w < workers; ++w)
+        free_heap(&heaps[w]);
+    free(outputs);
+    free(heaps);
+    free(points);
+    free(tree.nodes);
+    free(tree.entries);
+    return reader.count;
+}
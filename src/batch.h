@@ -0,0 +1,36 @@
+/**
+ * @file batch.h
+ *
+ * Nearest and receivable navaids for streams of positions.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef batch_h
+#define batch_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct coordinate;
+struct navaid;
+struct pool;
+
+long batch(struct navaid **cache, const uint64_t *selection, const char *path,
+    bool receivable, int limit, struct pool *pool);
+bool parse_position(const char *s, struct coordinate *c);
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * @file bktree.c
+ *
+ * BK-tree of navaid codes for approximate matching.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bktree.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+/**
+ * Marker for the end of a list of nodes or positions.
+ */
+#define NONE (-1)
+
+/**
+ * BK-tree node.
+ *
+ * Each node holds one distinct navaid code. Navaids that share the code are
+ * chained through the next array of the tree, in cache order. Children are
+ * chained through their sibling field.
+ */
+struct node {
+    const char *key;    ///< Navaid code
+    int distance;       ///< Edit distance from the parent's code
+    int child;          ///< First child node
+    int sibling;        ///< Next sibling node
+    int first;          ///< First cache position with this code
+    int last;           ///< Last cache position with this code
+};
+
+/**
+ * BK-tree structure.
+ *
+ * Nodes are held in a contiguous array and refer to each other by index.
+ */
+struct bktree {
+    struct node *nodes; ///< Array of nodes, the root is at index 0
+    int count;          ///< Number of nodes in use
+    int *next;          ///< Next cache position with the same code
+    int size;           ///< Number of navaids in the cache
+};
+
+/**
+ * Calculates the Levenshtein edit distance between a term and a code.
+ *
+ * The code is limited to CODE_MAX characters, so a single row of the
+ * dynamic programming matrix fits on the stack.
+ *
+ * @param term the search term
+ * @param code the navaid code
+ * @return the number of single character edits to turn one into the other
+ */
+static int levenshtein(const char *term, const char *code)
+{
+    int row[CODE_MAX + 1];
+    int n = (int)strlen(code);
+    assert(n <= CODE_MAX);
+
+    for (int j = 0; j <= n; ++j)
+        row[j] = j;
+
+    for (int i = 1; *term; ++term, ++i) {
+        int diagonal = row[0];
+        row[0] = i;
+        for (int j = 1; j <= n; ++j) {
+            int above = row[j];
+            int cost = diagonal + (*term != code[j - 1]);
+            if (row[j] + 1 < cost)
+                cost = row[j] + 1;
+            if (row[j - 1] + 1 < cost)
+                cost = row[j - 1] + 1;
+            row[j] = cost;
+            diagonal = above;
+        }
+    }
+    return row[n];
+}
+
+/**
+ * Adds a node to a tree, expanding the node array when necessary.
+ *
+ * @param tree a pointer to the tree
+ * @param key the navaid code
+ * @param distance the edit distance from the parent's code
+ * @param position the cache position of the navaid
+ * @return the index of the new node
+ */
+static int add_node(struct bktree *tree, const char *key, int distance,
+    int position)
+{
+    if ((tree->count & (tree->count - 1)) == 0) {
+        size_t size = (tree->count ? tree->count * 2 : 1) * sizeof(struct node);
+        if ((tree->nodes = realloc(tree->nodes, size)) == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    struct node *node = &tree->nodes[tree->count];
+    node->key = key;
+    node->distance = distance;
+    node->child = node->sibling = NONE;
+    node->first = node->last = position;
+    return tree->count++;
+}
+
+/**
+ * Inserts a navaid into a tree.
+ *
+ * @param tree a pointer to the tree
+ * @param key the navaid code
+ * @param position the cache position of the navaid
+ */
+static void insert(struct bktree *tree, const char *key, int position)
+{
+    if (tree->count == 0) {
+        add_node(tree, key, 0, position);
+        return;
+    }
+    int i = 0;
+    for (;;) {
+        int d = levenshtein(key, tree->nodes[i].key);
+        if (d == 0) {
+            tree->next[tree->nodes[i].last] = position;
+            tree->nodes[i].last = position;
+            return;
+        }
+        int c = tree->nodes[i].child;
+        while (c != NONE && tree->nodes[c].distance != d)
+            c = tree->nodes[c].sibling;
+        if (c == NONE) {
+            int n = add_node(tree, key, d, position);
+            tree->nodes[n].sibling = tree->nodes[i].child;
+            tree->nodes[i].child = n;
+            return;
+        }
+        i = c;
+    }
+}
+
+/**
+ * Creates a BK-tree over the distinct codes in a navaid cache.
+ *
+ * The tree refers to navaids by their position in the cache, so the cache
+ * must outlive the tree. The pointer returned from this function must be
+ * destroyed after use with destroy_bktree.
+ *
+ * @param cache an array of pointers to navaid structures, terminated by NULL
+ * @return a pointer to a BK-tree (never returns NULL)
+ */
+struct bktree *create_bktree(struct navaid **cache)
+{
+    assert(cache != NULL);
+
+    struct bktree *tree;
+    if ((tree = calloc(1, sizeof(struct bktree))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    while (cache[tree->size] != NULL)
+        ++tree->size;
+    if ((tree->next = malloc((tree->size + 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < tree->size; ++i) {
+        tree->next[i] = NONE;
+        insert(tree, cache[i]->code, i);
+    }
+    return tree;
+}
+
+/**
+ * Destroys a BK-tree.
+ *
+ * @param tree a pointer to a BK-tree
+ */
+void destroy_bktree(struct bktree *tree)
+{
+    if (tree != NULL) {
+        free(tree->nodes);
+        free(tree->next);
+    }
+    free(tree);
+}
+
+/**
+ * Searches a BK-tree for codes within an edit distance of a term.
+ *
+ * The triangle inequality means that only children whose distance from
+ * their parent is within max of the term's distance from the parent need
+ * to be visited, so most of the tree is never compared with the term.
+ *
+ * Suggestions are returned in tree order. The array returned through
+ * suggestions must be freed after use.
+ *
+ * @param tree a pointer to a BK-tree
+ * @param term the search term, in uppercase
+ * @param max the maximum edit distance
+ * @param suggestions receives an array of suggestions
+ * @return the number of suggestions
+ */
+int search_bktree(const struct bktree *tree, const char *term, int max,
+    struct suggestion **suggestions)
+{
+    assert(tree != NULL && term != NULL && suggestions != NULL);
+
+    int *stack;
+    size_t size = (tree->count + 1) * sizeof(int);
+    if ((stack = malloc(size)) == NULL ||
+        (*suggestions = malloc((tree->size + 1) * sizeof(struct suggestion)))
+            == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    int n = 0, top = 0;
+    if (tree->count > 0)
+        stack[top++] = 0;
+    while (top > 0) {
+        const struct node *node = &tree->nodes[stack[--top]];
+        int d = levenshtein(term, node->key);
+        if (d <= max)
+            for (int p = node->first; p != NONE; p = tree->next[p]) {
+                struct suggestion s = { p, d };
+                (*suggestions)[n++] = s;
+            }
+        for (int c = node->child; c != NONE; c = tree->nodes[c].sibling)
+            if (abs(tree->nodes[c].distance - d) <= max)
+                stack[top++] = c;
+    }
+    free(stack);
+    return n;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file bktree.h
+ *
+ * BK-tree of navaid codes for approximate matching.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef bktree_h
+#define bktree_h
+
+struct navaid;
+struct bktree;
+
+/**
+ * Approximate match of a navaid code.
+ */
+struct suggestion {
+    int position;   ///< Position of the navaid in the cache
+    int distance;   ///< Edit distance between the code and the search term
+};
+
+struct bktree *create_bktree(struct navaid **cache);
+void destroy_bktree(struct bktree *tree);
+int search_bktree(const struct bktree *tree, const char *term, int max,
+    struct suggestion **suggestions);
+
+#endif
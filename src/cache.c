@@ -19,112 +19,252 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
 #include "cache.h"
 
 #include <assert.h>
-#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <zlib.h>
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
 
+#include "arena.h"
+#include "flags.h"
+#include "gzindex.h"
+#include "internal.h"
 #include "parse.h"
+#include "pool.h"
+#include "region.h"
+#include "snapshot.h"
 #include "types.h"
+#include "util.h"
+
+/**
+ * Size of the buffer used by zlib when inflating the navigation data file.
+ */
+#define GZBUFSIZE (128 * 1024)
 
 /**
- * Size of chunks allocated dynamically as part of the navaid cache.
+ * Minimum size of the uncompressed data between checkpoints in the index of
+ * the compressed navigation data file.
  */
-#define CHUNKSIZE 8192
+#define SEGMENT_SPAN (1024 * 1024)
 
 /**
- * Navigation data file handle.
+ * Maximum size of the name of a gzip index file.
  */
-static gzFile gz;
+#define GZINDEX_NAME_SIZE 64
+
+/**
+ * Arena that owns the cache and everything it refers to.
+ */
+static struct arena *arena;
+
+/**
+ * Range of loaded data in a navigation data buffer.
+ */
+struct range {
+    size_t begin;   ///< Offset of the first byte
+    size_t end;     ///< Offset after the last byte
+};
 
 /**
- * Closes resources on exit.
+ * Navigation data buffer.
  *
- * The only closeable resource is the navigation data file. This function must
- * be registered with atexit before the navigation data file is opened.
+ * The navigation data file is held in memory while the cache is in use,
+ * because the string fields of navaids are slices of it. When the file is
+ * loaded through its gzip index, only some ranges of the buffer may hold
+ * data. A range that does not start at the beginning or finish at the end of
+ * the buffer may start or finish part way through a line.
  */
-static void exit_handler()
-{
-    if (gz != NULL && gzclose_r(gz) != Z_OK)
-        fprintf(stderr, "Error closing data file: %s", gzerror(gz, NULL));
-}
+struct buffer {
+    char *data;             ///< Contents of the navigation data file
+    size_t size;            ///< Size of the contents in bytes
+    bool mapped;            ///< True if the contents are memory mapped
+    struct range *ranges;   ///< Ranges of loaded data
+    int count;              ///< Number of ranges
+};
 
 /**
- * Dynamic cache structure.
+ * Cache builder structure.
  *
  * The cache is a NULL-terminated contiguous array of pointers to navaid
- * structures. Space is allocated in chunks and the max field keeps track
- * of the largest index that can be used on the array.
+ * structures. The array and the navaids are allocated from an arena. The
+ * array is allocated once, for the maximum number of navaids that can be
+ * added, which is known before parsing starts.
  */
-struct dynamic_cache {
-    int chunks;             ///< Number of chunks allocated to the cache
-    int max;                ///< Maximum index available in the cache
-    struct navaid **cache;  ///< Dynamically allocated array of navaid pointers
+struct builder {
+    struct arena *arena;    ///< Arena that owns the cache
+    int max;                ///< Maximum number of navaids in the cache
+    int count;              ///< Number of navaids in the cache
+    struct navaid **cache;  ///< Array of navaid pointers
 };
 
 /**
- * Initializes an empty dynamic cache.
+ * Initializes an empty cache builder.
  *
- * @param d a pointer to a dynamic cache structure
+ * @param b a pointer to a cache builder structure
+ * @param arena the arena that owns the cache
+ * @param max the maximum number of navaids that will be added
  */
-static void init(struct dynamic_cache *d)
+static void init(struct builder *b, struct arena *arena, int max)
 {
-    assert(d != NULL);
-    d->chunks = 0;
-    d->max = d->chunks * CHUNKSIZE - 1;
-    d->cache = NULL;
+    assert(b != NULL && arena != NULL && max >= 0);
+    b->arena = arena;
+    b->max = max;
+    b->count = 0;
+    b->cache = arena_alloc(arena, (max + 1) * sizeof(struct navaid *));
 }
 
 /**
- * Creates a new chunk of memory in a dynamic cache.
+ * Adds a copy of a navaid to a cache builder.
  *
- * The chunks field is incremented to track the number of chunks and the
- * max field is updated to indicate the maximum index available in the
- * array of pointers that form the cache.
+ * @param b a pointer to a cache builder structure
+ * @param navaid a pointer to the navaid to copy
+ */
+static void add(struct builder *b, const struct navaid *navaid)
+{
+    assert(b->count < b->max);
+    struct navaid *n = arena_alloc(b->arena, sizeof(struct navaid));
+    *n = *navaid;
+    b->cache[b->count++] = n;
+}
+
+/**
+ * Adds a navaid to a cache builder without copying it.
  *
- * @param d a pointer to a dynamic cache structure
+ * @param b a pointer to a cache builder structure
+ * @param navaid a pointer to the navaid, which must outlive the cache
  */
-static void create_chunk(struct dynamic_cache *d)
+static void refer(struct builder *b, struct navaid *navaid)
 {
-    assert(d != NULL);
-    size_t size = ++d->chunks * CHUNKSIZE * sizeof(struct navaid *);
-    d->max = d->chunks * CHUNKSIZE - 1;
-    if ((d->cache = realloc(d->cache, size)) == NULL) {
-        perror("realloc");
-        exit(EXIT_FAILURE);
+    assert(b->count < b->max);
+    b->cache[b->count++] = navaid;
+}
+
+/**
+ * Terminates the cache in a cache builder with NULL.
+ *
+ * @param b a pointer to a cache builder structure
+ */
+static void terminate(struct builder *b)
+{
+    b->cache[b->count] = NULL;
+}
+
+/**
+ * Checks if a navaid is selected by the search restrictions and region.
+ *
+ * When navaids are grouped into stations, DMEs are always selected so that
+ * they can join VORs, NDBs and ILSs, and glideslopes and markers are
+ * selected with ILSs.
+ *
+ * @param navaid the navaid to check
+ * @param region the region (may be NULL)
+ * @return true if the navaid should be in the cache
+ */
+static bool selected(const struct navaid *navaid, const struct region *region)
+{
+    extern struct flags flags;
+    switch (navaid->type) {
+    case NDB:
+        return flags.ndb && in_region(region, &navaid->coordinate);
+    case VOR:
+        return flags.vor && in_region(region, &navaid->coordinate);
+    case ILS:
+    case LOC:
+        return flags.ils && in_region(region, &navaid->coordinate);
+    case DME:
+    case SDM:
+        return (flags.dme || flags.group) &&
+            in_region(region, &navaid->coordinate);
+    case GS:
+    case OM:
+    case MM:
+    case IM:
+        return flags.ils && flags.group &&
+            in_region(region, &navaid->coordinate);
+    default:
+        return false;
     }
 }
 
+/**
+ * Returns the record types that are selected by the search restrictions.
+ *
+ * This must agree with selected, so that no part of the navigation data
+ * that might hold a selected navaid is skipped.
+ *
+ * @return a bit set of record types (bit n for type n)
+ */
+static uint64_t selected_types()
+{
+    extern struct flags flags;
+    uint64_t types = 0;
+    if (flags.ndb)
+        types |= 1ULL << NDB;
+    if (flags.vor)
+        types |= 1ULL << VOR;
+    if (flags.ils)
+        types |= 1ULL << ILS | 1ULL << LOC;
+    if (flags.dme || flags.group)
+        types |= 1ULL << DME | 1ULL << SDM;
+    if (flags.ils && flags.group)
+        types |= 1ULL << GS | 1ULL << OM | 1ULL << MM | 1ULL << IM;
+    return types;
+}
+
+/**
+ * Checks if a segment of the navigation data might hold selected navaids.
+ *
+ * @param summary the summary of the segment
+ * @param region the region (may be NULL)
+ * @return true if the segment must be loaded
+ */
+static bool segment_selected(const struct summary *summary,
+    const struct region *region)
+{
+    if ((summary->types & selected_types()) == 0) return false;
+
+    struct bounds box = {
+        { summary->min_lat, summary->min_lon },
+        { summary->max_lat, summary->max_lon }
+    };
+    return overlaps_region(region, &box);
+}
+
 /**
  * Preprocesses raw lines from the navigation data file.
  *
- * Newlines and carriage returns are stripped from the end of the string
- * and all characters are converted to uppercase. Conversion to uppercase
- * improves consistency in the output and produces a marginal performance
- * improvement during searches.
+ * A carriage return is stripped from the end of the line. Lines are not
+ * converted to uppercase here: the parser converts the fields it splits,
+ * and the descriptive name, which is most of the line, is only converted
+ * where it is used (see parse).
  *
- * @param s a line from the navigation data file
+ * @param s a line from the navigation data file, without its newline
+ * @param end a pointer to the terminator of the line
  * @return the length of the processed string
  */
-static int preprocess(char *s)
+int preprocess(char *s, char *end)
 {
-    int n = 0;
-    for (; *s; ++s, ++n) {
-        if (*s == '\n' || *s == '\r') {
-            *s = '\0';
-            break;
-        }
-        *s = toupper(*s);
-    }
-    return n;
+    if (end > s && end[-1] == '\r')
+        *--end = '\0';
+    return (int)(end - s);
 }
 
 /**
@@ -150,123 +290,965 @@ static void check_version(const char *header)
 }
 
 /**
- * Creates a navaid cache.
+ * Allocates space for the contents of the navigation data file.
+ *
+ * One byte more than the size is allocated, so the contents can always be
+ * terminated.
  *
- * The cache is built from the compressed navigation data file as a
- * dynamically expanding contiguous array of pointers to navaid structures.
- * Each line of the input file is converted to uppercase and trimmed, before
- * being passed to a parser that creates navaid structures to add to the cache.
+ * @param buffer a pointer to the buffer
+ * @param size the size of the contents in bytes
+ */
+static void allocate_buffer(struct buffer *buffer, size_t size)
+{
+    if ((buffer->data = realloc(buffer->data, size + 1)) == NULL) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Memory maps an uncompressed navigation data file.
  *
- * The data file is located through the FG_ROOT environment variable.
+ * The mapping is private, so the contents can be modified in place by the
+ * parser without affecting the file. Files that are empty or do not end with
+ * a newline are not mapped, because the last line could not be terminated.
  *
- * This function never returns NULL. Any errors in reading the input file or
- * allocating memory for the cache result in a message printed to standard
- * error and the program terminating with an error status.
+ * @param buffer a pointer to the buffer
+ * @param path the path to the uncompressed navigation data file
+ * @return true if the file was mapped, false if it could not be
+ */
+static bool map_file(struct buffer *buffer, const char *path)
+{
+    int fd;
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return false;
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+    if (((char *)data)[st.st_size - 1] != '\n') {
+        munmap(data, st.st_size);
+        return false;
+    }
+    buffer->data = data;
+    buffer->size = st.st_size;
+    buffer->mapped = true;
+    return true;
+}
+
+/**
+ * Reads the uncompressed size recorded in the trailer of a gzip file.
  *
- * The pointer returned from this function must be freed after use (and the
- * structures to which it points may also need to be freed).
+ * The size is recorded modulo 2^32, so it is only used as a hint.
  *
- * @param bounds a pointer to a bounds structure
- * @return an array of pointers to navaid structures, terminated with NULL
+ * @param path the path to the compressed navigation data file
+ * @return the uncompressed size, or 0 if it cannot be read
  */
-struct navaid **create_cache(struct bounds *bounds)
+static size_t gzip_size(const char *path)
 {
-    char *fg_root;
-    if ((fg_root = getenv("FG_ROOT")) == NULL) {
-        fprintf(stderr, "Missing environment variable FG_ROOT\n");
-        exit(EXIT_FAILURE);
+    FILE *f;
+    unsigned char trailer[4];
+    size_t size = 0;
+    if ((f = fopen(path, "rb")) == NULL)
+        return 0;
+    if (fseek(f, -4, SEEK_END) == 0 && fread(trailer, 1, 4, f) == 4)
+        size = (size_t)trailer[0] | (size_t)trailer[1] << 8 |
+            (size_t)trailer[2] << 16 | (size_t)trailer[3] << 24;
+    fclose(f);
+    return size;
+}
+
+#ifdef HAVE_LIBDEFLATE
+/**
+ * Inflates a compressed navigation data file with libdeflate.
+ *
+ * libdeflate decompresses a whole gzip member in one call, which is
+ * considerably faster than zlib, but needs to know the uncompressed size in
+ * advance. If the size in the trailer turns out to be wrong, e.g. for a file
+ * of several members, the caller falls back to zlib.
+ *
+ * @param buffer a pointer to the buffer
+ * @param path the path to the compressed navigation data file
+ * @return true if the file was inflated
+ */
+static bool inflate_libdeflate(struct buffer *buffer, const char *path)
+{
+    FILE *f;
+    if ((f = fopen(path, "rb")) == NULL)
+        return false;
+
+    struct stat st;
+    char *in = NULL;
+    bool ok = fstat(fileno(f), &st) == 0 && st.st_size > 0 &&
+        (in = malloc(st.st_size)) != NULL &&
+        fread(in, 1, st.st_size, f) == (size_t)st.st_size;
+    fclose(f);
+
+    size_t size = gzip_size(path);
+    if (ok && size > 0) {
+        struct libdeflate_decompressor *d;
+        if ((d = libdeflate_alloc_decompressor()) == NULL) {
+            perror("libdeflate_alloc_decompressor");
+            exit(EXIT_FAILURE);
+        }
+        allocate_buffer(buffer, size);
+        ok = libdeflate_gzip_decompress(d, in, st.st_size, buffer->data, size,
+            &buffer->size) == LIBDEFLATE_SUCCESS;
+        libdeflate_free_decompressor(d);
     }
+    free(in);
+    return ok && size > 0;
+}
+#endif
 
-    char *path = NULL, *ndgz = "Navaids/nav.dat.gz";
-    size_t size = strlen(fg_root) + strlen("/") + strlen(ndgz) + 1;
-    if ((path = malloc(size)) == NULL) {
+/**
+ * Extends the summary of a segment to include a coordinate.
+ *
+ * A coordinate that is not a number is never rejected by a region, so it
+ * extends the summary to cover everywhere.
+ *
+ * @param summary the summary of the segment
+ * @param type the record type
+ * @param lat the latitude
+ * @param lon the longitude
+ */
+static void extend(struct summary *summary, long type, double lat, double lon)
+{
+    if (summary->types == 0) {
+        summary->min_lat = summary->min_lon = INFINITY;
+        summary->max_lat = summary->max_lon = -INFINITY;
+    }
+    summary->types |= 1ULL << type;
+    if (isnan(lat) || isnan(lon)) {
+        summary->min_lat = summary->min_lon = -INFINITY;
+        summary->max_lat = summary->max_lon = INFINITY;
+    } else {
+        summary->min_lat = fmin(summary->min_lat, lat);
+        summary->max_lat = fmax(summary->max_lat, lat);
+        summary->min_lon = fmin(summary->min_lon, lon);
+        summary->max_lon = fmax(summary->max_lon, lon);
+    }
+}
+
+/**
+ * Summarizes the record types and coordinates in each segment of a newly
+ * built gzip index.
+ *
+ * Records are attributed to the segment in which their line starts. The
+ * fields are read in the same way as the parser reads them.
+ *
+ * @param index the gzip index
+ * @param data the uncompressed navigation data, terminated
+ * @param size the size of the data in bytes
+ */
+static void summarize(struct gzindex *index, const char *data, size_t size)
+{
+    int segment = 0, count = gzindex_segments(index);
+    const char *line = data, *end = data + size;
+    while (line < end) {
+        while (segment + 1 < count &&
+            (size_t)(line - data) >= gzindex_offset(index, segment + 1))
+            ++segment;
+        char *s;
+        long type = strtol(line, &s, 10);
+        if (s > line && type >= 0 && type < 64) {
+            double lat = strtod(s, &s);
+            double lon = strtod(s, &s);
+            extend(gzindex_summary(index, segment), type, lat, lon);
+        }
+        if ((line = memchr(line, '\n', end - line)) == NULL)
+            break;
+        ++line;
+    }
+}
+
+/**
+ * Data shared by the tasks that inflate segments of the navigation data.
+ */
+struct segments {
+    const struct gzindex *index;    ///< Index of the compressed file
+    const unsigned char *in;        ///< Contents of the compressed file
+    size_t size;                    ///< Size of the compressed file
+    char *out;                      ///< Buffer for the uncompressed data
+    const int *segments;            ///< Segments to inflate
+    bool *failed;                   ///< Failure of each task
+};
+
+/**
+ * Inflates one segment of the navigation data, as a thread pool task.
+ *
+ * @param task the index of the task
+ * @param worker the index of the worker (unused)
+ * @param data a pointer to the segments structure
+ */
+static void inflate_task(int task, int worker, void *data)
+{
+    (void)worker;
+    struct segments *s = data;
+    s->failed[task] = !inflate_segment(s->index, s->in, s->size,
+        s->segments[task], s->out);
+}
+
+/**
+ * Inflates the segments of the navigation data that might hold selected
+ * navaids, using a gzip index.
+ *
+ * The first segment, which holds the header, is always inflated. The
+ * segment after each selected segment is inflated too, to complete the
+ * last line of the selected segment. Segments are inflated concurrently,
+ * unless there is no thread pool.
+ *
+ * @param buffer a pointer to the buffer
+ * @param arena the arena that owns the buffer
+ * @param index the gzip index
+ * @param in the contents of the compressed file
+ * @param size the size of the compressed file
+ * @param region a pointer to the region (may be NULL)
+ * @param all true to inflate every segment
+ * @param pool the thread pool (may be NULL)
+ * @return true if the segments were inflated
+ */
+static bool inflate_segments(struct buffer *buffer, struct arena *arena,
+    struct gzindex *index, const unsigned char *in, size_t size,
+    const struct region *region, bool all, struct pool *pool)
+{
+    int count = gzindex_segments(index);
+    bool *loaded = calloc(count, sizeof(bool));
+    int *segments = malloc(count * sizeof(int));
+    bool *failed = calloc(count, sizeof(bool));
+    if (loaded == NULL || segments == NULL || failed == NULL) {
         perror("malloc");
         exit(EXIT_FAILURE);
     }
-    snprintf(path, size, "%s/%s", fg_root, ndgz);
 
-    if (atexit(exit_handler) != 0) {
-        perror("atexit");
-        exit(EXIT_FAILURE);
+    int n = 0, runs = 0;
+    for (int i = 0; i < count; ++i) {
+        bool wanted = all || i == 0 ||
+            segment_selected(gzindex_summary(index, i), region);
+        if (wanted && i + 1 < count)
+            loaded[i + 1] = true;
+        if (wanted || loaded[i]) {
+            loaded[i] = true;
+            segments[n++] = i;
+            if (i == 0 || !loaded[i - 1])
+                ++runs;
+        }
     }
 
-    if ((gz = gzopen(path, "rb")) == NULL) {
-        fprintf(stderr, "Failed to open %s\n", path);
-        exit(EXIT_FAILURE);
+    bool ok = true;
+#ifdef HAVE_LIBDEFLATE
+    // libdeflate inflates a whole file faster than zlib on one thread
+    ok = n < count || (pool != NULL && pool_size(pool) > 1);
+#endif
+    if (ok) {
+        allocate_buffer(buffer, gzindex_offset(index, count));
+        buffer->size = gzindex_offset(index, count);
+        struct segments s = { index, in, size, buffer->data, segments, failed };
+        if (pool != NULL)
+            run_pool(pool, n, inflate_task, &s);
+        else
+            for (int i = 0; i < n; ++i)
+                inflate_task(i, 0, &s);
+        for (int i = 0; i < n; ++i)
+            ok = ok && !failed[i];
+    }
+
+    if (ok) {
+        buffer->ranges = arena_alloc(arena, runs * sizeof(struct range));
+        buffer->count = 0;
+        for (int i = 0; i < count; ++i) {
+            if (!loaded[i])
+                continue;
+            if (i == 0 || !loaded[i - 1])
+                buffer->ranges[buffer->count++].begin =
+                    gzindex_offset(index, i);
+            buffer->ranges[buffer->count - 1].end =
+                gzindex_offset(index, i + 1);
+        }
     }
+    free(failed);
+    free(segments);
+    free(loaded);
+    return ok;
+}
+
+/**
+ * Inflates a compressed navigation data file through its gzip index.
+ *
+ * The index records checkpoints in the compressed file, and the record
+ * types and coordinates found between them, so that only the segments that
+ * might hold selected navaids need be inflated, on several threads at once.
+ * The index is kept in the user cache directory. If there is no index for
+ * the current version of the file, the whole file is inflated and the
+ * index is built as it goes.
+ *
+ * @param buffer a pointer to the buffer
+ * @param arena the arena that owns the buffer
+ * @param path the path to the compressed navigation data file
+ * @param region a pointer to the region (may be NULL)
+ * @param all true to inflate the whole file
+ * @param pool the thread pool (may be NULL)
+ * @return true if the file was inflated, false to fall back to inflate_file
+ */
+static bool inflate_indexed(struct buffer *buffer, struct arena *arena,
+    const char *path, const struct region *region, bool all,
+    struct pool *pool)
+{
+    char name[GZINDEX_NAME_SIZE];
+    snprintf(name, sizeof name, "navdat-%016llx.gzi",
+        (unsigned long long)fnv1a(path, strlen(path), FNV_OFFSET));
+    char *index_path = cache_path(name);
+    if (index_path == NULL)
+        return false;
 
-    struct dynamic_cache dcache;
-    init(&dcache);
+    FILE *f;
+    struct stat source;
+    unsigned char *in = NULL;
+    bool ok = (f = fopen(path, "rb")) != NULL;
+    if (ok) {
+        ok = fstat(fileno(f), &source) == 0 && source.st_size > 0 &&
+            (in = malloc(source.st_size)) != NULL &&
+            fread(in, 1, source.st_size, f) == (size_t)source.st_size;
+        fclose(f);
+    }
 
-    bool have_spec = false;
-    char buf[BUFSIZ];
-    struct navaid *navaid;
-    int i = 0;
-    while (gzgets(gz, buf, BUFSIZ) != NULL) {
-        if (preprocess(buf) == 0)
-            continue;
-        if (!have_spec) {
-            check_version(buf);
-            have_spec = true;
-        } else if ((navaid = parse(buf, bounds)) != NULL) {
-            if (i > dcache.max)
-                create_chunk(&dcache);
-            dcache.cache[i++] = navaid;
+    struct gzindex *index = NULL;
+    if (ok && (index = load_gzindex(index_path, &source, in)) != NULL) {
+        ok = inflate_segments(buffer, arena, index, in, source.st_size,
+            region, all, pool);
+    } else if (ok) {
+        index = build_gzindex(in, source.st_size, SEGMENT_SPAN,
+            &buffer->data, &buffer->size);
+        if ((ok = index != NULL)) {
+            buffer->data[buffer->size] = '\0';
+            summarize(index, buffer->data, buffer->size);
+            save_gzindex(index, index_path, &source);
         }
     }
+    destroy_gzindex(index);
+    free(in);
+    free(index_path);
+    return ok;
+}
 
-    if (i == 0) {
-        fputs("Did not find any navigation data in data file\n", stderr);
+/**
+ * Inflates a compressed navigation data file into memory.
+ *
+ * The whole file is inflated into a single buffer, sized from the gzip
+ * trailer, rather than line by line.
+ *
+ * @param buffer a pointer to the buffer
+ * @param path the path to the compressed navigation data file
+ */
+static void inflate_file(struct buffer *buffer, const char *path)
+{
+#ifdef HAVE_LIBDEFLATE
+    if (inflate_libdeflate(buffer, path))
+        return;
+#endif
+    gzFile gz;
+    if ((gz = gzopen(path, "rb")) == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
         exit(EXIT_FAILURE);
     }
+    gzbuffer(gz, GZBUFSIZE);
+
+    size_t capacity = gzip_size(path);
+    if (capacity < GZBUFSIZE)
+        capacity = GZBUFSIZE;
+    allocate_buffer(buffer, capacity);
+    buffer->size = 0;
+
+    int n;
+    for (;;) {
+        if (buffer->size == capacity)
+            allocate_buffer(buffer, capacity *= 2);
+        size_t want = capacity - buffer->size;
+        if (want > INT_MAX)
+            want = INT_MAX;
+        if ((n = gzread(gz, buffer->data + buffer->size, want)) <= 0)
+            break;
+        buffer->size += n;
+    }
 
     int error;
     const char *gzmsg = gzerror(gz, &error);
     switch(error) {
     case Z_OK:
-        if (i > dcache.max)
-            create_chunk(&dcache);
-        dcache.cache[i] = NULL;
         break;
     case Z_ERRNO:
         fprintf(stderr, "Problems reading %s: %s\n", path, strerror(errno));
+        gzclose_r(gz);
         exit(EXIT_FAILURE);
         break;
     default:
         fprintf(stderr, "Problems reading %s: %s\n", path, gzmsg);
+        gzclose_r(gz);
         exit(EXIT_FAILURE);
         break;
     }
+    gzclose_r(gz);
+}
+
+/**
+ * Releases a navigation data buffer, as an arena cleanup action.
+ *
+ * @param data a pointer to the buffer
+ */
+static void release_buffer(void *data)
+{
+    struct buffer *buffer = data;
+    if (buffer->mapped)
+        munmap(buffer->data, buffer->size);
+    else
+        free(buffer->data);
+}
+
+/**
+ * Releases a snapshot, as an arena cleanup action.
+ *
+ * @param data a pointer to the snapshot
+ */
+static void release_snapshot(void *data)
+{
+    detach_snapshot(data);
+}
+
+/**
+ * Releases an arena, as a cleanup action of another arena.
+ *
+ * @param data a pointer to the arena
+ */
+static void release_arena(void *data)
+{
+    destroy_arena(data);
+}
+
+/**
+ * Loads the navigation data file into memory.
+ *
+ * An uncompressed file (Navaids/nav.dat) is memory mapped if present,
+ * otherwise the compressed file (Navaids/nav.dat.gz) is inflated into one
+ * buffer, through its gzip index if possible (see inflate_indexed). The
+ * buffer is released when the arena is destroyed.
+ *
+ * @param fg_root the FG_ROOT directory
+ * @param arena the arena that owns the buffer
+ * @param region a pointer to the region (may be NULL)
+ * @param all true to load the whole file
+ * @param pool the thread pool (may be NULL)
+ * @return a pointer to the buffer
+ */
+static struct buffer *load(const char *fg_root, struct arena *arena,
+    const struct region *region, bool all, struct pool *pool)
+{
+    struct buffer *buffer = arena_alloc(arena, sizeof(struct buffer));
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->mapped = false;
+    buffer->ranges = NULL;
+    buffer->count = 0;
+
+    char *path = data_path(fg_root, "Navaids/nav.dat");
+    if (!map_file(buffer, path)) {
+        free(path);
+        path = data_path(fg_root, "Navaids/nav.dat.gz");
+        if (!inflate_indexed(buffer, arena, path, region, all, pool))
+            inflate_file(buffer, path);
+        buffer->data[buffer->size] = '\0';
+    }
+    free(path);
+    arena_cleanup(arena, release_buffer, buffer);
+
+    if (buffer->ranges == NULL) {
+        buffer->ranges = arena_alloc(arena, sizeof(struct range));
+        buffer->ranges[0].begin = 0;
+        buffer->ranges[0].end = buffer->size;
+        buffer->count = 1;
+    }
+    return buffer;
+}
+
+/**
+ * Counts the lines in the loaded ranges of a navigation data buffer.
+ *
+ * This is an upper bound on the number of navaids the buffer holds.
+ *
+ * @param buffer a pointer to the buffer
+ * @return the number of lines
+ */
+static int count_lines(const struct buffer *buffer)
+{
+    int n = 1;
+    for (int i = 0; i < buffer->count; ++i) {
+        const char *p = buffer->data + buffer->ranges[i].begin;
+        const char *end = buffer->data + buffer->ranges[i].end;
+        while ((p = memchr(p, '\n', end - p)) != NULL) {
+            ++p;
+            ++n;
+        }
+    }
+    return n;
+}
+
+/**
+ * Parses a navigation data buffer into a cache builder.
+ *
+ * Lines are found with memchr and trimmed in place,
+ * before being passed to a parser. The string fields of navaids are slices
+ * of the buffer. Only whole lines in the loaded ranges are parsed.
+ *
+ * @param b a pointer to a cache builder structure, not yet initialized
+ * @param arena the arena that owns the cache
+ * @param buffer a pointer to the buffer
+ * @param region a pointer to the region (may be NULL)
+ * @param all true to add every navaid, ignoring restrictions and region
+ */
+static void parse_buffer(struct builder *b, struct arena *arena,
+    struct buffer *buffer, const struct region *region, bool all)
+{
+    init(b, arena, count_lines(buffer));
+
+    bool have_spec = false;
+    struct navaid navaid;
+    for (int i = 0; i < buffer->count; ++i) {
+        const struct range *range = &buffer->ranges[i];
+        char *line = buffer->data + range->begin;
+        char *end = buffer->data + range->end;
+        if (range->begin > 0) {
+            if ((line = memchr(line, '\n', end - line)) == NULL)
+                continue;
+            ++line;
+        }
+        while (line < end) {
+            char *eol = memchr(line, '\n', end - line);
+            if (eol == NULL) {
+                if (range->end < buffer->size)
+                    break;
+                eol = end;
+            }
+            *eol = '\0';
+            if (preprocess(line, eol) > 0) {
+                if (!have_spec) {
+                    check_version(line);
+                    have_spec = true;
+                } else if (parse(line, &navaid) &&
+                    (all || selected(&navaid, region))) {
+                    add(b, &navaid);
+                }
+            }
+            line = eol + 1;
+        }
+    }
+    terminate(b);
+}
+
+/**
+ * Marks the navaids in a snapshot that might be selected.
+ *
+ * The navaids in the type partitions selected by the search restrictions
+ * are marked and, with a region, the marks are narrowed to the blocks of
+ * the spatial index that overlap the region. Marked navaids must still be
+ * checked with selected.
+ *
+ * @param snapshot a pointer to the snapshot
+ * @param region a pointer to the region (may be NULL)
+ * @return a bitmap of the marked navaids, to be freed by the caller
+ */
+static uint64_t *select_records(const struct snapshot *snapshot,
+    const struct region *region)
+{
+    size_t words = (snapshot_count(snapshot) + 63) / 64 + 1;
+    uint64_t *marks, *inside;
+    if ((marks = calloc(words, sizeof(uint64_t))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    snapshot_partitions(snapshot, selected_types(), marks);
+    if (region != NULL) {
+        if ((inside = calloc(words, sizeof(uint64_t))) == NULL) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
+        snapshot_region(snapshot, region, inside);
+        for (size_t w = 0; w < words; ++w)
+            marks[w] &= inside[w];
+        free(inside);
+    }
+    return marks;
+}
+
+/**
+ * Builds a cache from the shared snapshot of the navigation data file.
+ *
+ * If no snapshot has been published for the current version of the file,
+ * the file is loaded into a temporary arena and published first. If
+ * publishing fails, the cache is built from the private load instead and
+ * the temporary arena is kept until the cache is destroyed.
+ *
+ * The snapshot holds navaids of every type, so one snapshot serves every
+ * combination of search restrictions. Only the navaids in the partitions
+ * of the selected types and, with a region, in the blocks of the spatial
+ * index that overlap the region are read (see select_records).
+ *
+ * The snapshot can be mapped at any address, so its records hold offsets
+ * rather than pointers. The cache refers to a view of each selected record
+ * (see snapshot_navaid), filled in one array, whose strings stay in the
+ * snapshot. Each process therefore shares one copy of the strings, the
+ * spatial index and the partitions, and holds only the fixed fields of the
+ * navaids it selects, wherever the snapshot is mapped.
+ *
+ * @param b a pointer to a cache builder structure, not yet initialized
+ * @param fg_root the FG_ROOT directory
+ * @param region a pointer to the region (may be NULL)
+ * @param pool the thread pool
+ */
+static void share(struct builder *b, const char *fg_root,
+    const struct region *region, struct pool *pool)
+{
+    char *path = data_path(fg_root, "Navaids/nav.dat");
+    if (access(path, R_OK) != 0) {
+        free(path);
+        path = data_path(fg_root, "Navaids/nav.dat.gz");
+    }
+
+    struct snapshot *snapshot;
+    if ((snapshot = attach_snapshot(path)) == NULL) {
+        struct arena *private = create_arena(ARENA_PAGE);
+        struct builder all;
+        parse_buffer(&all, private, load(fg_root, private, NULL, true, pool),
+            NULL, true);
+        if (publish_snapshot(path, all.cache))
+            snapshot = attach_snapshot(path);
+        if (snapshot == NULL) {
+            init(b, arena, all.count);
+            for (int i = 0; i < all.count; ++i)
+                if (selected(all.cache[i], region))
+                    add(b, all.cache[i]);
+            terminate(b);
+            arena_cleanup(arena, release_arena, private);
+        } else {
+            destroy_arena(private);
+        }
+    }
+
+    if (snapshot != NULL) {
+        arena_cleanup(arena, release_snapshot, snapshot);
+        size_t n = snapshot_count(snapshot), v = 0;
+        uint64_t *marks = select_records(snapshot, region);
+        struct navaid *views = arena_alloc(arena, n * sizeof(struct navaid));
+        init(b, arena, (int)n);
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t word = marks[i / 64];
+            if (word == 0) {
+                i |= 63;
+                continue;
+            }
+            if (((word >> (i % 64)) & 1) == 0)
+                continue;
+            snapshot_navaid(snapshot, i, &views[v]);
+            if (selected(&views[v], region))
+                refer(b, &views[v++]);
+        }
+        terminate(b);
+        free(marks);
+    }
+    free(path);
+}
+
+/**
+ * Navigation data source.
+ *
+ * A source is a directory laid out like FG_ROOT, holding Navaids/nav.dat or
+ * Navaids/nav.dat.gz. Each source is loaded into its own arena, so that
+ * sources can be loaded concurrently.
+ */
+struct source {
+    const char *root;           ///< Directory holding the navigation data
+    struct arena *arena;        ///< Arena that owns the navaids loaded
+    struct builder builder;     ///< Navaids loaded from the source
+};
+
+/**
+ * Data shared by the tasks that load navigation data sources.
+ */
+struct ingest {
+    struct source *sources;         ///< Sources in priority order
+    const struct region *region;    ///< Region (may be NULL)
+};
 
+/**
+ * Checks if a directory holds navigation data.
+ *
+ * @param root the directory
+ * @return true if the directory holds Navaids/nav.dat or Navaids/nav.dat.gz
+ */
+static bool has_navdata(const char *root)
+{
+    char *path = data_path(root, "Navaids/nav.dat");
+    bool found = access(path, R_OK) == 0;
     free(path);
-    return dcache.cache;
+    if (!found) {
+        path = data_path(root, "Navaids/nav.dat.gz");
+        found = access(path, R_OK) == 0;
+        free(path);
+    }
+    return found;
 }
 
 /**
- * Destroys a single navaid structure.
+ * Finds the navigation data sources, in priority order.
+ *
+ * Overlays are the directories in the colon-separated FG_SCENERY path
+ * that hold navigation data, in the order given, followed by FG_ROOT,
+ * which always has the lowest priority. The sources are allocated from
+ * the cache arena.
  *
- * @param navaid a pointer to a navaid structure
+ * @param fg_root the FG_ROOT directory
+ * @param sources receives the sources
+ * @return the number of sources
  */
-static void destroy_navaid(struct navaid *navaid)
+static int find_sources(const char *fg_root, struct source **sources)
 {
-    if (navaid != NULL) {
-        free(navaid->code);
-        free(navaid->icao);
-        free(navaid->name);
-        free(navaid->runway);
+    const char *scenery = getenv("FG_SCENERY");
+    char *paths = arena_strdup(arena, scenery != NULL ? scenery : "");
+
+    int max = 2;
+    for (const char *p = paths; *p != '\0'; ++p)
+        if (*p == ':')
+            ++max;
+    *sources = arena_alloc(arena, max * sizeof(struct source));
+
+    int n = 0;
+    char *saveptr;
+    for (char *root = strtok_r(paths, ":", &saveptr); root != NULL;
+        root = strtok_r(NULL, ":", &saveptr)) {
+        if (strcmp(root, fg_root) != 0 && has_navdata(root))
+            (*sources)[n++].root = root;
     }
-    free(navaid);
+    (*sources)[n++].root = fg_root;
+    return n;
+}
+
+/**
+ * Loads one navigation data source, as a thread pool task.
+ *
+ * Segments of a compressed file are inflated on the loading thread, since
+ * the thread pool is busy loading the sources.
+ *
+ * @param task the index of the source
+ * @param worker the index of the worker (unused)
+ * @param data a pointer to the ingest structure
+ */
+static void load_task(int task, int worker, void *data)
+{
+    (void)worker;
+    struct ingest *ingest = data;
+    struct source *source = &ingest->sources[task];
+    if (source->arena != NULL)
+        return;
+    source->arena = create_arena(ARENA_PAGE);
+    parse_buffer(&source->builder, source->arena,
+        load(source->root, source->arena, ingest->region, false, NULL),
+        ingest->region, false);
+}
+
+/**
+ * Hashes the fields that identify a navaid across sources.
+ *
+ * Navaids are the same if they have the same type, code and frequency, to
+ * the hundredth of a MHz (or kHz for NDBs), and the same position to about
+ * ten metres.
+ *
+ * @param navaid a pointer to the navaid
+ * @return the hash
+ */
+static uint64_t identity_hash(const struct navaid *navaid)
+{
+    int64_t fields[] = {
+        navaid->type,
+        llround(navaid->frequency * 100),
+        llround(navaid->coordinate.lat * 1e4),
+        llround(navaid->coordinate.lon * 1e4)
+    };
+    uint64_t hash = fnv1a(fields, sizeof fields, FNV_OFFSET);
+    return fnv1a(navaid->code, strlen(navaid->code), hash);
+}
+
+/**
+ * Checks if two navaids from different sources are the same navaid.
+ *
+ * @param a a pointer to a navaid
+ * @param b a pointer to another navaid
+ * @return true if the navaids are the same
+ */
+static bool same_navaid(const struct navaid *a, const struct navaid *b)
+{
+    return a->type == b->type &&
+        llround(a->frequency * 100) == llround(b->frequency * 100) &&
+        llround(a->coordinate.lat * 1e4) == llround(b->coordinate.lat * 1e4) &&
+        llround(a->coordinate.lon * 1e4) == llround(b->coordinate.lon * 1e4) &&
+        strcmp(a->code, b->code) == 0;
+}
+
+/**
+ * Slot in the hash table used to merge sources.
+ */
+struct slot {
+    const struct navaid *navaid;    ///< Navaid in the slot (NULL if empty)
+    uint32_t hash;                  ///< High bits of the navaid's hash
+    int source;                     ///< Source of the navaid
+};
+
+/**
+ * Merges the navaids loaded from several sources into a cache builder.
+ *
+ * A navaid overrides the same navaid (see same_navaid) in any source of
+ * lower priority. Duplicates within one source are all kept, as they are
+ * when there is only one source. Navaids are looked up in an open
+ * addressing hash table of the navaids merged from sources of higher
+ * priority. The source of lowest priority, usually FG_ROOT and by far the
+ * largest, is only looked up and never added to the table, so the table
+ * stays small and merging takes time proportional to the total number of
+ * navaids.
+ *
+ * The merged cache refers to the navaids in the sources' arenas rather
+ * than copying them.
+ *
+ * @param b a pointer to a cache builder structure, not yet initialized
+ * @param sources the sources, in priority order
+ * @param n the number of sources
+ */
+static void merge(struct builder *b, const struct source *sources, int n)
+{
+    int total = 0;
+    for (int i = 0; i < n; ++i)
+        total += sources[i].builder.count;
+
+    size_t capacity = 16;
+    while (capacity < 2 * (size_t)(total - sources[n - 1].builder.count))
+        capacity *= 2;
+    struct slot *table;
+    if ((table = calloc(capacity, sizeof(struct slot))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    init(b, arena, total);
+    for (int i = 0; i < n; ++i) {
+        struct navaid **navaids = sources[i].builder.cache;
+        for (int j = 0; j < sources[i].builder.count; ++j) {
+            uint64_t hash = identity_hash(navaids[j]);
+            size_t k = hash & (capacity - 1);
+            bool overridden = false;
+            for (; table[k].navaid != NULL && !overridden;
+                k = (k + 1) & (capacity - 1)) {
+                overridden = table[k].source < i &&
+                    table[k].hash == (uint32_t)(hash >> 32) &&
+                    same_navaid(table[k].navaid, navaids[j]);
+            }
+            if (overridden)
+                continue;
+            if (i < n - 1) {
+                table[k].navaid = navaids[j];
+                table[k].hash = (uint32_t)(hash >> 32);
+                table[k].source = i;
+            }
+            b->cache[b->count++] = navaids[j];
+        }
+    }
+    terminate(b);
+    free(table);
+}
+
+/**
+ * Creates a navaid cache.
+ *
+ * The navigation data file is loaded into memory and parsed in place (see
+ * load and parse_buffer). A compressed file is loaded through its gzip
+ * index, skipping parts that cannot hold selected navaids. With the shared
+ * flag, the cache is instead built from a snapshot of the data in shared
+ * memory, published by the first process to load the current version of
+ * the file, so that concurrent and later processes need not load it at all.
+ *
+ * Navigation data is read from FG_ROOT and from any overlays in the
+ * FG_SCENERY path (see find_sources). Overlays are loaded concurrently
+ * with FG_ROOT, privately even with the shared flag, and merged over it.
+ *
+ * The navaids, the array of pointers to them and the data they refer to
+ * are all owned by one arena, so the cache is released in one step.
+ *
+ * This function never returns NULL. Any errors in reading the input file or
+ * allocating memory for the cache result in a message printed to standard
+ * error and the program terminating with an error status.
+ *
+ * The cache must be destroyed after use with destroy_cache.
+ *
+ * @param region a pointer to the region (may be NULL)
+ * @param pool the thread pool for loading the navigation data
+ * @return an array of pointers to navaid structures, terminated with NULL
+ */
+struct navaid **create_cache(const struct region *region, struct pool *pool)
+{
+    char *fg_root;
+    if ((fg_root = getenv("FG_ROOT")) == NULL) {
+        fprintf(stderr, "Missing environment variable FG_ROOT\n");
+        exit(EXIT_FAILURE);
+    }
+
+    assert(arena == NULL);
+    arena = create_arena(ARENA_PAGE);
+
+    struct source *sources;
+    int n = find_sources(fg_root, &sources);
+
+    struct builder b;
+    extern struct flags flags;
+    if (n == 1 && flags.shared) {
+        share(&b, fg_root, region, pool);
+    } else if (n == 1) {
+        parse_buffer(&b, arena, load(fg_root, arena, region, false, pool),
+            region, false);
+    } else {
+        for (int i = 0; i < n; ++i)
+            sources[i].arena = NULL;
+        if (flags.shared) {
+            sources[n - 1].arena = arena;
+            share(&sources[n - 1].builder, fg_root, region, pool);
+        }
+        struct ingest ingest = { sources, region };
+        run_pool(pool, n, load_task, &ingest);
+        for (int i = 0; i < n; ++i)
+            if (sources[i].arena != arena)
+                arena_cleanup(arena, release_arena, sources[i].arena);
+        merge(&b, sources, n);
+    }
+
+    if (b.count == 0) {
+        fputs("Did not find any navigation data in data file\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    return b.cache;
 }
 
 /**
  * Destroys a navaid cache.
  *
+ * The cache, its navaids and the data they refer to are released together
+ * by destroying the arena that owns them.
+ *
  * @param cache an array of pointers to navaid structures
  */
 void destroy_cache(struct navaid **cache)
 {
-    struct navaid **p = cache;
-    while (*p)
-        destroy_navaid(*p++);
-    free(cache);
+    if (cache == NULL)
+        return;
+    destroy_arena(arena);
+    arena = NULL;
 }
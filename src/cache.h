@@ -22,9 +22,11 @@
 #ifndef cache_h
 #define cache_h
 
-struct bounds;
+struct pool;
+struct region;
 
-struct navaid **create_cache(struct bounds *bounds);
+struct navaid **create_cache(const struct region *region,
+    struct pool *pool);
 void destroy_cache(struct navaid **cache);
 
 #endif
@@ -0,0 +1,321 @@
+/**
+ * @file conflict.c
+ *
+ * Detection of navaids with conflicting frequencies and coverage.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "conflict.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "geo.h"
+#include "parse.h"
+#include "search.h"
+#include "types.h"
+
+/**
+ * Distance in nm within which navaids with the same code are treated as
+ * parts of the same station.
+ */
+#define COLOCATED_NM 1.0
+
+/**
+ * Nautical miles per degree of latitude, rounded down so that latitude
+ * differences never overestimate distances.
+ */
+#define NM_PER_DEGREE 60.0
+
+/**
+ * Radio services. Navaids only conflict with navaids in the same service.
+ */
+enum Service {
+    SERVICE_NDB,    ///< NDB, channels of 1 kHz
+    SERVICE_VHF,    ///< VOR, ILS and LOC, channels of 50 kHz
+    SERVICE_DME     ///< DME, channels of 50 kHz paired with VHF
+};
+
+/**
+ * Navaid entry for the spatial join.
+ */
+struct station {
+    long key;               ///< Service and channel
+    double lat;             ///< Latitude, the sweep coordinate
+    int range;              ///< Reception range in nm
+    int position;           ///< Position of the navaid in the cache
+    const struct navaid *navaid;    ///< The navaid
+};
+
+/**
+ * Conflicting pair of navaids.
+ */
+struct conflict {
+    int first;          ///< Position of the first navaid in the cache
+    int second;         ///< Position of the second navaid in the cache
+    double distance;    ///< Distance between the navaids in nm
+    bool adjacent;      ///< True if the channels are adjacent, not the same
+};
+
+/**
+ * Growable array of conflicts.
+ */
+struct conflicts {
+    struct conflict *items; ///< Conflicts
+    size_t count;           ///< Number of conflicts
+    size_t capacity;        ///< Capacity of the array
+};
+
+/**
+ * Calculates the service and channel key of a navaid.
+ *
+ * @param navaid a pointer to a navaid structure
+ * @return the key, or -1 if the navaid has no channel
+ */
+static long channel_key(const struct navaid *navaid)
+{
+    switch (navaid->type) {
+    case NDB:
+        return SERVICE_NDB * 1000000L + lround(navaid->frequency);
+    case VOR:
+    case ILS:
+    case LOC:
+        return SERVICE_VHF * 1000000L + lround(navaid->frequency * 20);
+    case DME:
+    case SDM:
+        return SERVICE_DME * 1000000L + lround(navaid->frequency * 20);
+    default:
+        return -1;
+    }
+}
+
+/**
+ * Compares stations by key, then latitude, then data file order.
+ *
+ * @param a pointer to the first station
+ * @param b pointer to the second station
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_stations(const void *a, const void *b)
+{
+    const struct station *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    if (x->lat != y->lat)
+        return x->lat < y->lat ? -1 : 1;
+    return x->position - y->position;
+}
+
+/**
+ * Compares conflicts by data file order of the first, then second navaid.
+ *
+ * @param a pointer to the first conflict
+ * @param b pointer to the second conflict
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_conflicts(const void *a, const void *b)
+{
+    const struct conflict *x = a, *y = b;
+    if (x->first != y->first)
+        return x->first - y->first;
+    return x->second - y->second;
+}
+
+/**
+ * Checks if two navaids are parts of the same station or airport.
+ *
+ * The DME of a VOR-DME shares its code and position, and localizers at
+ * opposite ends of a runway often share a frequency but are never in use
+ * at the same time, so neither is a conflict.
+ *
+ * @param a pointer to the first navaid
+ * @param b pointer to the second navaid
+ * @param d the distance between them in nm
+ * @return true if the navaids belong together
+ */
+static bool related(const struct navaid *a, const struct navaid *b, double d)
+{
+    if (a->icao != NULL && b->icao != NULL && strcmp(a->icao, b->icao) == 0)
+        return true;
+    return d < COLOCATED_NM && strcmp(a->code, b->code) == 0;
+}
+
+/**
+ * Records a conflict.
+ *
+ * @param list the conflicts
+ * @param a the first station
+ * @param b the second station
+ * @param d the distance between them in nm
+ */
+static void record(struct conflicts *list, const struct station *a,
+    const struct station *b, double d)
+{
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        struct conflict *items;
+        if ((items = realloc(list->items,
+            list->capacity * sizeof(struct conflict))) == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        list->items = items;
+    }
+    struct conflict c = {
+        a->position < b->position ? a->position : b->position,
+        a->position < b->position ? b->position : a->position,
+        d,
+        a->key != b->key
+    };
+    list->items[list->count++] = c;
+}
+
+/**
+ * Finds overlapping pairs in a channel and its upper neighbour.
+ *
+ * The stations of both channels are merged by latitude and swept in order.
+ * Two navaids more than their combined range apart in latitude alone cannot
+ * overlap, so for each navaid the sweep stops at the first one beyond the
+ * navaid's range plus the largest range in the set. Pairs entirely in the
+ * upper channel are left for when that channel is swept.
+ *
+ * @param channel the stations in the channel, sorted by latitude
+ * @param n the number of stations in the channel
+ * @param adjacent the stations in the next channel up (may be empty)
+ * @param m the number of stations in the next channel
+ * @param merged working space for n + m stations
+ * @param list receives the conflicts
+ */
+static void sweep(const struct station *channel, size_t n,
+    const struct station *adjacent, size_t m, struct station *merged,
+    struct conflicts *list)
+{
+    size_t i = 0, j = 0, k = 0;
+    int max = 0;
+    while (i < n || j < m) {
+        if (j == m || (i < n && channel[i].lat <= adjacent[j].lat))
+            merged[k] = channel[i++];
+        else
+            merged[k] = adjacent[j++];
+        if (merged[k].range > max)
+            max = merged[k].range;
+        ++k;
+    }
+
+    long key = channel[0].key;
+    for (i = 0; i < k; ++i) {
+        const struct station *a = &merged[i];
+        double window = (a->range + max) / NM_PER_DEGREE;
+        for (j = i + 1; j < k && merged[j].lat - a->lat <= window; ++j) {
+            const struct station *b = &merged[j];
+            if (a->key != key && b->key != key)
+                continue;
+            double d = distance(&a->navaid->coordinate, &b->navaid->coordinate);
+            if (d < a->range + b->range && !related(a->navaid, b->navaid, d))
+                record(list, a, b, d);
+        }
+    }
+}
+
+/**
+ * Prints a conflict to standard output.
+ *
+ * @param cache the navaid cache
+ * @param c a pointer to the conflict
+ */
+static void print_conflict(struct navaid **cache, const struct conflict *c)
+{
+    const struct navaid *a = cache[c->first], *b = cache[c->second];
+    printf("%s frequency, %.0fnm apart, ranges %dnm and %dnm:\n",
+        c->adjacent ? "Adjacent" : "Same", c->distance, a->range, b->range);
+    print_navaid(a);
+    print_navaid(b);
+}
+
+/**
+ * Reports pairs of navaids whose frequencies and coverage conflict.
+ *
+ * Two navaids conflict if they are in the same radio service, are on the
+ * same or adjacent channels, and their reception range circles overlap,
+ * so that a receiver could capture the wrong station. Parts of the same
+ * station and navaids at the same airport are not reported.
+ *
+ * Navaids are grouped by service and channel, and each channel is joined
+ * with itself and its upper neighbour by a sweep in latitude, so only
+ * navaids that are close together are ever compared. Conflicts are printed
+ * in data file order of the first navaid, then the second.
+ *
+ * @param cache the navaid cache
+ * @param selection a filter selection (may be NULL)
+ * @return the number of conflicts
+ */
+int conflicts(struct navaid **cache, const uint64_t *selection)
+{
+    assert(cache != NULL);
+
+    size_t count = 0;
+    while (cache[count] != NULL)
+        ++count;
+
+    struct station *stations, *merged;
+    if ((stations = malloc((count + 1) * sizeof(struct station))) == NULL ||
+        (merged = malloc((count + 1) * sizeof(struct station))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        struct navaid *navaid = cache[i];
+        long key = channel_key(navaid);
+        if (key < 0 || !is_selected(selection, (int)i))
+            continue;
+        parse_details(navaid);
+        if (navaid->range <= 0)
+            continue;
+        struct station s = {
+            key, navaid->coordinate.lat, navaid->range, (int)i, navaid
+        };
+        stations[n++] = s;
+    }
+    qsort(stations, n, sizeof(struct station), compare_stations);
+
+    struct conflicts list = { NULL, 0, 0 };
+    for (size_t lo = 0, hi; lo < n; lo = hi) {
+        for (hi = lo + 1; hi < n && stations[hi].key == stations[lo].key;)
+            ++hi;
+        size_t end = hi;
+        if (end < n && stations[end].key == stations[lo].key + 1)
+            while (end < n && stations[end].key == stations[hi].key)
+                ++end;
+        sweep(&stations[lo], hi - lo, &stations[hi], end - hi, merged, &list);
+    }
+    qsort(list.items, list.count, sizeof(struct conflict), compare_conflicts);
+
+    for (size_t i = 0; i < list.count; ++i)
+        print_conflict(cache, &list.items[i]);
+
+    int conflicts = (int)list.count;
+    free(list.items);
+    free(merged);
+    free(stations);
+    return conflicts;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file conflict.h
+ *
+ * Detection of navaids with conflicting frequencies and coverage.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef conflict_h
+#define conflict_h
+
+#include <stdint.h>
+
+struct navaid;
+
+int conflicts(struct navaid **cache, const uint64_t *selection);
+
+#endif
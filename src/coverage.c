@@ -0,0 +1,431 @@
+/**
+ * @file coverage.c
+ *
+ * Coverage maps of receivable stations.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "coverage.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "geo.h"
+#include "parse.h"
+#include "pool.h"
+#include "region.h"
+#include "types.h"
+
+#ifndef M_PI
+/**
+ * Value of pi, if not defined by math.h.
+ */
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * Converts degrees to radians.
+ */
+#define RADIANS(d) ((d) * M_PI / 180.0)
+
+/**
+ * Converts radians to degrees.
+ */
+#define DEGREES(r) ((r) * 180.0 / M_PI)
+
+/**
+ * Number of cells along each side of a tile.
+ */
+#define TILE 64
+
+/**
+ * Reception disk of a station on the sphere.
+ */
+struct disk {
+    double lat;                 ///< Latitude of the station
+    double lon;                 ///< Longitude of the station
+    double sin_lat;             ///< Sine of the latitude
+    double cos_lat;             ///< Cosine of the latitude
+    double cos_range;           ///< Cosine of the range, as an angle
+    double south;               ///< Southern limit of the disk
+    double north;               ///< Northern limit of the disk
+    double reach;               ///< Greatest longitude difference in the disk
+};
+
+/**
+ * Coverage grid, divided into tiles of TILE by TILE cells.
+ */
+struct grid {
+    struct bounds box;          ///< Edges of the grid
+    double resolution;          ///< Size of a cell in degrees
+    int rows;                   ///< Number of rows, north first
+    int columns;                ///< Number of columns, west first
+    int tile_rows;              ///< Number of rows of tiles
+    int tile_columns;           ///< Number of columns of tiles
+    struct disk *disks;         ///< Disks of the stations
+    int count;                  ///< Number of disks
+    int *first;                 ///< Start of the disks of each row of tiles
+    int *members;               ///< Disks overlapping each row of tiles
+    const struct region *region;///< Region of the cells (may be NULL)
+    uint32_t *counts;           ///< Stations receivable in each cell
+};
+
+/**
+ * Checks if a navaid is a station that coverage is mapped for.
+ *
+ * @param navaid a pointer to the navaid
+ * @return true for NDBs, VORs and DMEs
+ */
+static bool is_station(const struct navaid *navaid)
+{
+    switch (navaid->type) {
+    case NDB:
+    case VOR:
+    case DME:
+    case SDM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Initializes the reception disk of a station.
+ *
+ * The greatest longitude difference is for the points where meridians
+ * touch the disk, or all longitudes if the disk covers a pole.
+ *
+ * @param disk a pointer to the disk
+ * @param navaid a pointer to the station
+ */
+static void init_disk(struct disk *disk, const struct navaid *navaid)
+{
+    double d = navaid->range / EARTH_RADIUS_NM;
+    disk->lat = navaid->coordinate.lat;
+    disk->lon = navaid->coordinate.lon;
+    disk->sin_lat = sin(RADIANS(disk->lat));
+    disk->cos_lat = cos(RADIANS(disk->lat));
+    disk->cos_range = cos(d);
+    disk->south = disk->lat - DEGREES(d);
+    disk->north = disk->lat + DEGREES(d);
+    if (disk->north >= 90 || disk->south <= -90)
+        disk->reach = 180;
+    else
+        disk->reach = DEGREES(asin(sin(d) / disk->cos_lat));
+}
+
+/**
+ * Finds the rows of tiles that each disk overlaps.
+ *
+ * The disks of each row of tiles are listed together, so a tile only
+ * considers the stations that might reach it.
+ *
+ * @param grid a pointer to the grid, with its disks
+ */
+static void bin_disks(struct grid *grid)
+{
+    double height = TILE * grid->resolution;
+    int n = 0;
+    if ((grid->first = calloc(grid->tile_rows + 1, sizeof(int))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < grid->count; ++i) {
+            const struct disk *disk = &grid->disks[i];
+            if (disk->north < grid->box.min.lat ||
+                disk->south > grid->box.max.lat)
+                continue;
+            int top = (int)floor((grid->box.max.lat - disk->north) / height);
+            int bottom = (int)floor((grid->box.max.lat - disk->south) / height);
+            if (top < 0)
+                top = 0;
+            if (bottom > grid->tile_rows - 1)
+                bottom = grid->tile_rows - 1;
+            for (int t = top; t <= bottom; ++t)
+                if (pass == 0)
+                    ++grid->first[t + 1];
+                else
+                    grid->members[grid->first[t]++] = i;
+        }
+        if (pass == 0) {
+            for (int t = 0; t < grid->tile_rows; ++t)
+                grid->first[t + 1] += grid->first[t];
+            n = grid->first[grid->tile_rows];
+            if ((grid->members = malloc((n + 1) * sizeof(int))) == NULL) {
+                perror("malloc");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    memmove(grid->first + 1, grid->first, grid->tile_rows * sizeof(int));
+    grid->first[0] = 0;
+}
+
+/**
+ * Checks if a disk might reach the longitudes of a tile.
+ *
+ * @param disk a pointer to the disk
+ * @param west the western edge of the tile
+ * @param east the eastern edge of the tile
+ * @return true if the disk might reach the tile
+ */
+static bool reaches(const struct disk *disk, double west, double east)
+{
+    if (disk->reach >= 180)
+        return true;
+    for (int shift = -360; shift <= 360; shift += 360)
+        if (disk->lon + shift - disk->reach <= east &&
+            disk->lon + shift + disk->reach >= west)
+            return true;
+    return false;
+}
+
+/**
+ * Counts the stations receivable in the cells of one tile, as a thread
+ * pool task.
+ *
+ * Each disk that reaches the tile is rasterized row by row: at the
+ * latitude of a row, the points within range of the station are a span of
+ * longitudes, found by the spherical law of cosines, and the cells whose
+ * centres are in the span are counted. Each tile writes only its own cells,
+ * so tiles need no locking.
+ *
+ * @param task the tile, by rows of tiles
+ * @param worker the worker running the task (unused)
+ * @param data a pointer to the grid
+ */
+static void cover_tile(int task, int worker, void *data)
+{
+    (void)worker;
+    struct grid *grid = data;
+    int tr = task / grid->tile_columns, tc = task % grid->tile_columns;
+    int r0 = tr * TILE, c0 = tc * TILE;
+    int r1 = r0 + TILE < grid->rows ? r0 + TILE : grid->rows;
+    int c1 = c0 + TILE < grid->columns ? c0 + TILE : grid->columns;
+    double res = grid->resolution;
+    double top = grid->box.max.lat, left = grid->box.min.lon;
+
+    double sin_lat[TILE], cos_lat[TILE];
+    for (int r = r0; r < r1; ++r) {
+        double lat = RADIANS(top - (r + 0.5) * res);
+        sin_lat[r - r0] = sin(lat);
+        cos_lat[r - r0] = cos(lat);
+    }
+
+    double west = left + c0 * res, east = left + c1 * res;
+    for (int k = grid->first[tr]; k < grid->first[tr + 1]; ++k) {
+        const struct disk *disk = &grid->disks[grid->members[k]];
+        if (!reaches(disk, west, east))
+            continue;
+        int ra = (int)ceil((top - disk->north) / res - 0.5);
+        int rb = (int)floor((top - disk->south) / res - 0.5);
+        if (ra < r0)
+            ra = r0;
+        if (rb > r1 - 1)
+            rb = r1 - 1;
+        for (int r = ra; r <= rb; ++r) {
+            uint32_t *row = grid->counts + (size_t)r * grid->columns;
+            double s = sin_lat[r - r0] * disk->sin_lat;
+            double c = cos_lat[r - r0] * disk->cos_lat;
+            if (c <= 0 ? s < disk->cos_range : disk->cos_range - s > c)
+                continue;
+            if (c <= 0 || disk->cos_range - s <= -c) {
+                for (int col = c0; col < c1; ++col)
+                    ++row[col];
+                continue;
+            }
+            double half = DEGREES(acos((disk->cos_range - s) / c));
+            for (int shift = -360; shift <= 360; shift += 360) {
+                double lon = disk->lon + shift;
+                int ca = (int)ceil((lon - half - left) / res - 0.5);
+                int cb = (int)floor((lon + half - left) / res - 0.5);
+                if (ca < c0)
+                    ca = c0;
+                if (cb > c1 - 1)
+                    cb = c1 - 1;
+                for (int col = ca; col <= cb; ++col)
+                    ++row[col];
+            }
+        }
+    }
+
+    if (grid->region == NULL)
+        return;
+    for (int r = r0; r < r1; ++r)
+        for (int col = c0; col < c1; ++col) {
+            struct coordinate centre = {
+                top - (r + 0.5) * res, left + (col + 0.5) * res
+            };
+            if (!in_region(grid->region, &centre))
+                grid->counts[(size_t)r * grid->columns + col] = 0;
+        }
+}
+
+/**
+ * Writes a coverage grid as a binary greyscale PGM image.
+ *
+ * Each pixel is the number of stations receivable in a cell, so the
+ * maximum grey value is the greatest count, up to 65535. The edges and
+ * resolution of the grid are given in a comment.
+ *
+ * @param grid a pointer to the grid
+ * @param f the stream
+ */
+static void write_pgm(const struct grid *grid, FILE *f)
+{
+    size_t cells = (size_t)grid->rows * grid->columns;
+    uint32_t max = 1;
+    for (size_t i = 0; i < cells; ++i)
+        if (grid->counts[i] > max)
+            max = grid->counts[i];
+    if (max > UINT16_MAX)
+        max = UINT16_MAX;
+
+    fprintf(f, "P5\n# nvs coverage top=%.7g left=%.7g resolution=%.7g\n"
+        "%d %d\n%u\n", grid->box.max.lat, grid->box.min.lon,
+        grid->resolution, grid->columns, grid->rows, (unsigned)max);
+    for (size_t i = 0; i < cells; ++i) {
+        uint32_t v = grid->counts[i] < max ? grid->counts[i] : max;
+        if (max > UINT8_MAX)
+            putc(v >> 8, f);
+        putc(v & 0xff, f);
+    }
+}
+
+/**
+ * Writes a coverage grid as CSV.
+ *
+ * The first row has the longitudes of the cell centres and each following
+ * row has the latitude of its cell centres then the counts, north first.
+ *
+ * @param grid a pointer to the grid
+ * @param f the stream
+ */
+static void write_csv(const struct grid *grid, FILE *f)
+{
+    double res = grid->resolution;
+    fputs("lat", f);
+    for (int c = 0; c < grid->columns; ++c)
+        fprintf(f, ",%.7g", grid->box.min.lon + (c + 0.5) * res);
+    putc('\n', f);
+    for (int r = 0; r < grid->rows; ++r) {
+        const uint32_t *row = grid->counts + (size_t)r * grid->columns;
+        fprintf(f, "%.7g", grid->box.max.lat - (r + 0.5) * res);
+        for (int c = 0; c < grid->columns; ++c)
+            fprintf(f, ",%u", (unsigned)row[c]);
+        putc('\n', f);
+    }
+}
+
+/**
+ * Maps how many stations are receivable across a region.
+ *
+ * The region, or the whole world, is divided into square cells and each
+ * cell counts the NDBs, VORs and DMEs in the cache whose reception range
+ * reaches its centre. Cells outside the region count nothing. Stations
+ * outside the region still count in the cells they reach, so the cache
+ * should not be limited to the region.
+ *
+ * The grid is divided into tiles that are counted in parallel by the
+ * thread pool. The map is written to a file as CSV if its name ends with
+ * ".csv" and as a PGM image otherwise.
+ *
+ * Prints a message to standard error and exits with failure status if the
+ * grid cannot be allocated or the file cannot be written.
+ *
+ * @param cache the navaid cache
+ * @param selection a filter selection (may be NULL)
+ * @param region the region to map (may be NULL, for the whole world)
+ * @param resolution the size of a cell in degrees
+ * @param path the path of the file to write
+ * @param pool the thread pool (may be NULL)
+ * @return the number of stations mapped
+ */
+int coverage(struct navaid **cache, const uint64_t *selection,
+    const struct region *region, double resolution, const char *path,
+    struct pool *pool)
+{
+    assert(cache != NULL);
+    assert(resolution > 0);
+
+    struct grid grid = { .resolution = resolution, .region = region };
+    region_bounds(region, &grid.box);
+    grid.rows = (int)ceil(
+        (grid.box.max.lat - grid.box.min.lat) / resolution - 1e-9);
+    grid.columns = (int)ceil(
+        (grid.box.max.lon - grid.box.min.lon) / resolution - 1e-9);
+    if (grid.rows < 1)
+        grid.rows = 1;
+    if (grid.columns < 1)
+        grid.columns = 1;
+    grid.tile_rows = (grid.rows + TILE - 1) / TILE;
+    grid.tile_columns = (grid.columns + TILE - 1) / TILE;
+
+    size_t count = 0;
+    while (cache[count] != NULL)
+        ++count;
+    if ((grid.disks = malloc((count + 1) * sizeof(struct disk))) == NULL ||
+        (grid.counts = calloc((size_t)grid.rows * grid.columns,
+            sizeof(uint32_t))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        struct navaid *navaid = cache[i];
+        if (!is_station(navaid) || !is_selected(selection, (int)i))
+            continue;
+        parse_details(navaid);
+        if (navaid->range > 0 && !isnan(navaid->coordinate.lat) &&
+            !isnan(navaid->coordinate.lon))
+            init_disk(&grid.disks[grid.count++], navaid);
+    }
+    bin_disks(&grid);
+
+    int tiles = grid.tile_rows * grid.tile_columns;
+    if (pool != NULL)
+        run_pool(pool, tiles, cover_tile, &grid);
+    else
+        for (int t = 0; t < tiles; ++t)
+            cover_tile(t, 0, &grid);
+
+    FILE *f;
+    if ((f = fopen(path, "wb")) == NULL) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    size_t length = strlen(path);
+    if (length >= 4 && strcmp(path + length - 4, ".csv") == 0)
+        write_csv(&grid, f);
+    else
+        write_pgm(&grid, f);
+    if (ferror(f) || fclose(f) != 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    free(grid.counts);
+    free(grid.members);
+    free(grid.first);
+    free(grid.disks);
+    return grid.count;
+}
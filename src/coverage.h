@@ -0,0 +1,35 @@
+/**
+ * @file coverage.h
+ *
+ * Coverage maps of receivable stations.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef coverage_h
+#define coverage_h
+
+#include <stdint.h>
+
+struct navaid;
+struct pool;
+struct region;
+
+int coverage(struct navaid **cache, const uint64_t *selection,
+    const struct region *region, double resolution, const char *path,
+    struct pool *pool);
+
+#endif
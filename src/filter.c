@@ -0,0 +1,837 @@
+/**
+ * @file filter.c
+ *
+ * Filter expressions over navaid fields.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filter.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "parse.h"
+#include "pool.h"
+#include "types.h"
+
+/**
+ * Number of navaids in a block, one per bit of a selection word.
+ */
+#define BLOCK 64
+
+/**
+ * Number of blocks filtered by each task on a thread pool.
+ */
+#define BLOCKS_PER_TASK 64
+
+/**
+ * Maximum length of an identifier in a filter expression.
+ */
+#define IDENTIFIER_MAX 16
+
+/**
+ * Navaid fields that can be used in filter expressions.
+ */
+enum Column {
+    COL_TYPE,       ///< Navaid type
+    COL_LAT,        ///< Latitude
+    COL_LON,        ///< Longitude
+    COL_ELEVATION,  ///< Elevation in feet
+    COL_RANGE,      ///< Range in nm
+    COL_FREQUENCY,  ///< Frequency
+    COLUMNS         ///< Number of columns
+};
+
+/**
+ * Filter program operations.
+ */
+enum Opcode {
+    OP_EQ,      ///< Push column == a
+    OP_NE,      ///< Push column != a
+    OP_LT,      ///< Push column < a
+    OP_LE,      ///< Push column <= a
+    OP_GT,      ///< Push column > a
+    OP_GE,      ///< Push column >= a
+    OP_IN,      ///< Push a <= column <= b
+    OP_AND,     ///< Pop two selections, push their intersection
+    OP_OR,      ///< Pop two selections, push their union
+    OP_NOT      ///< Replace the top selection with its complement
+};
+
+/**
+ * Filter program instruction.
+ */
+struct instruction {
+    enum Opcode op;         ///< Operation
+    enum Column column;     ///< Column compared (comparisons only)
+    double a;               ///< First operand (comparisons only)
+    double b;               ///< Second operand (OP_IN only)
+};
+
+/**
+ * Filter structure.
+ *
+ * A filter is a program for a stack machine in postfix order. Comparisons
+ * push the selection of a block of navaids and logical operations combine
+ * the selections on top of the stack.
+ */
+struct filter {
+    struct instruction *code;   ///< Instructions
+    int count;                  ///< Number of instructions
+    int capacity;               ///< Capacity of the instruction array
+    int depth;                  ///< Maximum stack depth
+    int columns;                ///< Bitmask of columns used
+};
+
+/**
+ * Filter expression parser state.
+ */
+struct parser {
+    const char *expression; ///< The whole expression
+    const char *s;          ///< Current position in the expression
+    struct filter *filter;  ///< The filter being compiled
+    int depth;              ///< Current stack depth
+};
+
+/**
+ * Field names, indexed by column.
+ */
+static const char *const column_names[COLUMNS] = {
+    "type", "lat", "lon", "elevation", "range", "freq"
+};
+
+/**
+ * Terminates the program with a filter syntax error.
+ *
+ * @param p the parser state
+ * @param message a description of the error
+ */
+static void syntax_error(const struct parser *p, const char *message)
+{
+    fprintf(stderr, "Invalid filter: %s\n", p->expression);
+    fprintf(stderr, "%*s^ %s\n", (int)(p->s - p->expression) + 16, "",
+        message);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Appends an instruction to the filter program.
+ *
+ * @param p the parser state
+ * @param i the instruction
+ */
+static void emit(struct parser *p, struct instruction i)
+{
+    struct filter *f = p->filter;
+    if (f->count == f->capacity) {
+        f->capacity = f->capacity > 0 ? f->capacity * 2 : 16;
+        struct instruction *code;
+        if ((code = realloc(f->code, f->capacity * sizeof(*code))) == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        f->code = code;
+    }
+    f->code[f->count++] = i;
+
+    if (i.op == OP_AND || i.op == OP_OR)
+        --p->depth;
+    else if (i.op != OP_NOT) {
+        f->columns |= 1 << i.column;
+        if (++p->depth > f->depth)
+            f->depth = p->depth;
+    }
+}
+
+/**
+ * Skips white space in the expression.
+ *
+ * @param p the parser state
+ */
+static void skip(struct parser *p)
+{
+    while (isspace((unsigned char)*p->s))
+        ++p->s;
+}
+
+/**
+ * Reads an identifier from the expression, if there is one.
+ *
+ * @param p the parser state
+ * @param name receives the identifier, in lowercase
+ * @return the length of the identifier, 0 if there is none
+ */
+static size_t identifier(struct parser *p, char name[IDENTIFIER_MAX])
+{
+    skip(p);
+    size_t n = 0;
+    while (isalpha((unsigned char)p->s[n])) {
+        if (n < IDENTIFIER_MAX - 1)
+            name[n] = tolower((unsigned char)p->s[n]);
+        ++n;
+    }
+    name[n < IDENTIFIER_MAX - 1 ? n : IDENTIFIER_MAX - 1] = '\0';
+    return n;
+}
+
+/**
+ * Consumes a keyword if it is next in the expression.
+ *
+ * @param p the parser state
+ * @param keyword the keyword, in lowercase
+ * @return true if the keyword was consumed
+ */
+static bool keyword(struct parser *p, const char *keyword)
+{
+    char name[IDENTIFIER_MAX];
+    size_t n = identifier(p, name);
+    if (n == 0 || strcmp(name, keyword) != 0)
+        return false;
+    p->s += n;
+    return true;
+}
+
+/**
+ * Consumes a punctuation token if it is next in the expression.
+ *
+ * @param p the parser state
+ * @param token the token
+ * @return true if the token was consumed
+ */
+static bool punctuation(struct parser *p, const char *token)
+{
+    skip(p);
+    size_t n = strlen(token);
+    if (strncmp(p->s, token, n) != 0)
+        return false;
+    p->s += n;
+    return true;
+}
+
+/**
+ * Reads a number from the expression.
+ *
+ * @param p the parser state
+ * @return the number
+ */
+static double number(struct parser *p)
+{
+    skip(p);
+    char *end;
+    double d = strtod(p->s, &end);
+    if (end == p->s)
+        syntax_error(p, "number expected");
+    p->s = end;
+    return d;
+}
+
+/**
+ * Reads a column name from the expression.
+ *
+ * Frequency and elevation may also be written in full or abbreviated.
+ *
+ * @param p the parser state
+ * @return the column
+ */
+static enum Column column(struct parser *p)
+{
+    char name[IDENTIFIER_MAX];
+    size_t n = identifier(p, name);
+    if (n == 0)
+        syntax_error(p, "field name expected");
+
+    enum Column c = COLUMNS;
+    for (int i = 0; i < COLUMNS; ++i)
+        if (strcmp(name, column_names[i]) == 0)
+            c = i;
+    if (strcmp(name, "frequency") == 0)
+        c = COL_FREQUENCY;
+    if (strcmp(name, "elev") == 0)
+        c = COL_ELEVATION;
+    if (c == COLUMNS)
+        syntax_error(p, "unknown field");
+    p->s += n;
+    return c;
+}
+
+/**
+ * Compiles a comparison of the navaid type.
+ *
+ * Only equality and inequality are supported. DME includes standalone
+ * DMEs, as in search results.
+ *
+ * @param p the parser state
+ */
+static void type_comparison(struct parser *p)
+{
+    bool negate = false;
+    if (punctuation(p, "!="))
+        negate = true;
+    else if (punctuation(p, "==") || punctuation(p, "="))
+        negate = false;
+    else
+        syntax_error(p, "= or != expected");
+
+    char name[IDENTIFIER_MAX];
+    size_t n = identifier(p, name);
+    struct instruction i = { OP_EQ, COL_TYPE, 0, 0 };
+    if (strcmp(name, "ndb") == 0)
+        i.a = NDB;
+    else if (strcmp(name, "vor") == 0)
+        i.a = VOR;
+    else if (strcmp(name, "ils") == 0)
+        i.a = ILS;
+    else if (strcmp(name, "loc") == 0)
+        i.a = LOC;
+    else if (strcmp(name, "dme") == 0)
+        i.a = DME;
+    else if (strcmp(name, "fix") == 0)
+        i.a = FIX;
+    else
+        syntax_error(p, "NDB, VOR, ILS, LOC, DME or FIX expected");
+    p->s += n;
+
+    emit(p, i);
+    if (i.a == DME) {
+        i.a = SDM;
+        emit(p, i);
+        emit(p, (struct instruction){ OP_OR, 0, 0, 0 });
+    }
+    if (negate)
+        emit(p, (struct instruction){ OP_NOT, 0, 0, 0 });
+}
+
+/**
+ * Compiles a comparison of a field with a number or a range.
+ *
+ * @param p the parser state
+ */
+static void comparison(struct parser *p)
+{
+    struct instruction i = { OP_EQ, column(p), 0, 0 };
+    if (i.column == COL_TYPE) {
+        type_comparison(p);
+        return;
+    }
+
+    if (keyword(p, "in")) {
+        i.op = OP_IN;
+        i.a = number(p);
+        if (!punctuation(p, "-"))
+            syntax_error(p, "range expected, e.g. 112-114");
+        i.b = number(p);
+    } else {
+        if (punctuation(p, "!="))
+            i.op = OP_NE;
+        else if (punctuation(p, "<="))
+            i.op = OP_LE;
+        else if (punctuation(p, ">="))
+            i.op = OP_GE;
+        else if (punctuation(p, "<"))
+            i.op = OP_LT;
+        else if (punctuation(p, ">"))
+            i.op = OP_GT;
+        else if (punctuation(p, "==") || punctuation(p, "="))
+            i.op = OP_EQ;
+        else
+            syntax_error(p, "comparison operator expected");
+        i.a = number(p);
+    }
+    emit(p, i);
+}
+
+static void disjunction(struct parser *p);
+
+/**
+ * Compiles a negation, a parenthesized expression or a comparison.
+ *
+ * @param p the parser state
+ */
+static void unary(struct parser *p)
+{
+    if (keyword(p, "not")) {
+        unary(p);
+        emit(p, (struct instruction){ OP_NOT, 0, 0, 0 });
+    } else if (punctuation(p, "(")) {
+        disjunction(p);
+        if (!punctuation(p, ")"))
+            syntax_error(p, ") expected");
+    } else
+        comparison(p);
+}
+
+/**
+ * Compiles a sequence of terms joined by "and".
+ *
+ * @param p the parser state
+ */
+static void conjunction(struct parser *p)
+{
+    unary(p);
+    while (keyword(p, "and")) {
+        unary(p);
+        emit(p, (struct instruction){ OP_AND, 0, 0, 0 });
+    }
+}
+
+/**
+ * Compiles a sequence of terms joined by "or".
+ *
+ * @param p the parser state
+ */
+static void disjunction(struct parser *p)
+{
+    conjunction(p);
+    while (keyword(p, "or")) {
+        conjunction(p);
+        emit(p, (struct instruction){ OP_OR, 0, 0, 0 });
+    }
+}
+
+/**
+ * Compiles a filter expression.
+ *
+ * An expression is a set of comparisons of navaid fields, combined with
+ * "and", "or", "not" and parentheses, e.g.
+ *
+ *     type=VOR and range>=130 and elevation>1000 and freq in 112-114
+ *
+ * The fields are type, lat, lon, elevation (or elev), range and freq (or
+ * frequency). Numeric fields may be compared with =, !=, <, <=, > and >=, or
+ * tested against an inclusive range with "in". The type may be compared
+ * with = or != to NDB, VOR, ILS, LOC, DME or FIX. Keywords are case
+ * insensitive.
+ *
+ * If the expression cannot be compiled, the program is terminated with an
+ * exit status. The pointer returned must be destroyed after use with
+ * destroy_filter.
+ *
+ * @param expression the filter expression
+ * @return a pointer to a filter (never returns NULL)
+ */
+struct filter *compile_filter(const char *expression)
+{
+    assert(expression != NULL);
+
+    struct filter *filter;
+    if ((filter = calloc(1, sizeof(struct filter))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    struct parser p = { expression, expression, filter, 0 };
+    disjunction(&p);
+    skip(&p);
+    if (*p.s != '\0')
+        syntax_error(&p, "and, or or end of filter expected");
+    return filter;
+}
+
+/**
+ * Destroys a filter.
+ *
+ * @param filter a pointer to a filter (may be NULL)
+ */
+void destroy_filter(struct filter *filter)
+{
+    if (filter != NULL)
+        free(filter->code);
+    free(filter);
+}
+
+/**
+ * Packs a block of comparison results into a selection word.
+ *
+ * @param m comparison results, 0 or 1 for each navaid
+ * @return a selection word with bit i set if m[i] is set
+ */
+static inline uint64_t pack(const unsigned char m[BLOCK])
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < BLOCK; ++i)
+        bits |= (uint64_t)m[i] << i;
+    return bits;
+}
+
+/**
+ * Compares a block of column values with the operands of an instruction.
+ *
+ * Each case is a fixed length loop without branches, which the compiler
+ * can vectorize. Values are compared in double precision, the precision of
+ * the navaid fields, so a number in a filter can tell apart any two values
+ * in the data.
+ *
+ * @param x the column values for the block
+ * @param i the comparison instruction
+ * @return a selection word for the block
+ */
+static uint64_t compare(const double x[BLOCK], const struct instruction *i)
+{
+    unsigned char m[BLOCK];
+    const double a = i->a, b = i->b;
+    switch (i->op) {
+    case OP_EQ:
+        for (int k = 0; k < BLOCK; ++k) m[k] = x[k] == a;
+        break;
+    case OP_NE:
+        for (int k = 0; k < BLOCK; ++k) m[k] = x[k] != a;
+        break;
+    case OP_LT:
+        for (int k = 0; k < BLOCK; ++k) m[k] = x[k] < a;
+        break;
+    case OP_LE:
+        for (int k = 0; k < BLOCK; ++k) m[k] = x[k] <= a;
+        break;
+    case OP_GT:
+        for (int k = 0; k < BLOCK; ++k) m[k] = x[k] > a;
+        break;
+    case OP_GE:
+        for (int k = 0; k < BLOCK; ++k) m[k] = x[k] >= a;
+        break;
+    case OP_IN:
+        for (int k = 0; k < BLOCK; ++k) m[k] = (x[k] >= a) & (x[k] <= b);
+        break;
+    default:
+        assert(0);
+        return 0;
+    }
+    return pack(m);
+}
+
+/**
+ * Shared state of a filter run.
+ */
+struct run {
+    const struct filter *filter;    ///< The filter
+    struct navaid **cache;          ///< The navaid cache
+    int count;                      ///< Number of navaids in the cache
+    uint64_t *selection;            ///< Selection bitmap, one word per block
+};
+
+/**
+ * Copies the columns used by a filter for a block of navaids.
+ *
+ * The cache holds navaid structures, so a block is transposed into columns
+ * before it is filtered. Only the columns used by the filter are copied,
+ * decoding elevation and range first if they are used (see parse_details).
+ * Positions past the end of the cache are zero.
+ *
+ * @param run the filter run
+ * @param begin the position of the first navaid in the block
+ * @param columns receives the column values
+ */
+static void gather(const struct run *run, int begin,
+    double columns[COLUMNS][BLOCK])
+{
+    struct navaid *const *cache = run->cache + begin;
+    int n = run->count - begin < BLOCK ? run->count - begin : BLOCK;
+    for (int c = 0; c < COLUMNS; ++c) {
+        if ((run->filter->columns & (1 << c)) == 0)
+            continue;
+        double *x = columns[c];
+        switch (c) {
+        case COL_TYPE:
+            for (int k = 0; k < n; ++k) x[k] = cache[k]->type;
+            break;
+        case COL_LAT:
+            for (int k = 0; k < n; ++k) x[k] = cache[k]->coordinate.lat;
+            break;
+        case COL_LON:
+            for (int k = 0; k < n; ++k) x[k] = cache[k]->coordinate.lon;
+            break;
+        case COL_ELEVATION:
+            for (int k = 0; k < n; ++k) {
+                parse_details(cache[k]);
+                x[k] = cache[k]->elevation;
+            }
+            break;
+        case COL_RANGE:
+            for (int k = 0; k < n; ++k) {
+                parse_details(cache[k]);
+                x[k] = cache[k]->range;
+            }
+            break;
+        case COL_FREQUENCY:
+            for (int k = 0; k < n; ++k) x[k] = cache[k]->frequency;
+            break;
+        }
+        for (int k = n; k < BLOCK; ++k)
+            x[k] = 0;
+    }
+}
+
+/**
+ * Runs a filter over a range of blocks.
+ *
+ * @param task the task number
+ * @param worker the worker running the task (unused)
+ * @param data a pointer to the filter run
+ */
+static void filter_blocks(int task, int worker, void *data)
+{
+    (void)worker;
+    const struct run *run = data;
+    const struct filter *filter = run->filter;
+    int blocks = (run->count + BLOCK - 1) / BLOCK;
+    int first = task * BLOCKS_PER_TASK;
+    int last = first + BLOCKS_PER_TASK < blocks ?
+        first + BLOCKS_PER_TASK : blocks;
+
+    double columns[COLUMNS][BLOCK];
+    uint64_t stack[filter->depth + 1];
+    for (int block = first; block < last; ++block) {
+        gather(run, block * BLOCK, columns);
+        int top = 0;
+        for (int pc = 0; pc < filter->count; ++pc) {
+            const struct instruction *i = &filter->code[pc];
+            switch (i->op) {
+            case OP_AND:
+                --top;
+                stack[top - 1] &= stack[top];
+                break;
+            case OP_OR:
+                --top;
+                stack[top - 1] |= stack[top];
+                break;
+            case OP_NOT:
+                stack[top - 1] = ~stack[top - 1];
+                break;
+            default:
+                stack[top++] = compare(columns[i->column], i);
+                break;
+            }
+        }
+        int n = run->count - block * BLOCK;
+        run->selection[block] = stack[0] &
+            (n >= BLOCK ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1);
+    }
+}
+
+/**
+ * Runs a filter over a navaid cache.
+ *
+ * The cache is processed in blocks of 64 navaids. Each comparison in the
+ * filter produces a 64 bit selection word for the block and the logical
+ * operations combine words, so there is no branch per navaid. If a thread
+ * pool is supplied, ranges of blocks are filtered in parallel.
+ *
+ * The bitmap returned has bit (i % 64) of word (i / 64) set if the navaid
+ * at position i is selected. It must be freed after use.
+ *
+ * @param filter a pointer to a filter
+ * @param cache the navaid cache
+ * @param pool a thread pool (may be NULL)
+ * @return a selection bitmap (never returns NULL)
+ */
+uint64_t *run_filter(const struct filter *filter, struct navaid **cache,
+    struct pool *pool)
+{
+    assert(filter != NULL && cache != NULL);
+
+    int count = 0;
+    while (cache[count] != NULL)
+        ++count;
+
+    int blocks = (count + BLOCK - 1) / BLOCK;
+    struct run run = { filter, cache, count, NULL };
+    if ((run.selection = malloc((blocks + 1) * sizeof(uint64_t))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    int tasks = (blocks + BLOCKS_PER_TASK - 1) / BLOCKS_PER_TASK;
+    if (pool != NULL)
+        run_pool(pool, tasks, filter_blocks, &run);
+    else
+        for (int task = 0; task < tasks; ++task)
+            filter_blocks(task, 0, &run);
+    return run.selection;
+}
+
+/**
+ * Returns the value of a column for a single navaid.
+ *
+ * Elevation and range are decoded first if needed (see parse_details).
+ *
+ * @param navaid a pointer to the navaid
+ * @param c the column
+ * @return the value of the column
+ */
+static double column_value(struct navaid *navaid, enum Column c)
+{
+    switch (c) {
+    case COL_TYPE:
+        return navaid->type;
+    case COL_LAT:
+        return navaid->coordinate.lat;
+    case COL_LON:
+        return navaid->coordinate.lon;
+    case COL_ELEVATION:
+        parse_details(navaid);
+        return navaid->elevation;
+    case COL_RANGE:
+        parse_details(navaid);
+        return navaid->range;
+    case COL_FREQUENCY:
+        return navaid->frequency;
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+/**
+ * Compares a single column value with the operands of an instruction.
+ *
+ * @param x the column value
+ * @param i the comparison instruction
+ * @return true if the value satisfies the comparison
+ */
+static bool compare_value(double x, const struct instruction *i)
+{
+    switch (i->op) {
+    case OP_EQ:
+        return x == i->a;
+    case OP_NE:
+        return x != i->a;
+    case OP_LT:
+        return x < i->a;
+    case OP_LE:
+        return x <= i->a;
+    case OP_GT:
+        return x > i->a;
+    case OP_GE:
+        return x >= i->a;
+    case OP_IN:
+        return x >= i->a && x <= i->b;
+    default:
+        assert(0);
+        return false;
+    }
+}
+
+/**
+ * Tests a single navaid against a filter.
+ *
+ * This gives the same result as the navaid's bit in the selection from
+ * run_filter, without filtering the whole cache, for when only a few
+ * navaids need to be tested.
+ *
+ * @param filter a pointer to a filter
+ * @param navaid a pointer to the navaid
+ * @return true if the navaid is selected by the filter
+ */
+bool test_filter(const struct filter *filter, struct navaid *navaid)
+{
+    assert(filter != NULL && navaid != NULL);
+
+    bool stack[filter->depth + 1];
+    int top = 0;
+    for (int pc = 0; pc < filter->count; ++pc) {
+        const struct instruction *i = &filter->code[pc];
+        switch (i->op) {
+        case OP_AND:
+            --top;
+            stack[top - 1] = stack[top - 1] && stack[top];
+            break;
+        case OP_OR:
+            --top;
+            stack[top - 1] = stack[top - 1] || stack[top];
+            break;
+        case OP_NOT:
+            stack[top - 1] = !stack[top - 1];
+            break;
+        default:
+            stack[top++] = compare_value(column_value(navaid, i->column), i);
+            break;
+        }
+    }
+    return stack[0];
+}
+
+/**
+ * Finds the bounds that a filter places on a numeric field.
+ *
+ * The program is evaluated over intervals rather than selections: a
+ * comparison of the field gives the interval it accepts, a comparison of
+ * another field or a negation gives no bound, "and" intersects intervals
+ * and "or" spans them. Every navaid the filter selects lies within the
+ * bounds, but not every navaid within them is selected.
+ *
+ * @param filter a pointer to a filter
+ * @param field the name of the field, e.g. "freq"
+ * @param min receives the lower bound, -HUGE_VAL if there is none
+ * @param max receives the upper bound, HUGE_VAL if there is none
+ * @return true if the field is bounded
+ */
+bool filter_bounds(const struct filter *filter, const char *field,
+    double *min, double *max)
+{
+    assert(filter != NULL && field != NULL);
+
+    enum Column target = COLUMNS;
+    for (int c = 0; c < COLUMNS; ++c)
+        if (strcmp(column_names[c], field) == 0)
+            target = c;
+
+    double low[filter->depth + 1], high[filter->depth + 1];
+    int top = 0;
+    for (int pc = 0; pc < filter->count; ++pc) {
+        const struct instruction *i = &filter->code[pc];
+        switch (i->op) {
+        case OP_AND:
+            --top;
+            low[top - 1] = fmax(low[top - 1], low[top]);
+            high[top - 1] = fmin(high[top - 1], high[top]);
+            continue;
+        case OP_OR:
+            --top;
+            low[top - 1] = fmin(low[top - 1], low[top]);
+            high[top - 1] = fmax(high[top - 1], high[top]);
+            continue;
+        case OP_NOT:
+            low[top - 1] = -HUGE_VAL;
+            high[top - 1] = HUGE_VAL;
+            continue;
+        default:
+            low[top] = -HUGE_VAL;
+            high[top] = HUGE_VAL;
+            break;
+        }
+        if (i->column != target)
+            ++top;
+        else if (i->op == OP_EQ) {
+            low[top] = i->a;
+            high[top++] = i->a;
+        } else if (i->op == OP_LT || i->op == OP_LE)
+            high[top++] = i->a;
+        else if (i->op == OP_GT || i->op == OP_GE)
+            low[top++] = i->a;
+        else if (i->op == OP_IN) {
+            low[top] = i->a;
+            high[top++] = i->b;
+        } else
+            ++top;
+    }
+    *min = low[0];
+    *max = high[0];
+    return *min > -HUGE_VAL || *max < HUGE_VAL;
+}
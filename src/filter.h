@@ -0,0 +1,54 @@
+/**
+ * @file filter.h
+ *
+ * Filter expressions over navaid fields.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef filter_h
+#define filter_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter;
+struct navaid;
+struct pool;
+
+struct filter *compile_filter(const char *expression);
+void destroy_filter(struct filter *filter);
+bool filter_bounds(const struct filter *filter, const char *field,
+    double *min, double *max);
+uint64_t *run_filter(const struct filter *filter, struct navaid **cache,
+    struct pool *pool);
+bool test_filter(const struct filter *filter, struct navaid *navaid);
+
+/**
+ * Checks if a position is set in a selection bitmap.
+ *
+ * @param selection a selection bitmap (may be NULL, selecting everything)
+ * @param position a position in the navaid cache
+ * @return true if the position is selected
+ */
+static inline bool is_selected(const uint64_t *selection, int position)
+{
+    return selection == NULL ||
+        ((selection[position / 64] >> (position % 64)) & 1) != 0;
+}
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file fix.c
+ *
+ * Fixes from the fix data file.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fix.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "region.h"
+#include "types.h"
+#include "util.h"
+
+/**
+ * Arena that owns the fixes.
+ */
+static struct arena *arena;
+
+/**
+ * State used while loading fixes.
+ */
+struct builder {
+    struct navaid **fixes;          ///< Fixes, growing
+    size_t count;                   ///< Number of fixes
+    size_t capacity;                ///< Capacity of the fixes array
+    const struct region *region;    ///< Region (may be NULL)
+};
+
+/**
+ * Parses a row of the fix data file and adds the fix, if it is in the region.
+ *
+ * Rows have a latitude, a longitude and an ident. Header rows and the end
+ * of data marker do not have two numbers and are skipped.
+ *
+ * @param s the row
+ * @param data a pointer to the builder
+ */
+static void parse_fix(char *s, void *data)
+{
+    struct builder *b = data;
+    char *end;
+    struct coordinate c;
+    c.lat = strtod(s, &end);
+    if (end == s)
+        return;
+    s = end;
+    c.lon = strtod(s, &end);
+    if (end == s || c.lat < -90 || c.lat > 90 || c.lon < -180 || c.lon > 180)
+        return;
+
+    s = end;
+    while (*s == ' ' || *s == '\t')
+        ++s;
+    size_t n = strcspn(s, " \t\r");
+    if (n == 0)
+        return;
+    if (n >= CODE_MAX)
+        n = CODE_MAX - 1;
+    s[n] = '\0';
+
+    if (!in_region(b->region, &c))
+        return;
+
+    struct navaid *fix = arena_alloc(arena, sizeof(struct navaid));
+    memset(fix, 0, sizeof(struct navaid));
+    fix->type = FIX;
+    fix->coordinate = c;
+    fix->code = arena_strdup(arena, s);
+    fix->name = "";
+
+    b->fixes = reserve(b->fixes, &b->capacity, b->count + 2,
+        sizeof(struct navaid *));
+    b->fixes[b->count++] = fix;
+}
+
+/**
+ * Releases the array of fixes, as an arena cleanup action.
+ *
+ * @param data the array of fixes
+ */
+static void release_fixes(void *data)
+{
+    free(data);
+}
+
+/**
+ * Creates an array of fixes from the fix data file in FG_ROOT.
+ *
+ * The array has the same form as a navaid cache, so it can be indexed and
+ * searched in the same way. Fixes have the type FIX, an ident and a
+ * coordinate, and an empty name.
+ *
+ * This function never returns NULL. If the fix data file cannot be read,
+ * the program is terminated with an exit status.
+ *
+ * The array must be destroyed after use with destroy_fixes.
+ *
+ * @param region a pointer to the region (may be NULL)
+ * @return an array of pointers to navaid structures, terminated with NULL
+ */
+struct navaid **create_fixes(const struct region *region)
+{
+    char *fg_root;
+    if ((fg_root = getenv("FG_ROOT")) == NULL) {
+        fprintf(stderr, "Missing environment variable FG_ROOT\n");
+        exit(EXIT_FAILURE);
+    }
+
+    assert(arena == NULL);
+    arena = create_arena(ARENA_PAGE);
+
+    struct builder b = { .region = region };
+    b.fixes = reserve(NULL, &b.capacity, 1, sizeof(struct navaid *));
+    char *path = data_path(fg_root, "Navaids/fix.dat.gz");
+    read_rows(path, parse_fix, &b);
+    free(path);
+
+    b.fixes[b.count] = NULL;
+    arena_cleanup(arena, release_fixes, b.fixes);
+    return b.fixes;
+}
+
+/**
+ * Destroys an array of fixes.
+ *
+ * @param fixes an array of pointers to navaid structures (may be NULL)
+ */
+void destroy_fixes(struct navaid **fixes)
+{
+    if (fixes == NULL)
+        return;
+    destroy_arena(arena);
+    arena = NULL;
+}
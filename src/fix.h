@@ -0,0 +1,31 @@
+/**
+ * @file fix.h
+ *
+ * Fixes from the fix data file.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef fix_h
+#define fix_h
+
+struct navaid;
+struct region;
+
+struct navaid **create_fixes(const struct region *region);
+void destroy_fixes(struct navaid **fixes);
+
+#endif
@@ -91,6 +91,8 @@ bool show_flags(const char *prefix)
     if (flags.ils) printf(" ILS");
     if (flags.ndb) printf(" NDB");
     if (flags.vor) printf(" VOR");
+    if (flags.airports) printf(" APT");
+    if (flags.fixes) printf(" FIX");
 
     if (flags.fuzzy) printf(" (including names)");
 
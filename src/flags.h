@@ -28,14 +28,24 @@
  * Program flags
  */
 struct flags {
+    int airports : 1;   ///< Search airports and runways
+    int conflicts : 1;  ///< Report frequency conflicts
     int coordinates: 1; ///< Show coordinates
     int dme : 1;        ///< Search for DME
+    int explain : 1;    ///< Explain the plan of each search
+    int fixes : 1;      ///< Search fixes
     int fuzzy : 1;      ///< Fuzzy search (search names as well as codes)
+    int group : 1;      ///< Group co-located navaids into stations
     int ils : 1;        ///< Search for ILS/LOC
     int morse : 1;      ///< Display Morse code ident
     int ndb : 1;        ///< Search for NDB
+    int plan : 1;       ///< Plan a route along airways
     int quiet : 1;      ///< Suppress extra messages
+    int receivable : 1; ///< Find receivable rather than nearest navaids
+    int remember : 1;   ///< Replay results of identical earlier searches
+    int shared : 1;     ///< Share loaded data between processes
     int spacing: 1;     ///< Add spacers between search results
+    int suggest: 1;     ///< Suggest similar codes when not found
     int vor : 1;        ///< Search for VOR
 };
 
@@ -0,0 +1,701 @@
+/**
+ * @file follow.c
+ *
+ * Follow a live position feed, reporting navaids in range.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "follow.h"
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "filter.h"
+#include "flags.h"
+#include "geo.h"
+#include "parse.h"
+#include "search.h"
+#include "types.h"
+
+#ifndef M_PI
+/**
+ * Value of pi, if not defined by math.h.
+ */
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * Converts degrees to radians.
+ */
+#define RADIANS(d) ((d) * M_PI / 180.0)
+
+/**
+ * Converts radians to degrees.
+ */
+#define DEGREES(r) ((r) * 180.0 / M_PI)
+
+/**
+ * Number of rows of grid cells, each one degree of latitude.
+ */
+#define FOLLOW_ROWS 180
+
+/**
+ * Number of columns of grid cells, each one degree of longitude.
+ */
+#define FOLLOW_COLUMNS 360
+
+/**
+ * Greatest range in nm for which a disk is convex, a quarter of the way
+ * around the Earth.
+ */
+#define FOLLOW_CONVEX 5400
+
+/**
+ * Margin by which a corner must be inside a disk for the disk to cover
+ * a cell, so that rounding never wrongly keeps a station in range.
+ */
+#define FOLLOW_MARGIN 1e-12
+
+/**
+ * Size of the buffer for reading the feed, and so of the longest line.
+ */
+#define FOLLOW_BUFFER 4096
+
+/**
+ * Set when following should stop, on an interrupt or termination signal.
+ */
+static volatile sig_atomic_t stopping;
+
+/**
+ * Point on the unit sphere.
+ */
+struct vector {
+    double x;   ///< Towards latitude 0, longitude 0
+    double y;   ///< Towards latitude 0, longitude 90 east
+    double z;   ///< Towards the north pole
+};
+
+/**
+ * Navaid that may come into range.
+ */
+struct station {
+    struct coordinate coordinate;   ///< Coordinate of the navaid
+    int range;                      ///< Reception range in nm
+    bool inside;                    ///< In range after the last update
+    unsigned seen;                  ///< Last cell change that found it
+    const struct navaid *navaid;    ///< The navaid
+};
+
+/**
+ * State of a followed aircraft.
+ *
+ * Each cell of the grid lists the stations whose disks may reach it. The
+ * stations whose disks cover the whole cell come first and are in range
+ * for as long as the aircraft stays in the cell. The rest cross the cell
+ * and are the only ones checked while the aircraft moves within it. The
+ * whole list is only examined when the aircraft enters a new cell.
+ */
+struct follower {
+    struct station *stations;   ///< Stations
+    int count;                  ///< Number of stations
+    int *first;                 ///< Start of the stations of each cell
+    int *covering;              ///< Number of covering stations of each cell
+    int *members;               ///< Stations of each cell
+    struct vector *corners;     ///< Corners of the cells, while building
+    int *crossing;              ///< Crossing stations in range
+    int crossed;                ///< Number of crossing stations in range
+    int *scratch;               ///< Crossing stations for the next update
+    int cell;                   ///< Cell of the aircraft, or -1
+    int nearest;                ///< Nearest station in range, or -1
+    unsigned changes;           ///< Number of cell changes
+    long updates;               ///< Number of positions followed
+    long events;                ///< Number of events reported
+};
+
+/**
+ * Feed of positions.
+ */
+struct feed {
+    int fd;                     ///< File descriptor to read
+    bool datagrams;             ///< Each read is a whole message
+    bool ended;                 ///< No more positions will arrive
+    char buffer[FOLLOW_BUFFER]; ///< Text not yet parsed
+    size_t length;              ///< Length of the text
+    struct coordinate latest;   ///< Latest position not yet followed
+    bool pending;               ///< True if the latest position is new
+    struct follower *every;     ///< Follows every position, or NULL
+};
+
+/**
+ * Checks if a navaid can come into range.
+ *
+ * @param navaid a pointer to the navaid
+ * @return true if the navaid can be reported
+ */
+static bool is_reported(const struct navaid *navaid)
+{
+    extern struct flags flags;
+    switch (navaid->type) {
+    case NDB:
+    case VOR:
+    case ILS:
+    case LOC:
+        return true;
+    case DME:
+    case SDM:
+        return flags.dme;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Finds the cell of a coordinate.
+ *
+ * @param lat the latitude
+ * @param lon the longitude
+ * @return the index of the cell
+ */
+static int cell_of(double lat, double lon)
+{
+    int row = (int)floor(lat + 90);
+    int column = (int)floor(lon + 180) % FOLLOW_COLUMNS;
+    if (row > FOLLOW_ROWS - 1)
+        row = FOLLOW_ROWS - 1;
+    if (row < 0)
+        row = 0;
+    if (column < 0)
+        column += FOLLOW_COLUMNS;
+    return row * FOLLOW_COLUMNS + column;
+}
+
+/**
+ * Converts a coordinate to a point on the unit sphere.
+ *
+ * @param lat the latitude
+ * @param lon the longitude
+ * @param v a pointer to the point to set
+ */
+static void to_vector(double lat, double lon, struct vector *v)
+{
+    v->x = cos(RADIANS(lat)) * cos(RADIANS(lon));
+    v->y = cos(RADIANS(lat)) * sin(RADIANS(lon));
+    v->z = sin(RADIANS(lat));
+}
+
+/**
+ * Checks if the disk of a station covers a whole cell.
+ *
+ * Along a parallel, distance grows with the difference in longitude, and
+ * meridians are great circles, so a convex disk covers the cell if it
+ * covers the corners. A corner is in the disk if the cosine of its angle
+ * from the station is at least the cosine of the range.
+ *
+ * @param f a pointer to the follower
+ * @param v a pointer to the station on the unit sphere
+ * @param cosine the cosine of the range of the station, as an angle
+ * @param row the row of the cell
+ * @param column the column of the cell
+ * @return true if the cell is covered
+ */
+static bool covers(const struct follower *f, const struct vector *v,
+    double cosine, int row, int column)
+{
+    for (int corner = 0; corner < 4; ++corner) {
+        const struct vector *c = &f->corners[(row + corner / 2) *
+            FOLLOW_COLUMNS + (column + corner % 2) % FOLLOW_COLUMNS];
+        if (v->x * c->x + v->y * c->y + v->z * c->z < cosine + FOLLOW_MARGIN)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Lists a station in the cells its disk may reach, or counts them.
+ *
+ * The disk lies within its latitude band and within the greatest
+ * longitude difference of the points where meridians touch it, unless it
+ * covers a pole.
+ *
+ * @param f a pointer to the follower
+ * @param k the index of the station
+ * @param cursor the next free member of each cell, or NULL to count the
+ * members of each cell in first
+ */
+static void bin_station(struct follower *f, int k, int *cursor)
+{
+    const struct station *s = &f->stations[k];
+    double d = s->range / EARTH_RADIUS_NM;
+    double south = s->coordinate.lat - DEGREES(d);
+    double north = s->coordinate.lat + DEGREES(d);
+    int west = 0, east = FOLLOW_COLUMNS - 1;
+    if (south > -90 && north < 90) {
+        double reach = DEGREES(asin(sin(d) / cos(RADIANS(s->coordinate.lat))));
+        int w = (int)floor(s->coordinate.lon - reach + 180);
+        int e = (int)floor(s->coordinate.lon + reach + 180);
+        if (e - w + 1 < FOLLOW_COLUMNS) {
+            west = w;
+            east = e;
+        }
+    }
+    struct vector v;
+    to_vector(s->coordinate.lat, s->coordinate.lon, &v);
+    double cosine = s->range < FOLLOW_CONVEX ? cos(d) : INFINITY;
+    int bottom = cell_of(south, 0) / FOLLOW_COLUMNS;
+    int top = cell_of(north, 0) / FOLLOW_COLUMNS;
+    for (int row = bottom; row <= top; ++row)
+        for (int c = west; c <= east; ++c) {
+            int column = (c % FOLLOW_COLUMNS + FOLLOW_COLUMNS) % FOLLOW_COLUMNS;
+            int cell = row * FOLLOW_COLUMNS + column;
+            if (cursor == NULL) {
+                ++f->first[cell + 1];
+                continue;
+            }
+            if (covers(f, &v, cosine, row, column)) {
+                int last = f->first[cell] + f->covering[cell]++;
+                f->members[cursor[cell]++] = f->members[last];
+                f->members[last] = k;
+            } else
+                f->members[cursor[cell]++] = k;
+        }
+}
+
+/**
+ * Builds the grid of a follower.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * memory cannot be allocated.
+ *
+ * @param f a pointer to the follower
+ * @param cache the navaid cache
+ * @param selection a filter selection (may be NULL)
+ */
+static void create_grid(struct follower *f, struct navaid **cache,
+    const uint64_t *selection)
+{
+    size_t count = 0;
+    while (cache[count] != NULL)
+        ++count;
+    int cells = FOLLOW_ROWS * FOLLOW_COLUMNS;
+    int *cursor;
+    if ((f->stations = malloc((count + 1) * sizeof(struct station))) == NULL ||
+        (f->first = calloc(cells + 1, sizeof(int))) == NULL ||
+        (f->covering = calloc(cells, sizeof(int))) == NULL ||
+        (cursor = malloc(cells * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    f->count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        struct navaid *navaid = cache[i];
+        if (!is_reported(navaid) || !is_selected(selection, (int)i) ||
+            isnan(navaid->coordinate.lat) || isnan(navaid->coordinate.lon))
+            continue;
+        parse_details(navaid);
+        if (navaid->range <= 0)
+            continue;
+        struct station *s = &f->stations[f->count++];
+        s->coordinate = navaid->coordinate;
+        s->range = navaid->range;
+        s->inside = false;
+        s->seen = 0;
+        s->navaid = navaid;
+    }
+
+    for (int k = 0; k < f->count; ++k)
+        bin_station(f, k, NULL);
+    for (int cell = 0; cell < cells; ++cell) {
+        f->first[cell + 1] += f->first[cell];
+        cursor[cell] = f->first[cell];
+    }
+    size_t members = f->first[cells];
+    if ((f->members = malloc((members + 1) * sizeof(int))) == NULL ||
+        (f->crossing = malloc((f->count + 1) * sizeof(int))) == NULL ||
+        (f->scratch = malloc((f->count + 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    if ((f->corners = malloc((cells + FOLLOW_COLUMNS) *
+        sizeof(struct vector))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int row = 0; row <= FOLLOW_ROWS; ++row)
+        for (int column = 0; column < FOLLOW_COLUMNS; ++column)
+            to_vector(row - 90, column - 180,
+                &f->corners[row * FOLLOW_COLUMNS + column]);
+    for (int k = 0; k < f->count; ++k)
+        bin_station(f, k, cursor);
+    free(f->corners);
+    free(cursor);
+
+    f->crossed = 0;
+    f->cell = f->nearest = -1;
+    f->changes = 0;
+    f->updates = f->events = 0;
+}
+
+/**
+ * Reports an event for a station.
+ *
+ * @param f a pointer to the follower
+ * @param event the name of the event
+ * @param s a pointer to the station
+ * @param p a pointer to the position of the aircraft
+ */
+static void report(struct follower *f, const char *event,
+    const struct station *s, const struct coordinate *p)
+{
+    printf("%s,%s,%s,%.2f,%.1f,%.1f\n", event,
+        type_description(s->navaid->type), s->navaid->code,
+        s->navaid->frequency, distance(p, &s->coordinate),
+        bearing(p, &s->coordinate));
+    ++f->events;
+}
+
+/**
+ * Marks a station as in or out of range, reporting a change.
+ *
+ * @param f a pointer to the follower
+ * @param s a pointer to the station
+ * @param inside true if the station is now in range
+ * @param p a pointer to the position of the aircraft
+ */
+static void set_inside(struct follower *f, struct station *s, bool inside,
+    const struct coordinate *p)
+{
+    if (s->inside == inside)
+        return;
+    s->inside = inside;
+    report(f, inside ? "enter" : "leave", s, p);
+}
+
+/**
+ * Checks the crossing stations of the current cell.
+ *
+ * The stations in range are marked as seen since the last cell change.
+ * The previous list of crossing stations in range is left in scratch.
+ *
+ * @param f a pointer to the follower
+ * @param p a pointer to the position of the aircraft
+ */
+static void check_crossing(struct follower *f, const struct coordinate *p)
+{
+    int n = 0;
+    int end = f->first[f->cell + 1];
+    for (int i = f->first[f->cell] + f->covering[f->cell]; i < end; ++i) {
+        struct station *s = &f->stations[f->members[i]];
+        bool inside = distance(p, &s->coordinate) <= s->range;
+        if (inside) {
+            f->scratch[n++] = f->members[i];
+            s->seen = f->changes;
+        }
+        set_inside(f, s, inside, p);
+    }
+    int *previous = f->crossing;
+    f->crossing = f->scratch;
+    f->scratch = previous;
+    f->crossed = n;
+}
+
+/**
+ * Moves the aircraft into a new cell.
+ *
+ * The covering stations of the new cell enter range if they were not
+ * already in it, and its crossing stations are checked. The stations in
+ * range in the old cell that were not seen in the new one leave range.
+ *
+ * @param f a pointer to the follower
+ * @param cell the new cell
+ * @param p a pointer to the position of the aircraft
+ */
+static void change_cell(struct follower *f, int cell,
+    const struct coordinate *p)
+{
+    int old = f->cell, crossed = f->crossed;
+    ++f->changes;
+    f->cell = cell;
+    for (int i = f->first[cell]; i < f->first[cell] + f->covering[cell]; ++i) {
+        struct station *s = &f->stations[f->members[i]];
+        s->seen = f->changes;
+        set_inside(f, s, true, p);
+    }
+    check_crossing(f, p);
+    if (old < 0)
+        return;
+
+    for (int i = f->first[old]; i < f->first[old] + f->covering[old]; ++i) {
+        struct station *s = &f->stations[f->members[i]];
+        if (s->seen != f->changes)
+            set_inside(f, s, false, p);
+    }
+    for (int i = 0; i < crossed; ++i) {
+        struct station *s = &f->stations[f->scratch[i]];
+        if (s->seen != f->changes)
+            set_inside(f, s, false, p);
+    }
+}
+
+/**
+ * Follows the aircraft to a new position.
+ *
+ * Reports the stations that enter or leave range, then the nearest
+ * station in range if it has changed. Stations at the same distance are
+ * ranked in data file order.
+ *
+ * @param f a pointer to the follower
+ * @param p a pointer to the position of the aircraft
+ */
+static void move(struct follower *f, const struct coordinate *p)
+{
+    int cell = cell_of(p->lat, p->lon);
+    if (cell != f->cell)
+        change_cell(f, cell, p);
+    else
+        check_crossing(f, p);
+
+    int nearest = -1;
+    double best = INFINITY;
+    int covered = f->first[cell] + f->covering[cell];
+    for (int i = f->first[cell]; i < covered + f->crossed; ++i) {
+        int k = i < covered ? f->members[i] : f->crossing[i - covered];
+        double d = distance(p, &f->stations[k].coordinate);
+        if (d < best || (d == best && k < nearest)) {
+            best = d;
+            nearest = k;
+        }
+    }
+    if (nearest >= 0 && nearest != f->nearest)
+        report(f, "nearest", &f->stations[nearest], p);
+    f->nearest = nearest;
+    ++f->updates;
+}
+
+/**
+ * Opens a feed of positions.
+ *
+ * The source is "-" for standard input or the number of a UDP port to
+ * receive on the local host.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * the source is not valid or the socket cannot be opened.
+ *
+ * @param feed a pointer to the feed to initialize
+ * @param source the source of the feed
+ */
+static void open_feed(struct feed *feed, const char *source)
+{
+    feed->length = 0;
+    feed->ended = feed->pending = false;
+    if (strcmp(source, "-") == 0) {
+        feed->fd = STDIN_FILENO;
+        feed->datagrams = false;
+        return;
+    }
+
+    char *end;
+    long port = strtol(source, &end, 10);
+    if (end == source || *end != '\0' || port < 1 || port > 65535) {
+        fprintf(stderr, "Invalid feed: %s\n", source);
+        exit(EXIT_FAILURE);
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((feed->fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1 ||
+        bind(feed->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror(source);
+        exit(EXIT_FAILURE);
+    }
+    feed->datagrams = true;
+}
+
+/**
+ * Reads what has arrived on a feed, keeping the latest position or
+ * following every position.
+ *
+ * Lines that do not start with a latitude and longitude are ignored, so
+ * a feed may carry other fields or a header. Lines too long for the
+ * buffer are dropped.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * the feed cannot be read.
+ *
+ * @param feed a pointer to the feed
+ */
+static void read_feed(struct feed *feed)
+{
+    ssize_t n = read(feed->fd, feed->buffer + feed->length,
+        FOLLOW_BUFFER - 2 - feed->length);
+    if (n == -1) {
+        if (errno == EINTR)
+            return;
+        perror("read");
+        exit(EXIT_FAILURE);
+    }
+    if (n == 0) {
+        feed->ended = true;
+        n = 1;
+        feed->buffer[feed->length] = '\n';
+    }
+    feed->length += n;
+    if (feed->datagrams)
+        feed->buffer[feed->length++] = '\n';
+    feed->buffer[feed->length] = '\0';
+
+    char *line = feed->buffer, *newline;
+    while ((newline = strchr(line, '\n')) != NULL) {
+        *newline = '\0';
+        if (parse_position(line, &feed->latest)) {
+            if (feed->every != NULL)
+                move(feed->every, &feed->latest);
+            else
+                feed->pending = true;
+        }
+        line = newline + 1;
+    }
+    feed->length -= line - feed->buffer;
+    if (feed->length >= FOLLOW_BUFFER - 2)
+        feed->length = 0;
+    memmove(feed->buffer, line, feed->length);
+}
+
+/**
+ * Handles an interrupt or termination signal by stopping following.
+ *
+ * @param number the signal number
+ */
+static void stop(int number)
+{
+    (void)number;
+    stopping = 1;
+}
+
+/**
+ * Returns the time on the monotonic clock.
+ *
+ * @return the time in seconds
+ */
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+ * Follows a live feed of aircraft positions, reporting the navaids that
+ * come into and go out of reception range.
+ *
+ * Positions arrive as lines starting with the latitude and longitude,
+ * such as a FlightGear generic protocol feed, on standard input or a UDP
+ * port. They are followed at most rate times a second, each time from
+ * the latest position to arrive, or as they arrive if the rate is 0.
+ *
+ * Each change is written to standard output as a CSV line of the event
+ * (enter, leave or nearest), the navaid type, code and frequency, and the
+ * distance and bearing from the aircraft, flushed after each update.
+ * Following ends when standard input ends or on an interrupt or
+ * termination signal.
+ *
+ * Prints a message to standard error and exits with failure status if
+ * the feed cannot be opened or read.
+ *
+ * @param cache the navaid cache
+ * @param selection a filter selection (may be NULL)
+ * @param source "-" for standard input or a UDP port number
+ * @param rate the greatest number of updates a second, 0 for all
+ * @return the number of updates
+ */
+long follow(struct navaid **cache, const uint64_t *selection,
+    const char *source, int rate)
+{
+    extern struct flags flags;
+    assert(cache != NULL && source != NULL && rate >= 0);
+
+    struct feed feed;
+    open_feed(&feed, source);
+    struct follower f;
+    create_grid(&f, cache, selection);
+    feed.every = rate == 0 ? &f : NULL;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    double start = now(), due = start;
+    clock_t cpu = clock();
+    struct pollfd poller = { feed.fd, POLLIN, 0 };
+    while (!feed.ended && !stopping) {
+        int timeout = -1;
+        if (feed.pending) {
+            double wait = ceil((due - now()) * 1000);
+            timeout = wait > 0 ? (int)wait : 0;
+        }
+        int ready = poll(&poller, 1, timeout);
+        if (ready == -1 && errno != EINTR) {
+            perror("poll");
+            exit(EXIT_FAILURE);
+        }
+        if (ready > 0)
+            read_feed(&feed);
+        if (feed.pending && (feed.ended || now() >= due)) {
+            move(&f, &feed.latest);
+            feed.pending = false;
+            due = now() + 1.0 / rate;
+        }
+        fflush(stdout);
+    }
+
+    if (!flags.quiet)
+        fprintf(stderr, "%ld update%s, %ld event%s in %.2fs, "
+            "using %.2fs of CPU\n", f.updates, f.updates == 1 ? "" : "s",
+            f.events, f.events == 1 ? "" : "s", now() - start,
+            (double)(clock() - cpu) / CLOCKS_PER_SEC);
+
+    if (feed.fd != STDIN_FILENO)
+        close(feed.fd);
+    free(f.scratch);
+    free(f.crossing);
+    free(f.members);
+    free(f.covering);
+    free(f.first);
+    free(f.stations);
+    return f.updates;
+}
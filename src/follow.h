@@ -0,0 +1,32 @@
+/**
+ * @file follow.h
+ *
+ * Follow a live position feed, reporting navaids in range.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef follow_h
+#define follow_h
+
+#include <stdint.h>
+
+struct navaid;
+
+long follow(struct navaid **cache, const uint64_t *selection,
+    const char *source, int rate);
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @file geo.c
+ *
+ * Geodesic calculations.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "geo.h"
+
+#include <math.h>
+
+#include "types.h"
+
+#ifndef M_PI
+/// @cond Doxygen_Suppress
+#define M_PI 3.14159265358979323846
+/// @endcond
+#endif
+
+/**
+ * Converts degrees to radians.
+ */
+#define RADIANS(d) ((d) * M_PI / 180.0)
+
+/**
+ * Calculates the great circle distance between two coordinates.
+ *
+ * Uses the haversine formula on a spherical Earth, which is accurate to
+ * within a fraction of a percent. That is more than sufficient for ranking
+ * and reception checks.
+ *
+ * @param a a pointer to the first coordinate
+ * @param b a pointer to the second coordinate
+ * @return the distance in nautical miles
+ */
+double distance(const struct coordinate *a, const struct coordinate *b)
+{
+    double dlat = RADIANS(b->lat - a->lat);
+    double dlon = RADIANS(b->lon - a->lon);
+    double h = sin(dlat / 2) * sin(dlat / 2) +
+        cos(RADIANS(a->lat)) * cos(RADIANS(b->lat)) *
+        sin(dlon / 2) * sin(dlon / 2);
+    return 2 * EARTH_RADIUS_NM * asin(sqrt(h < 1 ? h : 1));
+}
+
+/**
+ * Calculates the initial true bearing of the great circle from one
+ * coordinate to another.
+ *
+ * @param a a pointer to the starting coordinate
+ * @param b a pointer to the destination coordinate
+ * @return the bearing in degrees, from 0 up to but not including 360
+ */
+double bearing(const struct coordinate *a, const struct coordinate *b)
+{
+    double dlon = RADIANS(b->lon - a->lon);
+    double y = sin(dlon) * cos(RADIANS(b->lat));
+    double x = cos(RADIANS(a->lat)) * sin(RADIANS(b->lat)) -
+        sin(RADIANS(a->lat)) * cos(RADIANS(b->lat)) * cos(dlon);
+    double degrees = atan2(y, x) * 180.0 / M_PI;
+    return degrees < 0 ? degrees + 360 : degrees;
+}
+
+/**
+ * Calculates the position of a coordinate along a Hilbert curve.
+ *
+ * Latitude and longitude are quantized to 16 bits each and mapped to the
+ * distance along a Hilbert curve filling the grid, so coordinates that are
+ * close together usually have close keys. Coordinates that are not numbers
+ * have key 0.
+ *
+ * @param c a pointer to the coordinate
+ * @return the Hilbert key
+ */
+uint32_t hilbert_key(const struct coordinate *c)
+{
+    const uint32_t n = 1u << 16;
+    if (isnan(c->lat) || isnan(c->lon))
+        return 0;
+    double fx = (c->lon + 180) / 360 * (n - 1);
+    double fy = (c->lat + 90) / 180 * (n - 1);
+    uint32_t x = fx < 0 ? 0 : fx > n - 1 ? n - 1 : (uint32_t)fx;
+    uint32_t y = fy < 0 ? 0 : fy > n - 1 ? n - 1 : (uint32_t)fy;
+
+    uint32_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) != 0, ry = (y & s) != 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            uint32_t t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return d;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file geo.h
+ *
+ * Geodesic calculations.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef geo_h
+#define geo_h
+
+#include <stdint.h>
+
+struct coordinate;
+
+/**
+ * Mean radius of the Earth in nautical miles.
+ */
+#define EARTH_RADIUS_NM 3440.065
+
+double bearing(const struct coordinate *a, const struct coordinate *b);
+double distance(const struct coordinate *a, const struct coordinate *b);
+uint32_t hilbert_key(const struct coordinate *c);
+
+#endif
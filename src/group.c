@@ -0,0 +1,418 @@
+/**
+ * @file group.c
+ *
+ * Grouping of co-located navaids into stations.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "group.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "geo.h"
+#include "types.h"
+#include "util.h"
+
+#ifndef M_PI
+/// @cond Doxygen_Suppress
+#define M_PI 3.14159265358979323846
+/// @endcond
+#endif
+
+/**
+ * Distance in nm within which a DME is co-located with a VOR or NDB.
+ */
+#define COLOCATED_NM 1.0
+
+/**
+ * Size in degrees of the cells used to join DMEs to VORs and NDBs.
+ */
+#define CELL_SIZE 0.1
+
+/**
+ * Number of cells around a circle of latitude.
+ */
+#define CELLS_AROUND ((long)(360 / CELL_SIZE + 0.5))
+
+/**
+ * Nautical miles per degree of latitude, rounded down so that cell
+ * searches never fall short.
+ */
+#define NM_PER_DEGREE 60.0
+
+/**
+ * Groups structure.
+ *
+ * Each navaid maps to the position of the station it belongs to, which is
+ * its own position for VORs, NDBs, ILSs and LOCs. Stations hold the
+ * positions of their components.
+ */
+struct groups {
+    int *primary;               ///< Station position for each navaid
+    struct station *stations;   ///< Components, indexed by station position
+};
+
+/**
+ * Hash table of navaid positions, chained through a shared next array.
+ */
+struct table {
+    int *heads;     ///< First position in each bucket, -1 if empty
+    size_t mask;    ///< Number of buckets - 1
+};
+
+/**
+ * Returns the cell that contains a latitude or longitude.
+ *
+ * Longitude cells wrap at the antimeridian.
+ *
+ * @param degrees the latitude or longitude
+ * @param wrap true for longitude
+ * @return the cell number
+ */
+static long cell(double degrees, bool wrap)
+{
+    long c = (long)floor(degrees / CELL_SIZE);
+    if (wrap)
+        c = ((c % CELLS_AROUND) + CELLS_AROUND) % CELLS_AROUND;
+    return c;
+}
+
+/**
+ * Initializes an empty hash table.
+ *
+ * The table has at least twice as many buckets as entries, so that chains
+ * are short.
+ *
+ * @param table a pointer to the table
+ * @param entries the number of entries the table will hold
+ */
+static void init_table(struct table *table, size_t entries)
+{
+    size_t buckets = 16;
+    while (buckets < 2 * entries)
+        buckets *= 2;
+    if ((table->heads = malloc(buckets * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < buckets; ++i)
+        table->heads[i] = -1;
+    table->mask = buckets - 1;
+}
+
+/**
+ * Hashes an ident and a cell.
+ *
+ * @param code the ident
+ * @param lat the latitude cell
+ * @param lon the longitude cell
+ * @return the hash
+ */
+static uint64_t hash_ident(const char *code, long lat, long lon)
+{
+    uint64_t h = fnv1a(code, strlen(code) + 1, FNV_OFFSET);
+    h = fnv1a(&lat, sizeof(lat), h);
+    return fnv1a(&lon, sizeof(lon), h);
+}
+
+/**
+ * Hashes the airport and runway of a navaid.
+ *
+ * @param navaid a pointer to a navaid structure, with ICAO and runway
+ * @return the hash
+ */
+static uint64_t hash_runway(const struct navaid *navaid)
+{
+    uint64_t h = fnv1a(navaid->icao, strlen(navaid->icao) + 1, FNV_OFFSET);
+    return fnv1a(navaid->runway, strlen(navaid->runway), h);
+}
+
+/**
+ * Checks if two navaids serve the same airport and runway.
+ *
+ * @param a pointer to the first navaid
+ * @param b pointer to the second navaid
+ * @return true if the ICAO codes and runways are equal
+ */
+static bool same_runway(const struct navaid *a, const struct navaid *b)
+{
+    return strcmp(a->icao, b->icao) == 0 && strcmp(a->runway, b->runway) == 0;
+}
+
+/**
+ * Checks if a DME is co-located with a VOR or NDB.
+ *
+ * The DME of a VOR-DME is paired with the VOR frequency. An NDB-DME has
+ * its own channel, so only the ident and position are compared.
+ *
+ * @param dme a pointer to the DME
+ * @param primary a pointer to the VOR or NDB
+ * @return true if the DME belongs to the station
+ */
+static bool colocated(const struct navaid *dme, const struct navaid *primary)
+{
+    if (strcmp(dme->code, primary->code) != 0)
+        return false;
+    if (primary->type == VOR &&
+        fabs(dme->frequency - primary->frequency) > 0.005)
+        return false;
+    return distance(&dme->coordinate, &primary->coordinate) < COLOCATED_NM;
+}
+
+/**
+ * Checks if one candidate station for a DME is preferred to another.
+ *
+ * A VOR is preferred to an NDB, because a DME paired with a VOR frequency
+ * is more likely part of a VOR-DME than an NDB-DME. Otherwise the first
+ * in data file order is preferred.
+ *
+ * @param cache the navaid cache
+ * @param a the position of the first candidate
+ * @param b the position of the second candidate
+ * @return true if the first candidate is preferred
+ */
+static bool preferred(struct navaid **cache, int a, int b)
+{
+    if (cache[a]->type != cache[b]->type)
+        return cache[a]->type == VOR;
+    return a < b;
+}
+
+/**
+ * Finds the VOR or NDB that a DME belongs to.
+ *
+ * VORs and NDBs are hashed on ident and cell, so only the cells that
+ * overlap the co-location distance around the DME are probed, usually
+ * just one. Longitude cells narrow towards the poles, so more of them are
+ * probed there.
+ *
+ * @param cache the navaid cache
+ * @param groups the groups being built
+ * @param idents the table of VORs and NDBs
+ * @param next the chains of the table
+ * @param dme a pointer to the DME
+ * @return the position of the VOR or NDB, or -1 if there is none
+ */
+static int find_station(struct navaid **cache, const struct groups *groups,
+    const struct table *idents, const int *next, const struct navaid *dme)
+{
+    const struct coordinate *c = &dme->coordinate;
+    double dlat = COLOCATED_NM / NM_PER_DEGREE;
+    double dlon = COLOCATED_NM / (NM_PER_DEGREE * cos(c->lat * M_PI / 180));
+    long west = cell(c->lon - dlon, false), east = cell(c->lon + dlon, false);
+    if (!(dlon < 180) || east - west >= CELLS_AROUND) {
+        west = 0;
+        east = CELLS_AROUND - 1;
+    }
+
+    int match = -1;
+    for (long y = cell(c->lat - dlat, false); y <= cell(c->lat + dlat, false);
+        ++y)
+        for (long x = west; x <= east; ++x) {
+            long wrapped = ((x % CELLS_AROUND) + CELLS_AROUND) % CELLS_AROUND;
+            size_t h = hash_ident(dme->code, y, wrapped) & idents->mask;
+            for (int j = idents->heads[h]; j != -1; j = next[j])
+                if (groups->stations[j].dme == -1 &&
+                    colocated(dme, cache[j]) &&
+                    (match == -1 || preferred(cache, j, match)))
+                    match = j;
+        }
+    return match;
+}
+
+/**
+ * Returns the slot in a station for a component.
+ *
+ * @param station a pointer to the station
+ * @param type the type of the component
+ * @return a pointer to the slot
+ */
+static int *slot(struct station *station, enum NavaidType type)
+{
+    switch (type) {
+    case GS:
+        return &station->gs;
+    case OM:
+        return &station->om;
+    case MM:
+        return &station->mm;
+    case IM:
+        return &station->im;
+    default:
+        return &station->dme;
+    }
+}
+
+/**
+ * Creates groups of co-located navaids.
+ *
+ * Components are attached to stations with two hash joins. DMEs without
+ * an airport are joined to VORs and NDBs on ident and position, to within
+ * a cell, then checked for frequency and distance. Glideslopes, markers
+ * and ILS DMEs are joined to ILSs and LOCs on airport and runway,
+ * preferring an ILS with the same ident. Each component joins at most one
+ * station and each station takes at most one component of each kind.
+ *
+ * Components that do not join a station are left on their own, except
+ * glideslopes and markers, which are never shown alone, and DMEs unless
+ * standalone is set. Such navaids have no station.
+ *
+ * The pointer returned must be destroyed after use with destroy_groups.
+ *
+ * @param cache the navaid cache
+ * @param standalone true to keep DMEs that do not join a station
+ * @return a pointer to the groups (never returns NULL)
+ */
+struct groups *create_groups(struct navaid **cache, bool standalone)
+{
+    assert(cache != NULL);
+
+    size_t n = 0, beacons = 0, localizers = 0;
+    for (; cache[n] != NULL; ++n) {
+        enum NavaidType type = cache[n]->type;
+        beacons += type == VOR || type == NDB;
+        localizers += type == ILS || type == LOC;
+    }
+
+    struct groups *groups;
+    int *next;
+    if ((groups = malloc(sizeof(struct groups))) == NULL ||
+        (groups->primary = malloc((n + 1) * sizeof(int))) == NULL ||
+        (groups->stations = malloc((n + 1) * sizeof(struct station))) == NULL ||
+        (next = malloc((n + 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    struct table idents, runways;
+    init_table(&idents, beacons);
+    init_table(&runways, localizers);
+
+    const struct station none = { -1, -1, -1, -1, -1 };
+    for (size_t i = 0; i < n; ++i) {
+        const struct navaid *navaid = cache[i];
+        groups->stations[i] = none;
+        groups->primary[i] = (int)i;
+        size_t h;
+        switch (navaid->type) {
+        case VOR:
+        case NDB:
+            h = hash_ident(navaid->code, cell(navaid->coordinate.lat, false),
+                cell(navaid->coordinate.lon, true)) & idents.mask;
+            next[i] = idents.heads[h];
+            idents.heads[h] = (int)i;
+            break;
+        case ILS:
+        case LOC:
+            h = hash_runway(navaid) & runways.mask;
+            next[i] = runways.heads[h];
+            runways.heads[h] = (int)i;
+            break;
+        case GS:
+        case OM:
+        case MM:
+        case IM:
+            groups->primary[i] = -1;
+            break;
+        default:
+            if (!standalone)
+                groups->primary[i] = -1;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        const struct navaid *navaid = cache[i];
+        int match = -1;
+        switch (navaid->type) {
+        case DME:
+        case SDM:
+            if (navaid->icao == NULL) {
+                match = find_station(cache, groups, &idents, next, navaid);
+                break;
+            }
+            /* fall through - ILS DMEs join on runway */
+        case GS:
+        case OM:
+        case MM:
+        case IM: {
+            size_t h = hash_runway(navaid) & runways.mask;
+            for (int j = runways.heads[h]; j != -1; j = next[j]) {
+                if (!same_runway(navaid, cache[j]) ||
+                    *slot(&groups->stations[j], navaid->type) != -1)
+                    continue;
+                if (match == -1 || strcmp(navaid->code, cache[j]->code) == 0)
+                    match = j;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if (match != -1) {
+            *slot(&groups->stations[match], navaid->type) = (int)i;
+            groups->primary[i] = match;
+        }
+    }
+    free(next);
+    free(idents.heads);
+    free(runways.heads);
+    return groups;
+}
+
+/**
+ * Destroys groups of co-located navaids.
+ *
+ * @param groups a pointer to the groups (may be NULL)
+ */
+void destroy_groups(struct groups *groups)
+{
+    if (groups != NULL) {
+        free(groups->primary);
+        free(groups->stations);
+    }
+    free(groups);
+}
+
+/**
+ * Returns the position of the station a navaid belongs to.
+ *
+ * @param groups a pointer to the groups
+ * @param position the position of a navaid in the cache
+ * @return the position of the station, or -1 if the navaid has none
+ */
+int group_primary(const struct groups *groups, int position)
+{
+    return groups->primary[position];
+}
+
+/**
+ * Returns the components of a station.
+ *
+ * @param groups a pointer to the groups
+ * @param position the position of the station in the cache
+ * @return a pointer to the components, all -1 if there are none
+ */
+const struct station *group_station(const struct groups *groups, int position)
+{
+    return &groups->stations[position];
+}
@@ -0,0 +1,49 @@
+/**
+ * @file group.h
+ *
+ * Grouping of co-located navaids into stations.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef group_h
+#define group_h
+
+#include <stdbool.h>
+
+struct groups;
+struct navaid;
+
+/**
+ * Components of a composite station, as positions in the navaid cache.
+ *
+ * Missing components are -1.
+ */
+struct station {
+    int dme;        ///< DME of a VOR-DME, NDB-DME or ILS-DME
+    int gs;         ///< Glideslope of an ILS
+    int om;         ///< Outer marker of an ILS
+    int mm;         ///< Middle marker of an ILS
+    int im;         ///< Inner marker of an ILS
+};
+
+struct groups *create_groups(struct navaid **cache, bool standalone);
+void destroy_groups(struct groups *groups);
+int group_primary(const struct groups *groups, int position);
+const struct station *group_station(const struct groups *groups,
+    int position);
+
+#endif
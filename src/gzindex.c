@@ -0,0 +1,440 @@
+/**
+ * @file gzindex.c
+ *
+ * Random access checkpoints into gzip files.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "gzindex.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "util.h"
+
+/**
+ * Magic number identifying a gzip index file ("NVSZ").
+ */
+#define GZINDEX_MAGIC 0x5a53564eU
+
+/**
+ * Version of the gzip index file layout.
+ */
+#define GZINDEX_LAYOUT 2
+
+/**
+ * Size of the gzip trailer, holding the CRC-32 and size of the
+ * uncompressed data.
+ */
+#define TRAILER 8
+
+/**
+ * Size of the deflate window, i.e. the history needed to resume inflating.
+ */
+#define WINDOW (32 * 1024)
+
+/**
+ * Checkpoint at the start of a segment.
+ *
+ * A checkpoint is at a deflate block boundary, which may fall inside a
+ * byte of the compressed data, so the number of bits of the previous byte
+ * that belong to the block is recorded too.
+ */
+struct checkpoint {
+    uint64_t out;               ///< Offset in the uncompressed data
+    uint64_t in;                ///< Offset of the next compressed byte
+    uint32_t bits;              ///< Bits of the previous byte in the block
+    uint32_t window;            ///< Length of the window (up to WINDOW)
+    struct summary summary;     ///< Summary of the segment
+};
+
+/**
+ * Gzip index file header.
+ *
+ * The header is followed by the checkpoints and then a window of WINDOW
+ * bytes for each checkpoint.
+ *
+ * The index is valid for a compressed file with the same size, mtime and
+ * gzip trailer. The trailer holds the CRC-32 of the uncompressed data, so
+ * a file rewritten with the same size and mtime is not inflated from stale
+ * checkpoints, which could produce corrupt data without any zlib error.
+ */
+struct header {
+    uint32_t magic;             ///< GZINDEX_MAGIC
+    uint32_t layout;            ///< GZINDEX_LAYOUT
+    uint64_t source_size;       ///< Size of the compressed file
+    int64_t source_mtime;       ///< Modification time of the compressed file
+    uint64_t source_trailer;    ///< Gzip trailer of the compressed file
+    uint64_t total;             ///< Size of the uncompressed data
+    uint64_t count;             ///< Number of checkpoints
+};
+
+/**
+ * Gzip index.
+ *
+ * The index is either mapped from an index file or built in memory.
+ */
+struct gzindex {
+    void *base;                         ///< Mapped file (NULL if built)
+    size_t length;                      ///< Size of the mapping
+    struct checkpoint *checkpoints;     ///< Checkpoints
+    unsigned char *windows;             ///< Window for each checkpoint
+    int count;                          ///< Number of checkpoints
+    size_t capacity;                    ///< Capacity of the checkpoints
+    size_t wcapacity;                   ///< Capacity of the windows
+    size_t total;                       ///< Size of the uncompressed data
+    uint64_t trailer;                   ///< Gzip trailer of the file
+};
+
+/**
+ * Reads the gzip trailer of a compressed file.
+ *
+ * @param in the compressed file
+ * @param size the size of the compressed file
+ * @return the trailer, or 0 if the file is too short to have one
+ */
+static uint64_t read_trailer(const unsigned char *in, size_t size)
+{
+    uint64_t trailer = 0;
+    if (size >= TRAILER)
+        for (int i = 0; i < TRAILER; ++i)
+            trailer |= (uint64_t)in[size - TRAILER + i] << (8 * i);
+    return trailer;
+}
+
+/**
+ * Adds a checkpoint to an index being built.
+ *
+ * @param index a pointer to the index
+ * @param out the uncompressed data so far
+ * @param strm the inflate stream, stopped at a block boundary
+ * @param size the size of the compressed data
+ */
+static void add_checkpoint(struct gzindex *index, const char *out,
+    const z_stream *strm, size_t size)
+{
+    index->checkpoints = reserve(index->checkpoints, &index->capacity,
+        (size_t)index->count + 1, sizeof(struct checkpoint));
+    index->windows = reserve(index->windows, &index->wcapacity,
+        ((size_t)index->count + 1) * WINDOW, 1);
+
+    struct checkpoint *c = &index->checkpoints[index->count];
+    memset(c, 0, sizeof(struct checkpoint));
+    c->out = strm->total_out;
+    c->in = size - strm->avail_in;
+    c->bits = (uint32_t)strm->data_type & 7;
+    c->window = c->out < WINDOW ? (uint32_t)c->out : WINDOW;
+
+    unsigned char *window = &index->windows[(size_t)index->count * WINDOW];
+    memset(window, 0, WINDOW);
+    memcpy(window, out + c->out - c->window, c->window);
+    ++index->count;
+}
+
+/**
+ * Inflates a whole gzip file, building an index of checkpoints.
+ *
+ * The file is inflated one deflate block at a time and a checkpoint is
+ * recorded at the first block boundary after every span bytes of output,
+ * along with the window needed to resume inflating there. Files of more
+ * than one gzip member are not indexed.
+ *
+ * The uncompressed data is returned through out, with room for a
+ * terminator, and must be freed after use. The summaries of the segments
+ * are zeroed, for the caller to fill in.
+ *
+ * @param in the compressed file
+ * @param size the size of the compressed file
+ * @param span the minimum size of a segment of uncompressed data
+ * @param out receives the uncompressed data
+ * @param total receives the size of the uncompressed data
+ * @return a pointer to the index, or NULL if the file cannot be indexed
+ */
+struct gzindex *build_gzindex(const unsigned char *in, size_t size,
+    size_t span, char **out, size_t *total)
+{
+    assert(in != NULL && out != NULL && total != NULL);
+
+    struct gzindex *index;
+    if ((index = calloc(1, sizeof(struct gzindex))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    z_stream strm;
+    memset(&strm, 0, sizeof strm);
+    if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+        free(index);
+        return NULL;
+    }
+
+    size_t capacity = 4 * size + WINDOW;
+    char *data = NULL;
+    size_t last = 0;
+    int ret = Z_OK;
+    strm.next_in = (unsigned char *)in;
+    strm.avail_in = (uInt)size;
+    while (ret == Z_OK) {
+        if (data == NULL || strm.total_out == capacity) {
+            if (data != NULL)
+                capacity *= 2;
+            if ((data = realloc(data, capacity + 1)) == NULL) {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+        }
+        strm.next_out = (unsigned char *)data + strm.total_out;
+        strm.avail_out = (uInt)(capacity - strm.total_out);
+        ret = inflate(&strm, Z_BLOCK);
+        if (ret == Z_BUF_ERROR && strm.avail_out == 0)
+            ret = Z_OK;
+        if (ret == Z_OK && (strm.data_type & 128) &&
+            !(strm.data_type & 64) &&
+            (index->count == 0 || strm.total_out - last >= span)) {
+            add_checkpoint(index, data, &strm, size);
+            last = strm.total_out;
+        }
+    }
+
+    if (ret != Z_STREAM_END || strm.avail_in != 0 || index->count == 0) {
+        inflateEnd(&strm);
+        free(data);
+        destroy_gzindex(index);
+        return NULL;
+    }
+    index->total = strm.total_out;
+    index->trailer = read_trailer(in, size);
+    inflateEnd(&strm);
+
+    *out = data;
+    *total = index->total;
+    return index;
+}
+
+/**
+ * Maps a gzip index file, if it was built for the current compressed file.
+ *
+ * @param path the path to the index file
+ * @param source the status of the compressed file
+ * @param in the compressed file, of source->st_size bytes
+ * @return a pointer to the index, or NULL if there is no valid index file
+ */
+struct gzindex *load_gzindex(const char *path, const struct stat *source,
+    const unsigned char *in)
+{
+    int fd;
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return NULL;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct header))
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    const struct header *header = base;
+    size_t length = (size_t)st.st_size;
+    if (header->magic != GZINDEX_MAGIC || header->layout != GZINDEX_LAYOUT ||
+        header->source_size != (uint64_t)source->st_size ||
+        header->source_mtime != (int64_t)source->st_mtime ||
+        header->source_trailer != read_trailer(in, source->st_size) ||
+        header->count == 0 || header->count > INT32_MAX ||
+        length != sizeof(struct header) +
+            header->count * (sizeof(struct checkpoint) + WINDOW)) {
+        munmap(base, length);
+        return NULL;
+    }
+
+    struct gzindex *index;
+    if ((index = calloc(1, sizeof(struct gzindex))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    index->base = base;
+    index->length = length;
+    index->count = (int)header->count;
+    index->total = header->total;
+    index->trailer = header->source_trailer;
+    index->checkpoints =
+        (struct checkpoint *)((char *)base + sizeof(struct header));
+    index->windows = (unsigned char *)(index->checkpoints + index->count);
+    return index;
+}
+
+/**
+ * Writes a gzip index to an index file.
+ *
+ * The index is written to a temporary file that is renamed into place, so
+ * other processes never see a partial index. Index files are a cache, so
+ * failure is silently ignored.
+ *
+ * @param index a pointer to the index
+ * @param path the path to the index file
+ * @param source the status of the compressed file
+ */
+void save_gzindex(const struct gzindex *index, const char *path,
+    const struct stat *source)
+{
+    struct header header = {
+        .magic = GZINDEX_MAGIC,
+        .layout = GZINDEX_LAYOUT,
+        .source_size = (uint64_t)source->st_size,
+        .source_mtime = (int64_t)source->st_mtime,
+        .source_trailer = index->trailer,
+        .total = index->total,
+        .count = (uint64_t)index->count
+    };
+
+    char *tmp;
+    size_t n = strlen(path) + 32;
+    if ((tmp = malloc(n)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(tmp, n, "%s.%ld", path, (long)getpid());
+
+    size_t count = (size_t)index->count;
+    FILE *f;
+    if ((f = fopen(tmp, "wb")) != NULL) {
+        bool ok =
+            fwrite(&header, sizeof header, 1, f) == 1 &&
+            fwrite(index->checkpoints, sizeof(struct checkpoint), count, f)
+                == count &&
+            fwrite(index->windows, WINDOW, count, f) == count;
+        if (fclose(f) != 0 || !ok || rename(tmp, path) != 0)
+            unlink(tmp);
+    }
+    free(tmp);
+}
+
+/**
+ * Releases a gzip index.
+ *
+ * @param index a pointer to the index (may be NULL)
+ */
+void destroy_gzindex(struct gzindex *index)
+{
+    if (index == NULL)
+        return;
+    if (index->base != NULL) {
+        munmap(index->base, index->length);
+    } else {
+        free(index->checkpoints);
+        free(index->windows);
+    }
+    free(index);
+}
+
+/**
+ * Returns the number of segments in a gzip index.
+ *
+ * @param index a pointer to the index
+ * @return the number of segments
+ */
+int gzindex_segments(const struct gzindex *index)
+{
+    return index->count;
+}
+
+/**
+ * Returns the offset of a segment in the uncompressed data.
+ *
+ * @param index a pointer to the index
+ * @param segment the segment, or the number of segments for the end
+ * @return the offset
+ */
+size_t gzindex_offset(const struct gzindex *index, int segment)
+{
+    assert(segment >= 0 && segment <= index->count);
+    if (segment == index->count)
+        return index->total;
+    return (size_t)index->checkpoints[segment].out;
+}
+
+/**
+ * Returns the summary of a segment.
+ *
+ * The summary may only be modified in an index that has been built, not
+ * one that has been loaded.
+ *
+ * @param index a pointer to the index
+ * @param segment the segment
+ * @return a pointer to the summary
+ */
+struct summary *gzindex_summary(struct gzindex *index, int segment)
+{
+    assert(segment >= 0 && segment < index->count);
+    return &index->checkpoints[segment].summary;
+}
+
+/**
+ * Inflates one segment of a gzip file.
+ *
+ * Inflating resumes from the segment's checkpoint, priming the inflater
+ * with the bits of the block that start in the previous byte and with the
+ * window, so segments can be inflated independently and concurrently.
+ *
+ * @param index a pointer to the index
+ * @param in the compressed file
+ * @param size the size of the compressed file
+ * @param segment the segment
+ * @param out the buffer for the whole of the uncompressed data
+ * @return true if the segment was inflated
+ */
+bool inflate_segment(const struct gzindex *index, const unsigned char *in,
+    size_t size, int segment, char *out)
+{
+    const struct checkpoint *c = &index->checkpoints[segment];
+    size_t end = gzindex_offset(index, segment + 1);
+    if (c->in > size || (c->bits > 0 && c->in == 0))
+        return false;
+
+    z_stream strm;
+    memset(&strm, 0, sizeof strm);
+    if (inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+        return false;
+
+    int ret = Z_OK;
+    if (c->bits > 0)
+        ret = inflatePrime(&strm, (int)c->bits,
+            in[c->in - 1] >> (8 - c->bits));
+    if (ret == Z_OK && c->window > 0)
+        ret = inflateSetDictionary(&strm,
+            &index->windows[(size_t)segment * WINDOW], c->window);
+
+    strm.next_in = (unsigned char *)in + c->in;
+    strm.avail_in = (uInt)(size - c->in);
+    strm.next_out = (unsigned char *)out + c->out;
+    strm.avail_out = (uInt)(end - c->out);
+    while (ret == Z_OK && strm.avail_out > 0)
+        ret = inflate(&strm, Z_NO_FLUSH);
+    inflateEnd(&strm);
+    return strm.avail_out == 0 && (ret == Z_OK || ret == Z_STREAM_END);
+}
@@ -0,0 +1,56 @@
+/**
+ * @file gzindex.h
+ *
+ * Random access checkpoints into gzip files.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef gzindex_h
+#define gzindex_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Summary of the records that start in a segment of a data file.
+ */
+struct summary {
+    uint64_t types;     ///< Bit set of record types (bit n for type n < 64)
+    double min_lat;     ///< Minimum latitude
+    double max_lat;     ///< Maximum latitude
+    double min_lon;     ///< Minimum longitude
+    double max_lon;     ///< Maximum longitude
+};
+
+struct gzindex;
+struct stat;
+
+struct gzindex *build_gzindex(const unsigned char *in, size_t size,
+    size_t span, char **out, size_t *total);
+struct gzindex *load_gzindex(const char *path, const struct stat *source,
+    const unsigned char *in);
+void save_gzindex(const struct gzindex *index, const char *path,
+    const struct stat *source);
+void destroy_gzindex(struct gzindex *index);
+int gzindex_segments(const struct gzindex *index);
+size_t gzindex_offset(const struct gzindex *index, int segment);
+struct summary *gzindex_summary(struct gzindex *index, int segment);
+bool inflate_segment(const struct gzindex *index, const unsigned char *in,
+    size_t size, int segment, char *out);
+
+#endif
@@ -0,0 +1,180 @@
+/**
+ * @file heap.c
+ *
+ * Bounded heap for selecting the best search results.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "heap.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Comparison function used by qsort when draining an unbounded heap.
+ */
+static comparator sort_compare;
+
+/**
+ * Adapts the heap comparison function to qsort.
+ *
+ * @param a pointer to the first candidate
+ * @param b pointer to the second candidate
+ * @return an integer less than, equal to or greater than zero
+ */
+static int qsort_compare(const void *a, const void *b)
+{
+    return sort_compare(a, b);
+}
+
+/**
+ * Initializes an empty heap.
+ *
+ * @param heap a pointer to a heap structure
+ * @param limit the maximum number of candidates to keep, 0 for all
+ * @param compare the comparison function, ordering best first
+ */
+void init_heap(struct heap *heap, int limit, comparator compare)
+{
+    assert(heap != NULL && limit >= 0 && compare != NULL);
+    heap->items = NULL;
+    heap->count = heap->capacity = 0;
+    heap->limit = limit;
+    heap->compare = compare;
+}
+
+/**
+ * Swaps two candidates.
+ *
+ * @param a pointer to the first candidate
+ * @param b pointer to the second candidate
+ */
+static void swap(struct candidate *a, struct candidate *b)
+{
+    struct candidate t = *a;
+    *a = *b;
+    *b = t;
+}
+
+/**
+ * Restores heap order downwards from a node, worst candidate at the root.
+ *
+ * @param heap a pointer to a heap structure
+ * @param i the index of the node
+ * @param n the number of nodes in the heap
+ */
+static void sift_down(struct heap *heap, int i, int n)
+{
+    for (;;) {
+        int worst = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && heap->compare(&heap->items[l], &heap->items[worst]) > 0)
+            worst = l;
+        if (r < n && heap->compare(&heap->items[r], &heap->items[worst]) > 0)
+            worst = r;
+        if (worst == i)
+            return;
+        swap(&heap->items[i], &heap->items[worst]);
+        i = worst;
+    }
+}
+
+/**
+ * Restores heap order upwards from a node, worst candidate at the root.
+ *
+ * @param heap a pointer to a heap structure
+ * @param i the index of the node
+ */
+static void sift_up(struct heap *heap, int i)
+{
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap->compare(&heap->items[i], &heap->items[parent]) <= 0)
+            return;
+        swap(&heap->items[i], &heap->items[parent]);
+        i = parent;
+    }
+}
+
+/**
+ * Offers a candidate to a heap.
+ *
+ * @param heap a pointer to a heap structure
+ * @param candidate the candidate, which is copied into the heap
+ * @return true if the candidate was kept
+ */
+bool offer(struct heap *heap, const struct candidate *candidate)
+{
+    if (heap->limit > 0 && heap->count == heap->limit) {
+        if (heap->compare(candidate, &heap->items[0]) >= 0)
+            return false;
+        heap->items[0] = *candidate;
+        sift_down(heap, 0, heap->count);
+        return true;
+    }
+    if (heap->count == heap->capacity) {
+        heap->capacity = heap->capacity ? heap->capacity * 2 : 64;
+        if (heap->limit > 0 && heap->capacity > heap->limit)
+            heap->capacity = heap->limit;
+        size_t size = heap->capacity * sizeof(struct candidate);
+        if ((heap->items = realloc(heap->items, size)) == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    heap->items[heap->count] = *candidate;
+    if (heap->limit > 0)
+        sift_up(heap, heap->count);
+    ++heap->count;
+    return true;
+}
+
+/**
+ * Sorts the candidates in a heap, best first.
+ *
+ * After draining, the items array holds the candidates in order and can
+ * no longer be used as a heap.
+ *
+ * @param heap a pointer to a heap structure
+ * @return the number of candidates
+ */
+int drain(struct heap *heap)
+{
+    if (heap->limit == 0) {
+        sort_compare = heap->compare;
+        qsort(heap->items, heap->count, sizeof(struct candidate),
+            qsort_compare);
+        return heap->count;
+    }
+    for (int n = heap->count - 1; n > 0; --n) {
+        swap(&heap->items[0], &heap->items[n]);
+        sift_down(heap, 0, n);
+    }
+    return heap->count;
+}
+
+/**
+ * Frees the storage held by a heap.
+ *
+ * @param heap a pointer to a heap structure
+ */
+void free_heap(struct heap *heap)
+{
+    free(heap->items);
+    heap->items = NULL;
+    heap->count = heap->capacity = 0;
+}
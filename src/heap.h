@@ -0,0 +1,64 @@
+/**
+ * @file heap.h
+ *
+ * Bounded heap for selecting the best search results.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef heap_h
+#define heap_h
+
+#include <stdbool.h>
+
+struct navaid;
+
+/**
+ * Candidate search result.
+ */
+struct candidate {
+    const struct navaid *navaid;    ///< The matching navaid
+    int position;                   ///< Position of the navaid in the cache
+    double value;                   ///< Sort value, lowest first
+};
+
+/**
+ * Comparison function for candidates, ordering best first.
+ */
+typedef int (*comparator)(const struct candidate *, const struct candidate *);
+
+/**
+ * Heap structure.
+ *
+ * With a limit, the heap keeps the best candidates seen so far with the
+ * worst of them at the root, so each new candidate is compared with the
+ * root and most are rejected in constant time. Without a limit, every
+ * candidate is kept and sorted when the heap is drained.
+ */
+struct heap {
+    struct candidate *items;    ///< Candidates
+    int count;                  ///< Number of candidates held
+    int capacity;               ///< Allocated size of the items array
+    int limit;                  ///< Maximum number of candidates, 0 for all
+    comparator compare;         ///< Comparison function
+};
+
+void init_heap(struct heap *heap, int limit, comparator compare);
+bool offer(struct heap *heap, const struct candidate *candidate);
+int drain(struct heap *heap);
+void free_heap(struct heap *heap);
+
+#endif
@@ -0,0 +1,632 @@
+/**
+ * @file index.c
+ *
+ * Sorted index of navaid codes and ICAO airport codes.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "index.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "types.h"
+#include "util.h"
+
+/**
+ * Number of rows of one degree cells, from the south pole.
+ */
+#define CELL_ROWS 180
+
+/**
+ * Number of columns of one degree cells, from the antimeridian.
+ */
+#define CELL_COLUMNS 360
+
+/**
+ * Number of frequency bands per unit of frequency (MHz or kHz for NDB).
+ */
+#define BANDS_PER_UNIT 20
+
+/**
+ * Number of frequency bands, with the last holding frequencies above it.
+ */
+#define BANDS (2000 * BANDS_PER_UNIT)
+
+/**
+ * Index entry.
+ *
+ * Entries are sorted by key, then by position, so that entries with the
+ * same key appear in the order of the navigation data file.
+ */
+struct entry {
+    const char *key;    ///< Navaid code or ICAO code
+    int position;       ///< Position of the navaid in the cache
+};
+
+/**
+ * Sorted key array.
+ */
+struct keys {
+    struct entry *entries;  ///< Entries sorted by key
+    size_t count;           ///< Number of entries
+    size_t distinct;        ///< Number of distinct keys
+};
+
+/**
+ * Positions grouped into buckets, such as cells or frequency bands.
+ *
+ * The offsets are running totals of the number of navaids in each bucket,
+ * so they are both the statistics used to estimate how many navaids lie in
+ * a range of buckets and the means of finding them.
+ */
+struct buckets {
+    int *first;     ///< Offset of each bucket's positions, then the total
+    int *positions; ///< Positions by bucket, in data file order in each
+};
+
+/**
+ * Index structure.
+ *
+ * Codes and ICAO codes are held in separate sorted arrays so that a search
+ * term can be resolved with a range lookup in each, rather than a scan of
+ * the whole cache. Positions are also grouped by one degree cell and by
+ * frequency band, so that filters on position or frequency can be
+ * resolved without a scan.
+ */
+struct index {
+    struct keys codes;          ///< Navaid codes
+    struct keys icaos;          ///< Airport ICAO codes (ILS/LOC/DME only)
+    struct buckets cells;       ///< Positions by one degree cell
+    struct buckets bands;       ///< Positions by frequency band
+};
+
+/**
+ * Compares index entries for sorting.
+ *
+ * @param a pointer to the first entry
+ * @param b pointer to the second entry
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_entries(const void *a, const void *b)
+{
+    const struct entry *x = a, *y = b;
+    int c = strncmp(x->key, y->key, CODE_MAX);
+    return c != 0 ? c : x->position - y->position;
+}
+
+/**
+ * Compares integers for sorting.
+ *
+ * @param a pointer to the first integer
+ * @param b pointer to the second integer
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_positions(const void *a, const void *b)
+{
+    const int *x = a, *y = b;
+    return *x - *y;
+}
+
+/**
+ * Allocates an array of index entries.
+ *
+ * @param n the number of entries
+ * @return a pointer to the entries (never returns NULL)
+ */
+static struct entry *create_entries(size_t n)
+{
+    struct entry *e;
+    if ((e = malloc((n > 0 ? n : 1) * sizeof(struct entry))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return e;
+}
+
+/**
+ * Returns the cell row or column of a coordinate in degrees.
+ *
+ * @param degrees the latitude or longitude
+ * @param offset the offset of the first cell, 90 or 180
+ * @param cells the number of cells
+ * @return the row or column, clamped to the cells
+ */
+static int cell_of(double degrees, int offset, int cells)
+{
+    double k = floor(degrees + offset);
+    return k < 0 ? 0 : k >= cells ? cells - 1 : (int)k;
+}
+
+/**
+ * Returns the frequency band of a frequency.
+ *
+ * @param frequency the frequency
+ * @return the band, clamped to the bands
+ */
+static int band_of(double frequency)
+{
+    double k = floor(frequency * BANDS_PER_UNIT);
+    return k < 0 ? 0 : k >= BANDS ? BANDS - 1 : (int)k;
+}
+
+/**
+ * Groups positions into buckets with a counting sort.
+ *
+ * @param b the buckets to initialize
+ * @param buckets the number of buckets
+ * @param keys the bucket of each position
+ * @param n the number of positions
+ */
+static void init_buckets(struct buckets *b, int buckets, const int *keys,
+    size_t n)
+{
+    if ((b->first = calloc(buckets + 1, sizeof(int))) == NULL
+        || (b->positions = malloc((n > 0 ? n : 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n; ++i)
+        ++b->first[keys[i] + 1];
+    for (int k = 0; k < buckets; ++k)
+        b->first[k + 1] += b->first[k];
+    for (size_t i = 0; i < n; ++i)
+        b->positions[b->first[keys[i]]++] = (int)i;
+    memmove(b->first + 1, b->first, buckets * sizeof(int));
+    b->first[0] = 0;
+}
+
+/**
+ * Checks if a filter bounds a field, so that buckets of it can be used.
+ *
+ * @param filter the filter (may be NULL)
+ * @param field the name of the field
+ * @return true if the field is bounded
+ */
+static bool bounds_field(const struct filter *filter, const char *field)
+{
+    double min, max;
+    return filter != NULL && filter_bounds(filter, field, &min, &max);
+}
+
+/**
+ * Counts the distinct keys in a sorted key array.
+ *
+ * @param keys the sorted keys
+ */
+static void count_distinct(struct keys *keys)
+{
+    keys->distinct = 0;
+    for (size_t i = 0; i < keys->count; ++i)
+        if (i == 0 || strncmp(keys->entries[i - 1].key,
+            keys->entries[i].key, CODE_MAX) != 0)
+            ++keys->distinct;
+}
+
+/**
+ * Creates an index over the codes and ICAO codes in a navaid cache.
+ *
+ * Statistics of the codes are gathered as the index is created. Navaids
+ * are also grouped by cell and by frequency band, if the filter bounds
+ * their position or frequency, because otherwise the groups cannot be
+ * used (see choose_strategy).
+ *
+ * The index refers to navaids by their position in the cache, so the cache
+ * must outlive the index. The pointer returned from this function must be
+ * destroyed after use with destroy_index.
+ *
+ * @param cache an array of pointers to navaid structures, terminated by NULL
+ * @param filter the filter of the searches (may be NULL)
+ * @return a pointer to an index (never returns NULL)
+ */
+struct index *create_index(struct navaid **cache, const struct filter *filter)
+{
+    assert(cache != NULL);
+
+    size_t n = 0;
+    while (cache[n] != NULL)
+        ++n;
+
+    struct index *index;
+    if ((index = malloc(sizeof(struct index))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    index->codes.entries = create_entries(n);
+    index->icaos.entries = create_entries(n);
+    index->codes.count = index->icaos.count = 0;
+
+    bool celled = bounds_field(filter, "lat") || bounds_field(filter, "lon");
+    bool banded = bounds_field(filter, "freq");
+    int *cells = NULL, *bands = NULL;
+    if ((celled && (cells = malloc((n + 1) * sizeof(int))) == NULL)
+        || (banded && (bands = malloc((n + 1) * sizeof(int))) == NULL)) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        struct entry e = { cache[i]->code, (int)i };
+        index->codes.entries[index->codes.count++] = e;
+        if (cache[i]->icao != NULL) {
+            e.key = cache[i]->icao;
+            index->icaos.entries[index->icaos.count++] = e;
+        }
+        const struct coordinate *c = &cache[i]->coordinate;
+        if (celled)
+            cells[i] = cell_of(c->lat, 90, CELL_ROWS) * CELL_COLUMNS
+                + cell_of(c->lon, 180, CELL_COLUMNS);
+        if (banded)
+            bands[i] = band_of(cache[i]->frequency);
+    }
+    qsort(index->codes.entries, index->codes.count,
+        sizeof(struct entry), compare_entries);
+    qsort(index->icaos.entries, index->icaos.count,
+        sizeof(struct entry), compare_entries);
+    count_distinct(&index->codes);
+    count_distinct(&index->icaos);
+
+    index->cells.first = index->cells.positions = NULL;
+    index->bands.first = index->bands.positions = NULL;
+    if (celled)
+        init_buckets(&index->cells, CELL_ROWS * CELL_COLUMNS, cells, n);
+    if (banded)
+        init_buckets(&index->bands, BANDS, bands, n);
+    free(cells);
+    free(bands);
+
+    return index;
+}
+
+/**
+ * Destroys an index.
+ *
+ * @param index a pointer to an index
+ */
+void destroy_index(struct index *index)
+{
+    if (index != NULL) {
+        free(index->codes.entries);
+        free(index->icaos.entries);
+        free(index->cells.first);
+        free(index->cells.positions);
+        free(index->bands.first);
+        free(index->bands.positions);
+    }
+    free(index);
+}
+
+/**
+ * Finds the first entry whose key is not less than a prefix.
+ *
+ * @param keys the sorted keys
+ * @param prefix the prefix
+ * @param n the length of the prefix
+ * @return the index of the first entry not less than the prefix
+ */
+static size_t lower_bound(const struct keys *keys, const char *prefix,
+    size_t n)
+{
+    size_t lo = 0, hi = keys->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(keys->entries[mid].key, prefix, n) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Finds the first entry after a range of keys that start with a prefix.
+ *
+ * @param keys the sorted keys
+ * @param prefix the prefix
+ * @param n the length of the prefix
+ * @return the index of the first entry greater than all keys with the prefix
+ */
+static size_t upper_bound(const struct keys *keys, const char *prefix,
+    size_t n)
+{
+    size_t lo = 0, hi = keys->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(keys->entries[mid].key, prefix, n) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Collects the positions of entries in a key range that match a pattern.
+ *
+ * Entries with the same key are in data file order, so for a pattern
+ * without wildcards only the first limit entries can be among the first
+ * limit results and the rest of the range is skipped.
+ *
+ * @param keys the sorted keys
+ * @param pattern the search pattern, possibly including wildcards
+ * @param limit the number of results required, 0 for all
+ * @param positions the array to receive positions
+ * @param n the number of positions already in the array
+ * @param examined incremented by the number of entries examined
+ * @return the number of positions in the array after collection
+ */
+static size_t collect(const struct keys *keys, const char *pattern,
+    int limit, int *positions, size_t n, long *examined)
+{
+    size_t prefix = glob_prefix(pattern);
+    bool exact = pattern[prefix] == '\0';
+
+    size_t lo = lower_bound(keys, pattern, prefix);
+    size_t hi = exact ? lo : upper_bound(keys, pattern, prefix);
+    if (exact)
+        while (hi < keys->count &&
+            strncmp(keys->entries[hi].key, pattern, CODE_MAX) == 0 &&
+            (limit == 0 || hi - lo < (size_t)limit))
+            ++hi;
+
+    *examined += hi - lo;
+    for (size_t i = lo; i < hi; ++i)
+        if (exact || glob(pattern, keys->entries[i].key))
+            positions[n++] = keys->entries[i].position;
+    return n;
+}
+
+/**
+ * Looks up navaids whose code or ICAO code matches a pattern.
+ *
+ * The pattern may contain the wildcards '*' (any sequence of characters)
+ * and '?' (any single character). The literal prefix of the pattern, up to
+ * the first wildcard, is resolved with a range lookup on the sorted keys.
+ * Only entries in that range are tested against the full pattern.
+ *
+ * Positions are returned in ascending order, i.e. navigation data file
+ * order, with duplicates removed. If a limit is given, at least the first
+ * limit positions are returned, but there may be more. The array returned
+ * through positions must be freed after use.
+ *
+ * @param index a pointer to an index
+ * @param pattern the search pattern, in uppercase
+ * @param limit the number of results required, 0 for all
+ * @param positions receives an array of cache positions
+ * @param examined receives the number of index entries examined
+ * @return the number of matching navaids
+ */
+int lookup(const struct index *index, const char *pattern, int limit,
+    int **positions, long *examined)
+{
+    assert(index != NULL && pattern != NULL && positions != NULL);
+
+    size_t max = index->codes.count + index->icaos.count;
+    if ((*positions = malloc((max > 0 ? max : 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    *examined = 0;
+    size_t n = collect(&index->codes, pattern, limit, *positions, 0,
+        examined);
+    n = collect(&index->icaos, pattern, limit, *positions, n, examined);
+    qsort(*positions, n, sizeof(int), compare_positions);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (unique == 0 || (*positions)[unique - 1] != (*positions)[i])
+            (*positions)[unique++] = (*positions)[i];
+    return (int)unique;
+}
+
+/**
+ * Returns the number of navaids in an index.
+ *
+ * @param index a pointer to an index
+ * @return the number of navaids
+ */
+int index_size(const struct index *index)
+{
+    return (int)index->codes.count;
+}
+
+/**
+ * Estimates the number of entries examined by a lookup.
+ *
+ * An exact code is estimated from the average number of entries that
+ * share a key. A pattern is estimated from the range of keys that start
+ * with its literal prefix, found with the same binary search as a lookup.
+ *
+ * @param index a pointer to an index
+ * @param pattern the search pattern, in uppercase
+ * @return the estimated number of entries examined
+ */
+double estimate_lookup(const struct index *index, const char *pattern)
+{
+    const struct keys *keys[] = { &index->codes, &index->icaos };
+    size_t prefix = glob_prefix(pattern);
+    double estimate = 0;
+    for (int k = 0; k < 2; ++k) {
+        if (keys[k]->distinct == 0)
+            continue;
+        if (pattern[prefix] == '\0')
+            estimate += (double)keys[k]->count / keys[k]->distinct;
+        else
+            estimate += upper_bound(keys[k], pattern, prefix)
+                - lower_bound(keys[k], pattern, prefix);
+    }
+    return estimate;
+}
+
+/**
+ * Finds the rows and columns of the cells that intersect bounds.
+ *
+ * @param bounds the bounds, unbounded sides are infinite
+ * @param rows receives the first and last row
+ * @param columns receives the first and last column
+ * @return false if the bounds are empty
+ */
+static bool cell_range(const struct bounds *bounds, int rows[2],
+    int columns[2])
+{
+    if (bounds->min.lat > bounds->max.lat || bounds->min.lon > bounds->max.lon)
+        return false;
+    rows[0] = cell_of(bounds->min.lat, 90, CELL_ROWS);
+    rows[1] = cell_of(bounds->max.lat, 90, CELL_ROWS);
+    columns[0] = cell_of(bounds->min.lon, 180, CELL_COLUMNS);
+    columns[1] = cell_of(bounds->max.lon, 180, CELL_COLUMNS);
+    return true;
+}
+
+/**
+ * Finds the frequency bands that intersect a range of frequencies.
+ *
+ * @param min the lowest frequency
+ * @param max the highest frequency
+ * @param bands receives the first and last band
+ * @return false if the range is empty
+ */
+static bool band_range(double min, double max, int bands[2])
+{
+    if (min > max)
+        return false;
+    bands[0] = band_of(min);
+    bands[1] = band_of(max);
+    return true;
+}
+
+/**
+ * Counts the navaids in the cells that intersect bounds.
+ *
+ * The count is found from the number of navaids in each cell, without
+ * visiting them.
+ *
+ * @param index a pointer to an index
+ * @param bounds the bounds, unbounded sides are infinite
+ * @return the number of navaids in the cells
+ */
+int count_cells(const struct index *index, const struct bounds *bounds)
+{
+    assert(index->cells.first != NULL);
+    int rows[2], columns[2], n = 0;
+    if (!cell_range(bounds, rows, columns))
+        return 0;
+    const int *first = index->cells.first;
+    for (int r = rows[0]; r <= rows[1]; ++r)
+        n += first[r * CELL_COLUMNS + columns[1] + 1]
+            - first[r * CELL_COLUMNS + columns[0]];
+    return n;
+}
+
+/**
+ * Counts the navaids in the frequency bands that intersect a range.
+ *
+ * The count is found from the histogram of frequencies, without visiting
+ * the navaids.
+ *
+ * @param index a pointer to an index
+ * @param min the lowest frequency
+ * @param max the highest frequency
+ * @return the number of navaids in the bands
+ */
+int count_bands(const struct index *index, double min, double max)
+{
+    assert(index->bands.first != NULL);
+    int bands[2];
+    if (!band_range(min, max, bands))
+        return 0;
+    return index->bands.first[bands[1] + 1] - index->bands.first[bands[0]];
+}
+
+/**
+ * Allocates an array for the positions found by a lookup.
+ *
+ * @param n the number of positions
+ * @return a pointer to the array (never returns NULL)
+ */
+static int *create_positions(int n)
+{
+    int *positions;
+    if ((positions = malloc((n > 0 ? n : 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return positions;
+}
+
+/**
+ * Looks up the navaids in the cells that intersect bounds.
+ *
+ * Positions are returned in ascending order, i.e. navigation data file
+ * order. Navaids near the bounds may be outside them, so the caller must
+ * test each navaid. The array returned through positions must be freed
+ * after use.
+ *
+ * @param index a pointer to an index
+ * @param bounds the bounds, unbounded sides are infinite
+ * @param positions receives an array of cache positions
+ * @return the number of positions
+ */
+int lookup_cells(const struct index *index, const struct bounds *bounds,
+    int **positions)
+{
+    int rows[2], columns[2], n = 0;
+    *positions = create_positions(count_cells(index, bounds));
+    if (!cell_range(bounds, rows, columns))
+        return 0;
+    const struct buckets *b = &index->cells;
+    for (int r = rows[0]; r <= rows[1]; ++r) {
+        int lo = b->first[r * CELL_COLUMNS + columns[0]];
+        int hi = b->first[r * CELL_COLUMNS + columns[1] + 1];
+        memcpy(*positions + n, b->positions + lo, (hi - lo) * sizeof(int));
+        n += hi - lo;
+    }
+    qsort(*positions, n, sizeof(int), compare_positions);
+    return n;
+}
+
+/**
+ * Looks up the navaids in the frequency bands that intersect a range.
+ *
+ * Positions are returned in ascending order, i.e. navigation data file
+ * order. Navaids in the first and last band may be outside the range, so
+ * the caller must test each navaid. The array returned through positions
+ * must be freed after use.
+ *
+ * @param index a pointer to an index
+ * @param min the lowest frequency
+ * @param max the highest frequency
+ * @param positions receives an array of cache positions
+ * @return the number of positions
+ */
+int lookup_bands(const struct index *index, double min, double max,
+    int **positions)
+{
+    int bands[2], n = count_bands(index, min, max);
+    *positions = create_positions(n);
+    if (!band_range(min, max, bands))
+        return 0;
+    const struct buckets *b = &index->bands;
+    memcpy(*positions, b->positions + b->first[bands[0]], n * sizeof(int));
+    qsort(*positions, n, sizeof(int), compare_positions);
+    return n;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file index.h
+ *
+ * Sorted index of navaid codes and ICAO airport codes.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef index_h
+#define index_h
+
+struct bounds;
+struct filter;
+struct index;
+struct navaid;
+
+int count_bands(const struct index *index, double min, double max);
+int count_cells(const struct index *index, const struct bounds *bounds);
+struct index *create_index(struct navaid **cache, const struct filter *filter);
+void destroy_index(struct index *index);
+double estimate_lookup(const struct index *index, const char *pattern);
+int index_size(const struct index *index);
+int lookup(const struct index *index, const char *pattern, int limit,
+    int **positions, long *examined);
+int lookup_bands(const struct index *index, double min, double max,
+    int **positions);
+int lookup_cells(const struct index *index, const struct bounds *bounds,
+    int **positions);
+
+#endif
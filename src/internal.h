@@ -0,0 +1,39 @@
+/**
+ * @file internal.h
+ *
+ * Internal kernels of the library, declared for the benchmarks.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef internal_h
+#define internal_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+
+struct pool;
+
+bool describe(const struct navaid *navaid);
+char *format_coordinate(const struct coordinate c);
+bool match(const char *term, const struct navaid *navaid);
+int preprocess(char *s, char *end);
+int scan(struct navaid **cache, struct pool *pool,
+    const uint64_t *selection, const char *term, int limit, int **positions);
+
+#endif
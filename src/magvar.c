@@ -0,0 +1,572 @@
+/**
+ * @file magvar.c
+ *
+ * Magnetic variation from the World Magnetic Model.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "magvar.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "types.h"
+#include "util.h"
+
+#ifndef M_PI
+/// @cond Doxygen_Suppress
+#define M_PI 3.14159265358979323846
+/// @endcond
+#endif
+
+/**
+ * Maximum degree of the spherical harmonic model (12 for the WMM).
+ */
+#define MAX_DEGREE 12
+
+/**
+ * Spacing of the declination grid in degrees.
+ */
+#define GRID_STEP 0.5
+
+/**
+ * Number of rows (latitudes) in the declination grid.
+ */
+#define GRID_ROWS ((int)(180 / GRID_STEP) + 1)
+
+/**
+ * Number of columns (longitudes) in the declination grid.
+ */
+#define GRID_COLS ((int)(360 / GRID_STEP) + 1)
+
+/**
+ * Latitude of the first and last rows of the grid, just short of the poles,
+ * where declination depends on the direction of approach.
+ */
+#define GRID_POLE 89.999
+
+/**
+ * Magic number identifying a declination grid file ("NVSM").
+ */
+#define GRID_MAGIC 0x4d53564eU
+
+/**
+ * Version of the declination grid file layout.
+ */
+#define GRID_LAYOUT 1
+
+/**
+ * Maximum size of the name of a declination grid file.
+ */
+#define GRID_NAME_SIZE 64
+
+/**
+ * Maximum length of a line in a coefficient file.
+ */
+#define LINE_MAX_LENGTH 256
+
+/**
+ * Geomagnetic reference radius in km.
+ */
+#define REFERENCE_RADIUS 6371.2
+
+/**
+ * WGS84 semi-major axis in km.
+ */
+#define WGS84_A 6378.137
+
+/**
+ * WGS84 flattening.
+ */
+#define WGS84_F (1 / 298.257223563)
+
+/**
+ * Degrees to radians.
+ */
+#define RADIANS (M_PI / 180)
+
+/**
+ * Gauss coefficients of the main field, for one date.
+ */
+struct model {
+    int degree;                                     ///< Maximum degree
+    double g[MAX_DEGREE + 1][MAX_DEGREE + 1];       ///< g coefficients (nT)
+    double h[MAX_DEGREE + 1][MAX_DEGREE + 1];       ///< h coefficients (nT)
+};
+
+/**
+ * Sines and cosines of multiples of a longitude.
+ */
+struct column {
+    double cm[MAX_DEGREE + 1];  ///< cos(m * lon)
+    double sm[MAX_DEGREE + 1];  ///< sin(m * lon)
+};
+
+/**
+ * Horizontal component of the magnetic field at a grid point.
+ *
+ * The components are interpolated rather than the declination, because
+ * they vary smoothly even close to the magnetic poles, where declination
+ * turns through 180 degrees in a short distance.
+ */
+struct point {
+    float north;    ///< Northward component (nT)
+    float east;     ///< Eastward component (nT)
+};
+
+/**
+ * Declination grid file header.
+ *
+ * The header is followed by the grid points, by rows from south to north,
+ * each from west to east.
+ */
+struct header {
+    uint32_t magic;             ///< GRID_MAGIC
+    uint32_t layout;            ///< GRID_LAYOUT
+    uint64_t source_size;       ///< Size of the coefficient file
+    int64_t source_mtime;       ///< Modification time of the coefficient file
+    int64_t day;                ///< Day of the grid, in days since 1970
+    uint32_t rows;              ///< Number of rows
+    uint32_t cols;              ///< Number of columns
+};
+
+/**
+ * Magnetic variation model.
+ *
+ * Declination is interpolated from a grid for the current date, which is
+ * either mapped from a grid file or built in memory.
+ */
+struct magvar {
+    void *base;             ///< Mapped grid file (NULL if built)
+    size_t length;          ///< Size of the mapping
+    struct point *grid;     ///< Horizontal field at each grid point
+};
+
+/**
+ * Reads a World Magnetic Model coefficient file (WMM.COF) and computes the
+ * coefficients for a date.
+ *
+ * Prints a message to standard error and exits with failure status if the
+ * file cannot be read or is malformed.
+ *
+ * @param path the path to the coefficient file
+ * @param year the date as a decimal year
+ * @param model receives the coefficients
+ */
+static void read_model(const char *path, double year, struct model *model)
+{
+    FILE *f;
+    if ((f = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(model, 0, sizeof(struct model));
+    char line[LINE_MAX_LENGTH];
+    double epoch;
+    if (fgets(line, sizeof line, f) == NULL ||
+        sscanf(line, "%lf", &epoch) != 1) {
+        fprintf(stderr, "Malformed magnetic model header in %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    double dt = year - epoch;
+    while (fgets(line, sizeof line, f) != NULL) {
+        int n, m;
+        double g, h, dg, dh;
+        if (strncmp(line, "9999", 4) == 0)
+            break;
+        if (sscanf(line, "%d %d %lf %lf %lf %lf", &n, &m, &g, &h, &dg, &dh)
+            != 6 || n < 1 || n > MAX_DEGREE || m < 0 || m > n) {
+            fprintf(stderr, "Malformed magnetic model coefficients in %s:\n%s",
+                path, line);
+            exit(EXIT_FAILURE);
+        }
+        model->g[n][m] = g + dt * dg;
+        model->h[n][m] = h + dt * dh;
+        if (n > model->degree)
+            model->degree = n;
+    }
+    fclose(f);
+
+    if (model->degree == 0) {
+        fprintf(stderr, "No magnetic model coefficients in %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Computes the sines and cosines of multiples of a longitude.
+ *
+ * @param lon the longitude in degrees
+ * @param column receives the sines and cosines
+ */
+static void init_column(double lon, struct column *column)
+{
+    column->cm[0] = 1;
+    column->sm[0] = 0;
+    column->cm[1] = cos(lon * RADIANS);
+    column->sm[1] = sin(lon * RADIANS);
+    for (int m = 2; m <= MAX_DEGREE; ++m) {
+        column->cm[m] = column->cm[m - 1] * column->cm[1] -
+            column->sm[m - 1] * column->sm[1];
+        column->sm[m] = column->sm[m - 1] * column->cm[1] +
+            column->cm[m - 1] * column->sm[1];
+    }
+}
+
+/**
+ * Evaluates the horizontal field along a line of latitude.
+ *
+ * The geodetic latitude is converted to geocentric spherical coordinates
+ * at sea level and the Schmidt semi-normalized associated Legendre
+ * functions are computed once for the row. The field is then summed at
+ * each longitude and rotated back to the geodetic frame.
+ *
+ * @param model the coefficients
+ * @param lat the geodetic latitude in degrees
+ * @param columns the longitudes of the points
+ * @param count the number of points
+ * @param out receives the horizontal field at each point
+ */
+static void evaluate_row(const struct model *model, double lat,
+    const struct column *columns, int count, struct point *out)
+{
+    const double e2 = WGS84_F * (2 - WGS84_F);
+    double phi = lat * RADIANS;
+    double rc = WGS84_A / sqrt(1 - e2 * sin(phi) * sin(phi));
+    double p = rc * cos(phi), z = rc * (1 - e2) * sin(phi);
+    double r = sqrt(p * p + z * z);
+    double psi = asin(z / r);
+    double ct = sin(psi), st = cos(psi);
+
+    // Legendre functions and their derivatives with respect to colatitude,
+    // scaled by (a/r)^(n+2)
+    double P[MAX_DEGREE + 1][MAX_DEGREE + 1] = {{ 1 }};
+    double dP[MAX_DEGREE + 1][MAX_DEGREE + 1] = {{ 0 }};
+    for (int n = 1; n <= model->degree; ++n) {
+        for (int m = 0; m <= n; ++m) {
+            if (n == m) {
+                double k = n == 1 ? 1 : sqrt((2.0 * n - 1) / (2.0 * n));
+                P[n][n] = k * st * P[n - 1][n - 1];
+                dP[n][n] = k * (st * dP[n - 1][n - 1] +
+                    ct * P[n - 1][n - 1]);
+            } else {
+                double k = sqrt((double)n * n - m * m);
+                double j = n > m + 1 ? sqrt((n - 1.0) * (n - 1) - m * m) : 0;
+                double p2 = n > m + 1 ? P[n - 2][m] : 0;
+                double dp2 = n > m + 1 ? dP[n - 2][m] : 0;
+                P[n][m] = ((2 * n - 1) * ct * P[n - 1][m] - j * p2) / k;
+                dP[n][m] = ((2 * n - 1) * (ct * dP[n - 1][m] -
+                    st * P[n - 1][m]) - j * dp2) / k;
+            }
+        }
+    }
+    double scale = REFERENCE_RADIUS / r, f = scale * scale;
+    for (int n = 1; n <= model->degree; ++n) {
+        f *= scale;
+        for (int m = 0; m <= n; ++m) {
+            P[n][m] *= f;
+            dP[n][m] *= f;
+        }
+    }
+
+    double rotation = psi - phi;
+    for (int i = 0; i < count; ++i) {
+        const double *cm = columns[i].cm, *sm = columns[i].sm;
+        double x = 0, y = 0, down = 0;
+        for (int n = 1; n <= model->degree; ++n) {
+            for (int m = 0; m <= n; ++m) {
+                double t = model->g[n][m] * cm[m] + model->h[n][m] * sm[m];
+                double u = model->g[n][m] * sm[m] - model->h[n][m] * cm[m];
+                x += t * dP[n][m];
+                y += m * u * P[n][m];
+                down -= (n + 1) * t * P[n][m];
+            }
+        }
+        out[i].north = (float)(x * cos(rotation) - down * sin(rotation));
+        out[i].east = (float)(y / st);
+    }
+}
+
+/**
+ * Data shared by the tasks that build the declination grid.
+ */
+struct rows {
+    const struct model *model;      ///< Coefficients for the date of the grid
+    const struct column *columns;   ///< Longitudes of the grid columns
+    struct point *grid;             ///< Grid being built
+};
+
+/**
+ * Evaluates one row of the declination grid, as a thread pool task.
+ *
+ * @param task the index of the row
+ * @param worker the index of the worker (unused)
+ * @param data a pointer to the rows structure
+ */
+static void row_task(int task, int worker, void *data)
+{
+    (void)worker;
+    struct rows *rows = data;
+    double lat = -90 + task * GRID_STEP;
+    if (lat < -GRID_POLE) lat = -GRID_POLE;
+    if (lat > GRID_POLE) lat = GRID_POLE;
+    evaluate_row(rows->model, lat, rows->columns, GRID_COLS,
+        &rows->grid[(size_t)task * GRID_COLS]);
+}
+
+/**
+ * Returns the size of a declination grid in bytes.
+ *
+ * @return the size of the grid
+ */
+static size_t grid_size()
+{
+    return (size_t)GRID_ROWS * GRID_COLS * sizeof(struct point);
+}
+
+/**
+ * Maps a declination grid file, if it was built for the current coefficient
+ * file and date.
+ *
+ * @param path the path to the grid file
+ * @param source the status of the coefficient file
+ * @param day the current day, in days since 1970
+ * @return a pointer to the model, or NULL if there is no valid grid file
+ */
+static struct magvar *map_grid(const char *path, const struct stat *source,
+    int64_t day)
+{
+    int fd;
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return NULL;
+    struct stat st;
+    void *base = MAP_FAILED;
+    size_t length = sizeof(struct header) + grid_size();
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == length)
+        base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    const struct header *header = base;
+    if (header->magic != GRID_MAGIC || header->layout != GRID_LAYOUT ||
+        header->source_size != (uint64_t)source->st_size ||
+        header->source_mtime != (int64_t)source->st_mtime ||
+        header->day != day || header->rows != GRID_ROWS ||
+        header->cols != GRID_COLS) {
+        munmap(base, length);
+        return NULL;
+    }
+
+    struct magvar *magvar;
+    if ((magvar = malloc(sizeof(struct magvar))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    magvar->base = base;
+    magvar->length = length;
+    magvar->grid = (struct point *)((char *)base + sizeof(struct header));
+    return magvar;
+}
+
+/**
+ * Writes a declination grid to a grid file.
+ *
+ * The grid is written to a temporary file that is renamed into place, so
+ * other processes never see a partial grid. Grid files are a cache, so
+ * failure is silently ignored.
+ *
+ * @param magvar a pointer to the model
+ * @param path the path to the grid file
+ * @param source the status of the coefficient file
+ * @param day the day of the grid, in days since 1970
+ */
+static void write_grid(const struct magvar *magvar, const char *path,
+    const struct stat *source, int64_t day)
+{
+    struct header header = {
+        .magic = GRID_MAGIC,
+        .layout = GRID_LAYOUT,
+        .source_size = (uint64_t)source->st_size,
+        .source_mtime = (int64_t)source->st_mtime,
+        .day = day,
+        .rows = GRID_ROWS,
+        .cols = GRID_COLS
+    };
+
+    char *tmp;
+    size_t n = strlen(path) + 32;
+    if ((tmp = malloc(n)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(tmp, n, "%s.%ld", path, (long)getpid());
+
+    FILE *f;
+    if ((f = fopen(tmp, "wb")) != NULL) {
+        bool ok = fwrite(&header, sizeof header, 1, f) == 1 &&
+            fwrite(magvar->grid, grid_size(), 1, f) == 1;
+        if (fclose(f) != 0 || !ok || rename(tmp, path) != 0)
+            unlink(tmp);
+    }
+    free(tmp);
+}
+
+/**
+ * Creates a magnetic variation model for the current date.
+ *
+ * Evaluating the spherical harmonic model for every result would be
+ * expensive, so the field is evaluated once for a grid of points every
+ * GRID_STEP degrees, in parallel by rows, and interpolated from the grid.
+ * The grid is kept in the user cache directory and rebuilt when the
+ * coefficient file or the date changes.
+ *
+ * This function never returns NULL. Any errors in reading the coefficient
+ * file result in a message printed to standard error and the program
+ * terminating with an error status.
+ *
+ * The model must be destroyed after use with destroy_magvar.
+ *
+ * @param path the path to a World Magnetic Model coefficient file (WMM.COF)
+ * @param pool the thread pool for building the grid
+ * @return a pointer to the model
+ */
+struct magvar *create_magvar(const char *path, struct pool *pool)
+{
+    assert(path != NULL && pool != NULL);
+
+    struct stat source;
+    if (stat(path, &source) != 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    time_t now = time(NULL);
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    int year = tm.tm_year + 1900;
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    int64_t day = (int64_t)(now / 86400);
+
+    char name[GRID_NAME_SIZE];
+    snprintf(name, sizeof name, "magvar-%016llx.grid",
+        (unsigned long long)fnv1a(path, strlen(path), FNV_OFFSET));
+    char *grid_path = cache_path(name);
+
+    struct magvar *magvar = NULL;
+    if (grid_path != NULL)
+        magvar = map_grid(grid_path, &source, day);
+    if (magvar == NULL) {
+        struct model model;
+        read_model(path, year + tm.tm_yday / (leap ? 366.0 : 365.0), &model);
+        if ((magvar = malloc(sizeof(struct magvar))) == NULL ||
+            (magvar->grid = malloc(grid_size())) == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        magvar->base = NULL;
+        struct column *columns;
+        if ((columns = malloc(GRID_COLS * sizeof(struct column))) == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < GRID_COLS; ++i)
+            init_column(-180 + i * GRID_STEP, &columns[i]);
+        struct rows rows = { &model, columns, magvar->grid };
+        run_pool(pool, GRID_ROWS, row_task, &rows);
+        free(columns);
+        if (grid_path != NULL)
+            write_grid(magvar, grid_path, &source, day);
+    }
+    free(grid_path);
+    return magvar;
+}
+
+/**
+ * Destroys a magnetic variation model.
+ *
+ * @param magvar a pointer to the model (may be NULL)
+ */
+void destroy_magvar(struct magvar *magvar)
+{
+    if (magvar == NULL)
+        return;
+    if (magvar->base != NULL)
+        munmap(magvar->base, magvar->length);
+    else
+        free(magvar->grid);
+    free(magvar);
+}
+
+/**
+ * Returns the magnetic declination at a coordinate.
+ *
+ * The horizontal field is interpolated bilinearly from the four grid
+ * points around the coordinate and the declination is its direction.
+ *
+ * @param magvar a pointer to the model
+ * @param c the coordinate
+ * @return the declination in degrees, positive east
+ */
+double declination(const struct magvar *magvar, const struct coordinate *c)
+{
+    double y = fmin(fmax((c->lat + 90) / GRID_STEP, 0), GRID_ROWS - 1);
+    double x = fmin(fmax((c->lon + 180) / GRID_STEP, 0), GRID_COLS - 1);
+    int i = y < GRID_ROWS - 1 ? (int)y : GRID_ROWS - 2;
+    int j = x < GRID_COLS - 1 ? (int)x : GRID_COLS - 2;
+    double fy = y - i, fx = x - j;
+
+    const struct point *p = &magvar->grid[(size_t)i * GRID_COLS + j];
+    const struct point *q = p + GRID_COLS;
+    double north = (p[0].north * (1 - fx) + p[1].north * fx) * (1 - fy) +
+        (q[0].north * (1 - fx) + q[1].north * fx) * fy;
+    double east = (p[0].east * (1 - fx) + p[1].east * fx) * (1 - fy) +
+        (q[0].east * (1 - fx) + q[1].east * fx) * fy;
+    return atan2(east, north) / RADIANS;
+}
+
+/**
+ * Converts a true heading or bearing at a coordinate to magnetic.
+ *
+ * @param magvar a pointer to the model
+ * @param c the coordinate
+ * @param heading the true heading in degrees
+ * @return the magnetic heading in degrees, from 0 up to 360
+ */
+double magnetic(const struct magvar *magvar, const struct coordinate *c,
+    double heading)
+{
+    double m = fmod(heading - declination(magvar, c), 360);
+    return m < 0 ? m + 360 : m;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file magvar.h
+ *
+ * Magnetic variation from the World Magnetic Model.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef magvar_h
+#define magvar_h
+
+struct coordinate;
+struct magvar;
+struct pool;
+
+struct magvar *create_magvar(const char *path, struct pool *pool);
+void destroy_magvar(struct magvar *magvar);
+double declination(const struct magvar *magvar, const struct coordinate *c);
+double magnetic(const struct magvar *magvar, const struct coordinate *c,
+    double heading);
+
+#endif
@@ -21,14 +21,33 @@
 
 #include "main.h"
 
+#include <ctype.h>
 #include <getopt.h>
+#include <limits.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "airport.h"
+#include "airway.h"
+#include "batch.h"
+#include "bktree.h"
 #include "cache.h"
+#include "conflict.h"
+#include "coverage.h"
+#include "filter.h"
+#include "fix.h"
 #include "flags.h"
+#include "follow.h"
+#include "group.h"
+#include "index.h"
+#include "magvar.h"
+#include "pool.h"
+#include "region.h"
+#include "results.h"
 #include "search.h"
 #include "types.h"
 #include "util.h"
@@ -49,31 +68,47 @@
 #define SPACER_CHAR '-'
 
 /**
- * Creates and initializes a bounds structure, returning a pointer to it.
- *
- * The pointer must be freed after use.
+ * Option code for long options without a short equivalent.
+ */
+enum LongOption {
+    OPT_SUGGEST = 256,  ///< Suggest similar codes
+    OPT_LIMIT,          ///< Limit results per item
+    OPT_SORT,           ///< Sort results
+    OPT_SHARED,         ///< Share loaded data between processes
+    OPT_THREADS,        ///< Number of threads for scanning
+    OPT_WHERE,          ///< Filter expression
+    OPT_CONFLICTS,      ///< Report frequency conflicts
+    OPT_PLAN,           ///< Plan a route along airways
+    OPT_MAGNETIC,       ///< Show magnetic headings
+    OPT_REMEMBER,       ///< Replay results of identical searches
+    OPT_POLYGONS,       ///< Bound searches by polygons from a file
+    OPT_COVERAGE,       ///< Map receivable stations
+    OPT_RESOLUTION,     ///< Cell size of the coverage map
+    OPT_BATCH,          ///< Search around positions read from a file
+    OPT_RECEIVABLE,     ///< Find receivable rather than nearest navaids
+    OPT_FOLLOW,         ///< Follow a live feed of positions
+    OPT_RATE,           ///< Greatest rate of following a live feed
+    OPT_EXPLAIN         ///< Explain the plan of each search
+};
+
+/**
+ * Initializes a bounds structure to cover the whole world.
  *
- * @return a pointer to an initialized bounds structure
+ * @param bounds a pointer to the bounds structure
  */
-static struct bounds *create_bounds()
+static void init_bounds(struct bounds *bounds)
 {
-    struct bounds *bounds;
-    if ((bounds = malloc(sizeof(struct bounds))) == NULL) {
-        perror("malloc");
-        exit(EXIT_FAILURE);
-    }
     bounds->max.lat = 90;
     bounds->max.lon = 180;
     bounds->min.lat = -bounds->max.lat;
     bounds->min.lon = -bounds->max.lon;
-    return bounds;
 }
 
 /**
  * Parses search bounds from a string.
  *
  * Elements of the search bounds can be omitted to use the defaults
- * established in create_bounds. A complete bounds specification would
+ * established in init_bounds. A complete bounds specification would
  * have four elements, e.g. "60,2,50,-2". A partial bounds specification
  * can have fewer elements, but they must be delimited, e.g. "60,,50,".
  *
@@ -114,23 +149,189 @@ static void parse_bounds(const char *s, struct bounds *bounds)
 }
 
 /**
- * Prints the bounds in use to standard output.
+ * Creates a coordinate parsed from a string, returning a pointer to it.
  *
- * If no bounds are in use, prints nothing.
+ * The string must contain a latitude and longitude in decimal degrees,
+ * separated by a comma, e.g. "53.74,-1.99". If the coordinate cannot be
+ * parsed or is out of range, the program is terminated with an exit status.
  *
- * @param bounds a pointer to a bounds structure
- * @return true if anything was printed, otherwise false
+ * The pointer must be freed after use.
+ *
+ * @param s the coordinate specification
+ * @return a pointer to a coordinate structure
  */
-static bool show_bounds(const struct bounds *bounds)
+static struct coordinate *create_coordinate(const char *s)
 {
-    if (bounds == NULL)
-        return false;
-
-    printf("Using bounds top=%.02f, right=%.02f, bottom=%.02f, left=%.02f\n",
-        bounds->max.lat, bounds->max.lon,
-        bounds->min.lat, bounds->min.lon
-    );
-    return true;
+    struct coordinate *c;
+    if ((c = malloc(sizeof(struct coordinate))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    char *end;
+    c->lat = strtod(s, &end);
+    if (end == s || *end != ',') {
+        fprintf(stderr, "Invalid coordinate: %s\n", s);
+        exit(EXIT_FAILURE);
+    }
+    const char *lon = end + 1;
+    c->lon = strtod(lon, &end);
+    if (end == lon || *end != '\0' ||
+        c->lat < -90 || c->lat > 90 || c->lon < -180 || c->lon > 180) {
+        fprintf(stderr, "Invalid coordinate: %s\n", s);
+        exit(EXIT_FAILURE);
+    }
+    return c;
+}
+
+/**
+ * Checks if a reference point specification is a coordinate rather than
+ * the ICAO code of an airport.
+ *
+ * @param s the reference point specification
+ * @return true if the specification starts like a number
+ */
+static bool is_coordinate(const char *s)
+{
+    return isdigit((unsigned char)*s) || *s == '-' || *s == '+' || *s == '.';
+}
+
+/**
+ * Creates a coordinate from the ICAO code of an airport.
+ *
+ * If there is no airport data, the airport is not found or its position is
+ * unknown, the program is terminated with an exit status.
+ *
+ * The pointer must be freed after use.
+ *
+ * @param airports a pointer to the airport index (may be NULL)
+ * @param s the ICAO code
+ * @return a pointer to a coordinate structure
+ */
+static struct coordinate *create_airport_coordinate(
+    const struct airports *airports, const char *s)
+{
+    char icao[ICAO_MAX];
+    size_t i = 0;
+    for (; i < ICAO_MAX - 1 && s[i] != '\0'; ++i)
+        icao[i] = toupper((unsigned char)s[i]);
+    icao[i] = '\0';
+
+    const struct airport *airport = NULL;
+    if (airports != NULL && s[i] == '\0')
+        airport = find_airport(airports, icao);
+    if (airport == NULL || isnan(airport->coordinate.lat)) {
+        fprintf(stderr, "Invalid coordinate or airport: %s\n", s);
+        exit(EXIT_FAILURE);
+    }
+
+    struct coordinate *c;
+    if ((c = malloc(sizeof(struct coordinate))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    *c = airport->coordinate;
+    return c;
+}
+
+/**
+ * Parses a result limit from a string.
+ *
+ * If the limit is not a positive integer, the program is terminated with an
+ * exit status.
+ *
+ * @param s the limit specification
+ * @return the limit
+ */
+static int parse_limit(const char *s)
+{
+    char *end;
+    long limit = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || limit < 1 || limit > INT_MAX) {
+        fprintf(stderr, "Invalid limit: %s\n", s);
+        exit(EXIT_FAILURE);
+    }
+    return (int)limit;
+}
+
+/**
+ * Parses a coverage map resolution from a string.
+ *
+ * If the resolution is not a number of degrees from 0.001 to 10, the
+ * program is terminated with an exit status.
+ *
+ * @param s the resolution specification
+ * @return the resolution in degrees
+ */
+static double parse_resolution(const char *s)
+{
+    char *end;
+    double resolution = strtod(s, &end);
+    if (end == s || *end != '\0' ||
+        !(resolution >= 0.001 && resolution <= 10)) {
+        fprintf(stderr, "Invalid resolution: %s\n", s);
+        exit(EXIT_FAILURE);
+    }
+    return resolution;
+}
+
+/**
+ * Parses an update rate from a string.
+ *
+ * If the rate is not an integer from 0 to 1000, the program is terminated
+ * with an exit status. Zero follows every position.
+ *
+ * @param s the rate specification
+ * @return the rate in updates per second
+ */
+static int parse_rate(const char *s)
+{
+    char *end;
+    long rate = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || rate < 0 || rate > 1000) {
+        fprintf(stderr, "Invalid rate: %s\n", s);
+        exit(EXIT_FAILURE);
+    }
+    return (int)rate;
+}
+
+/**
+ * Parses a thread count from a string.
+ *
+ * If the thread count is not a non-negative integer, the program is
+ * terminated with an exit status. Zero selects one thread per processor.
+ *
+ * @param s the thread count specification
+ * @return the thread count
+ */
+static int parse_threads(const char *s)
+{
+    char *end;
+    long threads = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || threads < 0 || threads > INT_MAX) {
+        fprintf(stderr, "Invalid thread count: %s\n", s);
+        exit(EXIT_FAILURE);
+    }
+    return (int)threads;
+}
+
+/**
+ * Parses a sort key from a string.
+ *
+ * If the sort key is not recognized, the program is terminated with an
+ * exit status.
+ *
+ * @param s the sort key name
+ * @return the sort key
+ */
+static enum SortKey parse_sort(const char *s)
+{
+    if (strcmp(s, "distance") == 0) return SORT_DISTANCE;
+    if (strcmp(s, "frequency") == 0) return SORT_FREQUENCY;
+    if (strcmp(s, "range") == 0) return SORT_RANGE;
+    if (strcmp(s, "name") == 0) return SORT_NAME;
+
+    fprintf(stderr, "Invalid sort key: %s\n", s);
+    exit(EXIT_FAILURE);
 }
 
 /**
@@ -148,6 +349,35 @@ static void spacer(int n)
     putchar('\n');
 }
 
+/**
+ * Plans and prints the shortest route between two fixes or navaids along
+ * airways.
+ *
+ * @param airways a pointer to the airway network
+ * @param from the ident of the start
+ * @param to the ident of the destination
+ * @return exit status
+ */
+static int plan(const struct airways *airways, const char *from,
+    const char *to)
+{
+    const char *idents[] = { from, to };
+    for (int i = 0; i < 2; ++i)
+        if (!on_airway(airways, idents[i])) {
+            fprintf(stderr, "%s is not on an airway\n", idents[i]);
+            return EXIT_FAILURE;
+        }
+
+    struct leg *legs;
+    int n = plan_route(airways, from, to, &legs);
+    if (n == 0)
+        fprintf(stderr, "No route from %s to %s\n", from, to);
+    else
+        print_route(legs, n);
+    free(legs);
+    return n > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 /**
  * Prints a usage message to standard output.
  */
@@ -155,14 +385,53 @@ static void usage()
 {
     printf("nvs v%s\n", PROJECT_VERSION);
     puts("Usage: nvs [OPTIONS] ITEMS ...");
+    puts("       nvs [OPTIONS] --conflicts");
+    puts("       nvs [OPTIONS] --coverage=<file>");
+    puts("       nvs [OPTIONS] --batch=<file>");
+    puts("       nvs [OPTIONS] --follow=<feed>");
+    puts("       nvs --plan FROM TO");
+    puts("Items may use wildcards '*' and '?', e.g. 'EG*' or 'B?N'");
+    puts("Items may be omitted with --where, to search all navaids");
     puts("  -a, --all              Search for all navaid types, including DME");
+    puts("      --batch=<file>     Nearest navaids to each lat,lon in file"
+         " or '-'");
     puts("  -b, --bounds=<bounds>  Bounded by [t],[r],[b],[l] (wildcard '*')");
     puts("  -c, --coordinates      Show coordinates");
+    puts("      --conflicts        Report overlapping navaids on close"
+         " channels");
+    puts("      --coverage=<file>  Map stations in range per cell to PGM or"
+         " CSV");
+    puts("      --explain          Show how each item is searched for");
+    puts("      --follow=<feed>    Report navaids entering range from '-' or"
+         " UDP port");
     puts("  -f, --fuzzy            Search names as well as codes");
+    puts("  -g, --group            Show co-located navaids as one station");
     puts("  -h, --help             Show this help message");
+    puts("      --limit=<n>        Show at most n results for each item");
+    puts("      --magnetic=<cof>   Show magnetic headings, using WMM.COF file");
     puts("  -m, --morse            Show Morse code for each navaid");
+    puts("  -p, --airports         Search airports and runways as well");
+    puts("      --plan             Plan shortest route FROM TO along airways");
+    puts("      --polygons=<file>  Bounded by polygons of lat,lon lines in"
+         " file");
     puts("  -q, --quiet            Don't display additional messages");
+    puts("      --rate=<hz>        Updates per second for --follow (default:"
+         " 20)");
+    puts("      --receivable       Navaids in range of each position for"
+         " --batch");
+    puts("  -r, --reference=<pos>  Reference point [lat],[lon] or airport");
+    puts("      --remember         Replay results of identical earlier"
+         " searches");
+    puts("      --resolution=<deg> Cell size for --coverage (default: 0.1)");
     puts("  -s, --spacers          Add spacer lines between results");
+    puts("      --shared           Share loaded data with other processes");
+    puts("      --sort=<key>       Sort by distance, frequency, range or name");
+    puts("      --suggest          Suggest similar codes for items not found");
+    puts("      --threads=<n>      Threads for loading and scanning"
+         " (default: all CPUs)");
+    puts("      --where=<expr>     Filter, e.g. 'type=VOR and freq in"
+         " 112-114'");
+    puts("  -x, --fixes            Search fixes as well");
     puts("Search restrictions (multiples may be combined):");
     puts("  -d, --dme              Search for DMEs, including standalone");
     puts("  -i, --ils              Search for ILS/LOC");
@@ -173,9 +442,10 @@ static void usage()
 /**
  * Checks if bounds are valid.
  *
- * The only checks performed are whether the maximum latitude and
- * longitude are greater than the corresponding minimums and whether
- * all are in range.
+ * The only checks performed are whether the maximum latitude is greater
+ * than the minimum, whether the longitudes differ and whether all are in
+ * range. A minimum longitude greater than the maximum wraps the bounds at
+ * the antimeridian.
  *
  * @param bounds a pointer to a bounds structure
  * @return true if the bounds are valid
@@ -187,7 +457,7 @@ static bool valid(const struct bounds *bounds)
         bounds->max.lon <= 180.0 &&
         bounds->min.lon >= -180.0 &&
         bounds->max.lat > bounds->min.lat &&
-        bounds->max.lon > bounds->min.lon;
+        bounds->max.lon != bounds->min.lon;
 }
 
 /**
@@ -202,14 +472,36 @@ int main(int argc, char **argv)
     extern struct flags flags;
 
     static struct option longopts[] = {
+        {"airports", no_argument, NULL, 'p'},
         {"all", no_argument, NULL, 'a'},
+        {"batch", required_argument, NULL, OPT_BATCH},
         {"bounds", required_argument, NULL, 'b'},
+        {"conflicts", no_argument, NULL, OPT_CONFLICTS},
         {"coordinates", no_argument, NULL, 'c'},
+        {"coverage", required_argument, NULL, OPT_COVERAGE},
+        {"explain", no_argument, NULL, OPT_EXPLAIN},
         {"quiet", no_argument, NULL, 'q'},
+        {"follow", required_argument, NULL, OPT_FOLLOW},
         {"fuzzy", no_argument, NULL, 'f'},
+        {"group", no_argument, NULL, 'g'},
         {"help", no_argument, NULL, 'h'},
+        {"limit", required_argument, NULL, OPT_LIMIT},
+        {"magnetic", required_argument, NULL, OPT_MAGNETIC},
         {"morse", no_argument, NULL, 'm'},
+        {"plan", no_argument, NULL, OPT_PLAN},
+        {"polygons", required_argument, NULL, OPT_POLYGONS},
+        {"rate", required_argument, NULL, OPT_RATE},
+        {"receivable", no_argument, NULL, OPT_RECEIVABLE},
+        {"reference", required_argument, NULL, 'r'},
+        {"remember", no_argument, NULL, OPT_REMEMBER},
+        {"resolution", required_argument, NULL, OPT_RESOLUTION},
+        {"shared", no_argument, NULL, OPT_SHARED},
+        {"sort", required_argument, NULL, OPT_SORT},
         {"spacers", no_argument, NULL, 's'},
+        {"suggest", no_argument, NULL, OPT_SUGGEST},
+        {"threads", required_argument, NULL, OPT_THREADS},
+        {"where", required_argument, NULL, OPT_WHERE},
+        {"fixes", no_argument, NULL, 'x'},
         {"dme", no_argument, NULL, 'd'},
         {"ils", no_argument, NULL, 'i'},
         {"ndb", no_argument, NULL, 'n'},
@@ -222,24 +514,41 @@ int main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
-    struct bounds *bounds = NULL;
+    struct region *region = NULL;
+    struct bounds bounds;
+    struct coordinate *reference = NULL;
+    const char *reference_spec = NULL;
+    struct order order = { SORT_NONE, 0, NULL, NULL, NULL, NULL };
+    struct filter *filter = NULL;
+    const char *magnetic_path = NULL;
+    const char *where = NULL;
+    const char *coverage_path = NULL;
+    const char *batch_path = NULL;
+    const char *follow_source = NULL;
+    int rate = 20;
+    double resolution = 0.1;
+    int threads = 0;
     int c;
-    while ((c = getopt_long(argc, argv, "ab:cdfhimnvqs", longopts, NULL)) != -1)
+    while ((c = getopt_long(argc, argv, "ab:cdfghimnpvqr:sx", longopts, NULL))
+        != -1)
         switch (c) {
         case 'a':
             set_all_restrictions(true);
             break;
         case 'b':
-            bounds = create_bounds();
-            parse_bounds(optarg, bounds);
-            if (!valid(bounds)) {
+            init_bounds(&bounds);
+            parse_bounds(optarg, &bounds);
+            if (!valid(&bounds)) {
                 fprintf(stderr, "Invalid bounds: "
                     "top=%.02f, right=%.02f, bottom=%.02f, left=%.02f\n",
-                    bounds->max.lat, bounds->max.lon,
-                    bounds->min.lat, bounds->min.lon
+                    bounds.max.lat, bounds.max.lon,
+                    bounds.min.lat, bounds.min.lon
                 );
                 exit(EXIT_FAILURE);
             }
+            if (region == NULL)
+                region = create_region();
+            add_box(region, &bounds);
             break;
         case 'c':
             flags.coordinates |= 1;
@@ -250,6 +559,9 @@ int main(int argc, char **argv)
         case 'f':
             flags.fuzzy |= 1;
             break;
+        case 'g':
+            flags.group |= 1;
+            break;
         case 'h':
             usage();
             exit(EXIT_SUCCESS);
@@ -263,15 +575,85 @@ int main(int argc, char **argv)
         case 'n':
             flags.ndb |= 1;
             break;
+        case 'p':
+            flags.airports |= 1;
+            break;
         case 'v':
             flags.vor |= 1;
             break;
         case 'q':
             flags.quiet |= 1;
             break;
+        case 'r':
+            free(reference);
+            reference = is_coordinate(optarg)
+                ? create_coordinate(optarg) : NULL;
+            reference_spec = optarg;
+            break;
         case 's':
             flags.spacing |= 1;
             break;
+        case 'x':
+            flags.fixes |= 1;
+            break;
+        case OPT_SUGGEST:
+            flags.suggest |= 1;
+            break;
+        case OPT_LIMIT:
+            order.limit = parse_limit(optarg);
+            break;
+        case OPT_SORT:
+            order.key = parse_sort(optarg);
+            break;
+        case OPT_SHARED:
+            flags.shared |= 1;
+            break;
+        case OPT_THREADS:
+            threads = parse_threads(optarg);
+            break;
+        case OPT_WHERE:
+            destroy_filter(filter);
+            filter = compile_filter(optarg);
+            where = optarg;
+            break;
+        case OPT_CONFLICTS:
+            flags.conflicts |= 1;
+            break;
+        case OPT_PLAN:
+            flags.plan |= 1;
+            break;
+        case OPT_MAGNETIC:
+            magnetic_path = optarg;
+            break;
+        case OPT_REMEMBER:
+            flags.remember |= 1;
+            break;
+        case OPT_POLYGONS:
+            if (region == NULL)
+                region = create_region();
+            read_polygons(region, optarg);
+            break;
+        case OPT_COVERAGE:
+            coverage_path = optarg;
+            break;
+        case OPT_RESOLUTION:
+            resolution = parse_resolution(optarg);
+            break;
+        case OPT_BATCH:
+            batch_path = optarg;
+            break;
+        case OPT_RECEIVABLE:
+            flags.receivable |= 1;
+            break;
+        case OPT_FOLLOW:
+            follow_source = optarg;
+            break;
+        case OPT_RATE:
+            rate = parse_rate(optarg);
+            break;
+        case OPT_EXPLAIN:
+            flags.explain |= 1;
+            break;
         default:
             usage();
             exit(EXIT_FAILURE);
@@ -281,32 +663,166 @@ int main(int argc, char **argv)
     argc -= optind;
     argv += optind;
 
-    if (argc == 0) {
+    // Items are matched in uppercase, so they are reported in uppercase,
+    // and searches that differ only in case are remembered as one query
+    for (int i = 0; i < argc; ++i)
+        for (char *p = argv[i]; *p != '\0'; ++p)
+            *p = toupper((unsigned char)*p);
+
+    if (flags.plan && argc != 2) {
+        fputs("Plan requires a start and a destination\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    struct pool *pool = create_pool(threads);
+    struct magvar *magvar = magnetic_path != NULL ?
+        create_magvar(magnetic_path, pool) : NULL;
+    use_magvar(magvar);
+
+    if (flags.plan) {
+        struct airways *airways = create_airways();
+        int status = plan(airways, argv[0], argv[1]);
+        destroy_airways(airways);
+        destroy_magvar(magvar);
+        destroy_pool(pool);
+        destroy_filter(filter);
+        free(reference);
+        destroy_region(region);
+        return status;
+    }
+
+    static char *everything[] = { "*" };
+    bool report = flags.conflicts || coverage_path != NULL ||
+        batch_path != NULL || follow_source != NULL;
+    if (argc > 0 && report) {
+        fprintf(stderr, "Items cannot be used with --%s\n",
+            flags.conflicts ? "conflicts" :
+            coverage_path != NULL ? "coverage" :
+            batch_path != NULL ? "batch" : "follow");
+        exit(EXIT_FAILURE);
+    }
+    if (argc == 0 && filter != NULL && !report) {
+        argc = 1;
+        argv = everything;
+    }
+    if (argc == 0 && !report) {
         usage();
         exit(EXIT_FAILURE);
     }
 
+    if (order.key == SORT_DISTANCE && reference_spec == NULL) {
+        fputs("Sorting by distance requires a reference point\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
     if (!any_restriction())
         set_default_restrictions();
 
-    if (!flags.quiet) {
+    struct airports *airports = NULL;
+    if (reference_spec != NULL && reference == NULL) {
+        airports = load_airports(getenv("FG_ROOT"));
+        reference = create_airport_coordinate(airports, reference_spec);
+    }
+    order.reference = reference;
+
+    struct results *results =
+        flags.remember && !flags.explain && coverage_path == NULL &&
+        batch_path == NULL && follow_source == NULL ?
+        open_results(region, &order, reference_spec, where, magnetic_path,
+            argc, argv) : NULL;
+    if (results != NULL && replay_results(results)) {
+        close_results(results);
+        destroy_airports(airports);
+        destroy_magvar(magvar);
+        destroy_pool(pool);
+        destroy_filter(filter);
+        free(reference);
+        destroy_region(region);
+        return EXIT_SUCCESS;
+    }
+    if (results != NULL)
+        record_results(results);
+
+    if (!flags.quiet && batch_path == NULL && follow_source == NULL) {
         bool f = show_flags("Searching for");
-        bool b = show_bounds(bounds);
+        bool b = show_region(region);
         if ((f || b) && flags.spacing)
             spacer(SPACER_LENGTH);
     }
 
-    struct navaid **cache = create_cache(bounds);
-    free(bounds);
+    struct navaid **cache =
+        create_cache(coverage_path != NULL ? NULL : region, pool);
+    struct index *index = flags.fuzzy || report ?
+        NULL : create_index(cache, filter);
+    uint64_t *selection = filter && (report || index == NULL) ?
+        run_filter(filter, cache, pool) : NULL;
+    order.filter = filter;
+    order.selection = selection;
+    struct bktree *tree = flags.suggest ? create_bktree(cache) : NULL;
+    struct groups *groups = flags.group
+        ? create_groups(cache, flags.dme) : NULL;
+    order.groups = groups;
+
+    if (flags.airports && airports == NULL) {
+        airports = load_airports(getenv("FG_ROOT"));
+        if (airports == NULL && !flags.quiet)
+            fputs("No airport data found in FG_ROOT\n", stderr);
+    }
+
+    struct navaid **fixes = flags.fixes ? create_fixes(region) : NULL;
+    struct index *fix_index = fixes != NULL && !flags.fuzzy ?
+        create_index(fixes, filter) : NULL;
+    uint64_t *fix_selection = fixes != NULL && fix_index == NULL &&
+        filter != NULL ? run_filter(filter, fixes, pool) : NULL;
+    struct order fix_order = order;
+    fix_order.selection = fix_selection;
+    fix_order.groups = NULL;
 
+    if (flags.conflicts) {
+        int n = conflicts(cache, selection);
+        if (!flags.quiet)
+            printf("%d conflict%s found\n", n, n == 1 ? "" : "s");
+    }
+    if (coverage_path != NULL) {
+        int n = coverage(cache, selection, region, resolution, coverage_path,
+            pool);
+        if (!flags.quiet)
+            printf("Coverage of %d station%s written to %s\n", n,
+                n == 1 ? "" : "s", coverage_path);
+    }
+    if (batch_path != NULL)
+        batch(cache, selection, batch_path, flags.receivable, order.limit,
+            pool);
+    if (follow_source != NULL)
+        follow(cache, selection, follow_source, rate);
     for (; argc--; argv++) {
-        int matches = find(cache, *argv);
+        int matches = find(cache, index, pool, &order, *argv);
+        if (flags.airports && airports != NULL)
+            matches += find_airports(airports, region, &order, *argv);
+        if (fixes != NULL)
+            matches += find(fixes, fix_index, pool, &fix_order, *argv);
+        if (matches == 0 && tree != NULL)
+            matches = suggest(cache, tree, &order, *argv);
         if (!flags.quiet && matches == 0)
             printf("%s not found\n", *argv);
         if (flags.spacing)
             spacer(SPACER_LENGTH);
     }
+    close_results(results);
+    destroy_magvar(magvar);
+    destroy_pool(pool);
+    destroy_airports(airports);
+    free(fix_selection);
+    destroy_index(fix_index);
+    destroy_fixes(fixes);
+    destroy_region(region);
+    free(selection);
+    destroy_filter(filter);
+    destroy_groups(groups);
+    destroy_bktree(tree);
+    destroy_index(index);
     destroy_cache(cache);
+    free(reference);
 
     return EXIT_SUCCESS;
 }
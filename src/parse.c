@@ -22,241 +22,264 @@
 #include "parse.h"
 
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "flags.h"
 #include "types.h"
 #include "util.h"
 
 /**
- * Allocates a navaid structure.
+ * Splits the next whitespace delimited field from a string, in place.
  *
- * The pointer must be freed after use. If the memory cannot be allocated,
- * prints a message to standard error and exits the program with a
- * non-zero status.
+ * The field is converted to uppercase, the delimiter following it is
+ * overwritten with a terminator and the string pointer is advanced past it,
+ * so the field can be used as a string without copying. Fields longer than
+ * max - 1 are truncated.
  *
- * @return a pointer to a navaid structure (never returns NULL)
+ * @param s a pointer to the string pointer
+ * @param max the size of the field, including the terminator
+ * @return the field
  */
-static struct navaid *create_navaid()
+static char *field(char **s, size_t max)
 {
-    struct navaid *n;
-    if ((n = calloc(1, sizeof(struct navaid))) == NULL) {
-        perror("calloc");
-        exit(EXIT_FAILURE);
-    }
-    return n;
+    char *p = *s;
+    while (*p == ' ' || *p == '\t')
+        ++p;
+    char *start = p;
+    for (; *p && *p != ' ' && *p != '\t'; ++p)
+        *p = toupper((unsigned char)*p);
+    if ((size_t)(p - start) >= max)
+        start[max - 1] = '\0';
+    if (*p)
+        *p++ = '\0';
+    *s = p;
+    return start;
 }
 
 /**
- * Returns a navaid if its coordinate falls within bounds.
+ * Returns the remainder of a string, without leading whitespace.
  *
- * @param navaid the navaid to check
- * @param bounds the bounds
- * @return the navaid if in bounds, otherwise NULL
+ * @param s the string
+ * @return the remainder of the string
  */
-static struct navaid *in_bounds(struct navaid *navaid, struct bounds *bounds)
+static char *rest(char *s)
 {
-    if (bounds == NULL) return navaid;
+    while (*s == ' ' || *s == '\t')
+        ++s;
+    return s;
+}
 
-    if (navaid->coordinate.lat < bounds->min.lat) return NULL;
-    if (navaid->coordinate.lat > bounds->max.lat) return NULL;
-    if (navaid->coordinate.lon < bounds->min.lon) return NULL;
-    if (navaid->coordinate.lon > bounds->max.lon) return NULL;
+/**
+ * Skips the next whitespace delimited field of a string.
+ *
+ * @param s the string
+ * @return a pointer to the first character after the field
+ */
+static char *skip(char *s)
+{
+    while (*s == ' ' || *s == '\t')
+        ++s;
+    while (*s && *s != ' ' && *s != '\t')
+        ++s;
+    return s;
+}
 
-    return navaid;
+/**
+ * Decodes the elevation, range and navaid specific field of a navaid.
+ *
+ * The 810 format combines the glideslope angle and bearing into one field,
+ * as angle * 100000 + bearing, e.g. 300138.000 for 3.00° on 138°. Only
+ * the angle is kept, because the bearing is the bearing of the localizer.
+ *
+ * @param s the elevation field, followed by frequency, range and extra
+ * @param navaid a pointer to the navaid to receive the fields
+ */
+static void decode_details(char *s, struct navaid *navaid)
+{
+    navaid->elevation = (int)strtol(s, &s, 10);
+    s = skip(s);
+    navaid->range = (int)strtol(s, &s, 10);
+    navaid->extra.unused = strtof(s, &s);
+    if (navaid->type == GS)
+        navaid->extra.slope = floorf(navaid->extra.slope / 1000) / 100;
+    navaid->deferred = false;
 }
 
 /**
- * Parses an NDB from a 810 format string.
+ * Parses the numeric fields common to all 810 format navaids.
+ *
+ * Only the type, coordinates and frequency are decoded, because they are
+ * used to select and match every navaid. The elevation, range and navaid
+ * specific field are skipped and the navaid is marked as deferred, so they
+ * are decoded by parse_details for the few navaids that need them. The
+ * offset of the elevation back from the code, which follows the numeric
+ * fields, is kept so they can be found again. If the offset is too large
+ * to keep, they are decoded now.
  *
  * @param s the 810 format navaid specification
- * @param bounds pointer to a bounds structure (may be NULL)
- * @return a pointer to a navaid structure
+ * @param navaid a pointer to the navaid to receive the fields
+ * @return a pointer to the first character after the numeric fields
  */
-static struct navaid *parse_ndb(const char *s, struct bounds *bounds)
+static char *parse_numbers(char *s, struct navaid *navaid)
 {
-    extern struct flags flags;
-    if (!flags.ndb)
-        return NULL;
+    navaid->type = (enum NavaidType)strtol(s, &s, 10);
+    navaid->coordinate.lat = strtod(s, &s);
+    navaid->coordinate.lon = strtod(s, &s);
+    char *details = s;
+    navaid->frequency = strtod(skip(s), &s);
+    s = skip(skip(s));
 
-    struct navaid *navaid = create_navaid();
-    char code[CODE_MAX];
-    int n;
-    sscanf(s, "%d %lf %lf %d %lf %d %f %7s %n",
-        (int *)&navaid->type,
-        &navaid->coordinate.lat,
-        &navaid->coordinate.lon,
-        &navaid->elevation,
-        &navaid->frequency,
-        &navaid->range,
-        &navaid->extra.unused,
-        code,
-        &n
-    );
-    navaid->code = strdup_f(code);
-    navaid->name = strdup_f(s + n);
+    size_t offset = rest(s) - details;
+    navaid->deferred = offset <= USHRT_MAX;
+    navaid->details = navaid->deferred ? (unsigned short)offset : 0;
+    if (!navaid->deferred)
+        decode_details(details, navaid);
+    return s;
+}
 
-    return in_bounds(navaid, bounds);
+/**
+ * Parses an NDB from a 810 format string.
+ *
+ * String fields of the navaid are slices of the input string, which is
+ * modified to terminate them.
+ *
+ * @param s the 810 format navaid specification
+ * @param navaid a pointer to the navaid structure to receive the fields
+ */
+static void parse_ndb(char *s, struct navaid *navaid)
+{
+    s = parse_numbers(s, navaid);
+    navaid->code = field(&s, CODE_MAX);
+    navaid->name = rest(s);
 }
 
 /**
  * Parses a VOR from a 810 format string.
  *
+ * String fields of the navaid are slices of the input string, which is
+ * modified to terminate them.
+ *
  * @param s the 810 format navaid specification
- * @param bounds pointer to a bounds structure (may be NULL)
- * @return a pointer to a navaid structure
+ * @param navaid a pointer to the navaid structure to receive the fields
  */
-static struct navaid *parse_vor(const char *s, struct bounds *bounds)
+static void parse_vor(char *s, struct navaid *navaid)
 {
-    extern struct flags flags;
-    if (!flags.vor)
-        return NULL;
-
-    struct navaid *navaid = create_navaid();
-    char code[CODE_MAX];
-    int n;
-    sscanf(s, "%d %lf %lf %d %lf %d %f %7s %n",
-        (int *)&navaid->type,
-        &navaid->coordinate.lat,
-        &navaid->coordinate.lon,
-        &navaid->elevation,
-        &navaid->frequency,
-        &navaid->range,
-        &navaid->extra.variation,
-        code,
-        &n
-    );
+    s = parse_numbers(s, navaid);
     navaid->frequency /= 100;
-    navaid->code = strdup_f(code);
-    navaid->name = strdup_f(s + n);
-
-    return in_bounds(navaid, bounds);
+    navaid->code = field(&s, CODE_MAX);
+    navaid->name = rest(s);
 }
 
 /**
- * Parses an ILS/LOC from a 810 format string.
+ * Parses an ILS/LOC, or a glideslope or marker with the same fields, from
+ * a 810 format string.
+ *
+ * String fields of the navaid are slices of the input string, which is
+ * modified to terminate them.
  *
  * @param s the 810 format navaid specification
- * @param bounds pointer to a bounds structure (may be NULL)
- * @return a pointer to a navaid structure
+ * @param navaid a pointer to the navaid structure to receive the fields
  */
-static struct navaid *parse_loc(const char *s, struct bounds *bounds)
+static void parse_loc(char *s, struct navaid *navaid)
 {
-    extern struct flags flags;
-    if (!flags.ils)
-        return NULL;
-
-    struct navaid *navaid = create_navaid();
-    char code[CODE_MAX], icao[ICAO_MAX], runway[RWAY_MAX];
-    int n;
-    sscanf(s, "%d %lf %lf %d %lf %d %f %7s %7s %7s %n",
-        (int *)&navaid->type,
-        &navaid->coordinate.lat,
-        &navaid->coordinate.lon,
-        &navaid->elevation,
-        &navaid->frequency,
-        &navaid->range,
-        &navaid->extra.bearing,
-        code,
-        icao,
-        runway,
-        &n
-    );
+    s = parse_numbers(s, navaid);
     navaid->frequency /= 100;
-    navaid->code = strdup_f(code);
-    navaid->icao = strdup_f(icao);
-    navaid->name = strdup_f(s + n);
-    navaid->runway = strdup_f(runway);
-
-    return in_bounds(navaid, bounds);
+    navaid->code = field(&s, CODE_MAX);
+    navaid->icao = field(&s, ICAO_MAX);
+    navaid->runway = field(&s, RWAY_MAX);
+    navaid->name = rest(s);
 }
 
 /**
  * Parses a DME from a 810 format string.
  *
+ * String fields of the navaid are slices of the input string, which is
+ * modified to terminate them.
+ *
  * @param s the 810 format navaid specification
- * @param bounds pointer to a bounds structure (may be NULL)
- * @return a pointer to a navaid structure
+ * @param navaid a pointer to the navaid structure to receive the fields
  */
-static struct navaid *parse_dme(const char *s, struct bounds *bounds)
+static void parse_dme(char *s, struct navaid *navaid)
 {
-    extern struct flags flags;
-    if (!flags.dme)
-        return NULL;
-
-    struct navaid *navaid = create_navaid();
-    char code[CODE_MAX], icao[ICAO_MAX], runway[RWAY_MAX];
-    int n;
-    if (strstr(s, "DME-ILS") == NULL) {
-        sscanf(s, "%d %lf %lf %d %lf %d %f %7s %n",
-            (int *)&navaid->type,
-            &navaid->coordinate.lat,
-            &navaid->coordinate.lon,
-            &navaid->elevation,
-            &navaid->frequency,
-            &navaid->range,
-            &navaid->extra.bias,
-            code,
-            &n
-        );
-    } else {
-        sscanf(s, "%d %lf %lf %d %lf %d %f %7s %7s %7s %n",
-            (int *)&navaid->type,
-            &navaid->coordinate.lat,
-            &navaid->coordinate.lon,
-            &navaid->elevation,
-            &navaid->frequency,
-            &navaid->range,
-            &navaid->extra.bias,
-            code,
-            icao,
-            runway,
-            &n
-        );
-        navaid->icao = strdup_f(icao);
-        navaid->runway = strdup_f(runway);
-    }
+    s = parse_numbers(s, navaid);
     navaid->frequency /= 100;
-    navaid->code = strdup_f(code);
-    navaid->name = strdup_f(s + n);
-
-    return in_bounds(navaid, bounds);
+    navaid->code = field(&s, CODE_MAX);
+    if (contains(s, "DME-ILS")) {
+        navaid->icao = field(&s, ICAO_MAX);
+        navaid->runway = field(&s, RWAY_MAX);
+    }
+    navaid->name = rest(s);
 }
 
 /**
  * Parses a navaid from a 810 format string.
  *
+ * The string is modified in place and must outlive the navaid, because
+ * the navaid's string fields are slices of it. All supported types are
+ * parsed; restrictions on type and position are applied by the caller.
+ *
+ * The code, ICAO code and runway are converted to uppercase. The name is
+ * left as it is in the data file and the elevation, range and navaid
+ * specific field are left undecoded (see parse_details), because doing
+ * that work for every navaid loaded is wasted when only a few are printed.
+ * Names must be compared with contains and printed through a conversion
+ * to uppercase.
+ *
  * @param s the 810 format navaid specification
- * @param bounds pointer to a bounds structure (may be NULL)
- * @return a pointer to a navaid structure or NULL if ignored
+ * @param navaid a pointer to the navaid structure to receive the fields
+ * @return true if a navaid was parsed, false if the record is ignored
  */
-struct navaid *parse(const char *s, struct bounds *bounds)
+bool parse(char *s, struct navaid *navaid)
 {
-    enum NavaidType type = NIL;
-    sscanf(s, "%d", (int *)&type);
+    enum NavaidType type = (enum NavaidType)strtol(s, NULL, 10);
+    memset(navaid, 0, sizeof(struct navaid));
 
     switch (type) {
     case NDB:
-        return parse_ndb(s, bounds);
+        parse_ndb(s, navaid);
+        return true;
     case VOR:
-        return parse_vor(s, bounds);
+        parse_vor(s, navaid);
+        return true;
     case ILS:
     case LOC:
-        return parse_loc(s, bounds);
+        parse_loc(s, navaid);
+        return true;
     case GS:
     case OM:
     case MM:
     case IM:
-        return NULL;
+        parse_loc(s, navaid);
+        return true;
     case DME:
     case SDM:
-        return parse_dme(s, bounds);
+        parse_dme(s, navaid);
+        return true;
     case EOD:
-        return NULL;
+        return false;
     default:
         fprintf(stderr, "Unexpected navaid type %d in data file\n", type);
         exit(EXIT_FAILURE);
     }
 }
+
+/**
+ * Decodes the elevation, range and navaid specific field of a navaid.
+ *
+ * The fields are left in the data file line by parse, starting at the
+ * offset back from the code recorded when the navaid was parsed, and are
+ * decoded forward from there (see decode_details). Navaids that are not
+ * deferred, such as fixes and navaids read from a snapshot, are left
+ * unchanged.
+ *
+ * @param navaid a pointer to the navaid
+ */
+void parse_details(struct navaid *navaid)
+{
+    if (navaid->deferred)
+        decode_details(navaid->code - navaid->details, navaid);
+}
@@ -22,8 +22,11 @@
 #ifndef parse_h
 #define parse_h
 
-struct bounds;
+#include <stdbool.h>
 
-struct navaid *parse(const char *s, struct bounds *bounds);
+struct navaid;
+
+bool parse(char *s, struct navaid *navaid);
+void parse_details(struct navaid *navaid);
 
 #endif
@@ -0,0 +1,182 @@
+/**
+ * @file planner.c
+ *
+ * Choose how to find the navaids that match a search.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "planner.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "filter.h"
+#include "index.h"
+
+/**
+ * Cost of testing a navaid while scanning the cache.
+ */
+#define SCAN_COST 1.0
+
+/**
+ * Cost of filtering a navaid while scanning, a block at a time.
+ */
+#define BLOCK_COST 0.25
+
+/**
+ * Cost of examining an index entry.
+ */
+#define ENTRY_COST 1.0
+
+/**
+ * Cost of fetching a navaid found through the index and testing it.
+ */
+#define FETCH_COST 2.0
+
+/**
+ * Cost of each comparison when sorting positions into data file order.
+ */
+#define SORT_COST 0.1
+
+/**
+ * Names of the access paths.
+ */
+static const char *const path_names[PATHS] = {
+    "scan", "ident", "frequency", "cells"
+};
+
+/**
+ * Estimates the cost of looking up navaids in the index.
+ *
+ * Positions found in the index are sorted into data file order and each
+ * navaid found is fetched from the cache to be tested, unless it needs no
+ * test.
+ *
+ * @param rows the estimated number of navaids found
+ * @param count the number of navaids in the cache
+ * @param entry the cost of examining each index entry
+ * @param fetched whether each navaid found is fetched and tested
+ * @return the estimated cost
+ */
+static double lookup_cost(double rows, int count, double entry, bool fetched)
+{
+    return 2 * log2(count + 1.0) + rows * entry
+        + rows * log2(rows + 1) * SORT_COST
+        + (fetched ? rows * FETCH_COST : 0);
+}
+
+/**
+ * Chooses the cheapest way of finding the navaids that match a search.
+ *
+ * The number of navaids each path examines is estimated from statistics
+ * gathered when the index was created: the number of entries that share a
+ * code, the number of navaids in each frequency band and the number in
+ * each one degree cell. The index is only usable if there is one, and
+ * frequency and position only if the filter bounds them. They are not
+ * usable for grouped searches either, because stations are filtered by
+ * their primary navaid rather than the navaid that matched. A scan is
+ * shared between workers, so it is cheaper with more of them.
+ *
+ * @param strategy receives the estimates and the chosen path
+ * @param index an index over the cache (may be NULL)
+ * @param filter the filter (may be NULL)
+ * @param term the search term, in uppercase
+ * @param grouped whether matches are grouped into stations
+ * @param workers the number of workers sharing a scan
+ * @param count the number of navaids in the cache
+ */
+void choose_strategy(struct strategy *strategy, const struct index *index,
+    const struct filter *filter, const char *term, bool grouped,
+    int workers, int count)
+{
+    memset(strategy, 0, sizeof(struct strategy));
+    strategy->count = count;
+    strategy->filtered = filter != NULL;
+    for (int p = 0; p < PATHS; ++p)
+        strategy->rows[p] = -1;
+
+    strategy->rows[PATH_SCAN] = count;
+    strategy->cost[PATH_SCAN] = count *
+        (SCAN_COST + (filter != NULL ? BLOCK_COST : 0)) /
+        (workers > 0 ? workers : 1);
+
+    if (index != NULL) {
+        double rows = estimate_lookup(index, term);
+        strategy->rows[PATH_IDENT] = rows;
+        strategy->cost[PATH_IDENT] = lookup_cost(rows, count, ENTRY_COST,
+            filter != NULL);
+    }
+
+    if (index != NULL && filter != NULL && !grouped) {
+        double *min = &strategy->min_frequency;
+        double *max = &strategy->max_frequency;
+        if (filter_bounds(filter, "freq", min, max)) {
+            double rows = count_bands(index, *min, *max);
+            strategy->rows[PATH_BANDS] = rows;
+            strategy->cost[PATH_BANDS] = lookup_cost(rows, count, 0, true);
+        }
+
+        struct bounds *b = &strategy->bounds;
+        bool lat = filter_bounds(filter, "lat", &b->min.lat, &b->max.lat);
+        bool lon = filter_bounds(filter, "lon", &b->min.lon, &b->max.lon);
+        if (lat || lon) {
+            double rows = count_cells(index, b);
+            strategy->rows[PATH_CELLS] = rows;
+            strategy->cost[PATH_CELLS] = lookup_cost(rows, count, 0, true);
+        }
+    }
+
+    strategy->path = PATH_SCAN;
+    for (int p = 0; p < PATHS; ++p)
+        if (strategy->rows[p] >= 0 &&
+            strategy->cost[p] < strategy->cost[strategy->path])
+            strategy->path = p;
+}
+
+/**
+ * Prints the estimates and the chosen path of a search to standard output.
+ *
+ * The chosen path is marked with an asterisk, followed by the number of
+ * navaids it actually examined and the tests applied to them.
+ *
+ * @param strategy the strategy of the search
+ * @param term the search term
+ * @param examined the number of navaids or index entries examined
+ */
+void explain_strategy(const struct strategy *strategy, const char *term,
+    long examined)
+{
+    printf("Plan for %s among %d navaid%s:\n", term, strategy->count,
+        strategy->count == 1 ? "" : "s");
+    for (int p = 0; p < PATHS; ++p) {
+        char mark = p == (int)strategy->path ? '*' : ' ';
+        if (strategy->rows[p] < 0)
+            printf("  %c %-10s %10s\n", mark, path_names[p], "-");
+        else
+            printf("  %c %-10s %10.0f rows, cost %.1f\n", mark,
+                path_names[p], strategy->rows[p], strategy->cost[p]);
+    }
+
+    bool match = strategy->path != PATH_IDENT;
+    const char *tests = match && strategy->filtered ? "term and filter" :
+        match ? "term" : strategy->filtered ? "filter" : NULL;
+    printf("  Examined %ld by %s", examined, path_names[strategy->path]);
+    if (tests != NULL)
+        printf(", testing %s", tests);
+    putchar('\n');
+}
@@ -0,0 +1,66 @@
+/**
+ * @file planner.h
+ *
+ * Choose how to find the navaids that match a search.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef planner_h
+#define planner_h
+
+#include <stdbool.h>
+
+#include "types.h"
+
+struct filter;
+struct index;
+
+/**
+ * Ways of finding the navaids that may match a search.
+ */
+enum AccessPath {
+    PATH_SCAN,      ///< Scan the whole cache
+    PATH_IDENT,     ///< Look up codes and ICAO codes in the index
+    PATH_BANDS,     ///< Look up frequency bands in the index
+    PATH_CELLS,     ///< Look up one degree cells in the index
+    PATHS           ///< Number of access paths
+};
+
+/**
+ * Estimates for each access path and the path chosen to drive a search.
+ *
+ * The search term and the filter are applied to the navaids found by the
+ * driving path, except the term when the path is PATH_IDENT.
+ */
+struct strategy {
+    enum AccessPath path;   ///< The driving path
+    double rows[PATHS];     ///< Estimated navaids examined, < 0 if unusable
+    double cost[PATHS];     ///< Estimated cost of each path
+    double min_frequency;   ///< Lowest frequency the filter selects
+    double max_frequency;   ///< Highest frequency the filter selects
+    struct bounds bounds;   ///< Bounds of the positions the filter selects
+    int count;              ///< Number of navaids in the cache
+    bool filtered;          ///< Whether there is a filter
+};
+
+void choose_strategy(struct strategy *strategy, const struct index *index,
+    const struct filter *filter, const char *term, bool grouped,
+    int workers, int count);
+void explain_strategy(const struct strategy *strategy, const char *term,
+    long examined);
+
+#endif
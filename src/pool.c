@@ -0,0 +1,281 @@
+/**
+ * @file pool.c
+ *
+ * Thread pool with work stealing.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "pool.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Maximum number of threads in a pool.
+ */
+#define POOL_MAX 256
+
+/**
+ * Worker structure.
+ *
+ * Each worker owns a range of task indexes. It takes tasks from the front
+ * of its own range and, when that is empty, steals the back half of
+ * another worker's range.
+ */
+struct worker {
+    pthread_t thread;       ///< Thread (unused for worker 0)
+    pthread_mutex_t lock;   ///< Protects the task range
+    int begin;              ///< First task in the range
+    int end;                ///< End of the range (exclusive)
+    int id;                 ///< Index of the worker
+    struct pool *pool;      ///< Pool the worker belongs to
+};
+
+/**
+ * Thread pool structure.
+ *
+ * Worker 0 is the calling thread, which takes part in each run, so a pool
+ * of size 1 creates no threads at all.
+ */
+struct pool {
+    int size;                   ///< Number of workers, including the caller
+    struct worker *workers;     ///< Workers
+    pthread_mutex_t lock;       ///< Protects the fields below
+    pthread_cond_t start;       ///< Signalled when a run starts
+    pthread_cond_t done;        ///< Signalled when a worker finishes a run
+    unsigned generation;        ///< Incremented for each run
+    int active;                 ///< Number of threads still running
+    bool quit;                  ///< Set when the pool is destroyed
+    task_function work;         ///< Task function for the current run
+    void *data;                 ///< Task data for the current run
+};
+
+/**
+ * Takes the next task from a worker's own range.
+ *
+ * @param w a pointer to the worker
+ * @return the task index, or -1 if the range is empty
+ */
+static int take(struct worker *w)
+{
+    int task = -1;
+    pthread_mutex_lock(&w->lock);
+    if (w->begin < w->end)
+        task = w->begin++;
+    pthread_mutex_unlock(&w->lock);
+    return task;
+}
+
+/**
+ * Steals half of the remaining tasks of another worker.
+ *
+ * Victims are tried in turn, starting with the next worker.
+ *
+ * @param w a pointer to the worker that steals
+ * @return true if any tasks were stolen
+ */
+static bool steal(struct worker *w)
+{
+    struct pool *pool = w->pool;
+    for (int i = 1; i < pool->size; ++i) {
+        struct worker *v = &pool->workers[(w->id + i) % pool->size];
+        pthread_mutex_lock(&v->lock);
+        int n = (v->end - v->begin + 1) / 2;
+        if (n > 0) {
+            v->end -= n;
+            pthread_mutex_lock(&w->lock);
+            w->begin = v->end;
+            w->end = v->end + n;
+            pthread_mutex_unlock(&w->lock);
+        }
+        pthread_mutex_unlock(&v->lock);
+        if (n > 0)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Runs tasks until none are left for a worker to take or steal.
+ *
+ * @param w a pointer to the worker
+ */
+static void process(struct worker *w)
+{
+    struct pool *pool = w->pool;
+    do {
+        int task;
+        while ((task = take(w)) != -1)
+            pool->work(task, w->id, pool->data);
+    } while (steal(w));
+}
+
+/**
+ * Thread function for workers other than the caller.
+ *
+ * @param arg a pointer to the worker
+ * @return NULL
+ */
+static void *run_worker(void *arg)
+{
+    struct worker *w = arg;
+    struct pool *pool = w->pool;
+    unsigned seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->quit)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        seen = pool->generation;
+        bool quit = pool->quit;
+        pthread_mutex_unlock(&pool->lock);
+        if (quit)
+            return NULL;
+
+        process(w);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * Creates a thread pool.
+ *
+ * The pointer returned must be destroyed after use with destroy_pool.
+ *
+ * @param threads the number of threads, or 0 for one per online processor
+ * @return a pointer to a thread pool (never returns NULL)
+ */
+struct pool *create_pool(int threads)
+{
+    if (threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (int)n : 1;
+    }
+    if (threads > POOL_MAX)
+        threads = POOL_MAX;
+
+    struct pool *pool;
+    if ((pool = calloc(1, sizeof(struct pool))) == NULL ||
+        (pool->workers = calloc(threads, sizeof(struct worker))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    pool->size = threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int i = 0; i < threads; ++i) {
+        struct worker *w = &pool->workers[i];
+        w->id = i;
+        w->pool = pool;
+        pthread_mutex_init(&w->lock, NULL);
+        if (i > 0 && pthread_create(&w->thread, NULL, run_worker, w) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+/**
+ * Destroys a thread pool, stopping its threads.
+ *
+ * @param pool a pointer to a thread pool (may be NULL)
+ */
+void destroy_pool(struct pool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->size; ++i) {
+        if (i > 0)
+            pthread_join(pool->workers[i].thread, NULL);
+        pthread_mutex_destroy(&pool->workers[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->workers);
+    free(pool);
+}
+
+/**
+ * Returns the number of workers in a thread pool, including the caller.
+ *
+ * @param pool a pointer to a thread pool
+ * @return the number of workers
+ */
+int pool_size(const struct pool *pool)
+{
+    return pool->size;
+}
+
+/**
+ * Runs a set of tasks on a thread pool and waits for them to complete.
+ *
+ * Tasks are divided evenly between the workers, and workers that run out
+ * steal from the others, so tasks of uneven cost still keep every worker
+ * busy. The calling thread is worker 0. Tasks may run in any order and
+ * must only share data that is read-only or partitioned by task or worker.
+ *
+ * @param pool a pointer to a thread pool
+ * @param tasks the number of tasks
+ * @param work the task function
+ * @param data data passed to every task
+ */
+void run_pool(struct pool *pool, int tasks, task_function work, void *data)
+{
+    assert(pool != NULL && tasks >= 0 && work != NULL);
+
+    for (int i = 0; i < pool->size; ++i) {
+        struct worker *w = &pool->workers[i];
+        w->begin = (int)((long long)tasks * i / pool->size);
+        w->end = (int)((long long)tasks * (i + 1) / pool->size);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->work = work;
+    pool->data = data;
+    pool->active = pool->size - 1;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    process(&pool->workers[0]);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,41 @@
+/**
+ * @file pool.h
+ *
+ * Thread pool with work stealing.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef pool_h
+#define pool_h
+
+struct pool;
+
+/**
+ * Task function run by a thread pool.
+ *
+ * @param task the index of the task
+ * @param worker the index of the worker running the task
+ * @param data data shared by all tasks
+ */
+typedef void (*task_function)(int task, int worker, void *data);
+
+struct pool *create_pool(int threads);
+void destroy_pool(struct pool *pool);
+int pool_size(const struct pool *pool);
+void run_pool(struct pool *pool, int tasks, task_function work, void *data);
+
+#endif
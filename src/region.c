@@ -0,0 +1,786 @@
+/**
+ * @file region.c
+ *
+ * Search regions made of boxes and polygons.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "region.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "util.h"
+
+/**
+ * Minimum number of cells along each side of a polygon's grid.
+ */
+#define GRID_MIN 4
+
+/**
+ * Maximum number of cells along each side of a polygon's grid.
+ */
+#define GRID_MAX 256
+
+/**
+ * Margin in degrees added around an edge when finding the cells it
+ * crosses, so a point on the border of two cells sees the edge from both.
+ */
+#define GRID_MARGIN 1e-9
+
+/**
+ * State of a cell in a polygon's grid.
+ */
+enum CellState {
+    OUTSIDE,            ///< Wholly outside the polygon
+    INSIDE,             ///< Wholly inside the polygon
+    CROSSED_OUTSIDE,    ///< Crossed by edges, with its centre outside
+    CROSSED_INSIDE      ///< Crossed by edges, with its centre inside
+};
+
+/**
+ * Polygon, with a grid of cells over its bounding box for locating points.
+ *
+ * Longitudes of the vertices are continuous, so a polygon that crosses the
+ * antimeridian has longitudes beyond 180° or -180° rather than a jump.
+ */
+struct polygon {
+    struct coordinate *vertices;    ///< Vertices, the last joined to the first
+    int count;                      ///< Number of vertices
+    struct bounds box;              ///< Bounding box of the vertices
+    int side;                       ///< Number of cells along each side
+    double width;                   ///< Width of a cell in degrees
+    double height;                  ///< Height of a cell in degrees
+    unsigned char *cells;           ///< State of each cell, row by row
+    int *first;                     ///< Start of the edges of each cell
+    int *edges;                     ///< Edges crossing each cell, by cell
+};
+
+/**
+ * File of polygons, for messages.
+ */
+struct file {
+    char *path;                     ///< Path of the file
+    int polygons;                   ///< Number of polygons read from it
+};
+
+/**
+ * Region made of boxes and polygons.
+ *
+ * A coordinate is in the region if it is in any of its boxes or polygons.
+ */
+struct region {
+    struct bounds *boxes;           ///< Boxes, which may wrap at 180°
+    size_t box_count;               ///< Number of boxes
+    size_t box_capacity;            ///< Capacity of the boxes array
+    struct polygon *polygons;       ///< Polygons
+    size_t polygon_count;           ///< Number of polygons
+    size_t polygon_capacity;        ///< Capacity of the polygons array
+    struct file *files;             ///< Files the polygons were read from
+    size_t file_count;              ///< Number of files
+    size_t file_capacity;           ///< Capacity of the files array
+};
+
+/**
+ * State of a polygon file being read.
+ */
+struct reader {
+    struct region *region;          ///< The region receiving the polygons
+    struct file *file;              ///< The file being read
+    int line;                       ///< Number of the current line
+    int start;                      ///< Line of the first vertex of polygon
+    struct coordinate *vertices;    ///< Vertices of the current polygon
+    size_t count;                   ///< Number of vertices
+    size_t capacity;                ///< Capacity of the vertices array
+};
+
+/**
+ * Creates an empty region.
+ *
+ * This function never returns NULL. The region must be destroyed after use
+ * with destroy_region.
+ *
+ * @return a pointer to the region
+ */
+struct region *create_region()
+{
+    struct region *region;
+    if ((region = calloc(1, sizeof(struct region))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    return region;
+}
+
+/**
+ * Adds a box to a region.
+ *
+ * A box whose minimum longitude is greater than its maximum longitude
+ * wraps at the antimeridian, e.g. left=170 and right=-170 covers the 20°
+ * either side of 180°.
+ *
+ * @param region a pointer to the region
+ * @param box a pointer to the box
+ */
+void add_box(struct region *region, const struct bounds *box)
+{
+    assert(region != NULL);
+    region->boxes = reserve(region->boxes, &region->box_capacity,
+        region->box_count + 1, sizeof(struct bounds));
+    region->boxes[region->box_count++] = *box;
+}
+
+/**
+ * Converts a position in cells to the index of a cell, clamped to the grid.
+ *
+ * @param x the position in cells (may be infinite or not a number)
+ * @param side the number of cells along the side of the grid
+ * @return the index of the cell
+ */
+static int cell_index(double x, int side)
+{
+    if (!(x >= 0))
+        return 0;
+    if (x >= side)
+        return side - 1;
+    return (int)x;
+}
+
+/**
+ * Finds the column of a polygon's grid containing a longitude.
+ *
+ * @param polygon a pointer to the polygon
+ * @param lon the longitude
+ * @return the column, clamped to the grid
+ */
+static int column(const struct polygon *polygon, double lon)
+{
+    return cell_index((lon - polygon->box.min.lon) / polygon->width,
+        polygon->side);
+}
+
+/**
+ * Finds the row of a polygon's grid containing a latitude.
+ *
+ * @param polygon a pointer to the polygon
+ * @param lat the latitude
+ * @return the row, clamped to the grid
+ */
+static int row(const struct polygon *polygon, double lat)
+{
+    return cell_index((lat - polygon->box.min.lat) / polygon->height,
+        polygon->side);
+}
+
+/**
+ * Visits the cells of a polygon's grid that an edge crosses.
+ *
+ * The edge is clipped to each column it spans, so a long diagonal edge is
+ * only added to the cells along it rather than to its bounding box. Without
+ * a fill array, the cells' edge counts are incremented in first; with one,
+ * the edge is stored at the next free position of each cell.
+ *
+ * @param polygon a pointer to the polygon
+ * @param e the edge, from vertex e to the next vertex
+ * @param fill the next free position of each cell (may be NULL)
+ */
+static void add_edge(struct polygon *polygon, int e, int *fill)
+{
+    const struct coordinate *a = &polygon->vertices[e];
+    const struct coordinate *b = &polygon->vertices[(e + 1) % polygon->count];
+    double x0 = fmin(a->lon, b->lon), x1 = fmax(a->lon, b->lon);
+    int c0 = column(polygon, x0 - GRID_MARGIN);
+    int c1 = column(polygon, x1 + GRID_MARGIN);
+    for (int c = c0; c <= c1; ++c) {
+        double y0 = a->lat, y1 = b->lat;
+        if (a->lon != b->lon) {
+            double left = polygon->box.min.lon + c * polygon->width;
+            double lo = fmax(x0, left), hi = fmin(x1, left + polygon->width);
+            if (lo > hi)
+                lo = hi = (lo + hi) / 2;
+            double slope = (b->lat - a->lat) / (b->lon - a->lon);
+            y0 = a->lat + (lo - a->lon) * slope;
+            y1 = a->lat + (hi - a->lon) * slope;
+        }
+        int r0 = row(polygon, fmin(y0, y1) - GRID_MARGIN);
+        int r1 = row(polygon, fmax(y0, y1) + GRID_MARGIN);
+        for (int r = r0; r <= r1; ++r) {
+            int cell = r * polygon->side + c;
+            if (fill == NULL)
+                ++polygon->first[cell + 1];
+            else
+                polygon->edges[fill[cell]++] = e;
+        }
+    }
+}
+
+/**
+ * Compares doubles for sorting.
+ *
+ * @param a pointer to the first double
+ * @param b pointer to the second double
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_doubles(const void *a, const void *b)
+{
+    const double *x = a, *y = b;
+    return (*x > *y) - (*x < *y);
+}
+
+/**
+ * Classifies the cells of a polygon's grid.
+ *
+ * Each row is scanned along the latitude of its cell centres. The edges
+ * crossing that latitude are sorted by longitude, so whether each centre
+ * is inside follows from the number of crossings to its left.
+ *
+ * @param polygon a pointer to the polygon, with the edges of its cells
+ */
+static void classify(struct polygon *polygon)
+{
+    double *xs;
+    if ((xs = malloc(polygon->count * sizeof(double))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int r = 0; r < polygon->side; ++r) {
+        double y = polygon->box.min.lat + (r + 0.5) * polygon->height;
+        int n = 0;
+        for (int e = 0; e < polygon->count; ++e) {
+            const struct coordinate *a = &polygon->vertices[e];
+            const struct coordinate *b =
+                &polygon->vertices[(e + 1) % polygon->count];
+            if ((a->lat > y) != (b->lat > y))
+                xs[n++] = a->lon +
+                    (y - a->lat) * (b->lon - a->lon) / (b->lat - a->lat);
+        }
+        qsort(xs, n, sizeof(double), compare_doubles);
+        for (int c = 0, k = 0; c < polygon->side; ++c) {
+            double x = polygon->box.min.lon + (c + 0.5) * polygon->width;
+            while (k < n && xs[k] < x)
+                ++k;
+            int cell = r * polygon->side + c;
+            bool inside = k % 2 == 1;
+            if (polygon->first[cell + 1] > polygon->first[cell])
+                polygon->cells[cell] =
+                    inside ? CROSSED_INSIDE : CROSSED_OUTSIDE;
+            else
+                polygon->cells[cell] = inside ? INSIDE : OUTSIDE;
+        }
+    }
+    free(xs);
+}
+
+/**
+ * Builds the grid of a polygon.
+ *
+ * The grid has about four cells for each vertex, within limits. Cells that
+ * no edge crosses are wholly inside or outside, so most points are located
+ * by one lookup. Each crossed cell keeps its edges, so a point in it is
+ * only tested against those.
+ *
+ * @param polygon a pointer to the polygon, with its vertices and box
+ */
+static void build_grid(struct polygon *polygon)
+{
+    int side = (int)ceil(2 * sqrt(polygon->count));
+    if (side < GRID_MIN)
+        side = GRID_MIN;
+    if (side > GRID_MAX)
+        side = GRID_MAX;
+    polygon->side = side;
+    polygon->width = (polygon->box.max.lon - polygon->box.min.lon) /
+        polygon->side;
+    polygon->height = (polygon->box.max.lat - polygon->box.min.lat) /
+        polygon->side;
+
+    size_t cells = (size_t)polygon->side * polygon->side;
+    int *fill;
+    if ((polygon->cells = malloc(cells)) == NULL ||
+        (polygon->first = calloc(cells + 1, sizeof(int))) == NULL ||
+        (fill = malloc(cells * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int e = 0; e < polygon->count; ++e)
+        add_edge(polygon, e, NULL);
+    for (size_t i = 0; i < cells; ++i)
+        polygon->first[i + 1] += polygon->first[i];
+    if ((polygon->edges = malloc((polygon->first[cells] + 1) * sizeof(int)))
+        == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(fill, polygon->first, cells * sizeof(int));
+    for (int e = 0; e < polygon->count; ++e)
+        add_edge(polygon, e, fill);
+    free(fill);
+    classify(polygon);
+}
+
+/**
+ * Adds the polygon whose vertices have been read to the region.
+ *
+ * Prints a message to standard error and exits with failure status if the
+ * polygon has fewer than three vertices, has no area or goes around a pole.
+ *
+ * @param reader a pointer to the reader
+ */
+static void end_polygon(struct reader *reader)
+{
+    if (reader->count == 0)
+        return;
+
+    const char *path = reader->file->path;
+    if (reader->count < 3) {
+        fprintf(stderr, "Polygon at line %d of %s has fewer than three "
+            "vertices\n", reader->start, path);
+        exit(EXIT_FAILURE);
+    }
+    const struct coordinate *first = &reader->vertices[0];
+    const struct coordinate *last = &reader->vertices[reader->count - 1];
+    if (fabs(last->lon - first->lon) > 180) {
+        fprintf(stderr, "Polygon at line %d of %s goes around a pole\n",
+            reader->start, path);
+        exit(EXIT_FAILURE);
+    }
+
+    struct region *region = reader->region;
+    region->polygons = reserve(region->polygons, &region->polygon_capacity,
+        region->polygon_count + 1, sizeof(struct polygon));
+    struct polygon *polygon = &region->polygons[region->polygon_count++];
+    memset(polygon, 0, sizeof(struct polygon));
+    polygon->count = (int)reader->count;
+    if ((polygon->vertices =
+        malloc(reader->count * sizeof(struct coordinate))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(polygon->vertices, reader->vertices,
+        reader->count * sizeof(struct coordinate));
+
+    polygon->box.min = polygon->box.max = *first;
+    for (int i = 1; i < polygon->count; ++i) {
+        const struct coordinate *v = &polygon->vertices[i];
+        polygon->box.min.lat = fmin(polygon->box.min.lat, v->lat);
+        polygon->box.min.lon = fmin(polygon->box.min.lon, v->lon);
+        polygon->box.max.lat = fmax(polygon->box.max.lat, v->lat);
+        polygon->box.max.lon = fmax(polygon->box.max.lon, v->lon);
+    }
+    if (polygon->box.max.lat == polygon->box.min.lat ||
+        polygon->box.max.lon == polygon->box.min.lon) {
+        fprintf(stderr, "Polygon at line %d of %s has no area\n",
+            reader->start, path);
+        exit(EXIT_FAILURE);
+    }
+    build_grid(polygon);
+    ++reader->file->polygons;
+    reader->count = 0;
+}
+
+/**
+ * Reads a vertex of a polygon from a row of a polygon file.
+ *
+ * A vertex is a latitude and longitude in decimal degrees, separated by a
+ * comma or whitespace. Blank rows end a polygon and rows beginning with
+ * '#' are comments. Each longitude is moved by 360° if needed to be within
+ * 180° of the one before, so polygons can cross the antimeridian.
+ *
+ * @param row the row
+ * @param data a pointer to the reader
+ */
+static void read_vertex(char *row, void *data)
+{
+    struct reader *reader = data;
+    ++reader->line;
+
+    char *p = row + strspn(row, " \t\r");
+    if (*p == '#')
+        return;
+    if (*p == '\0') {
+        end_polygon(reader);
+        return;
+    }
+
+    struct coordinate v;
+    char *end;
+    v.lat = strtod(p, &end);
+    p = end + strspn(end, " \t,");
+    v.lon = strtod(p, &end);
+    if (end == p || end[strspn(end, " \t\r")] != '\0' ||
+        !(fabs(v.lat) <= 90) || !(fabs(v.lon) <= 180)) {
+        fprintf(stderr, "Invalid vertex in %s at line %d: %s\n",
+            reader->file->path, reader->line, row);
+        exit(EXIT_FAILURE);
+    }
+    if (reader->count > 0) {
+        double previous = reader->vertices[reader->count - 1].lon;
+        if (v.lon - previous > 180)
+            v.lon -= 360;
+        else if (v.lon - previous < -180)
+            v.lon += 360;
+    }
+    if (reader->count == 0)
+        reader->start = reader->line;
+    reader->vertices = reserve(reader->vertices, &reader->capacity,
+        reader->count + 1, sizeof(struct coordinate));
+    reader->vertices[reader->count++] = v;
+}
+
+/**
+ * Reads polygons from a file and adds them to a region.
+ *
+ * The file has one vertex per line, as a latitude and longitude in decimal
+ * degrees, e.g. "51.5,-0.5", with polygons separated by blank lines. The
+ * last vertex of a polygon is joined to the first. The file may be
+ * compressed with gzip.
+ *
+ * Prints a message to standard error and exits with failure status if the
+ * file cannot be read or is malformed.
+ *
+ * @param region a pointer to the region
+ * @param path the path to the polygon file
+ */
+void read_polygons(struct region *region, const char *path)
+{
+    assert(region != NULL);
+    region->files = reserve(region->files, &region->file_capacity,
+        region->file_count + 1, sizeof(struct file));
+    struct file *file = &region->files[region->file_count++];
+    file->path = strdup_f(path);
+    file->polygons = 0;
+
+    struct reader reader = { region, file, 0, 0, NULL, 0, 0 };
+    read_rows(path, read_vertex, &reader);
+    end_polygon(&reader);
+    free(reader.vertices);
+
+    if (file->polygons == 0) {
+        fprintf(stderr, "No polygons in %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Checks if a coordinate is in a box, which may wrap at the antimeridian.
+ *
+ * @param box a pointer to the box
+ * @param c a pointer to the coordinate
+ * @return true if the coordinate is in the box
+ */
+static bool in_box(const struct bounds *box, const struct coordinate *c)
+{
+    if (c->lat < box->min.lat || c->lat > box->max.lat)
+        return false;
+    if (box->min.lon > box->max.lon)
+        return !(c->lon < box->min.lon && c->lon > box->max.lon);
+    return !(c->lon < box->min.lon || c->lon > box->max.lon);
+}
+
+/**
+ * Calculates on which side of the line through a and b a point lies.
+ *
+ * @param a a pointer to the first point on the line
+ * @param b a pointer to the second point on the line
+ * @param p a pointer to the point
+ * @return positive if p is left of the line from a to b, negative if right
+ */
+static double orient(const struct coordinate *a, const struct coordinate *b,
+    const struct coordinate *p)
+{
+    return (b->lon - a->lon) * (p->lat - a->lat) -
+        (b->lat - a->lat) * (p->lon - a->lon);
+}
+
+/**
+ * Checks if the segment from p to q crosses the segment from a to b.
+ *
+ * Points on a line count as being on its right, so a segment passing
+ * through a vertex crosses exactly one of the two edges that meet there
+ * if it passes from one side of the polygon to the other, and neither or
+ * both if it only touches.
+ *
+ * @return true if the segments cross
+ */
+static bool crosses(const struct coordinate *p, const struct coordinate *q,
+    const struct coordinate *a, const struct coordinate *b)
+{
+    return (orient(a, b, p) > 0) != (orient(a, b, q) > 0) &&
+        (orient(p, q, a) > 0) != (orient(p, q, b) > 0);
+}
+
+/**
+ * Checks if a coordinate is in a polygon.
+ *
+ * Points in cells that no edge crosses are located by the cell. In a
+ * crossed cell, each edge of the cell that the segment from the point to
+ * the centre of the cell crosses moves the point to the other side of the
+ * polygon from the centre.
+ *
+ * @param polygon a pointer to the polygon
+ * @param lat the latitude of the point
+ * @param lon the longitude of the point, continuous with the polygon's
+ * @return true if the point is in the polygon
+ */
+static bool in_polygon(const struct polygon *polygon, double lat, double lon)
+{
+    if (!(lat >= polygon->box.min.lat && lat <= polygon->box.max.lat &&
+        lon >= polygon->box.min.lon && lon <= polygon->box.max.lon))
+        return false;
+
+    int r = row(polygon, lat), c = column(polygon, lon);
+    int cell = r * polygon->side + c;
+    switch (polygon->cells[cell]) {
+    case OUTSIDE:
+        return false;
+    case INSIDE:
+        return true;
+    }
+
+    struct coordinate point = { lat, lon }, centre = {
+        polygon->box.min.lat + (r + 0.5) * polygon->height,
+        polygon->box.min.lon + (c + 0.5) * polygon->width
+    };
+    bool inside = polygon->cells[cell] == CROSSED_INSIDE;
+    for (int k = polygon->first[cell]; k < polygon->first[cell + 1]; ++k) {
+        int e = polygon->edges[k];
+        if (crosses(&point, &centre, &polygon->vertices[e],
+            &polygon->vertices[(e + 1) % polygon->count]))
+            inside = !inside;
+    }
+    return inside;
+}
+
+/**
+ * Checks if a coordinate is in a region.
+ *
+ * @param region a pointer to the region (may be NULL, for everywhere)
+ * @param c a pointer to the coordinate
+ * @return true if the coordinate is in any box or polygon of the region
+ */
+bool in_region(const struct region *region, const struct coordinate *c)
+{
+    if (region == NULL)
+        return true;
+
+    for (size_t i = 0; i < region->box_count; ++i)
+        if (in_box(&region->boxes[i], c))
+            return true;
+    for (size_t i = 0; i < region->polygon_count; ++i) {
+        const struct polygon *polygon = &region->polygons[i];
+        if (in_polygon(polygon, c->lat, c->lon) ||
+            (polygon->box.max.lon > 180 &&
+                in_polygon(polygon, c->lat, c->lon + 360)) ||
+            (polygon->box.min.lon < -180 &&
+                in_polygon(polygon, c->lat, c->lon - 360)))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Checks if a box overlaps another, which may wrap at the antimeridian.
+ *
+ * @param a a pointer to the box that may wrap
+ * @param box a pointer to the other box
+ * @return true if the boxes overlap
+ */
+static bool box_overlaps(const struct bounds *a, const struct bounds *box)
+{
+    if (box->max.lat < a->min.lat || box->min.lat > a->max.lat)
+        return false;
+    if (a->min.lon > a->max.lon)
+        return !(box->max.lon < a->min.lon && box->min.lon > a->max.lon);
+    return !(box->max.lon < a->min.lon || box->min.lon > a->max.lon);
+}
+
+/**
+ * Checks if a box overlaps any cell of a polygon that is not wholly outside.
+ *
+ * @param polygon a pointer to the polygon
+ * @param box a pointer to the box
+ * @param shift degrees added to the longitudes of the box
+ * @return true if the box may contain points in the polygon
+ */
+static bool polygon_overlaps(const struct polygon *polygon,
+    const struct bounds *box, double shift)
+{
+    double min_lon = box->min.lon + shift, max_lon = box->max.lon + shift;
+    if (box->max.lat < polygon->box.min.lat ||
+        box->min.lat > polygon->box.max.lat ||
+        max_lon < polygon->box.min.lon || min_lon > polygon->box.max.lon)
+        return false;
+
+    int r0 = row(polygon, box->min.lat), r1 = row(polygon, box->max.lat);
+    int c0 = column(polygon, min_lon), c1 = column(polygon, max_lon);
+    for (int r = r0; r <= r1; ++r)
+        for (int c = c0; c <= c1; ++c)
+            if (polygon->cells[r * polygon->side + c] != OUTSIDE)
+                return true;
+    return false;
+}
+
+/**
+ * Checks if a box overlaps a region.
+ *
+ * The check is used to skip data whose bounding box is outside the region,
+ * so it may report an overlap where there is none, but never the reverse.
+ *
+ * @param region a pointer to the region (may be NULL, for everywhere)
+ * @param box a pointer to the box, which must not wrap
+ * @return true if the box may contain coordinates in the region
+ */
+bool overlaps_region(const struct region *region, const struct bounds *box)
+{
+    if (region == NULL)
+        return true;
+
+    for (size_t i = 0; i < region->box_count; ++i)
+        if (box_overlaps(&region->boxes[i], box))
+            return true;
+    for (size_t i = 0; i < region->polygon_count; ++i) {
+        const struct polygon *polygon = &region->polygons[i];
+        if (polygon_overlaps(polygon, box, 0) ||
+            (polygon->box.max.lon > 180 &&
+                polygon_overlaps(polygon, box, 360)) ||
+            (polygon->box.min.lon < -180 &&
+                polygon_overlaps(polygon, box, -360)))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Finds a box enclosing a region.
+ *
+ * Longitudes are between -180° and 180°, so a region with a box or polygon
+ * that crosses the antimeridian is enclosed by all longitudes. Without a
+ * region, the box encloses the whole world.
+ *
+ * @param region a pointer to the region (may be NULL)
+ * @param box receives the enclosing box
+ */
+void region_bounds(const struct region *region, struct bounds *box)
+{
+    box->min.lat = -90;
+    box->max.lat = 90;
+    box->min.lon = -180;
+    box->max.lon = 180;
+    if (region == NULL || region->box_count + region->polygon_count == 0)
+        return;
+
+    struct bounds all = { { INFINITY, INFINITY }, { -INFINITY, -INFINITY } };
+    for (size_t i = 0; i < region->box_count + region->polygon_count; ++i) {
+        const struct bounds *b = i < region->box_count ?
+            &region->boxes[i] :
+            &region->polygons[i - region->box_count].box;
+        all.min.lat = fmin(all.min.lat, b->min.lat);
+        all.max.lat = fmax(all.max.lat, b->max.lat);
+        if (b->min.lon > b->max.lon || b->min.lon < -180 || b->max.lon > 180) {
+            all.min.lon = -180;
+            all.max.lon = 180;
+        } else {
+            all.min.lon = fmin(all.min.lon, b->min.lon);
+            all.max.lon = fmax(all.max.lon, b->max.lon);
+        }
+    }
+    *box = all;
+}
+
+/**
+ * Prints the boxes and polygon files of a region to standard output.
+ *
+ * If no region is in use, prints nothing.
+ *
+ * @param region a pointer to the region (may be NULL)
+ * @return true if anything was printed, otherwise false
+ */
+bool show_region(const struct region *region)
+{
+    if (region == NULL)
+        return false;
+
+    for (size_t i = 0; i < region->box_count; ++i) {
+        const struct bounds *box = &region->boxes[i];
+        printf("Using bounds top=%.02f, right=%.02f, bottom=%.02f, "
+            "left=%.02f\n", box->max.lat, box->max.lon, box->min.lat,
+            box->min.lon);
+    }
+    for (size_t i = 0; i < region->file_count; ++i) {
+        const struct file *file = &region->files[i];
+        printf("Using %d polygon%s from %s\n", file->polygons,
+            file->polygons == 1 ? "" : "s", file->path);
+    }
+    return region->box_count > 0 || region->file_count > 0;
+}
+
+/**
+ * Writes an exact description of a region to a stream.
+ *
+ * Two regions with the same description contain the same coordinates.
+ *
+ * @param region a pointer to the region (may be NULL)
+ * @param f the stream
+ */
+void write_region(const struct region *region, FILE *f)
+{
+    if (region == NULL)
+        return;
+
+    for (size_t i = 0; i < region->box_count; ++i) {
+        const struct bounds *box = &region->boxes[i];
+        fprintf(f, "bounds=%a,%a,%a,%a\n", box->max.lat, box->max.lon,
+            box->min.lat, box->min.lon);
+    }
+    for (size_t i = 0; i < region->polygon_count; ++i) {
+        const struct polygon *polygon = &region->polygons[i];
+        fputs("polygon=", f);
+        for (int k = 0; k < polygon->count; ++k)
+            fprintf(f, "%a,%a;", polygon->vertices[k].lat,
+                polygon->vertices[k].lon);
+        fputc('\n', f);
+    }
+}
+
+/**
+ * Destroys a region.
+ *
+ * @param region a pointer to the region (may be NULL)
+ */
+void destroy_region(struct region *region)
+{
+    if (region == NULL)
+        return;
+
+    for (size_t i = 0; i < region->polygon_count; ++i) {
+        struct polygon *polygon = &region->polygons[i];
+        free(polygon->vertices);
+        free(polygon->cells);
+        free(polygon->first);
+        free(polygon->edges);
+    }
+    for (size_t i = 0; i < region->file_count; ++i)
+        free(region->files[i].path);
+    free(region->files);
+    free(region->polygons);
+    free(region->boxes);
+    free(region);
+}
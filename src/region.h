@@ -0,0 +1,42 @@
+/**
+ * @file region.h
+ *
+ * Search regions made of boxes and polygons.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef region_h
+#define region_h
+
+#include <stdbool.h>
+#include <stdio.h>
+
+struct bounds;
+struct coordinate;
+struct region;
+
+struct region *create_region();
+void add_box(struct region *region, const struct bounds *box);
+void read_polygons(struct region *region, const char *path);
+bool in_region(const struct region *region, const struct coordinate *c);
+bool overlaps_region(const struct region *region, const struct bounds *box);
+void region_bounds(const struct region *region, struct bounds *box);
+bool show_region(const struct region *region);
+void write_region(const struct region *region, FILE *f);
+void destroy_region(struct region *region);
+
+#endif
@@ -0,0 +1,793 @@
+/**
+ * @file results.c
+ *
+ * Persistent cache of search results.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "results.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "flags.h"
+#include "main.h"
+#include "region.h"
+#include "search.h"
+#include "types.h"
+#include "util.h"
+
+/**
+ * Magic number identifying a result cache file ("NVSR").
+ */
+#define RESULTS_MAGIC 0x5253564eU
+
+/**
+ * Version of the result cache file layout.
+ */
+#define RESULTS_LAYOUT 1
+
+/**
+ * Name of the result cache file in the user cache directory.
+ */
+#define RESULTS_NAME "results.db"
+
+/**
+ * Maximum total size of the results kept in the result cache file.
+ */
+#define RESULTS_LIMIT (16 * 1024 * 1024)
+
+/**
+ * Maximum size of one result. Larger results are not kept.
+ */
+#define RESULT_MAX (RESULTS_LIMIT / 4)
+
+/**
+ * Minimum number of slots in the hash table of a result cache file.
+ */
+#define RESULTS_SLOTS 64
+
+/**
+ * Size of the chunks in which a large captured output is copied.
+ */
+#define COPY_CHUNK (64 * 1024)
+
+/**
+ * Result cache file header.
+ *
+ * The header is followed by a hash table of slots, open addressed with
+ * linear probing, and then the data of the results. The data of a result
+ * is its query, followed by the standard output and standard error of the
+ * search.
+ */
+struct header {
+    uint32_t magic;     ///< RESULTS_MAGIC
+    uint32_t layout;    ///< RESULTS_LAYOUT
+    uint64_t dataset;   ///< Version of the data the results came from
+    uint64_t clock;     ///< Clock at the last use of any result
+    uint32_t capacity;  ///< Number of slots, a power of two
+    uint32_t count;     ///< Number of results
+};
+
+/**
+ * Hash table slot in a result cache file.
+ */
+struct slot {
+    uint64_t hash;      ///< Hash of the query
+    uint64_t used;      ///< Clock at the last use of the result
+    uint64_t offset;    ///< Offset of the data of the result
+    uint32_t query;     ///< Size of the query, 0 for an empty slot
+    uint32_t output;    ///< Size of the standard output
+    uint32_t errors;    ///< Size of the standard error
+    uint32_t unused;    ///< Padding
+};
+
+/**
+ * Result to be written to a result cache file.
+ */
+struct result {
+    struct slot slot;       ///< Hash, last use and sizes
+    const char *query;      ///< Query
+    const char *output;     ///< Standard output
+    const char *errors;     ///< Standard error
+};
+
+/**
+ * Result cache file mapped into memory.
+ */
+struct table {
+    void *base;                     ///< Base address of the mapping
+    size_t size;                    ///< Size of the mapping
+    int fd;                         ///< File descriptor, for updating
+    const struct header *header;    ///< Header
+    const struct slot *slots;       ///< Hash table
+};
+
+/**
+ * Result cache for one search.
+ */
+struct results {
+    char *path;         ///< Path to the result cache file
+    char *query;        ///< Normalized query
+    size_t length;      ///< Size of the query
+    uint64_t hash;      ///< Hash of the query
+    uint64_t dataset;   ///< Version of the data
+    FILE *capture[2];   ///< Captured standard output and error
+    int saved[2];       ///< Saved standard output and error descriptors
+};
+
+/**
+ * Results being recorded, if any, to be finished if the program exits.
+ */
+static struct results *recording;
+
+/**
+ * Updates a hash with the identity and version of a file.
+ *
+ * A missing file is hashed too, so that creating it changes the hash.
+ *
+ * @param path the path to the file
+ * @param hash the hash so far
+ * @return the updated hash
+ */
+static uint64_t hash_file(const char *path, uint64_t hash)
+{
+    struct stat st;
+    int64_t version[4] = { 0, 0, -1, 0 };
+    if (stat(path, &st) == 0) {
+        version[0] = (int64_t)st.st_dev;
+        version[1] = (int64_t)st.st_ino;
+        version[2] = (int64_t)st.st_size;
+        version[3] = (int64_t)st.st_mtime;
+    }
+    hash = fnv1a(path, strlen(path) + 1, hash);
+    return fnv1a(version, sizeof version, hash);
+}
+
+/**
+ * Updates a hash with the identity and version of a file in a directory.
+ *
+ * @param dir the directory
+ * @param name the path of the file relative to the directory
+ * @param hash the hash so far
+ * @return the updated hash
+ */
+static uint64_t hash_data(const char *dir, const char *name, uint64_t hash)
+{
+    char *path = data_path(dir, name);
+    hash = hash_file(path, hash);
+    free(path);
+    return hash;
+}
+
+/**
+ * Calculates the version of the data that a search might read.
+ *
+ * The version covers the navigation data in FG_ROOT and the FG_SCENERY
+ * overlays, the airport and fix data, the magnetic model with the current
+ * date, and the program version. Files are identified by their size and
+ * modification time, like the other caches, so the data files are never
+ * read.
+ *
+ * @param fg_root the FG_ROOT directory
+ * @param magnetic the path to the magnetic model (may be NULL)
+ * @return the version of the data
+ */
+static uint64_t dataset_version(const char *fg_root, const char *magnetic)
+{
+    uint64_t hash = fnv1a(PROJECT_VERSION, strlen(PROJECT_VERSION),
+        FNV_OFFSET);
+
+    const char *scenery = getenv("FG_SCENERY");
+    if (scenery != NULL) {
+        char *paths = strdup_f(scenery), *saveptr;
+        for (char *root = strtok_r(paths, ":", &saveptr); root != NULL;
+            root = strtok_r(NULL, ":", &saveptr)) {
+            hash = hash_data(root, "Navaids/nav.dat", hash);
+            hash = hash_data(root, "Navaids/nav.dat.gz", hash);
+        }
+        free(paths);
+    }
+    hash = hash_data(fg_root, "Navaids/nav.dat", hash);
+    hash = hash_data(fg_root, "Navaids/nav.dat.gz", hash);
+    hash = hash_data(fg_root, "Navaids/fix.dat.gz", hash);
+    hash = hash_data(fg_root, "Airports/apt.dat.gz", hash);
+
+    if (magnetic != NULL) {
+        int64_t day = (int64_t)(time(NULL) / 86400);
+        hash = hash_file(magnetic, hash);
+        hash = fnv1a(&day, sizeof day, hash);
+    }
+    return hash;
+}
+
+/**
+ * Creates the normalized query of a search.
+ *
+ * The query holds everything that affects the output of the search: the
+ * search restrictions and output flags, region, ordering, reference point,
+ * filter, magnetic model and items. Flags that do not affect the output,
+ * such as --shared and --threads, are left out. The reference point and
+ * the items are converted to uppercase, as they are searched for. Items
+ * stay in the order given, because results are printed in that order.
+ * Each part is terminated with a null character, so the query is binary
+ * data.
+ *
+ * The pointer returned must be freed after use.
+ *
+ * @param region a pointer to the region (may be NULL)
+ * @param order a pointer to the result ordering
+ * @param reference the reference point specification (may be NULL)
+ * @param where the filter expression (may be NULL)
+ * @param magnetic the path to the magnetic model (may be NULL)
+ * @param argc the number of items
+ * @param argv the items
+ * @param length a pointer to receive the size of the query
+ * @return the query
+ */
+static char *describe_query(const struct region *region,
+    const struct order *order, const char *reference, const char *where,
+    const char *magnetic, int argc, char **argv, size_t *length)
+{
+    extern struct flags flags;
+    const bool options[] = {
+        flags.airports, flags.conflicts, flags.coordinates, flags.dme,
+        flags.fixes, flags.fuzzy, flags.group, flags.ils, flags.morse,
+        flags.ndb, flags.quiet, flags.spacing, flags.suggest, flags.vor
+    };
+
+    char *query;
+    FILE *f;
+    if ((f = open_memstream(&query, length)) == NULL) {
+        perror("open_memstream");
+        exit(EXIT_FAILURE);
+    }
+    fputs("flags=", f);
+    for (size_t i = 0; i < sizeof options / sizeof options[0]; ++i)
+        fputc(options[i] ? '1' : '0', f);
+    fputc('\0', f);
+    write_region(region, f);
+    fputc('\0', f);
+    fprintf(f, "sort=%d,%d", (int)order->key, order->limit);
+    fputc('\0', f);
+    if (reference != NULL) {
+        fputs("reference=", f);
+        for (const char *p = reference; *p != '\0'; ++p)
+            fputc(toupper((unsigned char)*p), f);
+    }
+    fputc('\0', f);
+    if (where != NULL)
+        fprintf(f, "where=%s", where);
+    fputc('\0', f);
+    if (magnetic != NULL)
+        fprintf(f, "magnetic=%s", magnetic);
+    fputc('\0', f);
+    for (int i = 0; i < argc; ++i) {
+        for (const char *p = argv[i]; *p != '\0'; ++p)
+            fputc(toupper((unsigned char)*p), f);
+        fputc('\0', f);
+    }
+    if (fclose(f) != 0) {
+        perror("open_memstream");
+        exit(EXIT_FAILURE);
+    }
+    return query;
+}
+
+/**
+ * Maps the result cache file into memory.
+ *
+ * The file is only used if it is valid and its results came from the
+ * current version of the data, so results are invalidated as soon as the
+ * data changes.
+ *
+ * @param path the path to the result cache file
+ * @param dataset the version of the data
+ * @param table a pointer to the table structure to fill
+ * @return true if the file was mapped
+ */
+static bool map_table(const char *path, uint64_t dataset, struct table *table)
+{
+    int fd;
+    if ((fd = open(path, O_RDWR)) == -1 && (fd = open(path, O_RDONLY)) == -1)
+        return false;
+
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct header))
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    const struct header *header = base;
+    size_t size = st.st_size;
+    if (header->magic != RESULTS_MAGIC || header->layout != RESULTS_LAYOUT ||
+        header->dataset != dataset || header->capacity == 0 ||
+        (header->capacity & (header->capacity - 1)) != 0 ||
+        header->capacity > (size - sizeof(struct header)) /
+            sizeof(struct slot)) {
+        munmap(base, size);
+        close(fd);
+        return false;
+    }
+    table->base = base;
+    table->size = size;
+    table->fd = fd;
+    table->header = header;
+    table->slots = (const void *)((const char *)base + sizeof(struct header));
+    return true;
+}
+
+/**
+ * Unmaps the result cache file.
+ *
+ * @param table a pointer to the mapped table
+ */
+static void unmap_table(struct table *table)
+{
+    munmap(table->base, table->size);
+    close(table->fd);
+}
+
+/**
+ * Checks if the data of a slot lies within the result cache file.
+ *
+ * @param table a pointer to the mapped table
+ * @param slot a pointer to the slot
+ * @return true if the slot is in use and its data is within the file
+ */
+static bool valid_slot(const struct table *table, const struct slot *slot)
+{
+    uint64_t size = (uint64_t)slot->query + slot->output + slot->errors;
+    return slot->query != 0 && slot->offset <= table->size &&
+        size <= table->size - slot->offset;
+}
+
+/**
+ * Finds the slot holding the result of a query.
+ *
+ * @param table a pointer to the mapped table
+ * @param results a pointer to the result cache of the search
+ * @return a pointer to the slot, or NULL if there is no result
+ */
+static const struct slot *find_slot(const struct table *table,
+    const struct results *results)
+{
+    uint32_t mask = table->header->capacity - 1;
+    uint32_t k = (uint32_t)results->hash & mask;
+    for (uint32_t n = 0; n <= mask && table->slots[k].query != 0;
+        ++n, k = (k + 1) & mask) {
+        const struct slot *slot = &table->slots[k];
+        if (slot->hash == results->hash && slot->query == results->length &&
+            valid_slot(table, slot) &&
+            memcmp((const char *)table->base + slot->offset, results->query,
+                results->length) == 0)
+            return slot;
+    }
+    return NULL;
+}
+
+/**
+ * Compares results by last use, most recent first.
+ *
+ * @param a pointer to the first result
+ * @param b pointer to the second result
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_used(const void *a, const void *b)
+{
+    const struct result *x = a, *y = b;
+    if (x->slot.used != y->slot.used)
+        return x->slot.used > y->slot.used ? -1 : 1;
+    return 0;
+}
+
+/**
+ * Writes results to the result cache file.
+ *
+ * The file is written to a temporary file that is renamed into place, so
+ * other processes never see a partial file. The result cache is an
+ * optimization, so failure is silently ignored.
+ *
+ * @param path the path to the result cache file
+ * @param dataset the version of the data
+ * @param clock the clock at the last use of any result
+ * @param results the results to write
+ * @param count the number of results
+ */
+static void write_table(const char *path, uint64_t dataset, uint64_t clock,
+    struct result *results, uint32_t count)
+{
+    uint32_t capacity = RESULTS_SLOTS;
+    while (capacity < 2 * count)
+        capacity *= 2;
+    struct slot *slots;
+    if ((slots = calloc(capacity, sizeof(struct slot))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t offset = sizeof(struct header) + capacity * sizeof(struct slot);
+    for (uint32_t i = 0; i < count; ++i) {
+        struct slot *slot = &results[i].slot;
+        uint32_t k = (uint32_t)slot->hash & (capacity - 1);
+        while (slots[k].query != 0)
+            k = (k + 1) & (capacity - 1);
+        slot->offset = offset;
+        slots[k] = *slot;
+        offset += (uint64_t)slot->query + slot->output + slot->errors;
+    }
+    struct header header = {
+        .magic = RESULTS_MAGIC,
+        .layout = RESULTS_LAYOUT,
+        .dataset = dataset,
+        .clock = clock,
+        .capacity = capacity,
+        .count = count
+    };
+
+    char *tmp;
+    size_t n = strlen(path) + 32;
+    if ((tmp = malloc(n)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(tmp, n, "%s.%ld", path, (long)getpid());
+
+    FILE *f;
+    if ((f = fopen(tmp, "wb")) != NULL) {
+        bool ok = fwrite(&header, sizeof header, 1, f) == 1 &&
+            fwrite(slots, sizeof(struct slot), capacity, f) == capacity;
+        for (uint32_t i = 0; ok && i < count; ++i) {
+            const struct result *r = &results[i];
+            ok = fwrite(r->query, 1, r->slot.query, f) == r->slot.query &&
+                fwrite(r->output, 1, r->slot.output, f) == r->slot.output &&
+                fwrite(r->errors, 1, r->slot.errors, f) == r->slot.errors;
+        }
+        if (fclose(f) != 0 || !ok || rename(tmp, path) != 0)
+            unlink(tmp);
+    }
+    free(tmp);
+    free(slots);
+}
+
+/**
+ * Adds the result of a search to the result cache file.
+ *
+ * The new result is added to the results already in the file, most
+ * recently used first, and the least recently used results are dropped to
+ * keep the file within RESULTS_LIMIT.
+ *
+ * @param results a pointer to the result cache of the search
+ * @param output the standard output of the search
+ * @param output_size the size of the standard output
+ * @param errors the standard error of the search
+ * @param errors_size the size of the standard error
+ */
+static void store(const struct results *results, const char *output,
+    size_t output_size, const char *errors, size_t errors_size)
+{
+    if (results->length + output_size + errors_size > RESULT_MAX)
+        return;
+
+    struct table table;
+    bool mapped = map_table(results->path, results->dataset, &table);
+    uint32_t capacity = mapped ? table.header->capacity : 0;
+    uint64_t clock = mapped ? table.header->clock + 1 : 1;
+
+    struct result *kept;
+    if ((kept = malloc((capacity + 1) * sizeof(struct result))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    kept[0].slot = (struct slot){
+        .hash = results->hash,
+        .used = clock,
+        .query = (uint32_t)results->length,
+        .output = (uint32_t)output_size,
+        .errors = (uint32_t)errors_size
+    };
+    kept[0].query = results->query;
+    kept[0].output = output;
+    kept[0].errors = errors;
+
+    uint32_t count = 1;
+    const struct slot *replaced = mapped ? find_slot(&table, results) : NULL;
+    for (uint32_t k = 0; k < capacity; ++k) {
+        const struct slot *slot = &table.slots[k];
+        if (slot == replaced || !valid_slot(&table, slot))
+            continue;
+        const char *data = (const char *)table.base + slot->offset;
+        kept[count].slot = *slot;
+        kept[count].query = data;
+        kept[count].output = data + slot->query;
+        kept[count].errors = data + slot->query + slot->output;
+        ++count;
+    }
+    qsort(kept + 1, count - 1, sizeof(struct result), compare_used);
+
+    size_t total = 0;
+    uint32_t n = 0;
+    for (; n < count; ++n) {
+        const struct slot *slot = &kept[n].slot;
+        size_t size = (size_t)slot->query + slot->output + slot->errors;
+        if (total + size > RESULTS_LIMIT)
+            break;
+        total += size;
+    }
+    write_table(results->path, results->dataset, clock, kept, n);
+    free(kept);
+    if (mapped)
+        unmap_table(&table);
+}
+
+/**
+ * Copies a captured stream to its original stream.
+ *
+ * A capture that is small enough to be kept in the result cache is read
+ * into memory in one piece and returned; a larger capture is copied in
+ * chunks.
+ *
+ * @param capture the captured stream
+ * @param stream the original stream
+ * @param size a pointer to receive the size of the capture
+ * @return the captured data to be freed after use, or NULL if it is not
+ * kept
+ */
+static char *copy_capture(FILE *capture, FILE *stream, size_t *size)
+{
+    long end;
+    if (fseek(capture, 0, SEEK_END) != 0 || (end = ftell(capture)) < 0)
+        return NULL;
+    rewind(capture);
+    *size = (size_t)end;
+
+    char *data;
+    if (*size <= RESULT_MAX) {
+        if ((data = malloc(*size + 1)) == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        if (fread(data, 1, *size, capture) == *size) {
+            fwrite(data, 1, *size, stream);
+            return data;
+        }
+        free(data);
+        return NULL;
+    }
+
+    if ((data = malloc(COPY_CHUNK)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t n;
+    while ((n = fread(data, 1, COPY_CHUNK, capture)) > 0)
+        fwrite(data, 1, n, stream);
+    free(data);
+    return NULL;
+}
+
+/**
+ * Stops capturing standard output and error, restoring the originals.
+ *
+ * @param results a pointer to the result cache of the search
+ */
+static void stop_capture(struct results *results)
+{
+    FILE *streams[2] = { stdout, stderr };
+    for (int i = 0; i < 2; ++i) {
+        fflush(streams[i]);
+        if (results->saved[i] != -1) {
+            dup2(results->saved[i], fileno(streams[i]));
+            close(results->saved[i]);
+            results->saved[i] = -1;
+        }
+    }
+}
+
+/**
+ * Finishes recording a search.
+ *
+ * The captured output is copied to standard output and error and, if the
+ * search completed, kept in the result cache file.
+ *
+ * @param results a pointer to the result cache of the search
+ * @param complete true if the search completed
+ */
+static void finish(struct results *results, bool complete)
+{
+    FILE *streams[2] = { stdout, stderr };
+    char *data[2] = { NULL, NULL };
+    size_t size[2] = { 0, 0 };
+
+    stop_capture(results);
+    for (int i = 0; i < 2; ++i) {
+        data[i] = copy_capture(results->capture[i], streams[i], &size[i]);
+        fclose(results->capture[i]);
+        results->capture[i] = NULL;
+    }
+    if (complete && data[0] != NULL && data[1] != NULL)
+        store(results, data[0], size[0], data[1], size[1]);
+    free(data[0]);
+    free(data[1]);
+    recording = NULL;
+}
+
+/**
+ * Passes on the output of a search that did not complete.
+ *
+ * Registered with atexit, so that messages from a search that terminates
+ * the program are not lost in the capture.
+ */
+static void abandon()
+{
+    if (recording != NULL)
+        finish(recording, false);
+}
+
+/**
+ * Opens the result cache for a search.
+ *
+ * A search is identified by its normalized query (see describe_query) and
+ * the version of the data it reads (see dataset_version). Only the files'
+ * sizes and modification times are read, not the data files themselves.
+ *
+ * Returns NULL if there is no FG_ROOT or no user cache directory, in which
+ * case the search is run as usual.
+ *
+ * The result cache must be closed after use with close_results.
+ *
+ * @param region a pointer to the region (may be NULL)
+ * @param order a pointer to the result ordering
+ * @param reference the reference point specification (may be NULL)
+ * @param where the filter expression (may be NULL)
+ * @param magnetic the path to the magnetic model (may be NULL)
+ * @param argc the number of items
+ * @param argv the items
+ * @return a pointer to the result cache, or NULL
+ */
+struct results *open_results(const struct region *region,
+    const struct order *order, const char *reference, const char *where,
+    const char *magnetic, int argc, char **argv)
+{
+    const char *fg_root = getenv("FG_ROOT");
+    char *path;
+    if (fg_root == NULL || (path = cache_path(RESULTS_NAME)) == NULL)
+        return NULL;
+
+    struct results *results;
+    if ((results = malloc(sizeof(struct results))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    results->path = path;
+    results->query = describe_query(region, order, reference, where,
+        magnetic, argc, argv, &results->length);
+    results->hash = fnv1a(results->query, results->length, FNV_OFFSET);
+    results->dataset = dataset_version(fg_root, magnetic);
+    results->capture[0] = results->capture[1] = NULL;
+    results->saved[0] = results->saved[1] = -1;
+    return results;
+}
+
+/**
+ * Replays the stored result of a search, if there is one.
+ *
+ * The stored standard output and error are written without reading any
+ * data files, and the result is marked as recently used.
+ *
+ * @param results a pointer to the result cache of the search
+ * @return true if a stored result was replayed
+ */
+bool replay_results(struct results *results)
+{
+    assert(results != NULL);
+
+    struct table table;
+    if (!map_table(results->path, results->dataset, &table))
+        return false;
+
+    const struct slot *slot = find_slot(&table, results);
+    if (slot != NULL) {
+        const char *output = (const char *)table.base + slot->offset +
+            slot->query;
+        fwrite(output, 1, slot->output, stdout);
+        fwrite(output + slot->output, 1, slot->errors, stderr);
+
+        uint64_t clock = table.header->clock + 1;
+        off_t used = (const char *)slot - (const char *)table.base +
+            offsetof(struct slot, used);
+        bool touched = pwrite(table.fd, &clock, sizeof clock,
+            offsetof(struct header, clock)) == sizeof clock &&
+            pwrite(table.fd, &clock, sizeof clock, used) == sizeof clock;
+        (void)touched;
+    }
+    unmap_table(&table);
+    return slot != NULL;
+}
+
+/**
+ * Starts recording the output of a search.
+ *
+ * Standard output and error are captured in temporary files until the
+ * result cache is closed, when they are passed on and stored. If the
+ * output cannot be captured, the search is run as usual.
+ *
+ * @param results a pointer to the result cache of the search
+ */
+void record_results(struct results *results)
+{
+    assert(results != NULL && recording == NULL);
+
+    static bool registered;
+    if (!registered && atexit(abandon) != 0)
+        return;
+    registered = true;
+
+    FILE *streams[2] = { stdout, stderr };
+    fflush(stdout);
+    fflush(stderr);
+    bool ok = true;
+    for (int i = 0; i < 2 && ok; ++i) {
+        ok = (results->capture[i] = tmpfile()) != NULL &&
+            (results->saved[i] = dup(fileno(streams[i]))) != -1 &&
+            dup2(fileno(results->capture[i]), fileno(streams[i])) != -1;
+    }
+    if (ok) {
+        recording = results;
+        return;
+    }
+    stop_capture(results);
+    for (int i = 0; i < 2; ++i) {
+        if (results->capture[i] != NULL)
+            fclose(results->capture[i]);
+        results->capture[i] = NULL;
+    }
+}
+
+/**
+ * Closes the result cache for a search.
+ *
+ * If the search was recorded, its output is passed on and stored.
+ *
+ * @param results a pointer to the result cache (may be NULL)
+ */
+void close_results(struct results *results)
+{
+    if (results == NULL)
+        return;
+    if (recording == results)
+        finish(results, true);
+    free(results->query);
+    free(results->path);
+    free(results);
+}
@@ -0,0 +1,38 @@
+/**
+ * @file results.h
+ *
+ * Persistent cache of search results.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef results_h
+#define results_h
+
+#include <stdbool.h>
+
+struct order;
+struct region;
+struct results;
+
+struct results *open_results(const struct region *region,
+    const struct order *order, const char *reference, const char *where,
+    const char *magnetic, int argc, char **argv);
+bool replay_results(struct results *results);
+void record_results(struct results *results);
+void close_results(struct results *results);
+
+#endif
@@ -24,12 +24,27 @@
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "airport.h"
+#include "airway.h"
+#include "bktree.h"
+#include "filter.h"
 #include "flags.h"
+#include "geo.h"
+#include "group.h"
+#include "heap.h"
+#include "index.h"
+#include "internal.h"
+#include "magvar.h"
 #include "morse.h"
+#include "parse.h"
+#include "planner.h"
+#include "pool.h"
+#include "region.h"
 #include "types.h"
 #include "util.h"
 
@@ -38,13 +53,42 @@
  */
 #define COORDINATE_MAX 32
 
+/**
+ * Maximum edit distance for suggestions.
+ */
+#define SUGGEST_MAX 2
+
+/**
+ * Number of navaids in each partition of a parallel scan.
+ */
+#define PARTITION_SIZE 4096
+
+/**
+ * Number of feet in a nautical mile.
+ */
+#define FEET_PER_NM 6076.12
+
+/**
+ * Magnetic variation model for printing headings (NULL for true headings).
+ */
+static const struct magvar *variation;
+
+/**
+ * Suggestion with ranking information.
+ */
+struct ranked {
+    int distance;       ///< Edit distance from the search term
+    double proximity;   ///< Distance from the reference point in nm
+    int position;       ///< Position of the navaid in the cache
+};
+
 /**
  * Returns a description of a navaid type
  *
  * @param type the navaid type
  * @return a string that describes the navaid type
  */
-static char *type_description(const enum NavaidType type)
+char *type_description(const enum NavaidType type)
 {
     switch(type) {
     case NDB:
@@ -58,6 +102,8 @@ static char *type_description(const enum NavaidType type)
     case DME:
     case SDM:
         return "DME";
+    case FIX:
+        return "FIX";
     default:
         assert(0);
         return NULL;
@@ -70,7 +116,7 @@ static char *type_description(const enum NavaidType type)
  * @param c the coordinate to format
  * @return a string representation of the coordinate
  */
-static char *format_coordinate(const struct coordinate c)
+char *format_coordinate(const struct coordinate c)
 {
     extern struct flags flags;
     static char s[COORDINATE_MAX] = "";
@@ -87,26 +133,75 @@ static char *format_coordinate(const struct coordinate c)
     return s;
 }
 
+/**
+ * Formats a navaid name into a string, in uppercase.
+ *
+ * Names are left in the case of the data file when it is loaded, so only
+ * the names of navaids that are printed are converted.
+ *
+ * @param name the name to format
+ * @return the name in uppercase
+ */
+static const char *format_name(const char *name)
+{
+    static char *s;
+    static size_t capacity;
+    size_t n = strlen(name);
+    s = reserve(s, &capacity, n + 1, 1);
+    for (size_t i = 0; i <= n; ++i)
+        s[i] = toupper((unsigned char)name[i]);
+    return s;
+}
+
 /**
  * Common print function, used by NDB, VOR and DME.
  *
+ * Print functions print a navaid without a trailing newline.
+ *
  * @param navaid a pointer to a navaid structure
  */
 static void print_common(const struct navaid *navaid)
 {
     extern struct flags flags;
-    printf("%s %-4s %s %6.02f %3dnm %5dft %s %s\n",
+    printf("%s %-4s %s %6.02f %3dnm %5dft %s %s",
         type_description(navaid->type),
         navaid->code,
         format_coordinate(navaid->coordinate),
         navaid->frequency,
         navaid->range,
         navaid->elevation,
-        navaid->name,
+        format_name(navaid->name),
         flags.morse ? morse(navaid->code, " ") : ""
     );
 }
 
+/**
+ * Sets the magnetic variation model used to print headings.
+ *
+ * Headings are printed as true headings unless a model is set, in which
+ * case they are converted to magnetic and suffixed with 'M'.
+ *
+ * @param magvar a pointer to the model (NULL for true headings)
+ */
+void use_magvar(const struct magvar *magvar)
+{
+    variation = magvar;
+}
+
+/**
+ * Prints a heading at a coordinate to standard output.
+ *
+ * @param c the coordinate
+ * @param heading the true heading in degrees
+ */
+static void print_heading(const struct coordinate *c, double heading)
+{
+    if (variation != NULL)
+        printf("%03.0f°M", magnetic(variation, c, heading));
+    else
+        printf("%03.0f°", heading);
+}
+
 /**
  * Prints the description of an ILS/LOC to standard output.
  *
@@ -115,7 +210,7 @@ static void print_common(const struct navaid *navaid)
 static void print_loc(const struct navaid *navaid)
 {
     extern struct flags flags;
-    printf("%s %-4s %s %6.02f %3dnm %5dft %s-%-3s %03.0f° %s %s\n",
+    printf("%s %-4s %s %6.02f %3dnm %5dft %s-%-3s ",
         type_description(navaid->type),
         navaid->code,
         format_coordinate(navaid->coordinate),
@@ -123,9 +218,11 @@ static void print_loc(const struct navaid *navaid)
         navaid->range,
         navaid->elevation,
         navaid->icao,
-        navaid->runway,
-        navaid->extra.bearing,
-        navaid->name,
+        navaid->runway
+    );
+    print_heading(&navaid->coordinate, navaid->extra.bearing);
+    printf(" %s %s",
+        format_name(navaid->name),
         flags.morse ? morse(navaid->code, " ") : ""
     );
 }
@@ -141,7 +238,7 @@ static void print_dme(const struct navaid *navaid)
         print_common(navaid);
     else {
         extern struct flags flags;
-        printf("%s %-4s %s %6.02f %3dnm %5dft %s-%-3s %s %s\n",
+        printf("%s %-4s %s %6.02f %3dnm %5dft %s-%-3s %s %s",
             type_description(navaid->type),
             navaid->code,
             format_coordinate(navaid->coordinate),
@@ -150,82 +247,791 @@ static void print_dme(const struct navaid *navaid)
             navaid->elevation,
             navaid->icao,
             navaid->runway,
-            navaid->name,
+            format_name(navaid->name),
             flags.morse ? morse(navaid->code, " ") : ""
         );
     }
 }
 
 /**
- * Prints the description of a navaid to standard output.
+ * Prints the description of a fix to standard output.
+ *
+ * Fixes have no frequency, range or elevation, so only the ident and
+ * coordinate are printed.
+ *
+ * @param navaid a pointer to a navaid structure for the fix
+ */
+static void print_fix(const struct navaid *navaid)
+{
+    printf("%s %-5s %s",
+        type_description(navaid->type),
+        navaid->code,
+        format_coordinate(navaid->coordinate)
+    );
+}
+
+/**
+ * Prints the description of a navaid to standard output, without a
+ * trailing newline.
  *
  * @param navaid a pointer to a navaid structure
+ * @return true if anything was printed
  */
-static void print(const struct navaid *navaid)
+bool describe(const struct navaid *navaid)
 {
     switch (navaid->type) {
     case NDB:
     case VOR:
         print_common(navaid);
-        break;
+        return true;
     case ILS:
     case LOC:
         print_loc(navaid);
-        break;
+        return true;
     case DME:
     case SDM:
         print_dme(navaid);
-        break;
+        return true;
+    case FIX:
+        print_fix(navaid);
+        return true;
     default:
+        return false;
+    }
+}
+
+/**
+ * Prints the description of a navaid to standard output.
+ *
+ * Glideslopes and markers are only printed as part of a station.
+ *
+ * @param navaid a pointer to a navaid structure
+ */
+void print_navaid(const struct navaid *navaid)
+{
+    if (describe(navaid))
+        putchar('\n');
+}
+
+/**
+ * Prints a marker component of a station.
+ *
+ * @param cache the navaid cache
+ * @param name the name of the marker
+ * @param position the position of the marker in the cache, -1 for none
+ */
+static void print_marker(struct navaid **cache, const char *name,
+    int position)
+{
+    extern struct flags flags;
+    if (position == -1)
+        return;
+    printf(" +%s", name);
+    if (flags.coordinates)
+        printf(" %s", format_coordinate(cache[position]->coordinate));
+}
+
+/**
+ * Prints the description of a station and its components to standard
+ * output.
+ *
+ * The station is printed as its primary navaid, followed by its DME (with
+ * the bias, if any), its glideslope angle and its markers (with their
+ * coordinates, if shown).
+ *
+ * @param cache the navaid cache
+ * @param groups the groups of co-located navaids
+ * @param position the position of the station in the cache
+ */
+void print_station(struct navaid **cache, const struct groups *groups,
+    int position)
+{
+    const struct station *station = group_station(groups, position);
+    parse_details(cache[position]);
+    if (!describe(cache[position]))
         return;
+
+    if (station->dme != -1) {
+        parse_details(cache[station->dme]);
+        float bias = cache[station->dme]->extra.bias;
+        printf(" +DME");
+        if (bias != 0)
+            printf(" bias %.1fnm", bias);
+    }
+    if (station->gs != -1) {
+        parse_details(cache[station->gs]);
+        printf(" +GS %.2f°", cache[station->gs]->extra.slope);
     }
+    print_marker(cache, "OM", station->om);
+    print_marker(cache, "MM", station->mm);
+    print_marker(cache, "IM", station->im);
+    putchar('\n');
 }
 
 /**
  * Checks if a navaid matches the given search term.
  *
+ * Codes and ICAO codes are matched against the term as a glob pattern.
+ *
  * @param term the search term, as entered on the command line
  * @param navaid the navaid to test
  * @return true if the navaid matches the search term
  */
-static inline bool match(const char *term, const struct navaid *navaid)
+bool match(const char *term, const struct navaid *navaid)
 {
     if (navaid == NULL)
         return false;
-    if (strncmp(term, navaid->code, CODE_MAX) == 0)
+    if (glob(term, navaid->code))
         return true;
-    if (navaid->icao != NULL && strncmp(term, navaid->icao, ICAO_MAX) == 0)
+    if (navaid->icao != NULL && glob(term, navaid->icao))
         return true;
 
     extern struct flags flags;
-    if (flags.fuzzy && strstr(navaid->name, term) != NULL)
+    if (flags.fuzzy && contains(navaid->name, term))
         return true;
 
     return false;
 }
 
+/**
+ * Shared state of a parallel scan.
+ *
+ * Each partition writes its matches into the positions array starting at
+ * the position of its first navaid, so partitions never overlap and the
+ * matches of each are already in data file order.
+ */
+struct scan {
+    struct navaid **cache;      ///< The navaid cache
+    const char *term;           ///< The search term, in uppercase
+    const uint64_t *selection;  ///< Filter selection (may be NULL)
+    int count;                  ///< Number of navaids in the cache
+    int stop;                   ///< Matches needed per partition, 0 for all
+    int *positions;             ///< Matching positions, by partition
+    int *counts;                ///< Number of matches in each partition
+};
+
+/**
+ * Scans one partition of the cache for navaids that match a term.
+ *
+ * @param task the partition number
+ * @param worker the worker running the scan (unused)
+ * @param data a pointer to the scan state
+ */
+static void scan_partition(int task, int worker, void *data)
+{
+    (void)worker;
+    struct scan *scan = data;
+    int begin = task * PARTITION_SIZE;
+    int end = begin + PARTITION_SIZE < scan->count ?
+        begin + PARTITION_SIZE : scan->count;
+
+    int n = 0;
+    for (int i = begin; i < end; ++i)
+        if (is_selected(scan->selection, i) &&
+            match(scan->term, scan->cache[i])) {
+            scan->positions[begin + n] = i;
+            if (++n == scan->stop)
+                break;
+        }
+    scan->counts[task] = n;
+}
+
+/**
+ * Scans the whole cache for navaids that match a term.
+ *
+ * With a thread pool, the cache is divided into partitions that are scanned
+ * in parallel and then merged in partition order. Otherwise the cache is
+ * scanned in order on the calling thread. Either way, positions are returned
+ * in data file order. If a limit is given, only the first limit positions
+ * are returned. Navaids not in the filter selection are skipped. The array
+ * returned through positions must be freed after use.
+ *
+ * @param cache the navaid cache
+ * @param pool a thread pool (may be NULL)
+ * @param selection a filter selection (may be NULL)
+ * @param term the search term, in uppercase
+ * @param limit the number of results required, 0 for all
+ * @param positions receives an array of cache positions
+ * @return the number of matching navaids
+ */
+int scan(struct navaid **cache, struct pool *pool,
+    const uint64_t *selection, const char *term, int limit, int **positions)
+{
+    int count = 0;
+    while (cache[count] != NULL)
+        ++count;
+
+    if ((*positions = malloc((count + 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    int n = 0;
+    if (pool == NULL || pool_size(pool) == 1) {
+        for (int i = 0; i < count; ++i)
+            if (is_selected(selection, i) && match(term, cache[i])) {
+                (*positions)[n++] = i;
+                if (n == limit)
+                    break;
+            }
+        return n;
+    }
+
+    int partitions = (count + PARTITION_SIZE - 1) / PARTITION_SIZE;
+    struct scan s = {
+        cache, term, selection, count, limit, *positions, NULL
+    };
+    if ((s.counts = malloc((partitions + 1) * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    run_pool(pool, partitions, scan_partition, &s);
+
+    for (int p = 0; p < partitions && (limit == 0 || n < limit); ++p) {
+        int k = s.counts[p];
+        if (limit > 0 && k > limit - n)
+            k = limit - n;
+        memmove(*positions + n, *positions + p * PARTITION_SIZE,
+            k * sizeof(int));
+        n += k;
+    }
+    free(s.counts);
+    return n;
+}
+
+/**
+ * Compares candidates by sort value, then by data file order.
+ *
+ * @param a pointer to the first candidate
+ * @param b pointer to the second candidate
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_values(const struct candidate *a, const struct candidate *b)
+{
+    if (a->value != b->value)
+        return a->value < b->value ? -1 : 1;
+    return a->position - b->position;
+}
+
+/**
+ * Compares candidates by navaid name, then by data file order.
+ *
+ * Names are compared as if converted to uppercase, like they are printed.
+ *
+ * @param a pointer to the first candidate
+ * @param b pointer to the second candidate
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_names(const struct candidate *a, const struct candidate *b)
+{
+    const unsigned char *x = (const unsigned char *)a->navaid->name;
+    const unsigned char *y = (const unsigned char *)b->navaid->name;
+    while (*x != '\0' && toupper(*x) == toupper(*y)) {
+        ++x;
+        ++y;
+    }
+    int c = toupper(*x) - toupper(*y);
+    return c != 0 ? c : a->position - b->position;
+}
+
+/**
+ * Calculates the sort value of a navaid.
+ *
+ * Frequencies are compared in Hz, since NDB frequencies are in kHz and the
+ * others in MHz.
+ *
+ * @param order the result ordering
+ * @param navaid a pointer to a navaid structure
+ * @return the sort value, lowest first
+ */
+static double sort_value(const struct order *order, const struct navaid *navaid)
+{
+    switch (order->key) {
+    case SORT_DISTANCE:
+        return distance(order->reference, &navaid->coordinate);
+    case SORT_FREQUENCY:
+        return navaid->frequency * (navaid->type == NDB ? 1e3 : 1e6);
+    case SORT_RANGE:
+        return -navaid->range;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Prints a search result, as a station if the order groups navaids.
+ *
+ * @param cache the navaid cache
+ * @param order the result ordering
+ * @param position the position of the navaid in the cache
+ */
+static void show(struct navaid **cache, const struct order *order,
+    int position)
+{
+    if (order->groups != NULL)
+        print_station(cache, order->groups, position);
+    else {
+        parse_details(cache[position]);
+        print_navaid(cache[position]);
+    }
+}
+
+/**
+ * Accepts a matching navaid.
+ *
+ * Without a sort key, matches are printed immediately in data file order.
+ * Otherwise they are offered to a heap that keeps the best of them.
+ *
+ * @param heap a pointer to the heap of candidates
+ * @param cache the navaid cache
+ * @param order the result ordering
+ * @param position the position of the navaid in the cache
+ */
+static void accept(struct heap *heap, struct navaid **cache,
+    const struct order *order, int position)
+{
+    if (order->key == SORT_NONE) {
+        show(cache, order, position);
+        return;
+    }
+    if (order->key == SORT_RANGE)
+        parse_details(cache[position]);
+    const struct navaid *navaid = cache[position];
+    struct candidate c = { navaid, position, sort_value(order, navaid) };
+    offer(heap, &c);
+}
+
+/**
+ * Compares positions for sorting.
+ *
+ * @param a pointer to the first position
+ * @param b pointer to the second position
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_positions(const void *a, const void *b)
+{
+    const int *x = a, *y = b;
+    return *x - *y;
+}
+
+/**
+ * Replaces matching positions with the positions of their stations.
+ *
+ * Navaids without a station are removed, and stations matched through
+ * more than one component appear once. Positions remain in data file
+ * order.
+ *
+ * @param groups the groups of co-located navaids
+ * @param positions the positions of matching navaids, in data file order
+ * @param n the number of positions
+ * @return the number of positions after replacement
+ */
+static int to_stations(const struct groups *groups, int *positions, int n)
+{
+    int k = 0;
+    for (int i = 0; i < n; ++i)
+        if ((positions[k] = group_primary(groups, positions[i])) != -1)
+            ++k;
+    qsort(positions, k, sizeof(int), compare_positions);
+
+    int unique = 0;
+    for (int i = 0; i < k; ++i)
+        if (unique == 0 || positions[unique - 1] != positions[i])
+            positions[unique++] = positions[i];
+    return unique;
+}
+
+/**
+ * Keeps the positions of navaids that match a search term.
+ *
+ * @param cache the navaid cache
+ * @param term the search term, in uppercase
+ * @param positions the positions, in data file order
+ * @param n the number of positions
+ * @return the number of positions kept, still in data file order
+ */
+static int keep_matches(struct navaid **cache, const char *term,
+    int *positions, int n)
+{
+    int k = 0;
+    for (int i = 0; i < n; ++i)
+        if (match(term, cache[positions[i]]))
+            positions[k++] = positions[i];
+    return k;
+}
+
+/**
+ * Checks if a navaid passes the filter of a search.
+ *
+ * A scan filters the whole cache into a selection, otherwise navaids are
+ * tested one by one.
+ *
+ * @param cache the navaid cache
+ * @param filter the filter (may be NULL)
+ * @param selection the selection of a scan (may be NULL)
+ * @param position the position of the navaid in the cache
+ * @return true if the navaid is selected
+ */
+static bool passes(struct navaid **cache, const struct filter *filter,
+    const uint64_t *selection, int position)
+{
+    if (selection != NULL)
+        return is_selected(selection, position);
+    return filter == NULL || test_filter(filter, cache[position]);
+}
+
 /**
  * Finds a navaid and prints its description to standard output.
  *
+ * The code may be a glob pattern, e.g. EG* or B?N. A planner chooses the
+ * cheapest way of finding the navaids that may match (see choose_strategy):
+ * a scan of the whole cache, in parallel if a thread pool is supplied, or
+ * a lookup in the index by code, by frequency band or by position, if an
+ * index is supplied. Fuzzy searches must scan because names are not
+ * indexed. A scan uses the filter selection of the order, or runs the
+ * filter if there is none. The search term and the filter are then applied
+ * to the navaids found, so every plan finds the same navaids. If the order
+ * has groups, each matching navaid is replaced by its station, e.g. a DME
+ * by its VOR, and the filter is applied to the station. With the explain
+ * flag, the plan is printed before the results.
+ *
+ * Results are printed in data file order unless the order specifies a sort
+ * key. With a limit and no sort key, the search stops as soon as enough
+ * results have been found. With a sort key, a bounded heap keeps only the
+ * best results, so the full set of matches is never sorted.
+ *
  * @param cache the navaid cache
+ * @param index an index over the cache (may be NULL)
+ * @param pool a thread pool for scanning the cache (may be NULL)
+ * @param order the result ordering, limit and filter
  * @param code the code to search for
- * @return the number of navaids that match the search term
+ * @return the number of navaids printed
  */
-int find(struct navaid **cache, const char *code)
+int find(struct navaid **cache, const struct index *index, struct pool *pool,
+    const struct order *order, const char *code)
 {
+    extern struct flags flags;
     char *term = strdup_f(code);
     char *p = term;
     while ((*p = toupper(*p)))
         ++p;
 
-    struct navaid *navaid;
-    int matches = 0;
-    while ((navaid = *cache++) != NULL) {
-        if (match(term, navaid)) {
-            print(navaid);
+    int stop = order->key == SORT_NONE ? order->limit : 0;
+    struct heap heap;
+    init_heap(&heap, order->limit,
+        order->key == SORT_NAME ? compare_names : compare_values);
+
+    const struct filter *filter = order->filter;
+    const struct groups *groups = order->groups;
+    int count = 0;
+    if (index != NULL)
+        count = index_size(index);
+    else
+        while (cache[count] != NULL)
+            ++count;
+    struct strategy strategy;
+    choose_strategy(&strategy, index, filter, term, groups != NULL,
+        pool != NULL ? pool_size(pool) : 1, count);
+
+    const uint64_t *selection = NULL;
+    uint64_t *filtered = NULL;
+    int *positions, n, matches = 0;
+    long examined = count;
+    switch (strategy.path) {
+    case PATH_IDENT:
+        n = lookup(index, term, filter || groups ? 0 : stop, &positions,
+            &examined);
+        break;
+    case PATH_BANDS:
+        examined = lookup_bands(index, strategy.min_frequency,
+            strategy.max_frequency, &positions);
+        n = keep_matches(cache, term, positions, examined);
+        break;
+    case PATH_CELLS:
+        examined = lookup_cells(index, &strategy.bounds, &positions);
+        n = keep_matches(cache, term, positions, examined);
+        break;
+    default:
+        selection = order->selection;
+        if (selection == NULL && filter != NULL)
+            selection = filtered = run_filter(filter, cache, pool);
+        n = scan(cache, pool, selection, term, groups ? 0 : stop,
+            &positions);
+        break;
+    }
+    if (flags.explain)
+        explain_strategy(&strategy, term, examined);
+
+    if (groups != NULL)
+        n = to_stations(groups, positions, n);
+    for (int i = 0; i < n && (stop == 0 || matches < stop); ++i)
+        if (passes(cache, filter, selection, positions[i])) {
+            accept(&heap, cache, order, positions[i]);
             ++matches;
         }
+    free(positions);
+    free(filtered);
+
+    if (order->key != SORT_NONE) {
+        matches = drain(&heap);
+        for (int i = 0; i < matches; ++i)
+            show(cache, order, heap.items[i].position);
     }
+    free_heap(&heap);
+    free(term);
+    return matches;
+}
+
+/**
+ * Checks if an airport's reference point falls within a region.
+ *
+ * Airports without a reference point are never in a region.
+ *
+ * @param airport a pointer to the airport
+ * @param region the region (may be NULL)
+ * @return true if the airport is in the region or there is no region
+ */
+static bool airport_in_region(const struct airport *airport,
+    const struct region *region)
+{
+    if (region == NULL)
+        return true;
+    return !isnan(airport->coordinate.lat) &&
+        in_region(region, &airport->coordinate);
+}
+
+/**
+ * Prints an airport and its runways to standard output.
+ *
+ * The airport is printed with its elevation in the same column as navaid
+ * elevations, followed by a line for each runway end with its heading
+ * and the length of the runway. Helipads are printed once, without a
+ * heading or length.
+ *
+ * @param airports a pointer to the airport index
+ * @param airport a pointer to the airport
+ */
+static void print_airport(const struct airports *airports,
+    const struct airport *airport)
+{
+    printf("APT %-4s %s %6s %5s %5dft %s\n",
+        airport->icao,
+        isnan(airport->coordinate.lat) ?
+            "" : format_coordinate(airport->coordinate),
+        "", "",
+        airport->elevation,
+        airport_name(airports, airport)
+    );
+
+    const struct runway *runways = airport_runways(airports, airport);
+    for (uint32_t r = 0; r < airport->count; ++r) {
+        const struct runway *runway = &runways[r];
+        double length = distance(&runway->end[0].coordinate,
+            &runway->end[1].coordinate) * FEET_PER_NM;
+        for (int i = 0; i < 2; ++i) {
+            const struct runway_end *end = &runway->end[i];
+            printf("RWY %-4s %s %6s %5s %5dft %s-%-3s",
+                airport->icao,
+                format_coordinate(end->coordinate),
+                "", "",
+                airport->elevation,
+                airport->icao,
+                end->ident
+            );
+            if (length < 1) {
+                putchar('\n');
+                break;
+            }
+            putchar(' ');
+            print_heading(&end->coordinate,
+                bearing(&end->coordinate, &runway->end[1 - i].coordinate));
+            printf(" %.0fft\n", length);
+        }
+    }
+}
+
+/**
+ * Finds and prints airports whose ICAO code matches a code.
+ *
+ * Airports are printed in ICAO code order, with their runways, up to the
+ * result limit. Airports are not ranked or filtered by --where.
+ *
+ * @param airports a pointer to the airport index
+ * @param region the region (may be NULL)
+ * @param order the result ordering and limit
+ * @param code the code to search for, possibly including wildcards
+ * @return the number of airports found
+ */
+int find_airports(const struct airports *airports,
+    const struct region *region, const struct order *order, const char *code)
+{
+    char *term = strdup_f(code);
+    char *p = term;
+    while ((*p = toupper(*p)))
+        ++p;
+
+    int *indices, matches = 0;
+    int n = match_airports(airports, term, &indices);
+    for (int i = 0; i < n && (order->limit == 0 || matches < order->limit);
+        ++i) {
+        const struct airport *airport = get_airport(airports, indices[i]);
+        if (airport_in_region(airport, region)) {
+            print_airport(airports, airport);
+            ++matches;
+        }
+    }
+    free(indices);
+    free(term);
+    return matches;
+}
+
+/**
+ * Prints a planned route to standard output.
+ *
+ * The route is printed first in the usual flight plan form, with each
+ * airway followed by the waypoint where the route leaves it, then as a
+ * list of waypoints with the leg and total distances and the airways
+ * that reach them. With a magnetic variation model, the initial magnetic
+ * course of each leg is printed too.
+ *
+ * @param legs the waypoints of the route
+ * @param count the number of waypoints
+ */
+void print_route(const struct leg *legs, int count)
+{
+    double total = 0;
+    printf("Route %s", legs[0].ident);
+    for (int i = 1; i < count; ++i) {
+        total += legs[i].distance;
+        if (i + 1 < count && strcmp(legs[i].airway, legs[i + 1].airway) == 0)
+            continue;
+        printf(" %s %s", legs[i].airway, legs[i].ident);
+    }
+    printf(", %.0fnm\n", total);
+
+    total = 0;
+    for (int i = 0; i < count; ++i) {
+        total += legs[i].distance;
+        printf("%-5s %s %4.0fnm %5.0fnm ",
+            legs[i].ident,
+            format_coordinate(legs[i].coordinate),
+            legs[i].distance,
+            total
+        );
+        if (variation != NULL && i == 0)
+            printf("%5s ", "");
+        else if (variation != NULL) {
+            print_heading(&legs[i - 1].coordinate,
+                bearing(&legs[i - 1].coordinate, &legs[i].coordinate));
+            putchar(' ');
+        }
+        printf("%s\n", legs[i].airway);
+    }
+}
+
+/**
+ * Compares ranked suggestions for sorting.
+ *
+ * Suggestions are ordered by edit distance, then by proximity to the
+ * reference point, then by data file order.
+ *
+ * @param a pointer to the first suggestion
+ * @param b pointer to the second suggestion
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_ranked(const void *a, const void *b)
+{
+    const struct ranked *x = a, *y = b;
+    if (x->distance != y->distance)
+        return x->distance - y->distance;
+    if (x->proximity != y->proximity)
+        return x->proximity < y->proximity ? -1 : 1;
+    return x->position - y->position;
+}
+
+/**
+ * Removes repeated stations from ranked suggestions.
+ *
+ * A station can be suggested through more than one of its components.
+ * Only the best ranked suggestion of each station is kept.
+ *
+ * @param ranked the ranked suggestions, best first
+ * @param n the number of suggestions
+ * @return the number of suggestions remaining
+ */
+static int unique_stations(struct ranked *ranked, int n)
+{
+    int k = 0;
+    for (int i = 0; i < n; ++i) {
+        bool seen = false;
+        for (int j = 0; j < k && !seen; ++j)
+            seen = ranked[j].position == ranked[i].position;
+        if (!seen)
+            ranked[k++] = ranked[i];
+    }
+    return k;
+}
+
+/**
+ * Suggests navaids with codes similar to a search term.
+ *
+ * Navaids with codes within a small edit distance of the term are printed
+ * to standard output, closest first. If the order has a reference point,
+ * navaids with equally close codes are ordered by their distance from it.
+ * Exact matches are not suggested.
+ *
+ * @param cache the navaid cache
+ * @param tree a BK-tree over the cache
+ * @param order the result ordering and limit
+ * @param code the code to make suggestions for
+ * @return the number of navaids suggested
+ */
+int suggest(struct navaid **cache, const struct bktree *tree,
+    const struct order *order, const char *code)
+{
+    const struct coordinate *reference = order->reference;
+    char *term = strdup_f(code);
+    char *p = term;
+    while ((*p = toupper(*p)))
+        ++p;
+
+    struct suggestion *suggestions;
+    int n = search_bktree(tree, term, SUGGEST_MAX, &suggestions);
+
+    struct ranked *ranked;
+    if ((ranked = malloc((n + 1) * sizeof(struct ranked))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    int matches = 0;
+    for (int i = 0; i < n; ++i) {
+        int position = suggestions[i].position;
+        if (order->groups != NULL)
+            position = group_primary(order->groups, position);
+        if (suggestions[i].distance == 0 || position == -1)
+            continue;
+        struct navaid *navaid = cache[position];
+        struct ranked r = {
+            suggestions[i].distance,
+            reference ? distance(reference, &navaid->coordinate) : 0,
+            position
+        };
+        ranked[matches++] = r;
+    }
+    qsort(ranked, matches, sizeof(struct ranked), compare_ranked);
+    if (order->groups != NULL)
+        matches = unique_stations(ranked, matches);
+    if (order->limit > 0 && matches > order->limit)
+        matches = order->limit;
+
+    extern struct flags flags;
+    if (matches > 0 && !flags.quiet)
+        printf("%s not found, did you mean:\n", code);
+    for (int i = 0; i < matches; ++i)
+        show(cache, order, ranked[i].position);
+
+    free(ranked);
+    free(suggestions);
     free(term);
     return matches;
 }
@@ -22,8 +22,56 @@
 #ifndef nav_h
 #define nav_h
 
+#include <stdint.h>
+
+#include "types.h"
+
+struct airports;
+struct bktree;
+struct coordinate;
+struct filter;
+struct groups;
+struct index;
+struct leg;
+struct magvar;
 struct navaid;
+struct pool;
+struct region;
+
+/**
+ * Result ordering keys.
+ */
+enum SortKey {
+    SORT_NONE,      ///< Data file order
+    SORT_DISTANCE,  ///< Distance from the reference point, nearest first
+    SORT_FREQUENCY, ///< Frequency, lowest first
+    SORT_RANGE,     ///< Reception range, longest first
+    SORT_NAME       ///< Name, alphabetical
+};
+
+/**
+ * Ordering, limits and filters applied to search results.
+ */
+struct order {
+    enum SortKey key;                   ///< Sort key
+    int limit;                          ///< Maximum results per item, 0 for all
+    const struct coordinate *reference; ///< Reference point (may be NULL)
+    const struct filter *filter;        ///< Filter (may be NULL)
+    const uint64_t *selection;          ///< Filter selection (may be NULL)
+    const struct groups *groups;        ///< Stations to show (may be NULL)
+};
 
-int find(struct navaid **cache, const char *code);
+int find(struct navaid **cache, const struct index *index, struct pool *pool,
+    const struct order *order, const char *code);
+int find_airports(const struct airports *airports,
+    const struct region *region, const struct order *order, const char *code);
+int suggest(struct navaid **cache, const struct bktree *tree,
+    const struct order *order, const char *code);
+void print_navaid(const struct navaid *navaid);
+char *type_description(const enum NavaidType type);
+void use_magvar(const struct magvar *magvar);
+void print_route(const struct leg *legs, int count);
+void print_station(struct navaid **cache, const struct groups *groups,
+    int position);
 
 #endif
@@ -0,0 +1,794 @@
+/**
+ * @file snapshot.c
+ *
+ * Share loaded navigation data between processes.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @cond Doxygen_Suppress
+#define _POSIX_C_SOURCE 200809L
+/// @endcond
+
+#include "snapshot.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "geo.h"
+#include "parse.h"
+#include "region.h"
+#include "types.h"
+#include "util.h"
+
+/**
+ * Magic number identifying a snapshot ("NVS1").
+ */
+#define SNAPSHOT_MAGIC 0x3153564eU
+
+/**
+ * Version of the snapshot layout, part of the dataset key.
+ */
+#define SNAPSHOT_LAYOUT 7
+
+/**
+ * String offset representing a NULL string.
+ */
+#define SNAPSHOT_NULL UINT32_MAX
+
+/**
+ * Number of type partitions in a snapshot, one for each navaid type code
+ * that can occur in the navigation data file.
+ */
+#define SNAPSHOT_TYPES 16
+
+/**
+ * Number of records in each block of a snapshot.
+ */
+#define SNAPSHOT_BLOCK 256
+
+/**
+ * Maximum length of a shared memory object name.
+ */
+#define SNAPSHOT_NAME_MAX 32
+
+/**
+ * Full memory barrier, ordering the contents of a snapshot before its
+ * ready flag.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define BARRIER() __sync_synchronize()
+#else
+#define BARRIER()
+#endif
+
+/**
+ * Snapshot header.
+ *
+ * The header is followed by an array of records in data file order, a
+ * spatial index, the members of the type partitions, the bounding box of
+ * each block of the spatial index and a string table. All references
+ * within the snapshot are offsets, so it can be mapped at any address.
+ *
+ * The snapshot holds navaids of every type. The members of the partitions
+ * are record positions, grouped by type and in data file order within each
+ * type, so a search restricted to some types reads only their partitions.
+ *
+ * The spatial index holds the record positions in the order of the Hilbert
+ * keys of their coordinates, so navaids that are close together are
+ * usually in the same block, and a region is covered by a few contiguous
+ * runs of the index.
+ */
+struct header {
+    uint32_t magic;             ///< SNAPSHOT_MAGIC
+    uint32_t layout;            ///< SNAPSHOT_LAYOUT
+    uint64_t key;               ///< Dataset version key
+    volatile uint32_t ready;    ///< Set when the contents are complete
+    uint32_t count;             ///< Number of records
+    uint64_t records;           ///< Offset of the records
+    uint64_t index;             ///< Offset of the spatial index
+    uint64_t members;           ///< Offset of the partition members
+    uint64_t blocks;            ///< Offset of the block bounding boxes
+    uint64_t strings;           ///< Offset of the string table
+    uint64_t size;              ///< Total size of the snapshot
+    uint32_t partitions[SNAPSHOT_TYPES + 1];    ///< First member by type
+};
+
+/**
+ * Position independent navaid record.
+ */
+struct record {
+    double lat;         ///< Latitude
+    double lon;         ///< Longitude
+    double frequency;   ///< Radio frequency
+    int32_t type;       ///< Type of navaid
+    int32_t elevation;  ///< Elevation above sea level in feet
+    int32_t range;      ///< Reception range in nm
+    float extra;        ///< Navaid specific field
+    uint32_t code;      ///< Offset of the identification code
+    uint32_t icao;      ///< Offset of the airport ICAO code
+    uint32_t runway;    ///< Offset of the runway code
+    uint32_t name;      ///< Offset of the descriptive name
+};
+
+/**
+ * Bounding box of the records in a block of the spatial index.
+ */
+struct block {
+    double min_lat;     ///< Minimum latitude
+    double max_lat;     ///< Maximum latitude
+    double min_lon;     ///< Minimum longitude
+    double max_lon;     ///< Maximum longitude
+};
+
+/**
+ * Navaid position with its Hilbert key, for sorting.
+ */
+struct keyed {
+    uint32_t key;       ///< Hilbert key of the coordinate
+    uint32_t position;  ///< Position in data file order
+};
+
+/**
+ * Snapshot attached to this process.
+ *
+ * The snapshot stays open with a shared lock on it while it is attached,
+ * so the last process to detach it can tell that nobody else is using it.
+ */
+struct snapshot {
+    char *path;                     ///< Path to the navigation data file
+    char name[SNAPSHOT_NAME_MAX];   ///< Name of the shared memory object
+    uint64_t key;                   ///< Dataset version key
+    int fd;                         ///< Open descriptor holding the lock
+    void *base;                     ///< Base address of the mapping
+    size_t size;                    ///< Size of the mapping
+    const struct record *records;   ///< Records
+    const uint32_t *index;          ///< Spatial index
+    const uint32_t *members;        ///< Partition members
+    const uint32_t *partitions;     ///< First partition member by type
+    const struct block *blocks;     ///< Block bounding boxes
+    const char *strings;            ///< String table
+    size_t count;                   ///< Number of records
+};
+
+/**
+ * Calculates the dataset version key for a navigation data file.
+ *
+ * The key changes whenever the file is replaced or modified, or when the
+ * snapshot layout changes.
+ *
+ * @param path the path to the navigation data file
+ * @param key receives the key
+ * @return true if the key was calculated, false if the file cannot be found
+ */
+static bool dataset_key(const char *path, uint64_t *key)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+
+    uint64_t values[] = {
+        SNAPSHOT_LAYOUT, (uint64_t)st.st_dev, (uint64_t)st.st_ino,
+        (uint64_t)st.st_size, (uint64_t)st.st_mtime
+    };
+    *key = fnv1a(path, strlen(path), FNV_OFFSET);
+    *key = fnv1a(values, sizeof(values), *key);
+    return true;
+}
+
+/**
+ * Formats the name of the shared memory object holding a snapshot.
+ *
+ * @param key the dataset version key
+ * @param name receives the name
+ */
+static void data_name(uint64_t key, char *name)
+{
+    unsigned long long k = key;
+    snprintf(name, SNAPSHOT_NAME_MAX, "/nvs-d-%016llx", k);
+}
+
+/**
+ * Formats the name of the shared memory object recording the current
+ * snapshot for a navigation data file.
+ *
+ * @param path the path to the navigation data file
+ * @param name receives the name
+ */
+static void registry_name(const char *path, char *name)
+{
+    unsigned long long h = fnv1a(path, strlen(path), FNV_OFFSET);
+    snprintf(name, SNAPSHOT_NAME_MAX, "/nvs-r-%016llx", h);
+}
+
+/**
+ * Opens the registry of the current snapshot for a navigation data file.
+ *
+ * @param path the path to the navigation data file
+ * @param create true to create the registry if it does not exist
+ * @return a file descriptor, or -1 if the registry cannot be opened
+ */
+static int open_registry(const char *path, bool create)
+{
+    char name[SNAPSHOT_NAME_MAX];
+    registry_name(path, name);
+    if (create)
+        return shm_open(name, O_CREAT | O_RDWR, 0644);
+    return shm_open(name, O_RDONLY, 0);
+}
+
+/**
+ * Locks a shared memory object, waiting for any conflicting lock to be
+ * released.
+ *
+ * Locks belong to the process and are released when it closes the file
+ * descriptor or exits, however it exits.
+ *
+ * @param fd the file descriptor of the object
+ * @param type F_RDLCK for a shared lock or F_WRLCK for an exclusive lock
+ * @return true if the lock was taken
+ */
+static bool lock(int fd, short type)
+{
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &fl) == -1)
+        if (errno != EINTR)
+            return false;
+    return true;
+}
+
+/**
+ * Maps a snapshot if its publisher has finished writing it.
+ *
+ * @param fd the file descriptor of the snapshot
+ * @param size receives the size of the snapshot
+ * @return the base address of the mapping, NULL if the snapshot is not
+ * ready, or MAP_FAILED if it cannot be mapped
+ */
+static void *map_ready(int fd, size_t *size)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return MAP_FAILED;
+    if ((size_t)st.st_size < sizeof(struct header))
+        return NULL;
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return MAP_FAILED;
+    if (!((const struct header *)base)->ready) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+    BARRIER();
+    *size = st.st_size;
+    return base;
+}
+
+/**
+ * Attaches the published snapshot of a navigation data file, if any.
+ *
+ * The snapshot is mapped read-only. A publisher holds an exclusive lock on
+ * the registry of the data file from before it creates the snapshot until
+ * the snapshot is complete, so if the snapshot is not ready, waits for a
+ * shared lock on the registry. A snapshot that is still not ready once the
+ * lock is taken was abandoned by a publisher that failed, and is removed
+ * so that it can be published again. The snapshot is then locked shared
+ * until it is detached (see detach_snapshot).
+ *
+ * The pointer returned must be released with detach_snapshot.
+ *
+ * @param path the path to the navigation data file
+ * @return a pointer to the snapshot, or NULL if none is available
+ */
+struct snapshot *attach_snapshot(const char *path)
+{
+    uint64_t key;
+    char name[SNAPSHOT_NAME_MAX];
+    if (!dataset_key(path, &key))
+        return NULL;
+    data_name(key, name);
+
+    int fd;
+    if ((fd = shm_open(name, O_RDONLY, 0)) == -1)
+        return NULL;
+
+    size_t size;
+    void *base = map_ready(fd, &size);
+    if (base == NULL) {
+        int registry = open_registry(path, false);
+        if (registry != -1 && lock(registry, F_RDLCK)) {
+            if ((base = map_ready(fd, &size)) == NULL)
+                shm_unlink(name);
+        }
+        if (registry != -1)
+            close(registry);
+    }
+    if (base == NULL || base == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    const struct header *h = base;
+    if (h->magic != SNAPSHOT_MAGIC || h->layout != SNAPSHOT_LAYOUT ||
+        h->key != key || h->size != size || !lock(fd, F_RDLCK)) {
+        munmap(base, size);
+        close(fd);
+        return NULL;
+    }
+
+    struct snapshot *s;
+    if ((s = malloc(sizeof(struct snapshot))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    if ((s->path = strdup(path)) == NULL) {
+        perror("strdup");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(s->name, name, SNAPSHOT_NAME_MAX);
+    s->key = key;
+    s->fd = fd;
+    s->base = base;
+    s->size = size;
+    s->records = (const void *)((const char *)base + h->records);
+    s->index = (const void *)((const char *)base + h->index);
+    s->members = (const void *)((const char *)base + h->members);
+    s->partitions = h->partitions;
+    s->blocks = (const void *)((const char *)base + h->blocks);
+    s->strings = (const char *)base + h->strings;
+    s->count = h->count;
+    return s;
+}
+
+/**
+ * Copies a string into a snapshot string table.
+ *
+ * @param strings the string table
+ * @param offset a pointer to the next free offset in the table
+ * @param s the string (may be NULL)
+ * @return the offset of the string, or SNAPSHOT_NULL
+ */
+static uint32_t add_string(char *strings, size_t *offset, const char *s)
+{
+    if (s == NULL)
+        return SNAPSHOT_NULL;
+    size_t n = strlen(s) + 1;
+    memcpy(strings + *offset, s, n);
+    *offset += n;
+    return (uint32_t)(*offset - n);
+}
+
+/**
+ * Returns the partition of a navaid type.
+ *
+ * @param type the navaid type
+ * @return the partition, or 0 (NIL) if the type has no partition
+ */
+static unsigned partition(enum NavaidType type)
+{
+    return (unsigned)type < SNAPSHOT_TYPES ? (unsigned)type : NIL;
+}
+
+/**
+ * Writes the type partitions of a snapshot.
+ *
+ * The members are sorted by type with a counting sort, which keeps them in
+ * data file order within each type.
+ *
+ * @param h a pointer to the snapshot header
+ * @param members a pointer to the array of members to fill
+ * @param navaids an array of pointers to navaids
+ * @param count the number of navaids
+ */
+static void write_partitions(struct header *h, uint32_t *members,
+    struct navaid **navaids, size_t count)
+{
+    uint32_t next[SNAPSHOT_TYPES];
+    memset(h->partitions, 0, sizeof(h->partitions));
+    for (size_t i = 0; i < count; ++i)
+        ++h->partitions[partition(navaids[i]->type) + 1];
+    for (unsigned t = 0; t < SNAPSHOT_TYPES; ++t) {
+        h->partitions[t + 1] += h->partitions[t];
+        next[t] = h->partitions[t];
+    }
+    for (size_t i = 0; i < count; ++i)
+        members[next[partition(navaids[i]->type)]++] = (uint32_t)i;
+}
+
+/**
+ * Compares keyed positions by Hilbert key, then position.
+ *
+ * @param a pointer to the first keyed position
+ * @param b pointer to the second keyed position
+ * @return an integer less than, equal to or greater than zero
+ */
+static int compare_keyed(const void *a, const void *b)
+{
+    const struct keyed *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return x->position < y->position ? -1 : x->position > y->position;
+}
+
+/**
+ * Extends the bounding box of a block to include a record.
+ *
+ * A coordinate that is not a number is never rejected by a region, so it
+ * extends the box to cover everywhere.
+ *
+ * @param block a pointer to the block
+ * @param r a pointer to the record
+ * @param first true if the record is the first in the block
+ */
+static void extend_block(struct block *block, const struct record *r,
+    bool first)
+{
+    if (first) {
+        block->min_lat = block->min_lon = INFINITY;
+        block->max_lat = block->max_lon = -INFINITY;
+    }
+    if (isnan(r->lat) || isnan(r->lon)) {
+        block->min_lat = block->min_lon = -INFINITY;
+        block->max_lat = block->max_lon = INFINITY;
+        return;
+    }
+    block->min_lat = fmin(block->min_lat, r->lat);
+    block->max_lat = fmax(block->max_lat, r->lat);
+    block->min_lon = fmin(block->min_lon, r->lon);
+    block->max_lon = fmax(block->max_lon, r->lon);
+}
+
+/**
+ * Records a snapshot as the current one for a navigation data file.
+ *
+ * The previously recorded snapshot is unlinked. Processes that still have it
+ * attached keep their mapping, and the system releases its memory when the
+ * last of them detaches.
+ *
+ * @param registry the file descriptor of the registry
+ * @param name the name of the new snapshot
+ */
+static void replace_current(int registry, const char *name)
+{
+    char *current = MAP_FAILED;
+    if (ftruncate(registry, SNAPSHOT_NAME_MAX) == 0)
+        current = mmap(NULL, SNAPSHOT_NAME_MAX, PROT_READ | PROT_WRITE,
+            MAP_SHARED, registry, 0);
+    if (current == MAP_FAILED)
+        return;
+
+    current[SNAPSHOT_NAME_MAX - 1] = '\0';
+    if (*current == '/' && strcmp(current, name) != 0)
+        shm_unlink(current);
+    snprintf(current, SNAPSHOT_NAME_MAX, "%s", name);
+    munmap(current, SNAPSHOT_NAME_MAX);
+}
+
+/**
+ * Publishes navaids as the snapshot of a navigation data file.
+ *
+ * The snapshot is created exclusively, so if several processes try to
+ * publish at once, only one succeeds and the others attach to its snapshot
+ * when it is ready. A process that attaches never sees a partial snapshot,
+ * because the ready flag is set only after the contents are written. The
+ * registry is locked while the snapshot is written (see attach_snapshot),
+ * and nothing is published if the lock cannot be taken.
+ *
+ * Records are written in data file order, followed by a spatial index in
+ * Hilbert key order, the type partitions and the bounding box of each
+ * block of the spatial index. Deferred fields of the navaids are decoded
+ * as they are written.
+ *
+ * @param path the path to the navigation data file
+ * @param navaids an array of pointers to navaids, terminated with NULL
+ * @return true if a snapshot is available to attach, otherwise false
+ */
+bool publish_snapshot(const char *path, struct navaid **navaids)
+{
+    assert(navaids != NULL);
+
+    uint64_t key;
+    char name[SNAPSHOT_NAME_MAX];
+    if (!dataset_key(path, &key))
+        return false;
+    data_name(key, name);
+
+    size_t count = 0, bytes = 0;
+    for (; navaids[count] != NULL; ++count) {
+        const struct navaid *n = navaids[count];
+        bytes += strlen(n->code) + strlen(n->name) + 2;
+        if (n->icao != NULL)
+            bytes += strlen(n->icao) + 1;
+        if (n->runway != NULL)
+            bytes += strlen(n->runway) + 1;
+    }
+    if (bytes >= SNAPSHOT_NULL)
+        return false;
+
+    size_t blocks = (count + SNAPSHOT_BLOCK - 1) / SNAPSHOT_BLOCK;
+    size_t records = (sizeof(struct header) + 7) & ~(size_t)7;
+    size_t index = records + count * sizeof(struct record);
+    size_t members = index + count * sizeof(uint32_t);
+    size_t boxes = (members + count * sizeof(uint32_t) + 7) & ~(size_t)7;
+    size_t strings = boxes + blocks * sizeof(struct block);
+    size_t size = strings + bytes;
+
+    struct keyed *keyed;
+    if ((keyed = malloc((count + 1) * sizeof(struct keyed))) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        keyed[i].key = hilbert_key(&navaids[i]->coordinate);
+        keyed[i].position = (uint32_t)i;
+    }
+    qsort(keyed, count, sizeof(struct keyed), compare_keyed);
+
+    int registry;
+    if ((registry = open_registry(path, true)) == -1) {
+        free(keyed);
+        return false;
+    }
+    if (!lock(registry, F_WRLCK)) {
+        close(registry);
+        free(keyed);
+        return false;
+    }
+
+    int fd;
+    if ((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644)) == -1) {
+        bool exists = errno == EEXIST;
+        close(registry);
+        free(keyed);
+        return exists;
+    }
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        close(registry);
+        free(keyed);
+        return false;
+    }
+
+    struct header *h = base;
+    h->magic = SNAPSHOT_MAGIC;
+    h->layout = SNAPSHOT_LAYOUT;
+    h->key = key;
+    h->count = (uint32_t)count;
+    h->records = records;
+    h->index = index;
+    h->members = members;
+    h->blocks = boxes;
+    h->strings = strings;
+    h->size = size;
+
+    struct record *r = (void *)((char *)base + records);
+    char *table = (char *)base + strings;
+    size_t offset = 0;
+    for (size_t i = 0; i < count; ++i, ++r) {
+        struct navaid *n = navaids[i];
+        parse_details(n);
+        r->lat = n->coordinate.lat;
+        r->lon = n->coordinate.lon;
+        r->frequency = n->frequency;
+        r->type = n->type;
+        r->elevation = n->elevation;
+        r->range = n->range;
+        r->extra = n->extra.unused;
+        r->code = add_string(table, &offset, n->code);
+        r->icao = add_string(table, &offset, n->icao);
+        r->runway = add_string(table, &offset, n->runway);
+        r->name = add_string(table, &offset, n->name);
+    }
+    r = (void *)((char *)base + records);
+    uint32_t *positions = (void *)((char *)base + index);
+    struct block *block = (void *)((char *)base + boxes);
+    for (size_t i = 0; i < count; ++i) {
+        positions[i] = keyed[i].position;
+        extend_block(&block[i / SNAPSHOT_BLOCK], &r[positions[i]],
+            i % SNAPSHOT_BLOCK == 0);
+    }
+    free(keyed);
+    write_partitions(h, (void *)((char *)base + members), navaids, count);
+
+    BARRIER();
+    h->ready = 1;
+    munmap(base, size);
+
+    replace_current(registry, name);
+    close(registry);
+    return true;
+}
+
+/**
+ * Returns the number of navaids in a snapshot.
+ *
+ * @param snapshot a pointer to a snapshot
+ * @return the number of navaids
+ */
+size_t snapshot_count(const struct snapshot *snapshot)
+{
+    return snapshot->count;
+}
+
+/**
+ * Resolves a string in a snapshot.
+ *
+ * Snapshots are mapped read-only, so the string must not be modified even
+ * though navaid string fields are not const.
+ *
+ * @param snapshot a pointer to a snapshot
+ * @param offset the offset of the string
+ * @return the string, or NULL
+ */
+static char *string(const struct snapshot *snapshot, uint32_t offset)
+{
+    return offset == SNAPSHOT_NULL ? NULL : (char *)snapshot->strings + offset;
+}
+
+/**
+ * Fills a navaid structure from a snapshot record.
+ *
+ * The navaid is a view of the record. Its fixed fields are copied, but its
+ * string fields point into the string table of the snapshot, wherever the
+ * snapshot is mapped, so it must remain attached while the navaid is in
+ * use.
+ *
+ * @param snapshot a pointer to a snapshot
+ * @param i the index of the record
+ * @param navaid a pointer to the navaid structure to fill
+ */
+void snapshot_navaid(const struct snapshot *snapshot, size_t i,
+    struct navaid *navaid)
+{
+    assert(i < snapshot->count);
+    const struct record *r = &snapshot->records[i];
+    navaid->type = (enum NavaidType)r->type;
+    navaid->deferred = false;
+    navaid->details = 0;
+    navaid->coordinate.lat = r->lat;
+    navaid->coordinate.lon = r->lon;
+    navaid->elevation = r->elevation;
+    navaid->range = r->range;
+    navaid->frequency = r->frequency;
+    navaid->extra.unused = r->extra;
+    navaid->code = string(snapshot, r->code);
+    navaid->icao = string(snapshot, r->icao);
+    navaid->runway = string(snapshot, r->runway);
+    navaid->name = string(snapshot, r->name);
+}
+
+/**
+ * Marks the navaids of some types in a snapshot.
+ *
+ * Only the partitions of the types are read.
+ *
+ * @param snapshot a pointer to a snapshot
+ * @param types a bit set of navaid types (bit n for type n)
+ * @param marks a bitmap of (count + 63) / 64 words to receive the marks
+ */
+void snapshot_partitions(const struct snapshot *snapshot, uint64_t types,
+    uint64_t *marks)
+{
+    for (unsigned t = 0; t < SNAPSHOT_TYPES; ++t) {
+        if ((types & (1ULL << t)) == 0)
+            continue;
+        for (uint32_t i = snapshot->partitions[t];
+            i < snapshot->partitions[t + 1]; ++i) {
+            uint32_t p = snapshot->members[i];
+            marks[p / 64] |= (uint64_t)1 << (p % 64);
+        }
+    }
+}
+
+/**
+ * Marks the navaids in a snapshot that may be within a region.
+ *
+ * Only the blocks of the spatial index whose bounding boxes overlap the
+ * region are read. The navaids in them are marked by record index, so the
+ * caller can still visit them in data file order. Marked navaids may still
+ * be outside the region; unmarked navaids are not in it.
+ *
+ * @param snapshot a pointer to a snapshot
+ * @param region a pointer to the region
+ * @param marks a bitmap of (count + 63) / 64 words to receive the marks
+ */
+void snapshot_region(const struct snapshot *snapshot,
+    const struct region *region, uint64_t *marks)
+{
+    size_t blocks = (snapshot->count + SNAPSHOT_BLOCK - 1) / SNAPSHOT_BLOCK;
+    for (size_t b = 0; b < blocks; ++b) {
+        const struct block *block = &snapshot->blocks[b];
+        struct bounds box = {
+            { block->min_lat, block->min_lon },
+            { block->max_lat, block->max_lon }
+        };
+        if (!overlaps_region(region, &box))
+            continue;
+        size_t last = (b + 1) * SNAPSHOT_BLOCK;
+        if (last > snapshot->count)
+            last = snapshot->count;
+        for (size_t i = b * SNAPSHOT_BLOCK; i < last; ++i) {
+            uint32_t p = snapshot->index[i];
+            marks[p / 64] |= (uint64_t)1 << (p % 64);
+        }
+    }
+}
+
+/**
+ * Checks if any other process has a snapshot attached.
+ *
+ * @param snapshot a pointer to a snapshot
+ * @return true if another process holds a lock on the snapshot, or if that
+ * cannot be determined
+ */
+static bool in_use(const struct snapshot *snapshot)
+{
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    return fcntl(snapshot->fd, F_GETLK, &fl) == -1 || fl.l_type != F_UNLCK;
+}
+
+/**
+ * Detaches a snapshot from this process.
+ *
+ * A snapshot outlives the processes that use it, so that later processes
+ * can attach it without loading the navigation data file. Once the file
+ * has changed or been removed, the snapshot is stale, and the last process
+ * to detach it removes it. The next process to publish a new version of
+ * the file also removes it (see replace_current). When the file has been
+ * removed, its registry is removed too.
+ *
+ * @param snapshot a pointer to a snapshot (may be NULL)
+ */
+void detach_snapshot(struct snapshot *snapshot)
+{
+    if (snapshot == NULL)
+        return;
+    munmap(snapshot->base, snapshot->size);
+
+    uint64_t key;
+    bool exists = dataset_key(snapshot->path, &key);
+    if ((!exists || key != snapshot->key) && !in_use(snapshot)) {
+        shm_unlink(snapshot->name);
+        if (!exists) {
+            char registry[SNAPSHOT_NAME_MAX];
+            registry_name(snapshot->path, registry);
+            shm_unlink(registry);
+        }
+    }
+    close(snapshot->fd);
+    free(snapshot->path);
+    free(snapshot);
+}
@@ -0,0 +1,44 @@
+/**
+ * @file snapshot.h
+ *
+ * Share loaded navigation data between processes.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef snapshot_h
+#define snapshot_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct navaid;
+struct region;
+struct snapshot;
+
+struct snapshot *attach_snapshot(const char *path);
+bool publish_snapshot(const char *path, struct navaid **navaids);
+size_t snapshot_count(const struct snapshot *snapshot);
+void snapshot_navaid(const struct snapshot *snapshot, size_t i,
+    struct navaid *navaid);
+void snapshot_partitions(const struct snapshot *snapshot, uint64_t types,
+    uint64_t *marks);
+void snapshot_region(const struct snapshot *snapshot,
+    const struct region *region, uint64_t *marks);
+void detach_snapshot(struct snapshot *snapshot);
+
+#endif
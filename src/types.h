@@ -22,6 +22,8 @@
 #ifndef types_h
 #define types_h
 
+#include <stdbool.h>
+
 /**
  * Maximum length of a navaid code.
  */
@@ -52,7 +54,8 @@ enum NavaidType {
     IM  = 9,    ///< Inner Marker
     DME = 12,   ///< DME component of VOR or ILS
     SDM = 13,   ///< Standalone or NDB DME
-    EOD = 99    ///< End of data marker
+    EOD = 99,   ///< End of data marker
+    FIX = 100   ///< Fix from the fix data file (not a navaid data type)
 };
 
 /**
@@ -76,6 +79,8 @@ struct bounds {
  */
 struct navaid {
     enum NavaidType type;           ///< Type of navaid (VOR, NDB, etc.)
+    bool deferred;                  ///< Elevation, range, extra not decoded
+    unsigned short details;         ///< Offset back from code to elevation
     struct coordinate coordinate;   ///< Coordinate
     int elevation;                  ///< Elevation above sea level in feet
     int range;                      ///< Reception range in nm
@@ -83,13 +88,14 @@ struct navaid {
     union {
         float unused;               ///< NDB unused
         float variation;            ///< VOR twist
-        float bearing;              ///< ILS bearing (true)
+        float bearing;              ///< ILS and marker bearing (true)
+        float slope;                ///< Glideslope angle in degrees
         float bias;                 ///< DME bias
     } extra;                        ///< Navaid specific field
     char *code;                     ///< Identification code
     char *icao;                     ///< Airport ICAO code (ILS/LOC/DME)
     char *runway;                   ///< Runway code (ILS/LOC)
-    char *name;                     ///< Descriptive name
+    char *name;                     ///< Descriptive name, in any case
 };
 
 #endif
@@ -25,8 +25,19 @@
 
 #include "util.h"
 
+#include <ctype.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+/**
+ * Size of the buffer used to read data files row by row. Rows longer than
+ * this are skipped.
+ */
+#define ROW_CHUNK (256 * 1024)
 
 /**
  * Appends a string to a buffer with bounds checking.
@@ -43,6 +54,275 @@ char *append(char *buf, const char *s, size_t size)
     return strcat(buf, s);
 }
 
+/**
+ * Creates the path to a file in the user's cache directory for nvs.
+ *
+ * The directory is $XDG_CACHE_HOME/nvs, or $HOME/.cache/nvs if
+ * XDG_CACHE_HOME is not set, and is created if it does not exist. Caches
+ * are an optimization, so if there is no usable directory NULL is
+ * returned rather than terminating the program.
+ *
+ * The pointer returned must be freed after use.
+ *
+ * @param name the name of the file in the cache directory
+ * @return the path to the file, or NULL if there is no cache directory
+ */
+char *cache_path(const char *name)
+{
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char *dir;
+    char *cache;
+    if (base != NULL && *base != '\0')
+        cache = strdup_f(base);
+    else if (home != NULL && *home != '\0')
+        cache = data_path(home, ".cache");
+    else
+        return NULL;
+
+    if (mkdir(cache, 0755) != 0 && errno != EEXIST) {
+        free(cache);
+        return NULL;
+    }
+    dir = data_path(cache, "nvs");
+    free(cache);
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        free(dir);
+        return NULL;
+    }
+    char *path = data_path(dir, name);
+    free(dir);
+    return path;
+}
+
+/**
+ * Checks if a string starts with a term, ignoring the case of the string.
+ *
+ * @param s the string
+ * @param term the term, in uppercase
+ * @return true if the string starts with the term
+ */
+static bool starts_with(const char *s, const char *term)
+{
+    while (*term != '\0' && toupper((unsigned char)*s) == *term) {
+        ++s;
+        ++term;
+    }
+    return *term == '\0';
+}
+
+/**
+ * Checks if a string contains a term, ignoring the case of the string.
+ *
+ * If the term has a character without case, such as the '-' in "DME-ILS",
+ * the string is scanned for that character with strchr, which is much
+ * faster than comparing at every position.
+ *
+ * @param s the string to search
+ * @param term the term to search for, in uppercase
+ * @return true if the string contains the term
+ */
+bool contains(const char *s, const char *term)
+{
+    size_t k = 0;
+    while (term[k] != '\0' && isalpha((unsigned char)term[k]))
+        ++k;
+    if (term[k] != '\0') {
+        for (const char *p = strchr(s, term[k]); p != NULL;
+            p = strchr(p + 1, term[k]))
+            if ((size_t)(p - s) >= k && starts_with(p - k, term))
+                return true;
+        return false;
+    }
+    for (; *s != '\0'; ++s)
+        if (starts_with(s, term))
+            return true;
+    return *term == '\0';
+}
+
+/**
+ * Creates the path to a file in a directory, such as FG_ROOT.
+ *
+ * The pointer returned must be freed after use.
+ *
+ * @param dir the directory
+ * @param name the path of the file relative to the directory
+ * @return the path to the file
+ */
+char *data_path(const char *dir, const char *name)
+{
+    char *path = NULL;
+    size_t size = strlen(dir) + strlen("/") + strlen(name) + 1;
+    if ((path = malloc(size)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(path, size, "%s/%s", dir, name);
+    return path;
+}
+
+/**
+ * Updates a 64-bit FNV-1a hash with a block of data.
+ *
+ * FNV-1a is not a cryptographic hash, but it is fast and well distributed,
+ * which is all that is needed for keying caches. Start a new hash with
+ * FNV_OFFSET.
+ *
+ * @param data the data to hash
+ * @param size the size of the data in bytes
+ * @param hash the hash so far
+ * @return the updated hash
+ */
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash)
+{
+    const unsigned char *p = data;
+    while (size--) {
+        hash ^= *p++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Matches a string against a simple glob pattern.
+ *
+ * The wildcard '*' matches any sequence of characters, including an empty
+ * sequence, and '?' matches any single character. All other characters
+ * match themselves.
+ *
+ * @param pattern the glob pattern
+ * @param s the string to match
+ * @return true if the string matches the pattern
+ */
+bool glob(const char *pattern, const char *s)
+{
+    const char *star = NULL, *resume = NULL;
+    while (*s) {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = s;
+        } else if (*pattern == '?' || *pattern == *s) {
+            ++pattern;
+            ++s;
+        } else if (star != NULL) {
+            pattern = star + 1;
+            s = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*')
+        ++pattern;
+    return *pattern == '\0';
+}
+
+/**
+ * Returns the length of the literal prefix of a glob pattern.
+ *
+ * The literal prefix is the part of the pattern before the first wildcard.
+ * If the pattern has no wildcards, this is the length of the pattern.
+ *
+ * @param pattern the glob pattern
+ * @return the length of the literal prefix
+ */
+size_t glob_prefix(const char *pattern)
+{
+    return strcspn(pattern, "*?");
+}
+
+/**
+ * Reads a data file row by row, passing each row to a function.
+ *
+ * The file may be compressed with gzip or not. It is read in fixed size
+ * chunks and split into rows in place, with a partial row at the end of a
+ * chunk carried over to the next, so rows are never copied or allocated.
+ * The function may modify the row. If the file cannot be read, the program
+ * is terminated with an exit status.
+ *
+ * @param path the path to the data file
+ * @param row the function to call for each row
+ * @param data data passed to the function
+ */
+void read_rows(const char *path, row_function row, void *data)
+{
+    gzFile gz;
+    if ((gz = gzopen(path, "rb")) == NULL) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    gzbuffer(gz, ROW_CHUNK);
+
+    char *buffer;
+    if ((buffer = malloc(ROW_CHUNK + 1)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t used = 0;
+    bool overlong = false;
+    for (;;) {
+        int n = gzread(gz, buffer + used, (unsigned)(ROW_CHUNK - used));
+        if (n < 0) {
+            int errnum;
+            fprintf(stderr, "%s: %s\n", path, gzerror(gz, &errnum));
+            exit(EXIT_FAILURE);
+        }
+        char *p = buffer, *limit = buffer + used + n, *newline;
+        while ((newline = memchr(p, '\n', limit - p)) != NULL) {
+            *newline = '\0';
+            if (!overlong)
+                row(p, data);
+            overlong = false;
+            p = newline + 1;
+        }
+        used = limit - p;
+        if (n == 0) {
+            if (used > 0 && !overlong) {
+                p[used] = '\0';
+                row(p, data);
+            }
+            break;
+        }
+        if (used == ROW_CHUNK) {
+            overlong = true;
+            used = 0;
+        } else {
+            memmove(buffer, p, used);
+        }
+    }
+
+    free(buffer);
+    gzclose(gz);
+}
+
+/**
+ * Ensures that a dynamic array has capacity for a number of elements.
+ *
+ * The capacity is doubled as needed, so appending elements one at a time
+ * takes amortized constant time. This function never returns NULL.
+ *
+ * @param array the array, or NULL
+ * @param capacity a pointer to the capacity of the array, updated
+ * @param needed the number of elements needed
+ * @param size the size of an element
+ * @return the array, possibly moved
+ */
+void *reserve(void *array, size_t *capacity, size_t needed, size_t size)
+{
+    if (needed <= *capacity)
+        return array;
+    size_t n = *capacity > 0 ? *capacity : 1024;
+    while (n < needed)
+        n *= 2;
+    if ((array = realloc(array, n * size)) == NULL) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = n;
+    return array;
+}
+
 /**
  * Duplicates a string in dynamic storage.
  *
@@ -22,9 +22,29 @@
 #ifndef util_h
 #define util_h
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/**
+ * Initial value for FNV-1a hashes.
+ */
+#define FNV_OFFSET 14695981039346656037ULL
+
+/**
+ * Function called for each row of a data file.
+ */
+typedef void (*row_function)(char *row, void *data);
+
 char *append(char *buf, const char *s, size_t size);
+char *cache_path(const char *name);
+bool contains(const char *s, const char *term);
+char *data_path(const char *dir, const char *name);
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash);
+bool glob(const char *pattern, const char *s);
+void read_rows(const char *path, row_function row, void *data);
+void *reserve(void *array, size_t *capacity, size_t needed, size_t size);
+size_t glob_prefix(const char *pattern);
 char *strdup_f(const char *s);
 
 #endif
@@ -0,0 +1,151 @@
+/**
+ * @file test_filter.c
+ *
+ * Tests of filter expressions at the precision of the navaid fields.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filter.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "types.h"
+
+/**
+ * Maximum length of a filter expression built by a test.
+ */
+#define EXPRESSION_MAX 64
+
+/**
+ * Number of copies of the navaid filtered as a cache, enough to fill one
+ * block and part of another.
+ */
+#define COPIES 100
+
+/**
+ * Number of failed checks.
+ */
+static int failures;
+
+/**
+ * Checks whether a filter selects a navaid.
+ *
+ * The navaid is filtered both through run_filter, which compares blocks of
+ * navaids, and through test_filter, which compares one navaid.
+ *
+ * @param expression the filter expression
+ * @param navaid a pointer to the navaid
+ * @param expected true if the navaid should be selected
+ */
+static void expect(const char *expression, struct navaid *navaid,
+    bool expected)
+{
+    struct navaid *cache[COPIES + 1];
+    for (int i = 0; i < COPIES; ++i)
+        cache[i] = navaid;
+    cache[COPIES] = NULL;
+
+    struct filter *filter = compile_filter(expression);
+    uint64_t *selection = run_filter(filter, cache, NULL);
+    for (int i = 0; i < COPIES; ++i) {
+        bool selected = (selection[i / 64] >> (i % 64)) & 1;
+        if (selected != expected) {
+            fprintf(stderr, "run_filter(\"%s\") %s navaid %d\n", expression,
+                selected ? "selected" : "rejected", i);
+            ++failures;
+            break;
+        }
+    }
+    if (test_filter(filter, navaid) != expected) {
+        fprintf(stderr, "test_filter(\"%s\") %s the navaid\n", expression,
+            expected ? "rejected" : "selected");
+        ++failures;
+    }
+    free(selection);
+    destroy_filter(filter);
+}
+
+/**
+ * Checks comparisons of a field with the values one unit in the last
+ * place either side of its value.
+ *
+ * @param field the name of the field
+ * @param value the value of the field in the navaid
+ * @param navaid a pointer to the navaid
+ */
+static void expect_exact(const char *field, double value,
+    struct navaid *navaid)
+{
+    char expression[EXPRESSION_MAX];
+    double below = nextafter(value, -HUGE_VAL);
+    double above = nextafter(value, HUGE_VAL);
+
+    snprintf(expression, sizeof(expression), "%s=%.17g", field, value);
+    expect(expression, navaid, true);
+    snprintf(expression, sizeof(expression), "%s=%.17g", field, above);
+    expect(expression, navaid, false);
+    snprintf(expression, sizeof(expression), "%s>=%.17g", field, above);
+    expect(expression, navaid, false);
+    snprintf(expression, sizeof(expression), "%s<%.17g", field, above);
+    expect(expression, navaid, true);
+    snprintf(expression, sizeof(expression), "%s<=%.17g", field, below);
+    expect(expression, navaid, false);
+    snprintf(expression, sizeof(expression), "%s>%.17g", field, below);
+    expect(expression, navaid, true);
+    snprintf(expression, sizeof(expression), "%s in %.17g-%.17g", field,
+        above, HUGE_VAL);
+    expect(expression, navaid, false);
+}
+
+/**
+ * Runs the tests.
+ *
+ * @return the exit status, failure if any check failed
+ */
+int main(void)
+{
+    struct navaid pole_hill = {
+        .type = VOR, .coordinate = { 53.929444, -2.157528 },
+        .elevation = 1400, .range = 150, .frequency = 11210 / 100.0,
+        .code = "POL", .name = "POLE HILL VOR-DME"
+    };
+    expect("lat>=53.929444", &pole_hill, true);
+    expect("lat>=53.9294441", &pole_hill, false);
+    expect("lon<=-2.1575281", &pole_hill, false);
+    expect("freq=112.1", &pole_hill, true);
+    expect("freq>112.100001", &pole_hill, false);
+    expect("freq in 112.1-112.1", &pole_hill, true);
+    expect("elevation=1400 and range>=150", &pole_hill, true);
+    expect_exact("lat", pole_hill.coordinate.lat, &pole_hill);
+    expect_exact("lon", pole_hill.coordinate.lon, &pole_hill);
+    expect_exact("freq", pole_hill.frequency, &pole_hill);
+
+    struct navaid ndb = {
+        .type = NDB, .coordinate = { 51.477222, -0.461389 },
+        .range = 25, .frequency = 362.5, .code = "LON", .name = "LONDON NDB"
+    };
+    expect("freq=362.5", &ndb, true);
+    expect("freq<362.50001", &ndb, true);
+    expect("freq>=362.50001", &ndb, false);
+    expect_exact("freq", ndb.frequency, &ndb);
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file test_parse.c
+ *
+ * Tests of parsing navaids from 810 format records.
+ *
+ * Copyright (c) 2017 Richard Senior
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parse.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+/**
+ * Maximum length of a record parsed by a test.
+ */
+#define RECORD_MAX 256
+
+/**
+ * Number of failed checks.
+ */
+static int failures;
+
+/**
+ * Expected fields of a navaid.
+ */
+struct expected {
+    enum NavaidType type;   ///< Type of navaid
+    int elevation;          ///< Elevation above sea level in feet
+    int range;              ///< Reception range in nm
+    float extra;            ///< Navaid specific field
+    const char *code;       ///< Identification code
+    const char *icao;       ///< Airport ICAO code, NULL if none
+    const char *runway;     ///< Runway code, NULL if none
+    const char *name;       ///< Descriptive name
+};
+
+/**
+ * Checks that a string field has the expected value.
+ *
+ * @param record the record parsed
+ * @param field the name of the field
+ * @param actual the value parsed (may be NULL)
+ * @param expected the value expected (may be NULL)
+ */
+static void check_string(const char *record, const char *field,
+    const char *actual, const char *expected)
+{
+    if (actual == NULL && expected == NULL)
+        return;
+    if (actual == NULL || expected == NULL || strcmp(actual, expected) != 0) {
+        fprintf(stderr, "%s: %s is \"%s\", expected \"%s\"\n", record, field,
+            actual != NULL ? actual : "(null)",
+            expected != NULL ? expected : "(null)");
+        ++failures;
+    }
+}
+
+/**
+ * Checks that a numeric field has the expected value.
+ *
+ * @param record the record parsed
+ * @param field the name of the field
+ * @param actual the value parsed
+ * @param expected the value expected
+ */
+static void check_number(const char *record, const char *field,
+    double actual, double expected)
+{
+    if (fabs(actual - expected) > 1e-4) {
+        fprintf(stderr, "%s: %s is %g, expected %g\n", record, field, actual,
+            expected);
+        ++failures;
+    }
+}
+
+/**
+ * Parses a record and checks its fields, including the deferred ones.
+ *
+ * @param record the 810 format record
+ * @param e the expected fields
+ */
+static void expect(const char *record, const struct expected *e)
+{
+    char line[RECORD_MAX];
+    snprintf(line, sizeof(line), "%s", record);
+
+    struct navaid navaid;
+    if (!parse(line, &navaid)) {
+        fprintf(stderr, "%s: not parsed\n", record);
+        ++failures;
+        return;
+    }
+    parse_details(&navaid);
+    check_number(record, "type", navaid.type, e->type);
+    check_number(record, "elevation", navaid.elevation, e->elevation);
+    check_number(record, "range", navaid.range, e->range);
+    check_number(record, "extra", navaid.extra.unused, e->extra);
+    check_string(record, "code", navaid.code, e->code);
+    check_string(record, "icao", navaid.icao, e->icao);
+    check_string(record, "runway", navaid.runway, e->runway);
+    check_string(record, "name", navaid.name, e->name);
+}
+
+/**
+ * Runs the tests.
+ *
+ * @return the exit status, failure if any check failed
+ */
+int main(void)
+{
+    expect("3 53.92944400 -002.15752800 1400 11210 150 -3.0 POL "
+        "POLE HILL VOR-DME", &(struct expected){
+        VOR, 1400, 150, -3.0f, "POL", NULL, NULL, "POLE HILL VOR-DME"
+    });
+    expect("3\t 53.929444   -2.157528\t\t1400    11210  150   -3.0 \t POL"
+        "   POLE  HILL VOR-DME", &(struct expected){
+        VOR, 1400, 150, -3.0f, "POL", NULL, NULL, "POLE  HILL VOR-DME"
+    });
+    expect("2  51.477222  -0.461389      0   362   25    0.0  lon  "
+        "London Heathrow Beacon NDB", &(struct expected){
+        NDB, 0, 25, 0.0f, "LON", NULL, NULL, "London Heathrow Beacon NDB"
+    });
+    expect("4 51.464872 -0.434056    80 11030  18   269.720 IRR  EGLL "
+        "27R ILS-cat-I", &(struct expected){
+        ILS, 80, 18, 269.72f, "IRR", "EGLL", "27R", "ILS-cat-I"
+    });
+    expect("6 51.464872 -0.434056 \t 80 11030 10 300269.720\t\tIRR EGLL 27R"
+        "    GS", &(struct expected){
+        GS, 80, 10, 3.0f, "IRR", "EGLL", "27R", "GS"
+    });
+    expect("12  53.929444 -2.157528   1400  11210  199   0.000  POL  "
+        "POLE HILL VOR-DME", &(struct expected){
+        DME, 1400, 199, 0.0f, "POL", NULL, NULL, "POLE HILL VOR-DME"
+    });
+    expect("12 51.464872 -0.434056    80 11030  18   0.000 IRR  EGLL 27R "
+        "DME-ILS", &(struct expected){
+        DME, 80, 18, 0.0f, "IRR", "EGLL", "27R", "DME-ILS"
+    });
+    expect("2 51.0 -1.0 -12 338 50 0.0 N NEW  FOREST 338 NDB",
+        &(struct expected){
+        NDB, -12, 50, 0.0f, "N", NULL, NULL, "NEW  FOREST 338 NDB"
+    });
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}